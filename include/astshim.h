@@ -2,15 +2,23 @@
 #define ASTSHIM_H
 
 #include "astshim/base.h"
+#include "astshim/MemoryReport.h"
 #include "astshim/Object.h"
 #include "astshim/Stream.h"
 #include "astshim/Channel.h"
 #include "astshim/MapBox.h"
 #include "astshim/MapSplit.h"
 #include "astshim/QuadApprox.h"
+#include "astshim/ScratchArena.h"
+#include "astshim/PointStream.h"
+#include "astshim/Resample.h"
+#include "astshim/Warp.h"
 #include "astshim/Mapping.h"
+#include "astshim/CompiledMapping.h"
+#include "astshim/Rebinner.h"
 #include "astshim/Frame.h"
 #include "astshim/FrameSet.h"
+#include "astshim/Interner.h"
 
 // channels
 #include "astshim/FitsChan.h"
@@ -23,7 +31,9 @@
 #include "astshim/TimeFrame.h"
 
 // mappings
+#include "astshim/ChebyMap.h"
 #include "astshim/CmpMap.h"
+#include "astshim/GridMap.h"
 #include "astshim/LutMap.h"
 #include "astshim/MathMap.h"
 #include "astshim/MatrixMap.h"
@@ -0,0 +1,355 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_CHEBYMAP_H
+#define ASTSHIM_CHEBYMAP_H
+
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/Mapping.h"
+
+namespace ast {
+
+/**
+The bounding box over which one transform of a @ref ChebyMap is defined; see @ref ChebyMap.getDomain
+*/
+class ChebyDomain {
+public:
+    /**
+    Construct a ChebyDomain
+
+    @param[in] lbnd  Lower bound of the box along each axis
+    @param[in] ubnd  Upper bound of the box along each axis
+    */
+    ChebyDomain(std::vector<double> const & lbnd, std::vector<double> const & ubnd) :
+        lbnd(lbnd), ubnd(ubnd) {}
+
+    std::vector<double> const lbnd;  ///< lower bound of the box along each axis
+    std::vector<double> const ubnd;  ///< upper bound of the box along each axis
+};
+
+/**
+A ChebyMap is a form of @ref PolyMap in which each output coordinate is a sum of Chebyshev polynomials
+of the input coordinates, rather than of powers of them.
+
+Each transform is defined over a bounding box: each input coordinate is first scaled to the range [-1, 1]
+over the box, then each term of an output is a coefficient times the product of Chebyshev polynomials
+of the first kind, one of each scaled input, of specified degrees. Input positions outside the box
+give bad output values.
+
+A Chebyshev series is much better conditioned than the equivalent sum of powers, so a high order
+distortion model is fitted and evaluated more accurately as a ChebyMap than as a @ref PolyMap.
+
+As for a @ref PolyMap, the forward and inverse transforms are independent, and a transform that
+is not specified may be fitted with @ref polyTran (or, if the `IterInverse` attribute is set,
+the inverse may be evaluated iteratively from the forward transform).
+
+### Attributes
+
+ChebyMap has the attributes of @ref PolyMap:
+
+- @ref PolyMap_IterInverse "IterInverse": provide an iterative inverse transformation?
+- @ref PolyMap_NiterInverse "NiterInverse": maximum number of iterations for iterative inverse.
+- @ref PolyMap_TolInverse "TolInverse": target relative error for iterative inverse.
+
+### Notes
+
+- @ref Mapping.freeze "Freezing" the mapping evaluates each transform that is defined by coefficients
+    natively, by nested Clenshaw recurrences.
+- A ChebyMap is written to and read from a @ref Channel or @ref FitsChan like any other mapping.
+*/
+class ChebyMap : public Mapping {
+friend class Object;
+public:
+    /**
+    Construct a ChebyMap with specified forward and inverse transforms.
+
+    @param[in] coeff_f  A `ncoeff_f x (2 + nin)` matrix of coefficients of the forward transform.
+            Each row describes one term: the first element is the coefficient value;
+            the next element is the index of the output that uses the term (the first output
+            has index 1); the remaining elements are the degrees of the Chebyshev polynomials
+            of each input (degrees must not be negative, and floating point values are rounded
+            to the nearest integer).
+
+            For instance, if the ChebyMap has 2 inputs and 2 outputs, the row "(1.2, 2.0, 1.0, 3.0)"
+            adds 1.2 T1(x') T3(y') to output 2, where x' and y' are the inputs scaled to [-1, 1]
+            over the bounding box of the forward transform.
+    @param[in] coeff_i  A `ncoeff_i x (2 + nout)` matrix of coefficients of the inverse transform,
+            in the same form as `coeff_f` with "inputs" and "outputs" exchanged.
+    @param[in] lbnd_f  Lower bounds of the box over which the forward transform is defined,
+            one per input axis.
+    @param[in] ubnd_f  Upper bounds of the box over which the forward transform is defined,
+            one per input axis.
+    @param[in] lbnd_i  Lower bounds of the box over which the inverse transform is defined,
+            one per output axis.
+    @param[in] ubnd_i  Upper bounds of the box over which the inverse transform is defined,
+            one per output axis.
+    @param[in] options  Comma-separated list of attribute assignments.
+
+    @throw std::invalid_argument if the rows of `coeff_f` or `coeff_i` are too short
+            or a bound has the wrong length.
+    */
+    explicit ChebyMap(
+        ndarray::Array<double, 2, 2> const & coeff_f,
+        ndarray::Array<double, 2, 2> const & coeff_i,
+        std::vector<double> const & lbnd_f,
+        std::vector<double> const & ubnd_f,
+        std::vector<double> const & lbnd_i,
+        std::vector<double> const & ubnd_i,
+        std::string const & options=""
+    ) :
+        Mapping(reinterpret_cast<AstMapping *>(
+            _makeRawChebyMap(coeff_f, coeff_i, lbnd_f, ubnd_f, lbnd_i, ubnd_i, options)))
+    {}
+
+    /**
+    Construct a ChebyMap with only the forward transform specified.
+
+    The inverse may be fitted with @ref polyTran, or determined iteratively if `IterInverse`
+    is set in `options`.
+
+    @param[in] coeff_f  A `ncoeff_f x (2 + nin)` matrix of coefficients of the forward transform,
+            as for the other constructor.
+    @param[in] nout  Number of output coordinates.
+    @param[in] lbnd_f  Lower bounds of the box over which the forward transform is defined,
+            one per input axis.
+    @param[in] ubnd_f  Upper bounds of the box over which the forward transform is defined,
+            one per input axis.
+    @param[in] options  Comma-separated list of attribute assignments.
+
+    @throw std::invalid_argument if the rows of `coeff_f` are too short, `nout` is not positive
+            or a bound has the wrong length.
+    */
+    explicit ChebyMap(
+        ndarray::Array<double, 2, 2> const & coeff_f,
+        int nout,
+        std::vector<double> const & lbnd_f,
+        std::vector<double> const & ubnd_f,
+        std::string const & options=""
+    ) :
+        Mapping(reinterpret_cast<AstMapping *>(_makeRawChebyMap(coeff_f, nout, lbnd_f, ubnd_f, options)))
+    {}
+
+    /// Cast an object to a ChebyMap if possible, else throw std::runtime_error
+    explicit ChebyMap(Object & obj) : ChebyMap(detail::shallowCopy<AstChebyMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
+
+    virtual ~ChebyMap() {}
+
+    ChebyMap(ChebyMap const &) = default;
+    ChebyMap(ChebyMap &&) = default;
+    ChebyMap & operator=(ChebyMap const &) = default;
+    ChebyMap & operator=(ChebyMap &&) = default;
+
+    /// Return a deep copy of this object.
+    std::shared_ptr<ChebyMap> copy() const { return _copy<ChebyMap, AstChebyMap>(); }
+
+    /// Get @ref PolyMap_IterInverse "IterInverse": provide an iterative inverse transformation?
+    bool getIterInverse() const { return getB("IterInverse"); }
+
+    /// Get @ref PolyMap_NiterInverse "NiterInverse": maximum number of iterations for iterative inverse.
+    int getNiterInverse() const { return getI("NiterInverse"); }
+
+    /// Get @ref PolyMap_TolInverse "TolInverse": target relative error for iterative inverse.
+    double getTolInverse() const { return getD("TolInverse"); }
+
+    /**
+    Return the bounding box over which a transform is defined
+
+    @param[in] forward  If true, return the box of the forward transform (in input coordinates),
+                    else the box of the inverse transform (in output coordinates).
+    @return the box; bounds are NaN if that transform is not defined by coefficients
+                    and has no box (e.g. it is iterative and the forward transform has no box).
+    */
+    ChebyDomain getDomain(bool forward) const {
+        int const nAxes = forward ? getNin() : getNout();
+        std::vector<double> lbnd(nAxes, 0.0);
+        std::vector<double> ubnd(nAxes, 0.0);
+        astChebyDomain(getRawPtr(), static_cast<int>(forward), lbnd.data(), ubnd.data());
+        assertOK();
+        for (int i = 0; i < nAxes; ++i) {
+            if (lbnd[i] == AST__BAD) {
+                lbnd[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+            if (ubnd[i] == AST__BAD) {
+                ubnd[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+        return ChebyDomain(lbnd, ubnd);
+    }
+
+    /**
+    Return a copy of this ChebyMap in which one transform is replaced by a Chebyshev series fitted
+    to the other transform over a given box.
+
+    This works as @ref PolyMap.polyTran, except that the new transform is a Chebyshev series
+    defined over the box it was fitted to.
+
+    @param[in] forward  If true the forward transformation is replaced.
+                    Otherwise the inverse transformation is replaced.
+    @param[in] acc  The target accuracy, expressed as a geodesic distance within
+                    the ChebyMap's input space (if `forward` is true)
+                    or output space (if `forward` is false).
+    @param[in] maxacc  The maximum allowed accuracy for an acceptable fit,
+                    expressed as a geodesic distance within the ChebyMap's input space
+                    (if `forward` is true) or output space (if `forward` is false).
+    @param[in] maxorder  The maximum allowed order: one more than the maximum degree along any axis.
+    @param[in] lbnd  Lower bounds of the box to fit over, in the ChebyMap's input space
+                    (if `forward` is true) or output space (if `forward` is false).
+    @param[in] ubnd  Upper bounds of the box to fit over, as for `lbnd`.
+
+    @throw std::invalid_argument if lbnd.size() or ubnd.size() does not match getNin()/getNout()
+                    if `forward` is true/false.
+    */
+    ChebyMap polyTran(
+        bool forward,
+        double acc,
+        double maxacc,
+        int maxorder,
+        std::vector<double> const & lbnd,
+        std::vector<double> const & ubnd
+    ) const {
+        int const desSize = forward ? getNin() : getNout();
+        detail::assertEqual(lbnd.size(), "lbnd.size()", static_cast<std::size_t>(desSize),
+                            forward ? "getNin()" : "getNout()");
+        detail::assertEqual(ubnd.size(), "ubnd.size()", static_cast<std::size_t>(desSize),
+                            forward ? "getNin()" : "getNout()");
+        void * map = astPolyTran(getRawPtr(), static_cast<int>(forward), acc, maxacc, maxorder,
+                                 lbnd.data(), ubnd.data());
+        return ChebyMap(reinterpret_cast<AstChebyMap *>(map));
+    }
+
+    /**
+    Return a copy of this ChebyMap in which one transform is replaced by a Chebyshev series fitted
+    to the other transform over the bounding box of the other transform.
+
+    For example, if `forward` is false the new inverse transform is fitted over
+    the box spanned by the forward transform's outputs over the forward transform's box.
+
+    @param[in] forward  If true the forward transformation is replaced.
+                    Otherwise the inverse transformation is replaced.
+    @param[in] acc  The target accuracy, as for the other overload.
+    @param[in] maxacc  The maximum allowed accuracy for an acceptable fit, as for the other overload.
+    @param[in] maxorder  The maximum allowed order, as for the other overload.
+    */
+    ChebyMap polyTran(bool forward, double acc, double maxacc, int maxorder) const {
+        void * map = astPolyTran(getRawPtr(), static_cast<int>(forward), acc, maxacc, maxorder,
+                                 nullptr, nullptr);
+        return ChebyMap(reinterpret_cast<AstChebyMap *>(map));
+    }
+
+private:
+    /// Construct a ChebyMap from a raw AST pointer
+    explicit ChebyMap(AstChebyMap * map) :
+        Mapping(reinterpret_cast<AstMapping *>(map))
+    {
+        if (!astIsAChebyMap(getRawPtr())) {
+            std::ostringstream os;
+            os << "this is a " << getClass() << ", which is not a ChebyMap";
+            throw std::invalid_argument(os.str());
+        }
+    }
+
+    /// Check that each of a set of bounds has the expected length
+    static void _assertBoundsSize(std::vector<double> const & lbnd, std::vector<double> const & ubnd,
+                                  int nAxes, std::string const & suffix) {
+        detail::assertEqual(lbnd.size(), "lbnd" + suffix + ".size()", static_cast<std::size_t>(nAxes),
+                            "number of axes");
+        detail::assertEqual(ubnd.size(), "ubnd" + suffix + ".size()", static_cast<std::size_t>(nAxes),
+                            "number of axes");
+    }
+
+    /// Make a raw AstChebyMap with forward and inverse transforms.
+    static AstChebyMap * _makeRawChebyMap(
+        ndarray::Array<double, 2, 2> const & coeff_f,
+        ndarray::Array<double, 2, 2> const & coeff_i,
+        std::vector<double> const & lbnd_f,
+        std::vector<double> const & ubnd_f,
+        std::vector<double> const & lbnd_i,
+        std::vector<double> const & ubnd_i,
+        std::string const & options
+    ) {
+        int const nin = coeff_f.getSize<1>() - 2;
+        int const ncoeff_f = coeff_f.getSize<0>();
+        int const nout = coeff_i.getSize<1>() - 2;
+        int const ncoeff_i = coeff_i.getSize<0>();
+        if (nin <= 0) {
+            std::ostringstream os;
+            os << "coeff_f row length = " << nin + 2
+                << ", which is too short; length = nin + 2 and nin must be > 0";
+            throw std::invalid_argument(os.str());
+        }
+        if (nout <= 0) {
+            std::ostringstream os;
+            os << "coeff_i row length " << nout + 2
+                << ", which is too short; length = nout + 2 and nout must be > 0";
+            throw std::invalid_argument(os.str());
+        }
+        _assertBoundsSize(lbnd_f, ubnd_f, nin, "_f");
+        _assertBoundsSize(lbnd_i, ubnd_i, nout, "_i");
+
+        void * map = astChebyMap(nin, nout, ncoeff_f, coeff_f.getData(), ncoeff_i, coeff_i.getData(),
+                                 lbnd_f.data(), ubnd_f.data(), lbnd_i.data(), ubnd_i.data(),
+                                 options.c_str());
+        assertOK(reinterpret_cast<AstObject *>(map));
+        return reinterpret_cast<AstChebyMap *>(map);
+    }
+
+    /// Make a raw AstChebyMap with only a forward transform.
+    static AstChebyMap * _makeRawChebyMap(
+        ndarray::Array<double, 2, 2> const & coeff_f,
+        int nout,
+        std::vector<double> const & lbnd_f,
+        std::vector<double> const & ubnd_f,
+        std::string const & options
+    ) {
+        int const nin = coeff_f.getSize<1>() - 2;
+        int const ncoeff_f = coeff_f.getSize<0>();
+        if (nin <= 0) {
+            std::ostringstream os;
+            os << "coeff_f row length = " << nin + 2
+                << ", which is too short; length = nin + 2 and nin must be > 0";
+            throw std::invalid_argument(os.str());
+        }
+        if (nout <= 0) {
+            std::ostringstream os;
+            os << "nout = " << nout << " <= 0";
+            throw std::invalid_argument(os.str());
+        }
+        _assertBoundsSize(lbnd_f, ubnd_f, nin, "_f");
+
+        void * map = astChebyMap(nin, nout, ncoeff_f, coeff_f.getData(), 0, nullptr,
+                                 lbnd_f.data(), ubnd_f.data(), nullptr, nullptr, options.c_str());
+        assertOK(reinterpret_cast<AstObject *>(map));
+        return reinterpret_cast<AstChebyMap *>(map);
+    }
+};
+
+}  // namespace ast
+
+#endif
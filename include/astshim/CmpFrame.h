@@ -76,7 +76,9 @@ public:
     {}
 
     /// Cast an object to a CmpFrame if possible, else throw std::runtime_error
-    explicit CmpFrame(Object & obj) : CmpFrame(detail::shallowCopy<AstCmpFrame>(obj.getRawPtr())) {}
+    explicit CmpFrame(Object & obj) : CmpFrame(detail::shallowCopy<AstCmpFrame>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~CmpFrame() {}
 
@@ -74,7 +74,9 @@ public:
     {}
 
     /// Cast an object to a CmpMap if possible, else throw std::runtime_error
-    explicit CmpMap(Object & obj) : CmpMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {}
+    explicit CmpMap(Object & obj) : CmpMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~CmpMap() {}
 
@@ -0,0 +1,173 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_COMPILEDMAPPING_H
+#define ASTSHIM_COMPILEDMAPPING_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+
+namespace ast {
+class Mapping;
+
+namespace detail {
+class Kernel;
+}
+
+/**
+An immutable snapshot of a @ref Mapping, compiled into an evaluation plan
+that any number of threads may use concurrently without locking.
+
+Construct with @ref Mapping.freeze (or the constructor, which is equivalent).
+The mapping is simplified and flattened into a tree of kernels held in plain C++ data structures:
+- Linear mappings (e.g. @ref MatrixMap, @ref ShiftMap, @ref WinMap, @ref ZoomMap, @ref PermMap
+    and @ref UnitMap), and runs of them, become a single affine transformation.
+- @ref PolyMap "PolyMaps" become polynomial coefficient tables.
+- @ref ChebyMap "ChebyMaps" become dense arrays of Chebyshev coefficients, summed by Clenshaw recurrences.
+- @ref GridMap "GridMaps" become displacement tables, interpolated natively.
+- @ref SphMap "SphMaps" and @ref UnitNormMap "UnitNormMaps" are evaluated natively, with vectorized
+    trigonometric functions.
+- @ref SlaMap "SlaMaps" fall back, but @ref optimizeSkyConversion replaces the conversions in them
+    that are fixed rotations by (@ref SphMap, @ref MatrixMap, @ref SphMap), which do not.
+- Series and parallel @ref CmpMap "compound mappings" are flattened into sequences of kernels.
+- Anything else falls back to calling AST on a private copy of that component. These calls are
+    serialized by a mutex, so they do not run concurrently. If AST was built without thread support
+    the mutex is process-wide, and a CompiledMapping that falls back may only be used by several
+    threads at once if nothing else calls AST meanwhile, since AST's error status is then global.
+    Use @ref getPlan or @ref isNative to see which components fell back.
+
+Native kernels agree with AST to within rounding error, but not necessarily to the last bit.
+A CompiledMapping does not change if the original @ref Mapping is later modified.
+Copies share the same (immutable) plan.
+*/
+class CompiledMapping {
+public:
+    /**
+    Compile a mapping
+
+    @param[in] map  Mapping to compile
+    */
+    explicit CompiledMapping(Mapping const & map);
+
+    ~CompiledMapping() {}
+
+    CompiledMapping(CompiledMapping const &) = default;
+    CompiledMapping(CompiledMapping &&) = default;
+    CompiledMapping & operator=(CompiledMapping const &) = default;
+    CompiledMapping & operator=(CompiledMapping &&) = default;
+
+    /// Get the number of input axes
+    int getNin() const { return _nIn; }
+
+    /// Get the number of output axes
+    int getNout() const { return _nOut; }
+
+    /// Is the forward transform available?
+    bool getTranForward() const { return static_cast<bool>(_forward); }
+
+    /// Is the inverse transform available?
+    bool getTranInverse() const { return static_cast<bool>(_inverse); }
+
+    /**
+    Return the names of the leaf kernels of a plan, in evaluation order
+
+    Native kernels have names such as "Affine" and "Poly";
+    components that fall back to AST are reported by their AST class name.
+
+    @param[in] forward  Describe the forward plan? Otherwise describe the inverse plan.
+
+    @throw std::runtime_error if the requested transform is not available.
+    */
+    std::vector<std::string> getPlan(bool forward=true) const;
+
+    /**
+    Return true if the plan never calls AST (so concurrent calls never block one another)
+
+    @param[in] forward  Check the forward plan? Otherwise check the inverse plan.
+
+    @throw std::runtime_error if the requested transform is not available.
+    */
+    bool isNative(bool forward=true) const;
+
+    /**
+    Perform a forward transformation, putting the results into a pre-allocated array
+
+    @param[in] from  input coordinates, with dimensions (nPts, nIn)
+    @param[out] to  transformed coordinates, with dimensions (nPts, nOut)
+
+    Both arrays may have any memory layout (e.g. C- or Fortran-ordered).
+    */
+    void tran(ConstArray2D const & from, StridedArray2D const & to) const { _tran(from, true, to); }
+
+    /**
+    Perform a forward transformation, returning the results as a new array
+
+    @param[in] from  input coordinates, with dimensions (nPts, nIn)
+    @return the results as a new array with dimensions (nPts, nOut)
+    */
+    Array2D tran(ConstArray2D const & from) const {
+        Array2D to = ndarray::allocate(from.getSize<0>(), getNout());
+        _tran(from, true, to);
+        return to;
+    }
+
+    /**
+    Perform an inverse transformation, putting the results into a pre-allocated array
+
+    @param[in] from  output coordinates, with dimensions (nPts, nOut)
+    @param[out] to  transformed coordinates, with dimensions (nPts, nIn)
+
+    Both arrays may have any memory layout (e.g. C- or Fortran-ordered).
+    */
+    void tranInverse(ConstArray2D const & from, StridedArray2D const & to) const { _tran(from, false, to); }
+
+    /**
+    Perform an inverse transformation, returning the results as a new array
+
+    @param[in] from  output coordinates, with dimensions (nPts, nOut)
+    @return the results as a new array with dimensions (nPts, nIn)
+    */
+    Array2D tranInverse(ConstArray2D const & from) const {
+        Array2D to = ndarray::allocate(from.getSize<0>(), getNin());
+        _tran(from, false, to);
+        return to;
+    }
+
+private:
+    void _tran(ConstArray2D const & from, bool doForward, StridedArray2D const & to) const;
+
+    detail::Kernel const & _getKernel(bool forward) const;
+
+    int _nIn;
+    int _nOut;
+    std::shared_ptr<detail::Kernel const> _forward;
+    std::shared_ptr<detail::Kernel const> _inverse;
+};
+
+}  // namespace ast
+
+#endif
@@ -22,6 +22,7 @@
 #ifndef ASTSHIM_FRAME_H
 #define ASTSHIM_FRAME_H
 
+#include <cstddef>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
@@ -312,7 +313,8 @@ public:
         If conversion is possible, the Base attributes of the two
         @ref FrameSet "FrameSets" will be modified on exit to identify the Frames
         used to access the intermediate coordinate system which was
-        finally accepted.
+        finally accepted. A @ref Object.isFrozen "frozen" FrameSet is left
+        unchanged, as the conversion is found between copies.
 
         Note that it is possible to force a particular Frame within a
         @ref FrameSet to be used as the basis for the intermediate
@@ -421,6 +423,10 @@ public:
         of both @ref FrameSet "FrameSets". This may be achieved by calling @ref convert
         in the inverses of the @ref FrameSet "FrameSets" (using @ref Mapping.getInverse "getInverse")
         so as to interchange their base and current frames.
+    - If the convert cache is enabled (see @ref setConvertCacheSize), results are cached
+        by the content of this frame and `to` and by `domainlist`, and the FrameSet returned
+        is a copy of a cached result, identical to the one that would be found without the cache.
+        Attribute `Base` of FrameSets is still set as described above.
     */
     FrameSet convert(Frame const & to, std::string const & domainlist="");
 
@@ -529,7 +535,8 @@ public:
     then the @ref FrameSet's Current attribute will be modified to indicate which Frame was used to
     obtain attribute values which were not specified by the template.  This Frame
     will, in some sense, represent the "closest" non-virtual coordinate system to
-    the one you requested.
+    the one you requested. A @ref Object.isFrozen "frozen" FrameSet is left unchanged,
+    as a copy of it is searched.
 
     ### Applicability to Subclasses
 
@@ -1133,8 +1140,10 @@ public:
     */
     void permAxes(std::vector<int> perm) {
         detail::assertEqual(perm.size(), "perm.size()", getNin(), "naxes");
+        _assertMutable();
         astPermAxes(getRawPtr(), perm.data());
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -1296,6 +1305,7 @@ public:
     is used to match another?
     */
     void setActiveUnit(bool enable) {
+        _assertMutable();
         astSetActiveUnit(getRawPtr(), enable);
         assertOK();
     }
@@ -1555,6 +1565,33 @@ private:
 };
 
 
+/**
+Get the maximum number of results kept by the cache used by @ref Frame.convert
+
+See @ref setConvertCacheSize for details.
+*/
+std::size_t getConvertCacheSize();
+
+/**
+Set the maximum number of results kept by the cache used by @ref Frame.convert
+
+Searching for a conversion path is expensive, so while this cache is enabled, @ref Frame.convert
+saves the result of each search and returns a copy of it for later calls
+with frames that have the same content and the same `domainlist`.
+Frames are identified by their description by @ref Object.show (looked up by its hash and length,
+then compared in full), so the cache is shared by all frames, including copies and frames read from files.
+When the cache is full, the least recently used result is discarded.
+
+The cache is shared by all threads.
+
+@param[in] maxEntries  Maximum number of results to keep; 0 (the default) disables the cache
+    and discards any results in it
+*/
+void setConvertCacheSize(std::size_t maxEntries);
+
+/// Discard all results in the cache used by @ref Frame.convert
+void clearConvertCache();
+
 /**
 A class representing a Frame and a Mapping
 */
@@ -22,9 +22,13 @@
 #ifndef ASTSHIM_FRAMESET_H
 #define ASTSHIM_FRAMESET_H
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "astshim/base.h"
 #include "astshim/Frame.h"
@@ -117,7 +121,9 @@ public:
     /// Cast an object to a FrameSet if possible, else throw std::invalid_argument
     explicit FrameSet(Object & obj) : FrameSet(
         detail::shallowCopy<AstFrameSet>(obj.getRawPtr()))
-    {}
+    {
+        _shareState(obj);
+    }
 
     ~FrameSet() {}
 
@@ -139,8 +145,10 @@ public:
     @param[in] frame  @ref Frame whose axes are to be appended to each @ref Frame in this FrameSet.
     */
     void addAxes(Frame const & frame) {
+        _assertMutable();
         astAddFrame(getRawPtr(), AST__ALLFRAMES, nullptr, frame.getRawPtr());
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -190,8 +198,10 @@ public:
         if (iframe == AST__ALLFRAMES) {
             throw std::runtime_error("iframe = AST__ALLFRAMES; call addAxes instead");
         }
+        _assertMutable();
         astAddFrame(getRawPtr(), iframe, map.getRawPtr(), frame.getRawPtr());
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -215,8 +225,10 @@ public:
         to make the current Frame act as a mirror.
     */
     void addVariant(Mapping const & map, std::string const & name) {
+        _assertMutable();
         astAddVariant(getRawPtr(), map.getRawPtr(), name.c_str());
         assertOK();
+        _clearCaches();
     }
 
     /// Return a deep copy of this object.
@@ -279,14 +291,33 @@ public:
         necessarily guarantee that it will be able to perform the required coordinate conversion.
         If necessary, the `TranForward` and `TranInverse` attributes of the returned @ref Mapping
         should be inspected to determine if the required transformation is available.    
+    - If @ref setCacheMappings has enabled the cache, the result is a copy of a cached @ref Mapping.
     */
-    Mapping getMapping(int ind1=BASE, int ind2=CURRENT) const {
-        AstMapping * map = reinterpret_cast<AstMapping *>(astGetMapping(getRawPtr(), ind1, ind2));
-        assertOK();
-        if (map == nullptr) {
-            throw std::runtime_error("getMapping failed (returned a null mapping)");
+    Mapping getMapping(int ind1=BASE, int ind2=CURRENT) const;
+
+    /**
+    Get whether @ref getMapping caches the mappings it finds; see @ref setCacheMappings
+    */
+    bool getCacheMappings() const { return _cacheMappings; }
+
+    /**
+    Enable or disable caching of the mappings found by @ref getMapping
+
+    While enabled, the first call to @ref getMapping for a pair of frames stores the mapping
+    that AST finds, and later calls for the same pair return a copy of it; copying is much faster
+    than having AST find and simplify the mapping again. The cache is cleared whenever this FrameSet
+    is modified (e.g. by @ref addFrame, @ref removeFrame, @ref remapFrame, @ref setBase,
+    @ref setCurrent or setting any other attribute), whether through this object or another that
+    shares its AST object (e.g. one made by casting it with `FrameSet(obj)`), and when caching is disabled.
+
+    Caching is disabled by default, and is not enabled for copies of this FrameSet.
+    */
+    void setCacheMappings(bool cache) {
+        std::lock_guard<std::mutex> lock(*_cacheMutex);
+        _cacheMappings = cache;
+        if (!cache) {
+            _mappings.clear();
         }
-        return Mapping(map);
     }
 
     /**
@@ -346,6 +377,7 @@ public:
     void mirrorVariants(int iframe) {
         astMirrorVariants(getRawPtr(), iframe);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -387,8 +419,10 @@ public:
         (see attribute `Variant`).
     */
     void remapFrame(int iframe, Mapping & map) {
+        _assertMutable();
         astRemapFrame(getRawPtr(), iframe, map.getRawPtr());
         assertOK();
+        _clearCaches();
     };
 
     /**
@@ -416,8 +450,10 @@ public:
     @throw std::runtime_error if you attempt to remove the last frame
     */
     void removeFrame(int iframe) {
+        _assertMutable();
         astRemoveFrame(getRawPtr(), iframe);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -437,10 +473,58 @@ public:
         to make the current Frame act as a mirror.
     */
     void renameVariant(std::string const & name) {
+        _assertMutable();
         astAddVariant(getRawPtr(), NULL, name.c_str());
         assertOK();
+        _clearCaches();
     }
 
+    /**
+    Compute the outline of a box in the base @ref Frame as a polygon in the current @ref Frame
+
+    A typical use is to find the footprint of a detector on the sky: the base @ref Frame
+    is the detector's pixel frame, and the current @ref Frame is a @ref SkyFrame.
+
+    The boundary of the box is sampled adaptively: each edge is bisected until the midpoint
+    of every segment is within `tol` of the geodesic joining the segment's ends, as measured by
+    @ref distance in the current @ref Frame. Vertices that then lie within `tol` of the geodesic
+    joining their neighbours are dropped, so a straight edge needs no points beyond its corners.
+
+    @param[in] lbnd  Lower bound of the box in the base @ref Frame; must have 2 elements
+    @param[in] ubnd  Upper bound of the box in the base @ref Frame; must have 2 elements
+    @param[in] tol  Maximum distance in the current @ref Frame (e.g. radians for a @ref SkyFrame)
+                between the polygon and the true outline
+    @return the vertices of the polygon as an array of shape (nVertices, getNout()), in order
+        around the box, starting at `lbnd` and going first along axis 1 of the base @ref Frame.
+        The polygon is implicitly closed: the first vertex is not repeated.
+        Points whose coordinates are undefined are omitted.
+
+    @throw std::invalid_argument if the base @ref Frame is not 2-dimensional, if `lbnd` or `ubnd`
+        does not have 2 elements, or if `tol` is not positive.
+    */
+    Array2D skyFootprint(PointD const & lbnd, PointD const & ubnd, double tol) const;
+
+    /**
+    Compute @ref skyFootprint for many FrameSets, e.g. every detector of a camera, using multiple threads
+
+    Each thread works on its own copy of a FrameSet. Multiple threads are only used if AST
+    was built with thread support.
+
+    @param[in] frameSets  FrameSets whose footprints are wanted
+    @param[in] lbnds  Lower bound of the box for each FrameSet
+    @param[in] ubnds  Upper bound of the box for each FrameSet
+    @param[in] tol  Tolerance, as for @ref skyFootprint
+    @param[in] nThreads  Number of threads; 0 for one per hardware thread
+    @return the footprint of each FrameSet
+
+    @throw std::invalid_argument if `lbnds` or `ubnds` is not the same length as `frameSets`,
+        or for any reason given by @ref skyFootprint.
+    */
+    static std::vector<Array2D> skyFootprints(std::vector<std::shared_ptr<FrameSet>> const & frameSets,
+                                              std::vector<PointD> const & lbnds,
+                                              std::vector<PointD> const & ubnds, double tol,
+                                              int nThreads=0);
+
     /**
     Set @ref FrameSet_Base "Base": index of base @ref Frame
     */
@@ -460,7 +544,10 @@ protected:
     @throw std::invalid_argument if `rawPtr` is not an AstFrameSet.
     */
     explicit FrameSet(AstFrameSet * rawPtr) :
-        Frame(reinterpret_cast<AstFrame *>(rawPtr))
+        Frame(reinterpret_cast<AstFrame *>(rawPtr)),
+        _cacheMappings(false),
+        _mappings(),
+        _mappingsModifications(0)
     {
         if (!astIsAFrameSet(getRawPtr())) {
             std::ostringstream os;
@@ -468,6 +555,22 @@ protected:
             throw std::invalid_argument(os.str());
         }
     }
+
+    void _clearCaches() override {
+        {
+            std::lock_guard<std::mutex> lock(*_cacheMutex);
+            _mappings.clear();
+        }
+        Frame::_clearCaches();
+    }
+
+private:
+    bool _cacheMappings;
+    // Mappings cached by getMapping, indexed by (from frame, to frame); they are kept unlocked.
+    // These members are guarded by _cacheMutex.
+    mutable std::map<std::pair<int, int>, std::shared_ptr<Mapping>> _mappings;
+    // The modification count of the AST object when `_mappings` was filled; see Object::_getModificationCount
+    mutable std::size_t _mappingsModifications;
 };
 
 }  // namespace ast
@@ -0,0 +1,132 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_GRIDMAP_H
+#define ASTSHIM_GRIDMAP_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/Mapping.h"
+
+namespace ast {
+
+namespace detail {
+struct GridField;
+}  // namespace detail
+
+/**
+Enums describing the interpolation used by @ref GridMap
+*/
+enum class GridInterp {
+    BILINEAR,   ///< bilinear interpolation between the 2x2 nearest grid points
+    BICUBIC,    ///< bicubic convolution (Keys, a = -0.5) over the 4x4 nearest grid points
+};
+
+/**
+A GridMap is a 2-D @ref Mapping that adds a displacement interpolated in a table sampled
+on a regular grid, e.g. a measured detector distortion.
+
+The forward transform maps (x, y) to (x + dx(x, y), y + dy(x, y)), where dx and dy are interpolated
+in the tables. Beyond the grid the displacement is that at the nearest point on the edge of the grid.
+The inverse transform is found iteratively, by Newton's method; positions for which it does not
+converge transform to bad values.
+
+A GridMap is an AST IntraMap whose transformation function is provided by astshim and whose table is
+held in its `IntraFlag` attribute, so it may be combined with other mappings
+(e.g. in a @ref SeriesMap), simplified, and written to and read from a @ref Channel like any other
+mapping. A GridMap read from a Channel has the C++ type Object; cast it to a GridMap
+with the cast constructor. The transformation function is registered with AST when astshim is loaded.
+
+@ref Mapping.freeze "Freezing" the mapping evaluates the table natively.
+*/
+class GridMap : public Mapping {
+friend class Object;
+public:
+    /**
+    Construct a GridMap
+
+    @param[in] dx  Displacement along x at each grid point; an array of shape (ny, nx),
+                where element [i, j] is at position (origin[0] + j spacing[0], origin[1] + i spacing[1]).
+    @param[in] dy  Displacement along y at each grid point, as for `dx`.
+    @param[in] origin  Position (x, y) of grid point [0, 0].
+    @param[in] spacing  Spacing of the grid points along x and y; both must be positive.
+    @param[in] interp  Interpolation method.
+    @param[in] options  Comma-separated list of attribute assignments.
+
+    @throw std::invalid_argument if `dx` and `dy` have different shapes or fewer than 2 x 2 points,
+        `origin` or `spacing` do not have 2 elements, or the spacing is not positive.
+    */
+    explicit GridMap(
+        ndarray::Array<double, 2, 2> const & dx,
+        ndarray::Array<double, 2, 2> const & dy,
+        std::vector<double> const & origin,
+        std::vector<double> const & spacing,
+        GridInterp interp=GridInterp::BILINEAR,
+        std::string const & options=""
+    );
+
+    /// Cast an object to a GridMap if possible, else throw std::invalid_argument
+    explicit GridMap(Object & obj) : GridMap(detail::shallowCopy<AstIntraMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
+
+    virtual ~GridMap() {}
+
+    GridMap(GridMap const &) = default;
+    GridMap(GridMap &&) = default;
+    GridMap & operator=(GridMap const &) = default;
+    GridMap & operator=(GridMap &&) = default;
+
+    /// Return a deep copy of this object.
+    std::shared_ptr<GridMap> copy() const { return _copy<GridMap, AstIntraMap>(); }
+
+    /// Get the interpolation method
+    GridInterp getInterp() const;
+
+    /// Get the position (x, y) of grid point [0, 0]
+    std::vector<double> getOrigin() const;
+
+    /// Get the spacing of the grid points along x and y
+    std::vector<double> getSpacing() const;
+
+    /// Get the displacement along x at each grid point, as an array of shape (ny, nx)
+    Array2D getDx() const;
+
+    /// Get the displacement along y at each grid point, as an array of shape (ny, nx)
+    Array2D getDy() const;
+
+    /// Return true if `obj` is a GridMap (an IntraMap that uses the GridMap transformation function)
+    static bool isGridMap(Object const & obj);
+
+private:
+    /// Construct a GridMap from a raw AST pointer
+    explicit GridMap(AstIntraMap * rawptr);
+
+    /// Get the table
+    std::shared_ptr<detail::GridField const> _getField() const;
+};
+
+}  // namespace ast
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsstcorp.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_INTERNER_H
+#define ASTSHIM_INTERNER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/Object.h"
+
+namespace ast {
+
+/**
+A pool of shared, read-only objects, in which objects with identical content are stored once
+
+@ref intern returns the pooled object whose content (as written by @ref Object.show) matches
+the object provided, adding a deep copy of that object to the pool if there is none.
+Replacing many identical objects (e.g. the same camera distortion in each of thousands
+of cached WCS) with the interned one keeps a single copy in memory.
+
+Compound mappings (@ref CmpMap, @ref SeriesMap and @ref ParallelMap) are interned component
+by component, and rebuilt from the interned components, so different compound mappings
+that contain an identical component share a single AST object for it.
+Other objects, including @ref FrameSet "FrameSets" (which always hold private copies
+of their mappings) are shared only as a whole.
+
+Interned objects are shared, so they are returned as pointers to const, and are
+@ref Object.isFrozen "frozen": any attempt to modify one (or an object cast from one) throws
+std::runtime_error, including from Python, which does not enforce const.
+To modify one, modify a @ref Object.copy "copy" of it instead (copy-on-write).
+
+The pool holds weak references: an object leaves the pool once nothing else uses it.
+
+@warning An Interner has no lock: like the AST objects it contains, it may only be used by one thread
+at a time, and interned objects share AST objects, so they must all be used by the same thread.
+*/
+class Interner {
+public:
+    Interner() : _entries(), _nLookups(0), _nHits(0), _bytesSaved(0) {}
+
+    ~Interner() {}
+
+    Interner(Interner const &) = delete;
+    Interner(Interner &&) = default;
+    Interner & operator=(Interner const &) = delete;
+    Interner & operator=(Interner &&) = default;
+
+    /**
+    Return the pooled object with the same content and C++ type as `obj`, adding a copy if there is none
+
+    @param[in] obj  Object to intern; it is not modified, and is never itself added to the pool
+    */
+    template <typename T>
+    std::shared_ptr<T const> intern(T const & obj) {
+        return std::dynamic_pointer_cast<T const>(_intern(obj));
+    }
+
+    /// Get the number of calls to @ref intern, including those made for components of compound mappings
+    std::size_t getNumLookups() const { return _nLookups; }
+
+    /// Get the number of calls to @ref intern that found an object already in the pool
+    std::size_t getNumHits() const { return _nHits; }
+
+    /**
+    Get an estimate of the memory saved by interning, in bytes
+
+    This is the sum of the @ref Object_ObjSize "ObjSize" of the pooled object found by each hit:
+    the memory saved once the callers replace their own objects with the interned ones.
+    */
+    std::size_t getBytesSaved() const { return _bytesSaved; }
+
+    /// Get the number of objects in the pool that are still in use
+    std::size_t size() const;
+
+    /// Remove entries for objects that are no longer in use
+    void purge();
+
+private:
+    struct Entry {
+        std::weak_ptr<Object const> object;
+        std::type_index type;      // dynamic C++ type of the object that was interned
+        std::size_t contentSize;   // length of the object's description
+    };
+
+    std::shared_ptr<Object const> _intern(Object const & obj);
+
+    std::shared_ptr<Object const> _makePooled(Object const & obj, std::string const & content);
+
+    std::unordered_map<std::size_t, std::vector<Entry>> _entries;  // entries by hash of content
+    std::size_t _nLookups;
+    std::size_t _nHits;
+    std::size_t _bytesSaved;
+};
+
+}  // namespace ast
+
+#endif
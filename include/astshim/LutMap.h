@@ -58,6 +58,9 @@ In addition to those attributes provided by @ref Mapping and @ref Object,
     `TranInverse` attribute will have a value of one, indicating that the inverse transformation
     can be performed. Otherwise, it will have a value of zero, so that any attempt to use
     the inverse transformation will result in an error.
+- @ref Mapping.freeze "Freezing" the mapping evaluates a table with linear interpolation natively,
+    taking constant time per point however large the table is. The inverse uses a precomputed index
+    of the table if its values are strictly monotonic.
 */
 class LutMap : public Mapping {
 friend class Object;
@@ -81,7 +84,9 @@ public:
     {}
 
     /// Cast an object to a LutMap if possible, else throw std::runtime_error
-    explicit LutMap(Object & obj) : LutMap(detail::shallowCopy<AstLutMap>(obj.getRawPtr())) {}
+    explicit LutMap(Object & obj) : LutMap(detail::shallowCopy<AstLutMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~LutMap() {}
 
@@ -22,6 +22,7 @@
 #ifndef ASTSHIM_MAPBOX_H
 #define ASTSHIM_MAPBOX_H
 
+#include <memory>
 #include <vector>
 
 #include "ndarray.h"
@@ -120,6 +121,49 @@ private:
                   int minOutCoord=1, int maxOutCoord=0);
 };
 
+/**
+Compute the output bounding boxes of many input boxes, using multiple threads
+
+This is the batch equivalent of @ref MapBox, for finding e.g. the sky bounding box of every
+(detector, visit) pair, but it only computes the bounds, not the points at which they occur.
+
+There are two modes:
+- If `nSamples` is 0 then the bounds are found with astMapBox, as for @ref MapBox.
+- Otherwise the mapping is evaluated (in a single call for each box) at the corners of the box
+    and at `nSamples` evenly spaced points along the interior of each edge, and the bounds
+    are those of the transformed points, padded by a quarter of the largest second difference
+    between neighbouring points along an edge. This is much faster; the padding covers an extreme
+    value between samples on an edge if the mapping is smooth on the scale of the sampling,
+    and is zero for a linear mapping. The bounds may still be too small if the mapping varies faster
+    than that, or if the extreme values occur in the interior of the box (e.g. at an interior point
+    that maps to a celestial pole).
+
+Boxes that share a mapping are processed together by one thread, using its own copy of the mapping;
+if only one mapping is given, the boxes are shared among the threads, each with its own copy.
+Multiple threads are only used if AST was built with thread support.
+
+@param[in] maps  Mappings: either one per box, or a single mapping to use for every box
+@param[in] lbnd  Lower bounds of the input boxes, with dimensions (nBoxes, nIn)
+@param[in] ubnd  Upper bounds of the input boxes, with dimensions (nBoxes, nIn)
+@param[out] lbndOut  Lower bounds of the output boxes, with dimensions (nBoxes, nOut);
+            a bound is NaN if it cannot be found
+@param[out] ubndOut  Upper bounds of the output boxes, with dimensions (nBoxes, nOut)
+@param[in] nSamples  Number of points to sample along each edge, or 0 to use astMapBox
+@param[in] nThreads  Number of threads; 0 for one per hardware thread
+
+@throw std::invalid_argument if the array shapes do not match, if `maps` has the wrong length,
+    if the mappings do not all have the same number of input and output axes,
+    or if `nSamples` > 0 and there are more than 10 input axes.
+@throw std::runtime_error if AST reports an error.
+*/
+void mapBoxes(std::vector<std::shared_ptr<Mapping>> const & maps,
+              ConstArray2D const & lbnd,
+              ConstArray2D const & ubnd,
+              Array2D const & lbndOut,
+              Array2D const & ubndOut,
+              int nSamples=0,
+              int nThreads=0);
+
 }  // namespace ast
 
 #endif
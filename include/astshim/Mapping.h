@@ -22,7 +22,10 @@
 #ifndef ASTSHIM_MAPPING_H
 #define ASTSHIM_MAPPING_H
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "ndarray.h"
 
@@ -32,8 +35,18 @@
 
 namespace ast {
 
+class CompiledMapping;
 class ParallelMap;
+class PointReader;
+class PointWriter;
+class ResampleControl;
 class SeriesMap;
+class WarpControl;
+
+namespace detail {
+struct FastTran;
+struct ReducedMapping;
+}  // namespace detail
 
 /**
 An abstract base class for objects which transform one set of coordinates to another.
@@ -64,7 +77,9 @@ public:
     without listing the subclasses as friend classes).
     */
     explicit Mapping(AstMapping * mapping) :
-        Object(reinterpret_cast<AstObject *>(mapping))
+        Object(reinterpret_cast<AstObject *>(mapping)),
+        _cacheMutex(new std::mutex()),
+        _cachedModifications(0)
     {
         assertOK();
         if (!astIsAMapping(getRawPtr())) {
@@ -75,7 +90,9 @@ public:
     }
 
     /// Cast an object to a Mapping if possible, else throw std::runtime_error
-    explicit Mapping(Object & obj) : Mapping(detail::shallowCopy<AstMapping>(obj.getRawPtr())) {}
+    explicit Mapping(Object & obj) : Mapping(detail::shallowCopy<AstMapping>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~Mapping() {}
 
@@ -181,6 +198,14 @@ public:
     }
 
 
+    /**
+    Compile this mapping into an immutable @ref CompiledMapping
+    that any number of threads may use concurrently without locking.
+
+    Later changes to this mapping do not affect the returned @ref CompiledMapping.
+    */
+    CompiledMapping freeze() const;
+
     /**
     Return a series compound mapping this(first(input)).
 
@@ -261,11 +286,19 @@ public:
     Perform a forward transformation, putting the results into a pre-allocated array
 
     @param[in] from  input coordinates, with dimensions (nPts, nIn)
-    @param[in] to  transformed coordinates, with dimensions (nPts, nOut)
+    @param[out] to  transformed coordinates, with dimensions (nPts, nOut)
+
+    Both arrays may be C- or Fortran-ordered; Fortran-ordered arrays are used by AST in place.
+    Any number of points may be transformed: AST is called on chunks of at most @ref getTranChunkSize points,
+    which also bounds the size of the temporary buffers used to transpose other layouts.
+
+    Large batches through a @ref MatrixMap, @ref PermMap or @ref UnitMap (alone or as the mapping of a
+    @ref FrameSet) are transformed natively, giving exactly the results AST would, so the results never
+    depend on how many points are transformed at once. Use @ref freeze to evaluate other mappings natively.
     */
     void tran(
-        Array2D const & from,
-        Array2D & to
+        ConstArray2D const & from,
+        StridedArray2D const & to
     ) const {
         _tran(from, true, to);
     }
@@ -277,7 +310,7 @@ public:
     @return the results as a new array with dimensions (nPts, nOut)
     */
     Array2D tran(
-        Array2D const & from
+        ConstArray2D const & from
     ) const {
         Array2D to = ndarray::allocate(from.getSize<0>(), getNout());
         _tran(from, true, to);
@@ -288,11 +321,13 @@ public:
     Perform an inverse transformation
 
     @param[in] from  input coordinates, with dimensions (nPts, nOut)
-    @param[in] to  transformed coordinates, with dimensions (nPts, nIn)
+    @param[out] to  transformed coordinates, with dimensions (nPts, nIn)
+
+    Both arrays may be C- or Fortran-ordered; Fortran-ordered arrays are used by AST in place.
     */
     void tranInverse(
-        Array2D const & from,
-        Array2D & to
+        ConstArray2D const & from,
+        StridedArray2D const & to
     ) const {
         _tran(from, false, to);
     }
@@ -304,13 +339,125 @@ public:
     @return the results as a new array with dimensions (nPts, nIn)
     */
     Array2D tranInverse(
-        Array2D const & from
+        ConstArray2D const & from
     ) const {
         Array2D to = ndarray::allocate(from.getSize<0>(), getNin());
         _tran(from, false, to);
         return to;
     }
 
+    /**
+    Perform a forward transformation, computing only some of the outputs
+
+    Only the part of the mapping needed for the requested outputs is evaluated, and only the inputs
+    that those outputs depend on are read. The reduced mapping is found by splitting this mapping
+    with @ref MapSplit (applied to the inverted mapping, in order to split it by outputs) and is cached,
+    so later calls with the same `outAxes` reuse it. If the requested outputs cannot be split off,
+    the full mapping is used instead.
+
+    @param[in] from  input coordinates, with dimensions (nPts, nIn)
+    @param[in] outAxes  The output axes to compute, in the order wanted (1-based)
+    @param[out] to  transformed coordinates, with dimensions (nPts, outAxes.size());
+                may be C- or Fortran-ordered
+
+    @throw std::invalid_argument if `outAxes` is empty or contains an axis that is out of range
+        or listed more than once.
+    */
+    void tranOutputs(
+        ConstArray2D const & from,
+        std::vector<int> const & outAxes,
+        StridedArray2D const & to
+    ) const;
+
+    /**
+    Perform a forward transformation, computing only some of the outputs and returning them as a new array
+
+    See the other overload for details.
+
+    @param[in] from  input coordinates, with dimensions (nPts, nIn)
+    @param[in] outAxes  The output axes to compute, in the order wanted (1-based)
+    @return the results as a new array with dimensions (nPts, outAxes.size())
+    */
+    Array2D tranOutputs(
+        ConstArray2D const & from,
+        std::vector<int> const & outAxes
+    ) const {
+        Array2D to = ndarray::allocate(from.getSize<0>(), outAxes.size());
+        tranOutputs(from, outAxes, to);
+        return to;
+    }
+
+    /**
+    Solve for the inputs that the forward transformation maps to given outputs, by damped Newton iteration
+
+    This provides an inverse for mappings that have none (e.g. a @ref PolyMap constructed without
+    inverse coefficients), using only the forward transformation. All points are iterated together:
+    each iteration transforms every unconverged point once to find its residual and once more per axis
+    to estimate its Jacobian by finite differences, then takes a Newton step, halving the step
+    until the residual decreases.
+
+    @param[in] to  Output coordinates to invert, with dimensions (nPts, nOut)
+    @param[in] seed  Starting inputs, with dimensions (nPts, nIn), or a single point with dimensions
+                (1, nIn); in the latter case the mapping is linearized at that point and the linear
+                approximation inverted to give a starting point for each output.
+    @param[out] from  Solved input coordinates, with dimensions (nPts, nIn); may be C- or Fortran-ordered.
+                Points that do not converge are left at their best estimate, or NaN if the output
+                has bad values.
+    @param[in] tol  A point has converged when each of its outputs is within `tol` of its target
+    @param[in] maxIter  Maximum number of Newton steps per point
+    @return a flag for each point: true if it converged
+
+    @throw std::invalid_argument if the mapping does not have the same number of inputs and outputs,
+        if an array has the wrong dimensions, or if `tol` is not positive or `maxIter` is negative.
+    @throw std::runtime_error if the forward transformation is not available.
+    */
+    ndarray::Array<bool, 1, 1> tranInverseIterative(
+        ConstArray2D const & to,
+        ConstArray2D const & seed,
+        StridedArray2D const & from,
+        double tol,
+        int maxIter=50
+    ) const;
+
+    /**
+    Transform a stream of points in the forward direction, in constant memory
+
+    Points are pulled from `reader` in chunks of `chunkSize` points, transformed and pushed to `writer`.
+    Reading and writing are double buffered: while one chunk is transformed (by the calling thread)
+    the next chunk is read by one helper thread and the previous chunk is written by another;
+    both helper threads last for the whole stream. Only four chunk-sized buffers are used,
+    however many points there are.
+
+    @param[in] reader  Source of input points, with nIn axes
+    @param[in] writer  Destination for transformed points, with nOut axes
+    @param[in] chunkSize  Number of points per chunk; if 0 then use @ref getTranChunkSize
+    @return the number of points transformed
+
+    @throw std::invalid_argument if `reader` or `writer` has the wrong number of axes.
+    @throw std::runtime_error if reading, transforming or writing fails; all helper threads have
+        finished before the exception is thrown.
+    */
+    std::size_t tranStream(
+        PointReader & reader,
+        PointWriter & writer,
+        std::size_t chunkSize=0
+    ) const {
+        return _tranStream(reader, writer, chunkSize, true);
+    }
+
+    /**
+    Transform a stream of points in the inverse direction, in constant memory
+
+    See tranStream for details, swapping nIn and nOut
+    */
+    std::size_t tranInverseStream(
+        PointReader & reader,
+        PointWriter & writer,
+        std::size_t chunkSize=0
+    ) const {
+        return _tranStream(reader, writer, chunkSize, false);
+    }
+
     /**
     Transform a grid of points in the forward direction
 
@@ -345,14 +492,22 @@ public:
                 If too small a value is given, it will have the effect of inhibiting linear approximation
                 altogether (equivalent to setting " tol" to zero).  Although this may degrade
                 performance, accurate results will still be obtained.
-    @param[in] to  Computed points, with dimensions (nPts, nOut)
+    @param[out] to  Computed points, with dimensions (nPts, nOut);
+                may be C- or Fortran-ordered
+
+    Grids with more than @ref getTranChunkSize points are transformed in blocks of up to that many points.
+    If `tol` is nonzero then linear approximations do not extend across the boundaries of these blocks.
+
+    If the input axes of a large grid fall into independent groups (as for a @ref ParallelMap
+    or a spectral cube whose spectral axis is independent of its spatial axes), each group is
+    transformed once over its own sub-grid and the results are broadcast to every grid point.
     */
     void tranGridForward(
         PointI const & lbnd,
         PointI const & ubnd,
         double tol,
         int maxpix,
-        Array2D & to
+        StridedArray2D const & to
     ) const {
         _tranGrid(lbnd, ubnd, tol, maxpix, true, to);
     }
@@ -367,16 +522,303 @@ public:
         PointI const & ubnd,
         double tol,
         int maxpix,
-        Array2D & to
+        StridedArray2D const & to
     ) const {
         _tranGrid(lbnd, ubnd, tol, maxpix, false, to);
     }
 
+    /**
+    Resample an image onto a new pixel grid
+
+    Equivalent to the full version of @ref resample with no variance and no mask.
+    */
+    int resample(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        PointI const & dstLbnd,
+        ResampleControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref ResampleControl
+    int resample(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Resample a single-precision image onto a new pixel grid
+
+    Equivalent to the full version of @ref resample with no variance and no mask.
+    */
+    int resample(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        PointI const & dstLbnd,
+        ResampleControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref ResampleControl
+    int resample(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Resample an image onto a new pixel grid, using astResample<X>
+
+    This mapping must transform from the pixel (grid) coordinates of the source image
+    to the pixel coordinates of the destination image; its inverse is used to find the source position
+    of each destination pixel.
+    Images are indexed [y, x] (so x varies fastest, as for AST) and pixel [0, 0] has grid coordinates
+    `lbnd`, so the bounding box of an image is `lbnd` to `lbnd + (width - 1, height - 1)`.
+    Pixel centres have integer grid coordinates, as for AST.
+
+    The destination is divided into tiles of `ctrl.tileSize` pixels on a side, which are
+    shared among `ctrl.nThreads` threads; each thread uses its own copy of this mapping.
+    Multiple threads are only used if AST was built with thread support.
+
+    @param[in] srcImage  Source image
+    @param[in] srcVariance  Variance of the source image; may be empty. If provided then
+                `dstVariance` must also be provided.
+    @param[in] srcMask  Mask of the source image; may be empty. Pixels with any of the bits in
+                `ctrl.badMask` set are treated as bad, as are NaN image or variance pixels.
+    @param[in] srcLbnd  Grid coordinates (x, y) of srcImage[0, 0]
+    @param[out] dstImage  Destination image; pixels that receive no data are set to NaN
+    @param[out] dstVariance  Variance of the destination image; may be empty
+    @param[out] dstMask  Mask of the destination image; may be empty. If provided then `ctrl.noDataMask`
+                is set for pixels that receive no data and cleared for all other pixels.
+    @param[in] dstLbnd  Grid coordinates (x, y) of dstImage[0, 0]
+    @param[in] ctrl  Control parameters
+
+    @return the number of destination pixels that receive no data
+
+    @throw std::invalid_argument if this mapping is not 2-dimensional, if array shapes do not match,
+        or if only one of `srcVariance` and `dstVariance` is provided.
+    @throw std::runtime_error if AST reports an error.
+    */
+    int resample(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        ndarray::Array<double const, 2, 2> const & srcVariance,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        ndarray::Array<double, 2, 2> const & dstVariance,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd,
+        ResampleControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref ResampleControl
+    int resample(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        ndarray::Array<double const, 2, 2> const & srcVariance,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        ndarray::Array<double, 2, 2> const & dstVariance,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Resample a single-precision image onto a new pixel grid
+
+    See the double-precision version for details.
+    */
+    int resample(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        ndarray::Array<float const, 2, 2> const & srcVariance,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        ndarray::Array<float, 2, 2> const & dstVariance,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd,
+        ResampleControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref ResampleControl
+    int resample(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        ndarray::Array<float const, 2, 2> const & srcVariance,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        ndarray::Array<float, 2, 2> const & dstVariance,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Warp an image onto a new pixel grid
+
+    Equivalent to the full version of @ref warp with no mask.
+    */
+    int warp(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        PointI const & dstLbnd,
+        WarpControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref WarpControl
+    int warp(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Warp a single-precision image onto a new pixel grid
+
+    Equivalent to the full version of @ref warp with no mask.
+    */
+    int warp(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        PointI const & dstLbnd,
+        WarpControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref WarpControl
+    int warp(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Warp an image onto a new pixel grid, interpolating it with a native bilinear or Lanczos kernel
+
+    This is a faster alternative to @ref resample for the common case of a 2-d image and a simple kernel.
+    The source position of each destination pixel is computed with astTranGrid, using the inverse
+    of this mapping, one block of the destination at a time, and the kernel is then applied to that
+    block while the coordinates are still in cache.
+    The conventions for bounds and the mapping are the same as for @ref resample.
+
+    The kernel must lie entirely within the source image, so a destination pixel receives no data
+    unless its source position is at least 2 pixels from the low edge and more than 3 pixels from
+    the high edge of the source image along each axis for `WarpKernel::LANCZOS3`,
+    or more than 1 pixel from the high edge for `WarpKernel::BILINEAR`.
+    A source position exactly on a source pixel only needs that pixel, so it is always interpolated.
+
+    The destination is divided into blocks of `ctrl.blockSize` pixels on a side, which are
+    shared among `ctrl.nThreads` threads; each thread uses its own copy of this mapping.
+    Multiple threads are only used if AST was built with thread support.
+
+    @param[in] srcImage  Source image
+    @param[in] srcMask  Mask of the source image; may be empty
+    @param[in] srcLbnd  Grid coordinates (x, y) of srcImage[0, 0]
+    @param[out] dstImage  Destination image. A pixel is NaN if the kernel extends beyond the
+                source image (including if its source position is undefined), or if any source pixel
+                that contributes to it is NaN or has any of the bits in `ctrl.badMask` set.
+    @param[out] dstMask  Mask of the destination image; may be empty. If provided then each pixel is
+                set to the OR of the masks of the source pixels that contribute to it,
+                or to `ctrl.noDataMask` if the kernel extends beyond the source image.
+    @param[in] dstLbnd  Grid coordinates (x, y) of dstImage[0, 0]
+    @param[in] ctrl  Control parameters
+
+    @return the number of destination pixels that receive no data because the kernel
+        extends beyond the source image
+
+    @throw std::invalid_argument if this mapping is not 2-dimensional or if array shapes do not match.
+    @throw std::runtime_error if AST reports an error.
+    */
+    int warp(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd,
+        WarpControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref WarpControl
+    int warp(
+        ndarray::Array<double const, 2, 2> const & srcImage,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<double, 2, 2> const & dstImage,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd
+    ) const;
+
+    /**
+    Warp a single-precision image onto a new pixel grid
+
+    See the double-precision version for details.
+    */
+    int warp(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd,
+        WarpControl const & ctrl
+    ) const;
+
+    /// Equivalent to the version above with a default-constructed @ref WarpControl
+    int warp(
+        ndarray::Array<float const, 2, 2> const & srcImage,
+        ndarray::Array<int const, 2, 2> const & srcMask,
+        PointI const & srcLbnd,
+        ndarray::Array<float, 2, 2> const & dstImage,
+        ndarray::Array<int, 2, 2> const & dstMask,
+        PointI const & dstLbnd
+    ) const;
+
+protected:
+    void _clearCaches() override {
+        {
+            std::lock_guard<std::mutex> lock(*_cacheMutex);
+            _reducedMappings.clear();
+            _fastTrans[0].reset();
+            _fastTrans[1].reset();
+        }
+        Object::_clearCaches();
+    }
+
+    /**
+    Guards the caches of this wrapper and its subclasses, which threads that transform points
+    with the GIL released fill and read concurrently
+    */
+    mutable std::unique_ptr<std::mutex> _cacheMutex;
+
 private:
+    /**
+    Discard the caches below if any wrapper of the AST object has modified it since they were filled
+
+    The caller must hold `_cacheMutex`.
+    */
+    void _discardStaleCaches() const;
+
+    std::shared_ptr<detail::FastTran const> _getFastTran(bool doForward) const;
+
+    std::shared_ptr<detail::ReducedMapping const> _getReducedMapping(std::vector<int> const & outAxes) const;
+
     void _tran(
-        Array2D const & from,
+        ConstArray2D const & from,
         bool doForward,
-        Array2D & to
+        StridedArray2D const & to
+    ) const;
+
+    std::size_t _tranStream(
+        PointReader & reader,
+        PointWriter & writer,
+        std::size_t chunkSize,
+        bool doForward
     ) const;
 
     void _tranGrid(
@@ -385,10 +827,51 @@ private:
         double tol,
         int maxpix,
         bool doForward,
-        Array2D & to
+        StridedArray2D const & to
     ) const;
+
+    bool _tranGridSeparable(
+        PointI const & lbnd,
+        PointI const & ubnd,
+        double tol,
+        int maxpix,
+        bool doForward,
+        StridedArray2D const & to
+    ) const;
+
+    // Reduced mappings used by tranOutputs, indexed by the requested output axes
+    mutable std::map<std::vector<int>, std::shared_ptr<detail::ReducedMapping const>> _reducedMappings;
+
+    // Native replacements for astTranN used by _tran, for the forward [0] and inverse [1] transforms
+    mutable std::shared_ptr<detail::FastTran const> _fastTrans[2];
+
+    // The modification count of the AST object when the caches above were filled
+    mutable std::size_t _cachedModifications;
 };
 
+/**
+Get the maximum number of points that a @ref Mapping transforms in one call to AST
+
+See @ref setTranChunkSize for details.
+*/
+std::size_t getTranChunkSize();
+
+/**
+Set the maximum number of points that a @ref Mapping transforms in one call to AST
+
+@ref Mapping.tran, @ref Mapping.tranInverse, @ref Mapping.tranGridForward and
+@ref Mapping.tranGridInverse split larger arrays into chunks of at most this many points,
+so arrays of any size may be transformed even though AST counts points with an `int`.
+Unless an array is already in AST's axis-major (Fortran) order, each chunk is transposed
+through a temporary buffer of `(nIn + nOut) * nPts` doubles, so this also bounds temporary memory.
+It is also the default chunk size for @ref Mapping.tranStream.
+
+@param[in] nPts  New maximum number of points. The default is 65536.
+
+@throw std::invalid_argument if `nPts` is 0 or larger than the largest `int`.
+*/
+void setTranChunkSize(std::size_t nPts);
+
 }  // namespace ast
 
 #endif
@@ -373,7 +373,9 @@ public:
     {}
 
     /// Cast an object to a MathMap if possible, else throw std::runtime_error
-    explicit MathMap(Object & obj) : MathMap(detail::shallowCopy<AstMathMap>(obj.getRawPtr())) {}
+    explicit MathMap(Object & obj) : MathMap(detail::shallowCopy<AstMathMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~MathMap() {}
 
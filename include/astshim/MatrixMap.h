@@ -78,7 +78,9 @@ public:
     {}
 
     /// Cast an object to a MatrixMap if possible, else throw std::runtime_error
-    explicit MatrixMap(Object & obj) : MatrixMap(detail::shallowCopy<AstMatrixMap>(obj.getRawPtr())) {}
+    explicit MatrixMap(Object & obj) : MatrixMap(detail::shallowCopy<AstMatrixMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~MatrixMap() {}
 
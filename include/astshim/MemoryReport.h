@@ -0,0 +1,69 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsstcorp.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_MEMORYREPORT_H
+#define ASTSHIM_MEMORYREPORT_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace ast {
+
+/**
+Memory used by the objects of one AST class within an object; see @ref MemoryReport
+
+Bytes are those used by each object itself, excluding its components.
+*/
+class MemoryUsage {
+public:
+    MemoryUsage()
+            : nObjects(0), nUnique(0), totalBytes(0), uniqueBytes(0), largestBytes(0), isEstimate(false) {}
+
+    int nObjects;              ///< number of references to objects of this class
+    int nUnique;               ///< number of distinct objects of this class
+    std::size_t totalBytes;    ///< bytes used if each reference were to a separate copy
+    std::size_t uniqueBytes;   ///< bytes used by the distinct objects
+    std::size_t largestBytes;  ///< bytes used by the largest object of this class
+    bool isEstimate;           ///< are the bytes estimates? True for FrameSets (see @ref Object.memoryReport)
+};
+
+/**
+Memory used by an object and all of its components, as returned by @ref Object.memoryReport
+
+Components that are shared (the same AST object is used in more than one place,
+e.g. by an @ref Interner) are counted once in `uniqueBytes` but once per use in `totalBytes`,
+so `sharedBytes` is the memory saved by sharing.
+*/
+class MemoryReport {
+public:
+    MemoryReport() : totalBytes(0), uniqueBytes(0), sharedBytes(0), isEstimate(false), byClass() {}
+
+    std::size_t totalBytes;    ///< bytes used if each shared component were a separate copy
+    std::size_t uniqueBytes;   ///< bytes used by the distinct objects
+    std::size_t sharedBytes;   ///< totalBytes - uniqueBytes
+    bool isEstimate;           ///< is the breakdown by class an estimate? True if a FrameSet was reported
+    std::map<std::string, MemoryUsage> byClass;  ///< usage by AST class name, e.g. "LutMap"
+};
+
+}  // namespace ast
+
+#endif
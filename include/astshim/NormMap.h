@@ -62,7 +62,9 @@ public:
     {}
 
     /// Cast an object to a NormMap if possible, else throw std::runtime_error
-    explicit NormMap(Object & obj) : NormMap(detail::shallowCopy<AstNormMap>(obj.getRawPtr())) {}
+    explicit NormMap(Object & obj) : NormMap(detail::shallowCopy<AstNormMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~NormMap() {}
 
@@ -22,12 +22,16 @@
 #ifndef ASTSHIM_OBJECT_H
 #define ASTSHIM_OBJECT_H
 
+#include <atomic>
+#include <cstddef>
 #include <ostream>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 #include "astshim/base.h"
 #include "astshim/detail.h"
+#include "astshim/MemoryReport.h"
 
 namespace ast {
 
@@ -47,6 +51,7 @@ Object provides the following attributes:
 - @ref Object_UseDefs "UseDefs": allow use of default values for Object attributes?
 */
 class Object {
+    friend class Interner;
     typedef void (*Deleter)(AstObject *);
 public:
     typedef std::unique_ptr<AstObject,Deleter> ObjectPtr;
@@ -89,8 +94,10 @@ public:
     indicating that no value has been set.
     */
     void clear(std::string const & attrib) {
+        _assertMutable();
         astClear(getRawPtr(), attrib.c_str());
         assertOK();
+        _clearCaches();
     }
 
     /// Return a deep copy of this object.
@@ -114,12 +121,36 @@ public:
     /// Get @ref Object_Ident "Ident": object identification string that is copied.
     std::string getIdent() const { return getC("Ident"); }
 
+    /**
+    Is this object frozen, so that any attempt to modify it throws?
+
+    Objects returned by an @ref Interner are frozen, as are objects cast from them, since they share
+    an AST object with every other user of the pool. Copies (made by @ref copy) are not frozen.
+    */
+    bool isFrozen() const { return _state->isFrozen; }
+
     /// Get @ref Object_Nobject "Nobject": number of Objects in class.
     int getNobject() const { return getI("Nobject"); }
 
     /// Get @ref Object_ObjSize "ObjSize": the in-memory size of the Object in bytes.
     int getObjSize() const { return getI("ObjSize"); }
 
+    /**
+    Report the memory used by this object and all of its components, by AST class
+
+    The components of compound mappings and frames (@ref CmpMap, @ref TranMap and @ref CmpFrame)
+    and the frames and mappings of a @ref FrameSet are visited recursively.
+    The same AST object reached more than once is counted once in `uniqueBytes`.
+
+    A @ref FrameSet's mappings are found with astGetMapping from its base frame to each other frame,
+    and only their simple (non-compound) components are reported; the compound mappings that join them
+    are counted as part of the FrameSet. Any simple mappings that AST has to build to return
+    those mappings (e.g. by merging components) are reported as well, so for a FrameSet
+    the breakdown is an estimate, as flagged by `isEstimate` in the report and in the usage of
+    class "FrameSet".
+    */
+    MemoryReport memoryReport() const;
+
     /// Get @ref Object_RefCount "RefCount": count of active Object pointers
     int getRefCount() const { return getI("RefCount"); }
 
@@ -256,6 +287,7 @@ protected:
     explicit Object(AstObject * obj) {
         assertOK();
         _objPtr = ObjectPtr(obj, &detail::annulAstObject);
+        _state = std::make_shared<SharedState>();
     }
 
     // This is pure virtual because I *think* AstObject is effectively pure virtual.
@@ -266,6 +298,44 @@ protected:
     // derived type.
     virtual std::unique_ptr<Object> _copyPolymorphic() const = 0;
 
+    /**
+    Discard anything derived from the AST object and cached by this wrapper
+
+    Called after the AST object is modified, e.g. by setting or clearing an attribute.
+    Subclass methods that modify the object in other ways must call it as well.
+    Overrides must call this implementation, which counts the modification
+    (see @ref _getModificationCount) so other wrappers of the AST object discard their caches too.
+    */
+    virtual void _clearCaches() { ++_state->modifications; }
+
+    /**
+    Throw std::runtime_error if this object is frozen (see @ref isFrozen)
+
+    Called before the AST object is modified, by every method that modifies it.
+    */
+    void _assertMutable() const {
+        if (isFrozen()) {
+            std::ostringstream os;
+            os << "this " << getClass() << " is frozen (e.g. shared by an Interner); modify a copy instead";
+            throw std::runtime_error(os.str());
+        }
+    }
+
+    /**
+    Get the number of times the AST object has been modified through any wrapper of it
+
+    A wrapper cast from another (e.g. by `FrameSet(obj)`) shares the AST object, and this count,
+    with it. A cache is only valid while the count is what it was when the cache was filled.
+    */
+    std::size_t _getModificationCount() const { return _state->modifications; }
+
+    /**
+    Share the modification count, and frozen state, of another wrapper of the same AST object
+
+    Called by the constructors that cast an object, which share the AST object by astClone.
+    */
+    void _shareState(Object const & other) { _state = other._state; }
+
     // Implementation of deep copy: should be called to implement _copyPolymorphic
     // by all derived classes.
     template<typename T, typename AstT>
@@ -374,7 +444,11 @@ protected:
     
     @throw std::runtime_error if the attribute is read-only
     */
-    void set(std::string const & setting) { astSet(getRawPtr(), setting.c_str()); }
+    void set(std::string const & setting) {
+        _assertMutable();
+        astSet(getRawPtr(), setting.c_str());
+        _clearCaches();
+    }
 
     /**
     Set the value of an attribute as a bool
@@ -384,8 +458,10 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setB(std::string const & attrib, bool value) {
+        _assertMutable();
         astSetI(getRawPtr(), attrib.c_str(), value);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -396,8 +472,10 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setC(std::string const & attrib, std::string const & value) {
+        _assertMutable();
         astSetC(getRawPtr(), attrib.c_str(), value.c_str());
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -408,8 +486,10 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setD(std::string const & attrib, double value) {
+        _assertMutable();
         astSetD(getRawPtr(), attrib.c_str(), value);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -420,8 +500,10 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setF(std::string const & attrib, float value) {
+        _assertMutable();
         astSetF(getRawPtr(), attrib.c_str(), value);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -432,8 +514,10 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setI(std::string const & attrib, int value) {
+        _assertMutable();
         astSetI(getRawPtr(), attrib.c_str(), value);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -444,12 +528,27 @@ protected:
     @throw std::runtime_error if the attribute does not exist or the value cannot be converted
     */
     void setL(std::string const & attrib, long int value) {
+        _assertMutable();
         astSetL(getRawPtr(), attrib.c_str(), value);
         assertOK();
+        _clearCaches();
     }
 
 private:
+    // State of the AST object shared by every wrapper of it; atomic because transforming threads
+    // read it while the GIL is released
+    struct SharedState {
+        SharedState() : modifications(0), isFrozen(false) {}
+
+        std::atomic<std::size_t> modifications;  // number of modifications made to the AST object
+        std::atomic<bool> isFrozen;              // may the AST object no longer be modified?
+    };
+
+    /// Freeze this object (and every wrapper that shares its AST object); see @ref isFrozen
+    void _freeze() const { _state->isFrozen = true; }
+
     ObjectPtr _objPtr;
+    std::shared_ptr<SharedState> _state;
 };
 
 }  // namespace ast
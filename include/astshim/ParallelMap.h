@@ -67,7 +67,9 @@ public:
     {}
 
     /// Cast an object to a ParallelMap if possible, else throw std::runtime_error
-    explicit ParallelMap(Object & obj) : ParallelMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {}
+    explicit ParallelMap(Object & obj) : ParallelMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~ParallelMap() {}
 
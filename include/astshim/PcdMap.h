@@ -88,7 +88,9 @@ public:
     {}
 
     /// Cast an object to a PcdMap if possible, else throw std::runtime_error
-    explicit PcdMap(Object & obj) : PcdMap(detail::shallowCopy<AstPcdMap>(obj.getRawPtr())) {}
+    explicit PcdMap(Object & obj) : PcdMap(detail::shallowCopy<AstPcdMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~PcdMap() {}
 
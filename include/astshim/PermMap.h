@@ -105,7 +105,9 @@ public:
     {}
 
     /// Cast an object to a PermMap if possible, else throw std::runtime_error
-    explicit PermMap(Object & obj) : PermMap(detail::shallowCopy<AstPermMap>(obj.getRawPtr())) {}
+    explicit PermMap(Object & obj) : PermMap(detail::shallowCopy<AstPermMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~PermMap() {}
 
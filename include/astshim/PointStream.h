@@ -0,0 +1,280 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_POINTSTREAM_H
+#define ASTSHIM_POINTSTREAM_H
+
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "astshim/base.h"
+
+namespace ast {
+
+/**
+A source of points for @ref Mapping.tranStream
+
+Points are read in chunks into a buffer supplied by the caller.
+@ref Mapping.tranStream calls @ref read from a single helper thread, so that the next chunk can be read
+while the current chunk is transformed; a reader is only ever used by one thread at a time.
+
+Binary point files (as used by @ref IStreamPointReader, @ref MmapPointReader and @ref OStreamPointWriter)
+hold native-endian doubles in the same order as astshim's arrays: x0, y0, x1, y1, ...
+*/
+class PointReader {
+public:
+    /**
+    Construct a PointReader
+
+    @param[in] nAxes  Number of axes per point
+    */
+    explicit PointReader(int nAxes);
+
+    virtual ~PointReader() {}
+
+    PointReader(PointReader const &) = delete;
+    PointReader(PointReader &&) = delete;
+    PointReader & operator=(PointReader const &) = delete;
+    PointReader & operator=(PointReader &&) = delete;
+
+    /// Get the number of axes per point
+    int getNaxes() const { return _nAxes; }
+
+    /**
+    Read the next chunk of points
+
+    @param[out] points  Buffer with dimensions (maxPts, nAxes); the points are written to the first rows
+    @return the number of points read, which is less than maxPts only at the end of the data
+        and 0 once the data is exhausted
+
+    @throw std::runtime_error if the data cannot be read
+    */
+    virtual std::size_t read(Array2D const & points) = 0;
+
+private:
+    int const _nAxes;
+};
+
+/**
+A destination for points transformed by @ref Mapping.tranStream
+
+@ref Mapping.tranStream calls @ref write from a single helper thread, so that one chunk can be written
+while the next is transformed; a writer is only ever used by one thread at a time.
+*/
+class PointWriter {
+public:
+    /**
+    Construct a PointWriter
+
+    @param[in] nAxes  Number of axes per point
+    */
+    explicit PointWriter(int nAxes);
+
+    virtual ~PointWriter() {}
+
+    PointWriter(PointWriter const &) = delete;
+    PointWriter(PointWriter &&) = delete;
+    PointWriter & operator=(PointWriter const &) = delete;
+    PointWriter & operator=(PointWriter &&) = delete;
+
+    /// Get the number of axes per point
+    int getNaxes() const { return _nAxes; }
+
+    /**
+    Write a chunk of points
+
+    @param[in] points  Points to write, with dimensions (nPts, nAxes)
+
+    @throw std::runtime_error if the data cannot be written
+    */
+    virtual void write(Array2D const & points) = 0;
+
+private:
+    int const _nAxes;
+};
+
+/**
+Read binary points from a std::istream
+*/
+class IStreamPointReader : public PointReader {
+public:
+    /**
+    Construct an IStreamPointReader
+
+    @param[in] istream  Stream to read; it must outlive this reader
+    @param[in] nAxes  Number of axes per point
+    */
+    IStreamPointReader(std::istream & istream, int nAxes) : PointReader(nAxes), _istream(istream) {}
+
+    virtual ~IStreamPointReader() {}
+
+    virtual std::size_t read(Array2D const & points);
+
+private:
+    std::istream & _istream;
+};
+
+/**
+Read binary points from a memory-mapped file
+
+The file is mapped read-only, so reading it uses no memory beyond the page cache.
+*/
+class MmapPointReader : public PointReader {
+public:
+    /**
+    Construct a MmapPointReader
+
+    @param[in] path  Path to file
+    @param[in] nAxes  Number of axes per point
+
+    @throw std::runtime_error if the file cannot be opened or mapped,
+        or its size is not a whole number of points
+    */
+    MmapPointReader(std::string const & path, int nAxes);
+
+    virtual ~MmapPointReader();
+
+    /// Get the path to the file
+    std::string getPath() const { return _path; }
+
+    /// Get the total number of points in the file
+    std::size_t getNpoints() const { return _nPts; }
+
+    virtual std::size_t read(Array2D const & points);
+
+private:
+    std::string const _path;
+    void * _data;            // start of the mapped file, or nullptr if the file is empty
+    std::size_t _nPts;       // number of points in the file
+    std::size_t _nextPt;     // index of next point to read
+};
+
+/**
+Read points by calling a function
+
+The function has the same signature and contract as @ref PointReader.read.
+It is called from a helper thread of @ref Mapping.tranStream.
+
+This class is only available from C++: Python cannot supply a std::function, and a Python callable
+would need the GIL, which tranStream releases.
+*/
+class CallbackPointReader : public PointReader {
+public:
+    typedef std::function<std::size_t(Array2D const &)> Callback;
+
+    /**
+    Construct a CallbackPointReader
+
+    @param[in] callback  Function to call to read each chunk of points
+    @param[in] nAxes  Number of axes per point
+    */
+    CallbackPointReader(Callback const & callback, int nAxes) : PointReader(nAxes), _callback(callback) {}
+
+    virtual ~CallbackPointReader() {}
+
+    virtual std::size_t read(Array2D const & points) { return _callback(points); }
+
+private:
+    Callback _callback;
+};
+
+/**
+Write binary points to a std::ostream
+*/
+class OStreamPointWriter : public PointWriter {
+public:
+    /**
+    Construct an OStreamPointWriter
+
+    @param[in] ostream  Stream to write; it must outlive this writer
+    @param[in] nAxes  Number of axes per point
+    */
+    OStreamPointWriter(std::ostream & ostream, int nAxes) : PointWriter(nAxes), _ostream(ostream) {}
+
+    virtual ~OStreamPointWriter() {}
+
+    virtual void write(Array2D const & points);
+
+private:
+    std::ostream & _ostream;
+};
+
+/**
+Write binary points to a file
+*/
+class FilePointWriter : public PointWriter {
+public:
+    /**
+    Construct a FilePointWriter
+
+    @param[in] path  Path to file; an existing file is overwritten
+    @param[in] nAxes  Number of axes per point
+
+    @throw std::runtime_error if the file cannot be opened
+    */
+    FilePointWriter(std::string const & path, int nAxes);
+
+    virtual ~FilePointWriter() {}
+
+    /// Get the path to the file
+    std::string getPath() const { return _path; }
+
+    virtual void write(Array2D const & points);
+
+private:
+    std::string const _path;
+    std::ofstream _ofstream;
+};
+
+/**
+Write points by calling a function
+
+The function is called from a helper thread of @ref Mapping.tranStream.
+
+This class is only available from C++, for the same reasons as @ref CallbackPointReader.
+*/
+class CallbackPointWriter : public PointWriter {
+public:
+    typedef std::function<void(Array2D const &)> Callback;
+
+    /**
+    Construct a CallbackPointWriter
+
+    @param[in] callback  Function to call to write each chunk of points
+    @param[in] nAxes  Number of axes per point
+    */
+    CallbackPointWriter(Callback const & callback, int nAxes) : PointWriter(nAxes), _callback(callback) {}
+
+    virtual ~CallbackPointWriter() {}
+
+    virtual void write(Array2D const & points) { _callback(points); }
+
+private:
+    Callback _callback;
+};
+
+}  // namespace ast
+
+#endif
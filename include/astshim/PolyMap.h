@@ -23,9 +23,11 @@
 #define ASTSHIM_POLYMAP_H
 
 #include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "astshim/base.h"
@@ -123,7 +125,9 @@ public:
     {}
 
     /// Cast an object to a PolyMap if possible, else throw std::runtime_error
-    explicit PolyMap(Object & obj) : PolyMap(detail::shallowCopy<AstPolyMap>(obj.getRawPtr())) {}
+    explicit PolyMap(Object & obj) : PolyMap(detail::shallowCopy<AstPolyMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~PolyMap() {}
 
@@ -215,6 +219,11 @@ public:
                     The new polynomial will be evaluated over this rectangle. The length
                     should equal getNin() or getNout(), depending on `forward`.
 
+    If the polyTran cache is enabled (see @ref setPolyTranCacheSize and @ref setPolyTranCacheDir),
+    the result is looked up by the content of this PolyMap and the values of all the arguments,
+    and only fitted if it is not found, so each distortion model need only be fitted once
+    (once per machine, or once for all machines sharing a cache directory).
+
     @throw std::invalid_argument if lbnd.size() or ubnd.size() does not match getNin()/getNout()
                     if `forward` is true/false.
     */
@@ -225,25 +234,37 @@ public:
         int maxorder,
         std::vector<double> const & lbnd,
         std::vector<double> const & ubnd
-    ) {
-        int desSize = forward ? getNin() : getNout();
-        if (lbnd.size() != desSize) {
-            std::ostringstream os;
-            os << "lbnd.size() = " << lbnd.size() << " != " << desSize
-                << " = " << (forward ? "getNin()" : "getNout()");
-            throw std::invalid_argument(os.str());
-        }
-        if (ubnd.size() != desSize) {
-            std::ostringstream os;
-            os << "ubnd.size() = " << ubnd.size() << " != " << desSize
-                << " = " << (forward ? "getNin()" : "getNout()");
-            throw std::invalid_argument(os.str());
-        }
+    );
 
-        void * map = astPolyTran(this->getRawPtr(), static_cast<int>(forward), acc, maxacc, maxorder,
-                                       lbnd.data(), ubnd.data());
-        return PolyMap(reinterpret_cast<AstPolyMap *>(map));
-    }
+    /**
+    Compute @ref polyTran for many PolyMaps, e.g. the distortion model of every detector of a camera,
+    using multiple threads
+
+    Each thread fits its own copy of a PolyMap. PolyMaps with identical content are fitted once.
+    Multiple threads are only used if AST was built with thread support.
+
+    @param[in] polyMaps  PolyMaps to fit
+    @param[in] forward  Replace the forward transformation? See @ref polyTran.
+    @param[in] acc  Target accuracy, as for @ref polyTran
+    @param[in] maxacc  Maximum allowed accuracy, as for @ref polyTran
+    @param[in] maxorder  Maximum polynomial order, as for @ref polyTran
+    @param[in] lbnd  Lower bounds of the region to fit, as for @ref polyTran
+    @param[in] ubnd  Upper bounds of the region to fit, as for @ref polyTran
+    @param[in] nThreads  Number of threads; 0 for one per hardware thread
+    @return the new PolyMap for each of `polyMaps`
+
+    @throw std::invalid_argument for any reason given by @ref polyTran.
+    */
+    static std::vector<std::shared_ptr<PolyMap>> polyTrans(
+        std::vector<std::shared_ptr<PolyMap>> const & polyMaps,
+        bool forward,
+        double acc,
+        double maxacc,
+        int maxorder,
+        std::vector<double> const & lbnd,
+        std::vector<double> const & ubnd,
+        int nThreads=0
+    );
 
 private:
     /// Construct a PolyMap from an raw AST pointer
@@ -309,6 +330,54 @@ private:
     }
 };
 
+/**
+Get the maximum number of results kept in memory by the cache used by @ref PolyMap.polyTran
+
+See @ref setPolyTranCacheSize for details.
+*/
+std::size_t getPolyTranCacheSize();
+
+/**
+Set the maximum number of results kept in memory by the cache used by @ref PolyMap.polyTran
+
+Fitting a high-order polynomial is expensive, so while this cache is enabled, @ref PolyMap.polyTran
+saves each new PolyMap and returns a copy of it for later calls with a PolyMap that has the same content
+and the same arguments. PolyMaps are identified by their description by @ref Object.show (looked up
+by its hash and length, then compared in full), so the cache is shared by all PolyMaps, including copies
+and PolyMaps read from files.
+When the cache is full, the least recently used result is discarded.
+
+The cache is shared by all threads.
+
+@param[in] maxEntries  Maximum number of results to keep; 0 (the default) disables the cache
+    and discards any results in it
+*/
+void setPolyTranCacheSize(std::size_t maxEntries);
+
+/// Discard all results in the memory cache used by @ref PolyMap.polyTran
+void clearPolyTranCache();
+
+/**
+Get the directory used by @ref PolyMap.polyTran to cache results on disk; empty if none
+
+See @ref setPolyTranCacheDir for details.
+*/
+std::string getPolyTranCacheDir();
+
+/**
+Set the directory used by @ref PolyMap.polyTran to cache results on disk
+
+While a directory is set, @ref PolyMap.polyTran looks for a result saved in a file in that directory
+(after looking in memory) and saves each result it fits, so that other processes, e.g. the workers
+of a batch job, can use it. Each file holds the full description of the PolyMap that was fitted
+and the arguments, which are checked before a result is used. Files are written under temporary
+names and renamed, so processes may share a directory.
+
+@param[in] dir  The directory, which must exist; empty (the default) to not use a disk cache.
+    Files are never removed from it by astshim.
+*/
+void setPolyTranCacheDir(std::string const & dir);
+
 }  // namespace ast
 
 #endif
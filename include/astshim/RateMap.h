@@ -72,7 +72,9 @@ public:
     {}
 
     /// Cast an object to a RateMap if possible, else throw std::runtime_error
-    explicit RateMap(Object & obj) : RateMap(detail::shallowCopy<AstRateMap>(obj.getRawPtr())) {}
+    explicit RateMap(Object & obj) : RateMap(detail::shallowCopy<AstRateMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~RateMap() {}
 
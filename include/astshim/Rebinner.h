@@ -0,0 +1,216 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_REBINNER_H
+#define ASTSHIM_REBINNER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/Resample.h"
+
+namespace ast {
+
+class Mapping;
+
+/**
+Parameters controlling a @ref Rebinner
+*/
+class RebinControl {
+public:
+    /**
+    Construct a RebinControl
+
+    @param[in] kernel  Kernel used to spread each input pixel over the output pixels;
+                any kernel except `ResampleKernel::BLOCKAVE`
+    @param[in] tol  Maximum tolerable error, in output pixels, introduced by approximating the mapping
+                with piece-wise linear transformations; 0 to evaluate the mapping at every input pixel
+    */
+    explicit RebinControl(ResampleKernel kernel=ResampleKernel::LINEAR, double tol=0.0) :
+        kernel(kernel),
+        params(),
+        tol(tol),
+        maxpix(50),
+        wlim(0.0),
+        conserveFlux(false),
+        genVariance(false),
+        varianceWeight(false),
+        badMask(0),
+        nThreads(1),
+        tileSize(256)
+    {}
+
+    ~RebinControl() {}
+
+    RebinControl(RebinControl const &) = default;
+    RebinControl(RebinControl &&) = default;
+    RebinControl & operator=(RebinControl const &) = default;
+    RebinControl & operator=(RebinControl &&) = default;
+
+    ResampleKernel kernel;  ///< spreading kernel
+    std::vector<double> params;  ///< parameters for the kernel, as for astRebinSeq; missing values are 0
+    double tol;             ///< maximum error introduced by linear approximation (output pixels)
+    int maxpix;             ///< initial scale size (input pixels) for the linear approximation
+    double wlim;            ///< minimum weight, relative to a typical input pixel, for a good output pixel
+    bool conserveFlux;      ///< scale output values to conserve flux?
+    bool genVariance;       ///< compute output variance from the spread of input values?
+    bool varianceWeight;    ///< weight each input pixel by its inverse variance?
+    int badMask;            ///< mask bits that mark an input pixel as bad
+    int nThreads;           ///< number of threads; 0 for one per hardware thread
+    int tileSize;           ///< width and height of the input tiles that are shared among threads
+};
+
+/**
+Accumulate many images onto one output pixel grid, using astRebinSeqD
+
+Each input image is added by calling @ref add with a mapping from its pixel (grid) coordinates
+to those of the output. When all images have been added, call @ref finish to obtain the normalized
+output image and variance. The accumulators are kept, so more images may be added after that.
+
+Images are indexed [y, x] (so x varies fastest, as for AST) and pixel [0, 0] has grid coordinates `lbnd`;
+pixel centres have integer grid coordinates, as for AST.
+
+Each input image is divided into tiles of `ctrl.tileSize` pixels on a side. The tiles are split into
+`ctrl.nThreads` contiguous groups, each of which is rebinned by one thread into its own partial
+accumulator covering just the part of the output that the image overlaps. The partial accumulators are
+then added to the output accumulators in group order, so the result is reproducible for a given number
+of threads; it may differ in the last few bits for a different number of threads.
+Multiple threads are only used if AST was built with thread support.
+*/
+class Rebinner {
+public:
+    /**
+    Construct a Rebinner with empty accumulators
+
+    @param[in] lbnd  Grid coordinates (x, y) of the first pixel of the output
+    @param[in] ubnd  Grid coordinates (x, y) of the last pixel of the output
+    @param[in] ctrl  Control parameters, used for every image
+
+    @throw std::invalid_argument if `lbnd` or `ubnd` does not have 2 elements,
+        if `ubnd` < `lbnd` on either axis, or if `ctrl.tileSize` < 1.
+    */
+    Rebinner(std::vector<int> const & lbnd, std::vector<int> const & ubnd,
+             RebinControl const & ctrl=RebinControl());
+
+    ~Rebinner() {}
+
+    Rebinner(Rebinner const &) = default;
+    Rebinner(Rebinner &&) = default;
+    Rebinner & operator=(Rebinner const &) = default;
+    Rebinner & operator=(Rebinner &&) = default;
+
+    /**
+    Add an image with no mask
+
+    Equivalent to the full version of @ref add with an empty mask.
+    */
+    void add(
+        Mapping const & map,
+        ndarray::Array<double const, 2, 2> const & image,
+        ndarray::Array<double const, 2, 2> const & variance,
+        std::vector<int> const & lbnd
+    );
+
+    /**
+    Add an image to the accumulators
+
+    @param[in] map  Mapping from the grid coordinates of `image` to those of the output;
+                its forward transformation is used
+    @param[in] image  Image to add
+    @param[in] variance  Variance of `image`; may be empty. Must be provided for every image,
+                or for none, unless `ctrl.genVariance` is true; required if `ctrl.varianceWeight` is true.
+    @param[in] mask  Mask of `image`; may be empty. Pixels with any of the bits in
+                `ctrl.badMask` set are ignored, as are NaN image or variance pixels.
+    @param[in] lbnd  Grid coordinates (x, y) of image[0, 0]
+
+    @throw std::invalid_argument if `map` is not 2-dimensional, if array shapes do not match,
+        or if variance is provided for some images and not others.
+    @throw std::runtime_error if AST reports an error.
+    */
+    void add(
+        Mapping const & map,
+        ndarray::Array<double const, 2, 2> const & image,
+        ndarray::Array<double const, 2, 2> const & variance,
+        ndarray::Array<int const, 2, 2> const & mask,
+        std::vector<int> const & lbnd
+    );
+
+    /**
+    Compute the normalized output from the images added so far
+
+    The accumulators are not changed.
+
+    @param[out] image  Output image, with shape (height, width) of the output grid;
+                pixels with too little weight (see `ctrl.wlim`) are set to NaN
+    @param[out] variance  Output variance; may be empty. Must be empty unless
+                variance is being accumulated (see @ref hasVariance).
+
+    @return the number of output pixels set to NaN
+
+    @throw std::invalid_argument if an array has the wrong shape
+    @throw std::runtime_error if AST reports an error.
+    */
+    int finish(
+        ndarray::Array<double, 2, 2> const & image,
+        ndarray::Array<double, 2, 2> const & variance
+    ) const;
+
+    /// Zero the accumulators, ready to start again
+    void reset();
+
+    /// Get the grid coordinates of the first output pixel
+    std::vector<int> getLbnd() const { return _lbnd; }
+
+    /// Get the grid coordinates of the last output pixel
+    std::vector<int> getUbnd() const { return _ubnd; }
+
+    /// Get the control parameters
+    RebinControl getControl() const { return _ctrl; }
+
+    /// Get the number of images added since construction or the last call to @ref reset
+    int getNumImages() const { return _nImages; }
+
+    /// Get the total number of input pixels that have contributed to the output
+    std::size_t getNused() const { return static_cast<std::size_t>(_nused); }
+
+    /// Is output variance being accumulated?
+    bool hasVariance() const { return !_variance.empty(); }
+
+private:
+    std::vector<int> _lbnd;
+    std::vector<int> _ubnd;
+    RebinControl _ctrl;
+    int _width;
+    int _height;
+    int _nImages;
+    bool _inputVariance;  // were variances supplied with the images added so far?
+    std::int64_t _nused;
+    std::vector<double> _image;     // sum of weighted values
+    std::vector<double> _variance;  // variance accumulator; empty if variance is not accumulated
+    std::vector<double> _weights;   // weights; twice as many as pixels if ctrl.genVariance
+};
+
+}  // namespace ast
+
+#endif
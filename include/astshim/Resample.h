@@ -0,0 +1,94 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_RESAMPLE_H
+#define ASTSHIM_RESAMPLE_H
+
+#include <vector>
+
+#include "astshim/base.h"
+
+namespace ast {
+
+/**
+Enums describing the interpolation kernel used by @ref Mapping.resample
+
+See the description of `interp` for astResample<X> in the AST manual for details of each kernel
+and of the parameters in @ref ResampleControl.params that each uses.
+*/
+enum class ResampleKernel {
+    NEAREST = AST__NEAREST,     ///< nearest pixel
+    LINEAR = AST__LINEAR,       ///< linear interpolation between the nearest pixels
+    SINC = AST__SINC,           ///< sinc(pi x)
+    SINCSINC = AST__SINCSINC,   ///< sinc(pi x) sinc(k pi x)
+    SINCCOS = AST__SINCCOS,     ///< sinc(pi x) cos(k pi x)
+    SINCGAUSS = AST__SINCGAUSS, ///< sinc(pi x) exp(-k x^2)
+    SOMB = AST__SOMB,           ///< somb(pi x)
+    SOMBCOS = AST__SOMBCOS,     ///< somb(pi x) cos(k pi x)
+    GAUSS = AST__GAUSS,         ///< exp(-k x^2)
+    BLOCKAVE = AST__BLOCKAVE,   ///< block average over a box of pixels
+};
+
+/**
+Parameters controlling @ref Mapping.resample
+*/
+class ResampleControl {
+public:
+    /**
+    Construct a ResampleControl
+
+    @param[in] kernel  Interpolation kernel
+    @param[in] tol  Maximum tolerable error, in output pixels, introduced by approximating the mapping
+                with piece-wise linear transformations; 0 to evaluate the mapping at every output pixel
+    */
+    explicit ResampleControl(ResampleKernel kernel=ResampleKernel::LINEAR, double tol=0.0) :
+        kernel(kernel),
+        params(),
+        tol(tol),
+        maxpix(50),
+        conserveFlux(false),
+        badMask(0),
+        noDataMask(0),
+        nThreads(1),
+        tileSize(256)
+    {}
+
+    ~ResampleControl() {}
+
+    ResampleControl(ResampleControl const &) = default;
+    ResampleControl(ResampleControl &&) = default;
+    ResampleControl & operator=(ResampleControl const &) = default;
+    ResampleControl & operator=(ResampleControl &&) = default;
+
+    ResampleKernel kernel;  ///< interpolation kernel
+    std::vector<double> params;  ///< parameters for the kernel, as for astResample; missing values are 0
+    double tol;             ///< maximum error introduced by linear approximation (output pixels)
+    int maxpix;             ///< initial scale size (output pixels) for the linear approximation
+    bool conserveFlux;      ///< scale output values to conserve flux?
+    int badMask;            ///< mask bits that mark an input pixel as bad
+    int noDataMask;         ///< mask bits to set for output pixels that receive no data
+    int nThreads;           ///< number of threads; 0 for one per hardware thread
+    int tileSize;           ///< width and height of the output tiles that are shared among threads
+};
+
+}  // namespace ast
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_SCRATCHARENA_H
+#define ASTSHIM_SCRATCHARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace ast {
+
+class ScratchBuffer;
+
+/**
+A per-thread, growable pool of memory for the temporary buffers used when transforming points.
+
+Each thread has its own arena, obtained with @ref get. Temporaries are borrowed from it by
+constructing a @ref ScratchBuffer, which returns the memory when it goes out of scope.
+The arena keeps the memory, so once it has grown large enough for the work a thread does
+(e.g. a loop calling @ref Mapping.tran on batches of similar size), transforming points
+does no heap allocation at all.
+
+The arena grows as needed and never shrinks on its own; call @ref trim to release memory
+that is not in use.
+*/
+class ScratchArena {
+public:
+    friend class ScratchBuffer;
+
+    /// Get the arena for the calling thread
+    static ScratchArena & get();
+
+    ~ScratchArena() {}
+
+    ScratchArena(ScratchArena const &) = delete;
+    ScratchArena(ScratchArena &&) = delete;
+    ScratchArena & operator=(ScratchArena const &) = delete;
+    ScratchArena & operator=(ScratchArena &&) = delete;
+
+    /// Get the number of bytes held by the arena, whether in use or not
+    std::size_t getCapacity() const;
+
+    /// Get the number of bytes currently lent out
+    std::size_t getInUse() const { return _inUse * sizeof(double); }
+
+    /**
+    Get the largest number of bytes lent out at one time since the thread started
+    or @ref trim was last called
+    */
+    std::size_t getHighWaterMark() const { return _highWaterMark * sizeof(double); }
+
+    /**
+    Release all memory that is not in use and reset the high-water mark to the number of bytes in use
+
+    @return the number of bytes released
+    */
+    std::size_t trim();
+
+private:
+    // A block of memory from which buffers are lent in last in, first out order;
+    // data starts on a 64-byte cache line, so buffers (whose sizes are padded to whole lines) do too
+    struct Block {
+        explicit Block(std::size_t size);
+        std::unique_ptr<double[]> storage;
+        double * data;
+        std::size_t size;
+        std::size_t used;
+    };
+
+    ScratchArena() : _blocks(), _inUse(0), _highWaterMark(0) {}
+
+    double * _borrow(std::size_t size);
+
+    void _return(std::size_t size);
+
+    std::vector<Block> _blocks;
+    std::size_t _inUse;           // number of doubles lent out
+    std::size_t _highWaterMark;   // largest value of _inUse
+};
+
+/**
+A temporary array of doubles borrowed from the calling thread's @ref ScratchArena
+
+The data starts on a 64-byte cache line, and the buffer is padded to a whole number of lines,
+so buffers never share a cache line.
+
+Scratch buffers must be destroyed in the reverse order they were created, which is automatic
+for local variables. They can be neither copied nor moved, and must not be shared between threads.
+The contents are not initialized.
+*/
+class ScratchBuffer {
+public:
+    /**
+    Borrow a buffer
+
+    @param[in] size  Number of doubles
+    */
+    explicit ScratchBuffer(std::size_t size);
+
+    ~ScratchBuffer();
+
+    ScratchBuffer(ScratchBuffer const &) = delete;
+    ScratchBuffer(ScratchBuffer &&) = delete;
+    ScratchBuffer & operator=(ScratchBuffer const &) = delete;
+    ScratchBuffer & operator=(ScratchBuffer &&) = delete;
+
+    /// Get a pointer to the data
+    double * data() const { return _data; }
+
+    /// Get the number of doubles in the buffer
+    std::size_t size() const { return _size; }
+
+    double & operator[](std::size_t i) const { return _data[i]; }
+
+private:
+    ScratchArena & _arena;
+    std::size_t _size;
+    std::size_t _paddedSize;  // size rounded up to a whole number of 64-byte cache lines
+    double * _data;
+};
+
+}  // namespace ast
+
+#endif
@@ -67,7 +67,9 @@ public:
     {}
 
     /// Cast an object to a SeriesMap if possible, else throw std::runtime_error
-    explicit SeriesMap(Object & obj) : SeriesMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {}
+    explicit SeriesMap(Object & obj) : SeriesMap(detail::shallowCopy<AstCmpMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~SeriesMap() {}
 
@@ -49,7 +49,9 @@ public:
     {}
 
     /// Cast an object to a ShiftMap if possible, else throw std::runtime_error
-    explicit ShiftMap(Object & obj) : ShiftMap(detail::shallowCopy<AstShiftMap>(obj.getRawPtr())) {}
+    explicit ShiftMap(Object & obj) : ShiftMap(detail::shallowCopy<AstShiftMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~ShiftMap() {}
 
@@ -125,7 +125,9 @@ public:
     {}
 
     /// Cast an object to a SkyFrame if possible, else throw std::runtime_error
-    explicit SkyFrame(Object & obj) : SkyFrame(detail::shallowCopy<AstSkyFrame>(obj.getRawPtr())) {}
+    explicit SkyFrame(Object & obj) : SkyFrame(detail::shallowCopy<AstSkyFrame>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~SkyFrame() {}
 
@@ -69,7 +69,9 @@ public:
     }
 
     /// Cast an object to a SlaMap if possible, else throw std::runtime_error
-    explicit SlaMap(Object & obj) : SlaMap(detail::shallowCopy<AstSlaMap>(obj.getRawPtr())) {}
+    explicit SlaMap(Object & obj) : SlaMap(detail::shallowCopy<AstSlaMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~SlaMap() {}
 
@@ -172,8 +174,10 @@ public:
     the effects of atmospheric refraction are not.
     */
     void add(std::string const & cvt, std::vector<double> const & args=std::vector<double>()) {
+        _assertMutable();
         astSlaAdd(getRawPtr(), cvt.c_str(), args.size(), args.data());
         assertOK();
+        _clearCaches();
     }
 
     /// Return a deep copy of this object.
@@ -192,6 +196,38 @@ private:
     }
 };
 
+/**
+Return a copy of a celestial coordinate conversion in which the steps that amount to a fixed rotation
+of the sky are replaced by a rotation matrix, so the conversion can be evaluated natively
+
+Many of the conversions provided by @ref SlaMap (e.g. "PREC", "EQGAL", "HFK5Z" and "GALSUP") rotate
+the sky by an amount that depends only on their arguments (epochs and dates), yet AST recomputes
+the rotation for every point. This function fits a 3x3 matrix to each run of consecutive steps,
+as a linear transformation of unit vectors, and replaces the run by
+(inverse @ref SphMap, @ref MatrixMap, @ref SphMap), which @ref Mapping.freeze "freeze"
+evaluates natively. Steps that are not rotations, such as the E-terms
+of aberration ("ADDET", "SUBET", and hence "FK45Z" and "FK54Z") or apparent place ("AMP", "MAP"),
+are kept as they are unless they are within `maxError` of one.
+
+An SlaMap is split into its individual conversions (as by @ref SlaMap.add "add"), and a compound
+mapping into its series components, before runs are sought.
+A run is replaced only if the matrix transforms a thousand positions spread over the whole sky
+to within `maxError` of where the run puts them, and only if the run includes a nonlinear step.
+
+@param[in] map  Mapping from (longitude, latitude) to (longitude, latitude), in radians; e.g. an
+                @ref SlaMap, or the @ref FrameSet returned by @ref Frame.convert "convert"
+                between two @ref SkyFrame "SkyFrames".
+@param[in] maxError  Largest allowed angular difference, in radians, between a position
+                transformed by a replacement and by the steps it replaces.
+@return  The simplified mapping (of the base to the current frame, for a FrameSet), with rotations
+        replaced. The replacements return longitudes in the range [-pi, pi] (the same sky positions as
+        the steps they replace, which may return longitudes in [0, 2 pi]).
+
+@throw std::invalid_argument if `map` does not have 2 inputs and 2 outputs,
+    or `maxError` is not positive.
+*/
+Mapping optimizeSkyConversion(Mapping const & map, double maxError=1e-12);
+
 }  // namespace ast
 
 #endif
@@ -117,7 +117,9 @@ public:
     {}
 
     /// Cast an object to a SpecFrame if possible, else throw std::runtime_error
-    explicit SpecFrame(Object & obj) : SpecFrame(detail::shallowCopy<AstSpecFrame>(obj.getRawPtr())) {}
+    explicit SpecFrame(Object & obj) : SpecFrame(detail::shallowCopy<AstSpecFrame>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~SpecFrame() {}
 
@@ -229,8 +231,10 @@ public:
             represented by the supplied @ref SkyFrame (radians).
     */
     void setRefPos(SkyFrame const & frm, double lon, double lat) {
+        _assertMutable();
         astSetRefPos(getRawPtr(), frm.getRawPtr(), lon, lat);
         assertOK();
+        _clearCaches();
     }
 
     /**
@@ -241,8 +245,10 @@ public:
     @param[in] dec  FK5 J2000 Dec (radians).
     */
     void setRefPos(double ra, double dec) {
+        _assertMutable();
         astSetRefPos(getRawPtr(), NULL, ra, dec);
         assertOK();
+        _clearCaches();
     }
 
     /// Set @ref SpecFrame_RestFreq "RestFreq": rest frequency in GHz.
@@ -64,7 +64,9 @@ public:
     {}
 
     /// Cast an object to a SphMap if possible, else throw std::runtime_error
-    explicit SphMap(Object & obj) : SphMap(detail::shallowCopy<AstSphMap>(obj.getRawPtr())) {}
+    explicit SphMap(Object & obj) : SphMap(detail::shallowCopy<AstSphMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~SphMap() {}
 
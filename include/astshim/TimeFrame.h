@@ -90,7 +90,9 @@ public:
     {}
 
     /// Cast an object to a TimeFrame if possible, else throw std::runtime_error
-    explicit TimeFrame(Object & obj) : TimeFrame(detail::shallowCopy<AstTimeFrame>(obj.getRawPtr())) {}
+    explicit TimeFrame(Object & obj) : TimeFrame(detail::shallowCopy<AstTimeFrame>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~TimeFrame() {}
 
@@ -122,6 +124,27 @@ public:
         return detail::safeDouble(astCurrentTime(getRawPtr()));
     }
 
+    /**
+    Convert an array of times from this frame to another TimeFrame, e.g. the arrival times of a list
+    of events from UTC to TDB
+
+    @param[in] to  The frame to convert the times to.
+    @param[in] times  The times to convert, as specified by the attributes of this frame.
+    @return the times as specified by the attributes of `to`; bad times are NaN.
+
+    The conversion is found by @ref Frame.convert "convert". If it includes a @ref TimeMap
+    (e.g. for leap seconds or the TDB series) and the array is large, it is tabulated over the range
+    of the times, which is much faster than AST converting each time; the table has a breakpoint at
+    each leap second within the range and matches AST to within a few units in the last place.
+    Otherwise, or if the conversion cannot be tabulated, the times are converted by
+    @ref Mapping.tran "tran", which uses AST.
+
+    @throw ast::notfound_error if no conversion between the frames can be found
+        (e.g. if `to` has an "angular" `TimeScale` and this frame does not).
+    */
+    ndarray::Array<double, 1, 1> convertTimes(TimeFrame const & to,
+                                              ndarray::Array<double const, 1, 0> const & times);
+
     /// Get @ref TimeFrame_AlignTimeScale "AlignTimeScale": time scale in which to align TimeFrames.
     std::string getAlignTimeScale() const { return getC("AlignTimeScale"); }
 
@@ -57,7 +57,9 @@ public:
     {}
 
     /// Cast an object to a TimeMap if possible, else throw std::runtime_error
-    explicit TimeMap(Object & obj) : TimeMap(detail::shallowCopy<AstTimeMap>(obj.getRawPtr())) {}
+    explicit TimeMap(Object & obj) : TimeMap(detail::shallowCopy<AstTimeMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~TimeMap() {}
 
@@ -178,8 +180,10 @@ public:
     for time zones east of Greenwich).
     */
     void add(std::string const & cvt, std::vector<double> const & args=std::vector<double>()) {
+        _assertMutable();
         astTimeAdd(getRawPtr(), cvt.c_str(), args.size(), args.data());
         assertOK();
+        _clearCaches();
     }
 
     /// Return a deep copy of this object.
@@ -62,7 +62,9 @@ public:
     {}
 
     /// Cast an object to a TranMap if possible, else throw std::runtime_error
-    explicit TranMap(Object & obj) : TranMap(detail::shallowCopy<AstTranMap>(obj.getRawPtr())) {}
+    explicit TranMap(Object & obj) : TranMap(detail::shallowCopy<AstTranMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~TranMap() {}
 
@@ -55,7 +55,9 @@ public:
     {}
 
     /// Cast an object to a UnitMap if possible, else throw std::runtime_error
-    explicit UnitMap(Object & obj) : UnitMap(detail::shallowCopy<AstUnitMap>(obj.getRawPtr())) {}
+    explicit UnitMap(Object & obj) : UnitMap(detail::shallowCopy<AstUnitMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~UnitMap() {}
 
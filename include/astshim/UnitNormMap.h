@@ -66,7 +66,9 @@ public:
     {}
 
     /// Cast an object to a UnitNormMap if possible, else throw std::runtime_error
-    explicit UnitNormMap(Object & obj) : UnitNormMap(detail::shallowCopy<AstUnitNormMap>(obj.getRawPtr())) {}
+    explicit UnitNormMap(Object & obj) : UnitNormMap(detail::shallowCopy<AstUnitNormMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~UnitNormMap() {}
 
@@ -0,0 +1,77 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_WARP_H
+#define ASTSHIM_WARP_H
+
+namespace ast {
+
+/**
+Enums describing the interpolation kernel used by @ref Mapping.warp
+*/
+enum class WarpKernel {
+    BILINEAR,   ///< bilinear interpolation between the 2x2 nearest pixels
+    /// Lanczos kernel of order 3, sinc(x) sinc(x/3), over the 6x6 nearest pixels;
+    /// a position within 2 pixels of the low edge or 3 of the high edge of the source gets no data
+    LANCZOS3,
+};
+
+/**
+Parameters controlling @ref Mapping.warp
+*/
+class WarpControl {
+public:
+    /**
+    Construct a WarpControl
+
+    @param[in] kernel  Interpolation kernel
+    @param[in] tol  Maximum tolerable error, in source pixels, introduced by approximating the mapping
+                with piece-wise linear transformations; 0 to evaluate the mapping at every output pixel
+    */
+    explicit WarpControl(WarpKernel kernel=WarpKernel::LANCZOS3, double tol=0.0) :
+        kernel(kernel),
+        tol(tol),
+        maxpix(50),
+        badMask(0),
+        noDataMask(0),
+        nThreads(1),
+        blockSize(64)
+    {}
+
+    ~WarpControl() {}
+
+    WarpControl(WarpControl const &) = default;
+    WarpControl(WarpControl &&) = default;
+    WarpControl & operator=(WarpControl const &) = default;
+    WarpControl & operator=(WarpControl &&) = default;
+
+    WarpKernel kernel;  ///< interpolation kernel
+    double tol;         ///< maximum error introduced by linear approximation (source pixels)
+    int maxpix;         ///< initial scale size (output pixels) for the linear approximation
+    int badMask;        ///< mask bits that mark a source pixel as bad
+    int noDataMask;     ///< mask bits to set for destination pixels that receive no data
+    int nThreads;       ///< number of threads; 0 for one per hardware thread
+    int blockSize;      ///< width and height of the destination blocks that are shared among threads
+};
+
+}  // namespace ast
+
+#endif
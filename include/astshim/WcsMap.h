@@ -210,7 +210,9 @@ public:
     {}
 
     /// Cast an object to a WcsMap if possible, else throw std::runtime_error
-    explicit WcsMap(Object & obj) : WcsMap(detail::shallowCopy<AstWcsMap>(obj.getRawPtr())) {}
+    explicit WcsMap(Object & obj) : WcsMap(detail::shallowCopy<AstWcsMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~WcsMap() {}
 
@@ -67,7 +67,9 @@ public:
     {}
 
     /// Cast an object to a WinMap if possible, else throw std::runtime_error
-    explicit WinMap(Object & obj) : WinMap(detail::shallowCopy<AstWinMap>(obj.getRawPtr())) {}
+    explicit WinMap(Object & obj) : WinMap(detail::shallowCopy<AstWinMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~WinMap() {}
 
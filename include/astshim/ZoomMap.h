@@ -63,7 +63,9 @@ public:
     {}
 
     /// Cast an object to a ZoomMap if possible, else throw std::runtime_error
-    explicit ZoomMap(Object & obj) : ZoomMap(detail::shallowCopy<AstZoomMap>(obj.getRawPtr())) {}
+    explicit ZoomMap(Object & obj) : ZoomMap(detail::shallowCopy<AstZoomMap>(obj.getRawPtr())) {
+        _shareState(obj);
+    }
 
     virtual ~ZoomMap() {}
 
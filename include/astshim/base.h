@@ -40,6 +40,10 @@ public:
 };
 
 typedef ndarray::Array<double, 2, 2> Array2D;
+/// Read-only 2-d array with any memory layout (e.g. C- or Fortran-ordered)
+typedef ndarray::Array<double const, 2, 0> ConstArray2D;
+/// Writable 2-d array with any memory layout (e.g. C- or Fortran-ordered)
+typedef ndarray::Array<double, 2, 0> StridedArray2D;
 
 /**
 Throw std::runtime_error if AST's state is bad
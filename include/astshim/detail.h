@@ -22,7 +22,11 @@
 #ifndef ASTSHIM_DETAIL_H
 #define ASTSHIM_DETAIL_H
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
+#include <vector>
 
 #include "astshim/base.h"
 
@@ -71,9 +75,11 @@ inline void astBadToNan(std::vector<double> & p) {
 }
 
 /**
-Replace `AST__BAD` with a quiet NaN in a vector
+Replace `AST__BAD` with a quiet NaN in a 2-d array
+
+The array may have any memory layout; the data is modified in place.
 */
-inline void astBadToNan(ast::Array2D & arr) {
+inline void astBadToNan(ast::StridedArray2D const & arr) {
     for (auto i = arr.begin(); i != arr.end(); ++i) {
         for (auto j = i->begin(); j != i->end(); ++j) {
             if (*j == AST__BAD) {
@@ -83,6 +89,150 @@ inline void astBadToNan(ast::Array2D & arr) {
     }
 }
 
+/**
+Return the leading dimension with which astTranN and similar functions can use an array of coordinates
+in place, or 0 if the array must be transposed first.
+
+AST wants coordinates axis-major: all values for the first axis, then all values for the second axis...
+An array of (nPts, nAxes) coordinates is in that order if it is Fortran-ordered (possibly with padding
+between axes), or if it has a single axis and unit stride.
+
+@param[in] arr  Coordinates with dimensions (nPts, nAxes)
+*/
+template <typename T>
+std::size_t getAxisMajorStride(ndarray::Array<T, 2, 0> const & arr) {
+    std::ptrdiff_t const nPts = arr.template getSize<0>();
+    std::ptrdiff_t const nAxes = arr.template getSize<1>();
+    auto const strides = arr.getStrides();
+    if ((nPts > 1) && (strides[0] != 1)) {
+        return 0;
+    }
+    if (nAxes <= 1) {
+        return std::max<std::ptrdiff_t>(nPts, 1);
+    }
+    return strides[1] >= std::max<std::ptrdiff_t>(nPts, 1) ? strides[1] : 0;
+}
+
+/**
+Copy points `[start, start + nPts)` of an array of coordinates into an axis-major buffer
+
+@param[in] from  Coordinates with dimensions (nTotalPts, nAxes), with any memory layout
+@param[in] start  Index of first point to copy
+@param[in] nPts  Number of points to copy
+@param[out] dest  Axis-major buffer: point `j` of axis `i` is written to `dest[i * ld + j]`
+@param[in] ld  Leading dimension of `dest`
+*/
+template <typename T>
+void gatherAxisMajor(ndarray::Array<T, 2, 0> const & from, std::size_t start, std::size_t nPts,
+                     double * dest, std::size_t ld) {
+    // strides may be negative (e.g. for a reversed view), so index with signed offsets
+    auto const strides = from.getStrides();
+    for (std::size_t i = 0, nAxes = from.template getSize<1>(); i < nAxes; ++i) {
+        T const * fromAxis = from.getData() + static_cast<std::ptrdiff_t>(start) * strides[0] +
+                             static_cast<std::ptrdiff_t>(i) * strides[1];
+        double * destAxis = dest + i * ld;
+        for (std::size_t j = 0; j < nPts; ++j) {
+            destAxis[j] = fromAxis[static_cast<std::ptrdiff_t>(j) * strides[0]];
+        }
+    }
+}
+
+/**
+Copy an axis-major buffer into points `[start, start + nPts)` of an array of coordinates
+
+@param[in] src  Axis-major buffer: point `j` of axis `i` is read from `src[i * ld + j]`
+@param[in] ld  Leading dimension of `src`
+@param[in] start  Index of first point to write
+@param[in] nPts  Number of points to write
+@param[out] to  Coordinates with dimensions (nTotalPts, nAxes), with any memory layout
+*/
+inline void scatterAxisMajor(double const * src, std::size_t ld, std::size_t start, std::size_t nPts,
+                             ndarray::Array<double, 2, 0> const & to) {
+    // strides may be negative (e.g. for a reversed view), so index with signed offsets
+    auto const strides = to.getStrides();
+    for (std::size_t i = 0, nAxes = to.getSize<1>(); i < nAxes; ++i) {
+        double const * srcAxis = src + i * ld;
+        double * toAxis = to.getData() + static_cast<std::ptrdiff_t>(start) * strides[0] +
+                          static_cast<std::ptrdiff_t>(i) * strides[1];
+        for (std::size_t j = 0; j < nPts; ++j) {
+            toAxis[static_cast<std::ptrdiff_t>(j) * strides[0]] = srcAxis[j];
+        }
+    }
+}
+
+/**
+Return a value that no pixel of `planes` has, to mark bad pixels for astResample
+
+AST recognizes bad pixels by comparing them with the bad value, so a genuine pixel equal to it
+would be treated as bad. The search starts at the most negative finite value and steps towards zero,
+so the result is almost always that value.
+
+@param[in] planes  Image and variance planes; may include empty planes
+*/
+template <typename T>
+T chooseBadValue(std::vector<ndarray::Array<T const, 2, 2>> const & planes) {
+    T const first = -std::numeric_limits<T>::max();
+    // values between first and first / 2 are the only ones that can be reached, so only they are sorted
+    std::vector<T> taken;
+    for (auto const & plane : planes) {
+        T const * data = plane.getData();
+        for (std::size_t i = 0, nPix = plane.getNumElements(); i < nPix; ++i) {
+            if ((data[i] >= first) && (data[i] <= first / 2)) {
+                taken.push_back(data[i]);
+            }
+        }
+    }
+    std::sort(taken.begin(), taken.end());
+    T badval = first;
+    for (T value : taken) {
+        if (value > badval) {
+            break;
+        }
+        if (value == badval) {
+            badval = std::nextafter(badval, static_cast<T>(0));
+        }
+    }
+    return badval;
+}
+
+/**
+Return an image plane with NaN and masked pixels replaced by `badval`, for astResample and astRebinSeq
+
+AST recognizes bad pixels by comparing them with `badval`, which never matches NaN.
+The plane is only copied if it has pixels that must be replaced.
+
+@param[in] plane  Image or variance plane
+@param[in] mask  Mask plane with the same shape as `plane`; may be empty
+@param[in] badMask  Pixels of `mask` with any of these bits set are bad
+@param[in] badval  Value that marks a bad pixel
+*/
+template <typename T>
+ndarray::Array<T const, 2, 2> markBadPixels(ndarray::Array<T const, 2, 2> const & plane,
+                                            ndarray::Array<int const, 2, 2> const & mask, int badMask,
+                                            T badval) {
+    bool const useMask = !mask.isEmpty() && (badMask != 0);
+    std::size_t const nPix = plane.getNumElements();
+    T const * data = plane.getData();
+    int const * maskData = useMask ? mask.getData() : nullptr;
+    std::size_t i = 0;
+    for (; i < nPix; ++i) {
+        if (std::isnan(data[i]) || (useMask && (maskData[i] & badMask))) {
+            break;
+        }
+    }
+    if (i == nPix) {
+        return plane;
+    }
+    ndarray::Array<T, 2, 2> marked = ndarray::copy(plane);
+    T * markedData = marked.getData();
+    for (; i < nPix; ++i) {
+        if (std::isnan(markedData[i]) || (useMask && (maskData[i] & badMask))) {
+            markedData[i] = badval;
+        }
+    }
+    return marked;
+}
+
 /**
 Format an axis-specific attribute by appending the axis index
 
@@ -0,0 +1,573 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_DETAIL_KERNELS_H
+#define ASTSHIM_DETAIL_KERNELS_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "astshim/base.h"
+
+namespace ast {
+namespace detail {
+
+/**
+One step of the evaluation plan held by a @ref CompiledMapping.
+
+Coordinates are held axis-major, as for astTranN: element (axis `i`, point `j`)
+of a buffer with leading dimension `ld` is at `data[i*ld + j]`.
+
+Kernels are immutable once constructed, so any number of threads may call `apply` concurrently.
+*/
+class Kernel {
+public:
+    Kernel(int nIn, int nOut) : _nIn(nIn), _nOut(nOut) {}
+
+    virtual ~Kernel() {}
+
+    Kernel(Kernel const &) = delete;
+    Kernel(Kernel &&) = delete;
+    Kernel & operator=(Kernel const &) = delete;
+    Kernel & operator=(Kernel &&) = delete;
+
+    /// Number of input axes
+    int getNin() const { return _nIn; }
+
+    /// Number of output axes
+    int getNout() const { return _nOut; }
+
+    /// Short name of the kernel, e.g. "Affine"
+    virtual std::string getName() const = 0;
+
+    /// Return true if this kernel (including any children) never calls AST
+    virtual bool isNative() const { return true; }
+
+    /// Append the names of the leaf kernels, in evaluation order
+    virtual void describe(std::vector<std::string> & steps) const { steps.push_back(getName()); }
+
+    /**
+    Transform `nPts` points
+
+    @param[in] in  Input coordinates: `getNin()` rows of `nPts` values, with leading dimension `ldIn`
+    @param[in] ldIn  Leading dimension of `in`
+    @param[in] nPts  Number of points
+    @param[out] out  Output coordinates: `getNout()` rows of `nPts` values, with leading dimension `ldOut`;
+                    bad values are set to NaN
+    @param[in] ldOut  Leading dimension of `out`
+    */
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const = 0;
+
+private:
+    int const _nIn;
+    int const _nOut;
+};
+
+/**
+Affine transformation: out = matrix * in + offset
+
+Zero matrix elements are skipped, so an output that does not depend on an input
+is not made NaN by a NaN in that input (as for constants in a @ref PermMap).
+
+The matrix is classified when the kernel is constructed and `apply` uses the fastest applicable path:
+- diagonal: each output is a scaled and shifted copy of the input with the same index;
+- permutation: each output depends on at most one input (this includes axis permutations, scaled
+  permutations and constant outputs), so is a scaled copy, a plain copy or a constant fill;
+- general: a matrix product, blocked so that the rows of a block of points stay in cache
+  and tiled so that each input value is loaded once for several outputs.
+*/
+class AffineKernel : public Kernel {
+public:
+    /**
+    Construct an AffineKernel
+
+    @param[in] matrix  nOut x nIn matrix, in row-major order
+    @param[in] offset  nOut constant terms
+    */
+    AffineKernel(std::vector<double> const & matrix, std::vector<double> const & offset);
+
+    virtual std::string getName() const { return "Affine"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+    /// Return the kernel that applies `first` then `second`
+    static std::shared_ptr<AffineKernel> compose(AffineKernel const & first, AffineKernel const & second);
+
+    std::vector<double> const & getMatrix() const { return _matrix; }
+    std::vector<double> const & getOffset() const { return _offset; }
+
+    /// Is the matrix square and diagonal?
+    bool isDiagonal() const { return _isDiagonal; }
+
+    /// Does each output depend on at most one input? True for diagonal matrices.
+    bool isPermutation() const { return _isPermutation; }
+
+    /// For each output, the 0-based input it depends on or -1 if it is constant; empty unless isPermutation()
+    std::vector<int> const & getSource() const { return _source; }
+
+private:
+    void _applyDiagonal(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+    void _applyPermutation(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+    void _applyGeneral(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+    std::vector<double> const _matrix;
+    std::vector<double> const _offset;
+    bool _isDiagonal;
+    bool _isPermutation;
+    std::vector<int> _source;  // for each output, the 0-based input it depends on, or -1 if constant
+};
+
+/**
+Polynomial transformation described by a table of coefficients, as used by @ref PolyMap
+*/
+class PolyKernel : public Kernel {
+public:
+    /**
+    Construct a PolyKernel
+
+    @param[in] nIn  Number of inputs
+    @param[in] nOut  Number of outputs
+    @param[in] coeffs  Coefficients with `2 + nIn` values per term, in the format of the `coeff_f`
+                    argument of the @ref PolyMap constructor.
+    */
+    PolyKernel(int nIn, int nOut, std::vector<double> const & coeffs);
+
+    virtual std::string getName() const { return "Poly"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    struct Term {
+        double coeff;
+        int out;                 // 0-based output index
+        std::vector<int> powers; // one per input axis
+    };
+    std::vector<Term> _terms;
+    int _maxPower;
+};
+
+/**
+Chebyshev series over a box, as used by @ref ChebyMap
+
+Each output is a sum of terms, each a coefficient times a product of Chebyshev polynomials of the inputs,
+where each input is first scaled to the range [-1, 1] over the box. The coefficients of each output
+are held as a dense array with one dimension per input and summed by nested Clenshaw recurrences
+(the innermost over the last input), one block of points at a time, so evaluation is a few
+multiply-adds per coefficient per point with no calls to trigonometric functions.
+Points outside the box (or with a bad input) give bad values for all outputs, as for a ChebyMap.
+*/
+class ChebyKernel : public Kernel {
+public:
+    /**
+    Construct a ChebyKernel
+
+    @param[in] nIn  Number of inputs
+    @param[in] nOut  Number of outputs
+    @param[in] coeffs  Coefficients with `2 + nIn` values per term, in the format of the `coeff_f`
+                    argument of the @ref ChebyMap constructor
+    @param[in] lbnd  Lower bound of the box along each input axis
+    @param[in] ubnd  Upper bound of the box along each input axis; each must exceed that of `lbnd`
+
+    @throws std::invalid_argument if the arguments do not meet the requirements above.
+    */
+    ChebyKernel(int nIn, int nOut, std::vector<double> const & coeffs, std::vector<double> const & lbnd,
+                std::vector<double> const & ubnd);
+
+    virtual std::string getName() const { return "Cheby"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    // The coefficients of one output
+    struct Series {
+        std::vector<int> shape;           // for each input, 1 + the highest degree used
+        std::vector<std::size_t> strides; // for each input, the stride in coeffs between degrees
+        std::vector<double> coeffs;       // dense array; the degree of the first input varies slowest
+    };
+
+    void _clenshaw(Series const & series, int axis, std::size_t offset, double const * u, int nPts,
+                   double * result, double * scratch) const;
+
+    std::vector<Series> _series;  // one per output
+    std::vector<double> const _lbnd;
+    std::vector<double> const _ubnd;
+};
+
+/**
+Linear interpolation in a lookup table, as used by @ref LutMap
+
+The forward transform finds the table entry for each point by scaling, so its cost does not depend
+on the size of the table. The inverse transform, available for strictly monotonic tables,
+finds the interval containing each point with a precomputed index of buckets of equal width
+in output value (one bucket per table interval), so it also takes constant time per point unless
+the spacing of the table values varies wildly. Points outside the table are extrapolated linearly
+from the two nearest entries.
+*/
+class LutKernel : public Kernel {
+public:
+    /**
+    Construct a LutKernel
+
+    @param[in] lut  The lookup table; at least 2 values. If `forward` is false the values must
+                    increase or decrease strictly monotonically.
+    @param[in] start  The input value corresponding to the first table entry
+    @param[in] inc  The increment in input value between table entries; must not be zero
+    @param[in] forward  Transform from input to table value? Otherwise from table value to input.
+
+    @throws std::invalid_argument if the arguments do not meet the requirements above.
+    */
+    LutKernel(std::vector<double> const & lut, double start, double inc, bool forward);
+
+    virtual std::string getName() const { return "Lut"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+    /// Return true if the values of `lut` increase or decrease strictly monotonically
+    static bool isStrictlyMonotonic(std::vector<double> const & lut);
+
+private:
+    int _findInterval(double value) const;
+
+    std::vector<double> _lut;    // the table, negated for the inverse of a decreasing table
+    double const _start;
+    double const _inc;
+    bool const _forward;
+    double _sign;                // -1 if _lut was negated, else 1
+    double _bucketOrigin;        // _lut value at the start of bucket 0
+    double _bucketScale;         // number of buckets per unit _lut value
+    std::vector<int> _buckets;   // for each bucket, the interval containing its start; then the last interval
+};
+
+/**
+A displacement field sampled on a regular 2-D grid, as used by @ref GridMap
+*/
+struct GridField {
+    int nx;                 ///< number of grid points along x
+    int ny;                 ///< number of grid points along y
+    double x0;              ///< x of grid point (0, 0)
+    double y0;              ///< y of grid point (0, 0)
+    double sx;              ///< grid spacing along x
+    double sy;              ///< grid spacing along y
+    bool bicubic;           ///< interpolate by bicubic convolution? Otherwise bilinearly.
+    std::vector<double> dx; ///< x displacement at each grid point: ny rows of nx values
+    std::vector<double> dy; ///< y displacement at each grid point: ny rows of nx values
+};
+
+/**
+Add a displacement interpolated in a @ref GridField to 2-D points, or solve for the points that
+are displaced to given positions, as used by @ref GridMap
+
+The forward transform works on blocks of points in two passes: the first finds the grid cell
+and interpolation weights of every point, the second gathers the grid values and sums them.
+The inverse solves `x + d(x) = y` for each point by Newton's method, using the gradient
+of the interpolated displacement, starting from `y - d(y)`. Points for which it does not converge
+are bad.
+
+Beyond the grid the displacement is that at the nearest point on the edge of the grid.
+*/
+class GridKernel : public Kernel {
+public:
+    /**
+    Construct a GridKernel
+
+    @param[in] field  The displacement field
+    @param[in] forward  Add the displacement? Otherwise apply the inverse.
+    */
+    GridKernel(std::shared_ptr<GridField const> const & field, bool forward);
+
+    virtual std::string getName() const { return "Grid"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    void _applyForward(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+    void _applyInverse(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+    /// Interpolate the displacement at one point, and its derivatives d(dx, dy)/d(x, y) in row-major order
+    void _displacement(double x, double y, double & dx, double & dy, double * gradient) const;
+
+    std::shared_ptr<GridField const> const _field;
+    bool const _forward;
+};
+
+/**
+Convert 3-D Cartesian vectors to spherical coordinates (longitude, latitude), or back to unit vectors,
+as used by @ref SphMap
+
+Points are converted a block at a time, using sinCosN and atan2N, which are accurate to better than
+1e-15 radians and which the compiler can vectorize.
+As for a SphMap, the longitude at either pole is `polarLong` and a zero vector is bad.
+A bad input makes all outputs bad.
+*/
+class SphKernel : public Kernel {
+public:
+    /**
+    Construct a SphKernel
+
+    @param[in] polarLong  Longitude to assign to either pole (radians)
+    @param[in] forward  Convert from Cartesian to spherical coordinates? Otherwise the reverse.
+    */
+    SphKernel(double polarLong, bool forward);
+
+    virtual std::string getName() const { return "Sph"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    double const _polarLong;
+    bool const _forward;
+};
+
+/**
+Find the unit vector and norm of the offset of each point from a centre, or the reverse,
+as used by @ref UnitNormMap
+
+The forward transform has one more output than input: the unit vector followed by the norm.
+As for a UnitNormMap, the unit vector of the centre itself is bad and its norm is 0.
+A bad input makes all outputs bad.
+*/
+class UnitNormKernel : public Kernel {
+public:
+    /**
+    Construct a UnitNormKernel
+
+    @param[in] centre  The centre
+    @param[in] forward  Find the unit vector and norm? Otherwise the reverse.
+    */
+    UnitNormKernel(std::vector<double> const & centre, bool forward);
+
+    virtual std::string getName() const { return "UnitNorm"; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    std::vector<double> const _centre;
+    bool const _forward;
+};
+
+/**
+A 1-D function tabulated as a piecewise cubic, as made by @ref tabulateKernel
+
+Each segment holds the cubic through 4 equally spaced values, in Newton's forward difference form.
+The segments are sorted, so the segment containing each point is found by checking the segment
+of the previous point and bisecting the segment starts only if that fails; sorted inputs (e.g. the
+times of an event list) then cost one comparison each. The cubics are then evaluated by a loop
+that the compiler can vectorize.
+Points before the first segment are extrapolated from it, and a bad input gives a bad output.
+*/
+class PiecewiseCubicKernel : public Kernel {
+public:
+    /**
+    Construct a PiecewiseCubicKernel
+
+    Segment `i` starts at `start[i]` and extends to the start of the next segment (or forever,
+    for the last segment). Within it, at `s = (x - start[i]) * scale[i]` the value is
+    `y0[i] + s * (d1[i] + (s - 1) * (d2[i] + (s - 2) * d3[i]))`,
+    so a segment that passes through values y(s) at s = 0, 1, 2 and 3 has d1 = y(1) - y(0),
+    d2 half the second difference and d3 a sixth of the third difference.
+
+    @param[in] start  The start of each segment, in strictly increasing order
+    @param[in] scale  The scale of each segment: 3 divided by the length over which its values were taken
+    @param[in] y0  The value at the start of each segment
+    @param[in] d1  The first coefficient of each segment
+    @param[in] d2  The second coefficient of each segment
+    @param[in] d3  The third coefficient of each segment
+
+    @throws std::invalid_argument if there are no segments, the arguments differ in length
+        or `start` is not strictly increasing.
+    */
+    PiecewiseCubicKernel(std::vector<double> const & start, std::vector<double> const & scale,
+                         std::vector<double> const & y0, std::vector<double> const & d1,
+                         std::vector<double> const & d2, std::vector<double> const & d3);
+
+    virtual std::string getName() const { return "PiecewiseCubic"; }
+
+    /// The number of segments
+    int getNSegments() const { return static_cast<int>(_start.size()); }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    std::vector<double> const _start;
+    std::vector<double> const _scale;
+    std::vector<double> const _y0;
+    std::vector<double> const _d1;
+    std::vector<double> const _d2;
+    std::vector<double> const _d3;
+};
+
+/**
+Kernels applied one after another
+*/
+class SeriesKernel : public Kernel {
+public:
+    explicit SeriesKernel(std::vector<std::shared_ptr<Kernel const>> const & kernels);
+
+    virtual std::string getName() const { return "Series"; }
+
+    /// The kernels, in the order they are applied
+    std::vector<std::shared_ptr<Kernel const>> const & getKernels() const { return _kernels; }
+
+    virtual bool isNative() const;
+
+    virtual void describe(std::vector<std::string> & steps) const;
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    std::vector<std::shared_ptr<Kernel const>> const _kernels;
+    int _maxAxes;
+};
+
+/**
+Kernels applied to consecutive groups of axes
+*/
+class ParallelKernel : public Kernel {
+public:
+    explicit ParallelKernel(std::vector<std::shared_ptr<Kernel const>> const & kernels);
+
+    virtual std::string getName() const { return "Parallel"; }
+
+    /// The kernels, in order of the axes they transform
+    std::vector<std::shared_ptr<Kernel const>> const & getKernels() const { return _kernels; }
+
+    virtual bool isNative() const;
+
+    virtual void describe(std::vector<std::string> & steps) const;
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    std::vector<std::shared_ptr<Kernel const>> const _kernels;
+};
+
+/**
+Fallback for mappings that have no native kernel: call astTranN on a private copy of the mapping
+
+Calls are serialized by a mutex and the copy is locked to the calling thread for the duration
+of each call, so this kernel may be shared between threads. If AST was built without thread support,
+the mutex is shared by every AstKernel, since AST's error status is then global; other code must not
+call AST while an AstKernel may be in use by another thread.
+*/
+class AstKernel : public Kernel {
+public:
+    /**
+    Construct an AstKernel
+
+    @param[in] map  Mapping to transform with; a deep copy is made
+    @param[in] forward  Use the forward transform of `map`?
+    */
+    AstKernel(AstMapping * map, bool forward);
+
+    virtual ~AstKernel();
+
+    virtual std::string getName() const { return _className; }
+
+    virtual bool isNative() const { return false; }
+
+    virtual void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const;
+
+private:
+    AstMapping * _map;
+    bool const _forward;
+    std::string const _className;
+    mutable std::mutex _mutex;
+};
+
+/**
+Compile a mapping into a tree of kernels
+
+@param[in] map  Mapping to compile
+@param[in] forward  Compile the forward transform of `map`? Otherwise compile the inverse.
+*/
+std::shared_ptr<Kernel const> compileKernel(AstMapping * map, bool forward);
+
+/**
+Return a LutKernel for a LutMap, or nullptr if it cannot be evaluated natively (e.g. it uses nearest
+neighbour interpolation, has bad table values or the inverse is wanted of a table that is not
+strictly monotonic)
+
+@param[in] map  The LutMap
+@param[in] forward  Use the forward transform of `map`?
+*/
+std::shared_ptr<Kernel const> makeLutKernel(AstMapping * map, bool forward);
+
+/**
+Return a ChebyKernel for a ChebyMap, or nullptr if it cannot be evaluated natively (e.g. the
+transform is iterative rather than defined by coefficients)
+
+@param[in] map  The ChebyMap
+@param[in] forward  Use the forward transform of `map`?
+*/
+std::shared_ptr<Kernel const> makeChebyKernel(AstMapping * map, bool forward);
+
+/**
+Return a GridKernel for a @ref GridMap, or nullptr if `map` is not a GridMap
+
+@param[in] map  The mapping
+@param[in] forward  Use the forward transform of `map`?
+*/
+std::shared_ptr<Kernel const> makeGridKernel(AstMapping * map, bool forward);
+
+/**
+Return a SphKernel for a SphMap, or nullptr if it does not match AST
+
+@param[in] map  The SphMap
+@param[in] forward  Use the forward transform of `map`?
+*/
+std::shared_ptr<Kernel const> makeSphKernel(AstMapping * map, bool forward);
+
+/**
+Return a UnitNormKernel for a UnitNormMap, or nullptr if it does not match AST
+
+@param[in] map  The UnitNormMap
+@param[in] forward  Use the forward transform of `map`?
+*/
+std::shared_ptr<Kernel const> makeUnitNormKernel(AstMapping * map, bool forward);
+
+/**
+Tabulate a 1-D kernel that is smooth except for occasional jumps (e.g. the conversions of a @ref TimeMap,
+whose leap seconds are jumps) as a PiecewiseCubicKernel over a range of inputs
+
+The range starts as a few segments; each segment is checked against `source` midway between the
+values it was made from and split in two if it does not match, so segments shrink around jumps until
+a jump lies between adjacent doubles. The finished table is checked against `source` at 1000 more
+points scattered over the range. The tolerance of these checks is twice the rounding error
+of `source` itself, as estimated from the scatter of its values about a straight line at a few
+closely spaced points, or twice the rounding error of its largest output, if that is larger.
+
+@param[in] source  The kernel to tabulate; must have 1 input and 1 output
+@param[in] lo  The start of the range
+@param[in] hi  The end of the range
+@param[in] maxEvaluations  The most points `source` may be evaluated at
+
+@return the table, or nullptr if `source` could not be tabulated within `maxEvaluations` (including
+    if it gives bad values in the range, or is too rough to tabulate)
+*/
+std::shared_ptr<Kernel const> tabulateKernel(Kernel const & source, double lo, double hi,
+                                             std::size_t maxEvaluations);
+
+}}  // namespace ast::detail
+
+#endif
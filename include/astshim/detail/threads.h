@@ -0,0 +1,102 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_DETAIL_THREADS_H
+#define ASTSHIM_DETAIL_THREADS_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "astshim/base.h"
+
+namespace ast {
+namespace detail {
+
+/**
+Return the number of threads to use for a task that AST code runs in
+
+@param[in] nThreads  Number of threads requested; 0 for one per hardware thread
+@param[in] nItems  Number of independent work items; no more threads than this are used
+
+Returns 1 if AST was built without thread support, since AST's error status and memory management
+are then shared by all threads.
+*/
+int getNumThreads(int nThreads, std::size_t nItems);
+
+/**
+Call `func(threadIndex, item)` for each item in `[0, nItems)`, using `nThreads` threads
+
+Items are handed out dynamically, so threads that get cheap items do more of them.
+The calling thread is used as thread 0.
+
+@param[in] nThreads  Number of threads to use, as returned by @ref getNumThreads
+@param[in] nItems  Number of work items
+@param[in] func  Function to call for each item
+
+@throw the first exception thrown by `func` (in any thread), after all threads have finished;
+    once an exception is thrown no more items are started.
+*/
+void parallelFor(int nThreads, std::size_t nItems, std::function<void(int, std::size_t)> const & func);
+
+/**
+Deep copies of an AST object, one for each thread of a @ref parallelFor
+
+AST objects may only be used by the thread that has locked them, and every new object
+is locked by the thread that creates it. The copies are made by the constructing thread and unlocked,
+so that each worker thread can lock its copy with @ref lock. They are annulled by the destructor,
+which must be called by the constructing thread after the worker threads have finished.
+*/
+class ThreadCopies {
+public:
+    /**
+    Construct copies of an AST object
+
+    @param[in] object  Object to copy
+    @param[in] nThreads  Number of copies to make; thread 0 (the calling thread) uses `object` itself
+    */
+    ThreadCopies(AstObject * object, int nThreads);
+
+    ~ThreadCopies();
+
+    ThreadCopies(ThreadCopies const &) = delete;
+    ThreadCopies(ThreadCopies &&) = delete;
+    ThreadCopies & operator=(ThreadCopies const &) = delete;
+    ThreadCopies & operator=(ThreadCopies &&) = delete;
+
+    /**
+    Lock the copy for a given thread to the calling thread and return it
+
+    Call this once from each worker thread, before using the copy.
+    */
+    AstObject * lock(int threadIndex) const;
+
+    /// Unlock the copy for a given thread, once the calling thread has finished with it
+    void unlock(int threadIndex) const;
+
+private:
+    AstObject * _object;
+    std::vector<AstObject *> _copies;  // _copies[0] is unused (nullptr)
+};
+
+}}  // namespace ast::detail
+
+#endif
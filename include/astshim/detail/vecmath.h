@@ -0,0 +1,61 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#ifndef ASTSHIM_DETAIL_VECMATH_H
+#define ASTSHIM_DETAIL_VECMATH_H
+
+namespace ast {
+namespace detail {
+
+/**
+Compute the sine and cosine of each of `n` angles
+
+The angles are reduced by a three-part multiple of pi/2 and the sine and cosine are then
+evaluated by minimax polynomials, with no branches, so the compiler can vectorize the loop.
+The results are within 2e-16 of the true values for |angle| < 2^19 radians;
+larger (and non-finite) angles are passed to std::sin and std::cos.
+
+@param[in] angle  The angles, in radians
+@param[in] n  The number of angles
+@param[out] sine  The sine of each angle
+@param[out] cosine  The cosine of each angle
+*/
+void sinCosN(double const * angle, int n, double * sine, double * cosine);
+
+/**
+Compute the angle of each of `n` vectors (x, y), as std::atan2(y, x)
+
+The ratio of the smaller to the larger of |x| and |y| is reduced to below tan(pi/8)
+and its arctangent evaluated by a minimax polynomial, with no branches, so the compiler can
+vectorize the loop. The results are within 6e-16 radians (about one unit in the last place of pi)
+of the true values; vectors for which this fails (e.g. both zero or both infinite) are passed
+to std::atan2.
+
+@param[in] y  The y component of each vector
+@param[in] x  The x component of each vector
+@param[in] n  The number of vectors
+@param[out] angle  The angle of each vector, in radians, in the range [-pi, pi]
+*/
+void atan2N(double const * y, double const * x, int n, double * angle);
+
+}}  // namespace ast::detail
+
+#endif
@@ -29,6 +29,57 @@ A C++ shim around a subset of AST
     }
 }
 
+%{
+// Release the GIL for the lifetime of this object.
+// AST keeps its error status and memory caches in global variables unless it is built thread-safe,
+// and the GIL is what protects that state, so it is only released if AST is thread-safe.
+class ReleaseGil {
+public:
+#if defined(AST__THREADSAFE) && AST__THREADSAFE
+    ReleaseGil() : _state(PyEval_SaveThread()) {}
+    ~ReleaseGil() { PyEval_RestoreThread(_state); }
+private:
+    PyThreadState * _state;
+#endif
+};
+%}
+
+// Release the GIL while running a C++ method that uses no Python objects
+// (ndarray arguments are converted before, and results after, the GIL is released)
+%define %releaseGil(METHOD...)
+%exception METHOD {
+    try {
+        ReleaseGil releaseGil;
+        $action
+    } catch (std::exception & e) {
+        PyErr_SetString(PyExc_Exception, e.what());
+        SWIG_fail;
+    }
+}
+%enddef
+
+%releaseGil(ast::Mapping::tran)
+%releaseGil(ast::Mapping::tranInverse)
+%releaseGil(ast::Mapping::tranOutputs)
+%releaseGil(ast::Mapping::tranInverseIterative)
+%releaseGil(ast::Mapping::tranStream)
+%releaseGil(ast::Mapping::tranInverseStream)
+%releaseGil(ast::Mapping::tranGridForward)
+%releaseGil(ast::Mapping::tranGridInverse)
+%releaseGil(ast::Mapping::resample)
+%releaseGil(ast::Mapping::warp)
+%releaseGil(ast::FrameSet::skyFootprint)
+%releaseGil(ast::FrameSet::skyFootprints)
+%releaseGil(ast::PolyMap::polyTran)
+%releaseGil(ast::PolyMap::polyTrans)
+%releaseGil(ast::mapBoxes)
+%releaseGil(ast::Rebinner::add)
+%releaseGil(ast::Rebinner::finish)
+%releaseGil(ast::CompiledMapping::tran)
+%releaseGil(ast::CompiledMapping::tranInverse)
+%releaseGil(ast::Channel::read)
+%releaseGil(ast::FitsChan::readFits)
+
 %{
 #include "ndarray/swig.h"
 #include "ndarray/converter/eigen.h"
@@ -37,11 +88,26 @@ A C++ shim around a subset of AST
 %include "ndarray.i"
 
 %declareNumPyConverters(ndarray::Array<double, 2, 2>);
+// Arrays with any strides, so C- and Fortran-ordered numpy arrays are used without copying
+%declareNumPyConverters(ndarray::Array<double const, 2, 0>);
+%declareNumPyConverters(ndarray::Array<double, 2, 0>);
+// Images, variances and masks for Mapping.resample, Mapping.warp and Rebinner
+%declareNumPyConverters(ndarray::Array<double const, 2, 2>);
+%declareNumPyConverters(ndarray::Array<float, 2, 2>);
+%declareNumPyConverters(ndarray::Array<float const, 2, 2>);
+%declareNumPyConverters(ndarray::Array<int, 2, 2>);
+%declareNumPyConverters(ndarray::Array<int const, 2, 2>);
+// Per-point flags, e.g. from Mapping.tranInverseIterative
+%declareNumPyConverters(ndarray::Array<bool, 1, 1>);
+// Lists of times, for TimeFrame.convertTimes
+%declareNumPyConverters(ndarray::Array<double const, 1, 0>);
+%declareNumPyConverters(ndarray::Array<double, 1, 1>);
 
 %include "std_vector.i"
 %template(VectorDouble) std::vector<double>;
 %template(VectorInt) std::vector<int>;
 %template(VectorString) std::vector<std::string>;
+%template(VectorVectorDouble) std::vector<std::vector<double>>;
 
 %include "std_complex.i"
 
@@ -49,9 +115,19 @@ A C++ shim around a subset of AST
 %shared_ptr(ast::Object)
 %shared_ptr(ast::Stream);
 %shared_ptr(ast::Mapping)
+%template(VectorMapping) std::vector<std::shared_ptr<ast::Mapping>>;
 %shared_ptr(ast::Channel)
 %shared_ptr(ast::Frame)
 %shared_ptr(ast::FrameSet)
+%template(VectorFrameSet) std::vector<std::shared_ptr<ast::FrameSet>>;
+
+// return a list of arrays as a Python list of numpy arrays
+%typemap(out) std::vector<ast::Array2D> {
+    $result = PyList_New($1.size());
+    for (std::size_t i = 0; i < $1.size(); ++i) {
+        PyList_SET_ITEM($result, i, ndarray::PyConverter<ast::Array2D>::toPython($1[i]));
+    }
+}
 
 // channels
 %shared_ptr(ast::FitsChan)
@@ -64,7 +140,9 @@ A C++ shim around a subset of AST
 %shared_ptr(ast::TimeFrame)
 
 // mappings
+%shared_ptr(ast::ChebyMap)
 %shared_ptr(ast::CmpMap)
+%shared_ptr(ast::GridMap)
 %shared_ptr(ast::LutMap)
 %shared_ptr(ast::MathMap)
 %shared_ptr(ast::makeBadMatrixMap)
@@ -74,6 +152,7 @@ A C++ shim around a subset of AST
 %shared_ptr(ast::PcdMap)
 %shared_ptr(ast::PermMap)
 %shared_ptr(ast::PolyMap)
+%template(VectorPolyMap) std::vector<std::shared_ptr<ast::PolyMap>>;
 %shared_ptr(ast::RateMap)
 %shared_ptr(ast::SeriesMap)
 %shared_ptr(ast::ShiftMap)
@@ -91,13 +170,32 @@ A C++ shim around a subset of AST
 %shared_ptr(ast::StringStream);
 
 %include "astshim/base.h"
+%include "astshim/MemoryReport.h"
+%include "std_map.i"
+%template(MapStringMemoryUsage) std::map<std::string, ast::MemoryUsage>;
 %include "astshim/Object.h"
 %include "astshim/Stream.h"
 %include "astshim/Channel.h"
 %include "astshim/MapBox.h"
 %include "astshim/MapSplit.h"
 %include "astshim/QuadApprox.h"
+
+// std::istream, std::ostream and std::function are not available from Python; the callback classes
+// would also call Python from tranStream's helper threads, without the GIL
+%ignore ast::IStreamPointReader;
+%ignore ast::OStreamPointWriter;
+%ignore ast::CallbackPointReader;
+%ignore ast::CallbackPointWriter;
+%include "astshim/PointStream.h"
+
+%ignore ast::ScratchBuffer;
+%include "astshim/ScratchArena.h"
+
+%include "astshim/Resample.h"
+%include "astshim/Warp.h"
 %include "astshim/Mapping.h"
+%include "astshim/CompiledMapping.h"
+%include "astshim/Rebinner.h"
 %include "astshim/Frame.h"
 %include "astshim/FrameSet.h"
 
@@ -119,7 +217,9 @@ A C++ shim around a subset of AST
 %include "astshim/TimeFrame.h"
 
 // mappings
+%include "astshim/ChebyMap.h"
 %include "astshim/CmpMap.h"
+%include "astshim/GridMap.h"
 %include "astshim/LutMap.h"
 %include "astshim/MathMap.h"
 %include "astshim/makeBadMatrixMap.h"
@@ -142,6 +242,11 @@ A C++ shim around a subset of AST
 %include "astshim/WinMap.h"
 %include "astshim/ZoomMap.h"
 
+%include "astshim/Interner.h"
+%template(intern) ast::Interner::intern<ast::FrameSet>;
+%template(intern) ast::Interner::intern<ast::Frame>;
+%template(intern) ast::Interner::intern<ast::Mapping>;
+
 %define %addRepr(CLS...)
 %extend ast::CLS {
     std::string __repr__() const {
@@ -167,7 +272,9 @@ A C++ shim around a subset of AST
 %addRepr(TimeFrame)
 
 // mappings
+%addRepr(ChebyMap)
 %addRepr(CmpMap)
+%addRepr(GridMap)
 %addRepr(LutMap)
 %addRepr(MathMap)
 %addRepr(MatrixMap)
@@ -0,0 +1,532 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/kernels.h"
+#include "astshim/CompiledMapping.h"
+#include "astshim/Mapping.h"
+#include "astshim/ScratchArena.h"
+
+namespace ast {
+
+namespace {
+
+// Number of points transformed at a time; small enough that the scratch buffers stay in cache
+int const CHUNK_SIZE = 512;
+
+typedef std::unique_ptr<AstObject, void (*)(AstObject *)> RawPtr;
+
+RawPtr makeRawPtr(void * rawptr) {
+    return RawPtr(reinterpret_cast<AstObject *>(rawptr), &detail::annulAstObject);
+}
+
+AstMapping * asMapping(RawPtr const & ptr) {
+    return reinterpret_cast<AstMapping *>(ptr.get());
+}
+
+bool isClass(AstMapping * map, char const * className) {
+    char const * rawClass = astGetC(map, "Class");
+    assertOK();
+    return std::strcmp(rawClass, className) == 0;
+}
+
+/**
+Return an affine kernel for a linear mapping, or nullptr if AST cannot fit one
+*/
+std::shared_ptr<detail::Kernel const> makeAffineKernel(AstMapping * map, bool forward) {
+    RawPtr invMap(nullptr, &detail::annulAstObject);
+    if (!forward) {
+        // astLinearApprox only fits the forward transform
+        invMap = makeRawPtr(astCopy(map));
+        astInvert(invMap.get());
+        assertOK();
+        map = asMapping(invMap);
+    }
+    int const nIn = astGetI(map, "Nin");
+    int const nOut = astGetI(map, "Nout");
+    assertOK();
+    // the mapping is linear, so any box will do and the tolerance is irrelevant
+    std::vector<double> const lbnd(nIn, 0.0);
+    std::vector<double> const ubnd(nIn, 1.0);
+    std::vector<double> fit((1 + nIn) * nOut);
+    bool isOK = astLinearApprox(map, lbnd.data(), ubnd.data(), std::numeric_limits<double>::max(),
+                                fit.data());
+    if (!astOK) {
+        astClearStatus;
+        return nullptr;
+    }
+    if (!isOK || std::find(fit.begin(), fit.end(), AST__BAD) != fit.end()) {
+        return nullptr;
+    }
+    // fit is [constant, gradient for input 1, ...] x [output 1, output 2, ...]
+    std::vector<double> matrix(nOut * nIn);
+    std::vector<double> offset(fit.begin(), fit.begin() + nOut);
+    for (int j = 0; j < nOut; ++j) {
+        for (int i = 0; i < nIn; ++i) {
+            matrix[j * nIn + i] = fit[(1 + i) * nOut + j];
+        }
+    }
+    return std::make_shared<detail::AffineKernel>(matrix, offset);
+}
+
+/**
+Read the coefficients of one transform of an uninverted PolyMap or ChebyMap, in the format of the `coeff_f`
+argument of the PolyMap constructor; empty if the transform is not defined by coefficients
+*/
+std::vector<double> readPolyCoeffs(AstMapping * map, bool forward) {
+    auto rawPolyMap = reinterpret_cast<AstPolyMap *>(map);
+    int nCoeff = 0;
+    astPolyCoeffs(rawPolyMap, static_cast<int>(forward), 0, nullptr, &nCoeff);
+    assertOK();
+    if (nCoeff <= 0) {
+        return std::vector<double>();
+    }
+    int const nIn = astGetI(map, forward ? "Nin" : "Nout");
+    std::vector<double> coeffs((2 + nIn) * nCoeff);
+    astPolyCoeffs(rawPolyMap, static_cast<int>(forward), coeffs.size(), coeffs.data(), &nCoeff);
+    assertOK();
+    return coeffs;
+}
+
+/**
+Return a polynomial kernel for a PolyMap, or nullptr if the transform is not defined by coefficients
+(e.g. an iterative inverse)
+*/
+std::shared_ptr<detail::Kernel const> makePolyKernel(AstMapping * map, bool forward) {
+    // read the coefficients from an uninverted copy, so the meaning of "forward" is unambiguous
+    bool const useForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    auto polyMap = makeRawPtr(astCopy(map));
+    astSetI(polyMap.get(), "Invert", 0);
+    std::vector<double> const coeffs = readPolyCoeffs(asMapping(polyMap), useForward);
+    if (coeffs.empty()) {
+        return nullptr;
+    }
+    int const nIn = astGetI(polyMap.get(), useForward ? "Nin" : "Nout");
+    int const nOut = astGetI(polyMap.get(), useForward ? "Nout" : "Nin");
+    assertOK();
+    return std::make_shared<detail::PolyKernel>(nIn, nOut, coeffs);
+}
+
+/**
+Read the table of a LutMap from its description, as written by Object::show
+
+@param[in] map  The LutMap
+@param[out] lut  The table
+@param[out] start  The input value of the first table entry
+@param[out] inc  The increment in input value between table entries
+@return true if the table was read, false if not (e.g. it has bad values)
+*/
+bool readLutMap(AstMapping * map, std::vector<double> & lut, double & start, double & inc) {
+    std::istringstream is(Mapping(reinterpret_cast<AstMapping *>(astClone(map))).show());
+    int nLut = 0;
+    bool hasInc = false;
+    start = 0.0;  // Start is not written if it has its default value
+    std::vector<std::pair<int, double>> values;
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream ls(line);
+        std::string key, equals;
+        double value;
+        if (!(ls >> key >> equals >> value) || (equals != "=")) {
+            continue;
+        }
+        if (key == "Nlut") {
+            nLut = static_cast<int>(value);
+        } else if (key == "Start") {
+            start = value;
+        } else if (key == "Incr") {
+            inc = value;
+            hasInc = true;
+        } else if ((key.size() > 1) && (key[0] == 'L') &&
+                   (key.find_first_not_of("0123456789", 1) == std::string::npos)) {
+            values.emplace_back(std::stoi(key.substr(1)), value);
+        }
+    }
+    if ((nLut < 2) || !hasInc || (values.size() != static_cast<std::size_t>(nLut))) {
+        return false;
+    }
+    lut.assign(nLut, AST__BAD);
+    for (auto const & indexValue : values) {
+        if ((indexValue.first < 1) || (indexValue.first > nLut)) {
+            return false;
+        }
+        lut[indexValue.first - 1] = indexValue.second;
+    }
+    return std::find(lut.begin(), lut.end(), AST__BAD) == lut.end();
+}
+
+/**
+Return true if a kernel transforms some points as AST does, allowing for rounding
+
+@param[in] kernel  The kernel
+@param[in] map  The mapping the kernel is meant to match
+@param[in] forward  Use the forward transform of `map`?
+@param[in] in  The points, axis-major: `kernel.getNin()` rows of `nPts` values
+@param[in] nPts  The number of points
+*/
+bool matchesAst(detail::Kernel const & kernel, AstMapping * map, bool forward, std::vector<double> const & in,
+                int nPts) {
+    int const nIn = kernel.getNin();
+    int const nOut = kernel.getNout();
+    std::vector<double> expected(nOut * nPts);
+    std::vector<double> actual(nOut * nPts);
+    astTranN(map, nPts, nIn, nPts, in.data(), static_cast<int>(forward), nOut, nPts, expected.data());
+    assertOK();
+    kernel.apply(in.data(), nPts, nPts, actual.data(), nPts);
+    for (int k = 0; k < nOut * nPts; ++k) {
+        bool const expectedBad = std::isnan(expected[k]) || (expected[k] == AST__BAD);
+        if (expectedBad != std::isnan(actual[k])) {
+            return false;
+        }
+        if (!expectedBad && !(std::fabs(actual[k] - expected[k]) <= 1e-12 * (1.0 + std::fabs(expected[k])))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+Append `kernel` to a series of kernels, flattening nested series and combining adjacent affine kernels
+*/
+void appendToSeries(std::shared_ptr<detail::Kernel const> const & kernel,
+                    std::vector<std::shared_ptr<detail::Kernel const>> & kernels) {
+    if (auto series = std::dynamic_pointer_cast<detail::SeriesKernel const>(kernel)) {
+        for (auto const & child : series->getKernels()) {
+            appendToSeries(child, kernels);
+        }
+        return;
+    }
+    if (!kernels.empty()) {
+        auto prevAffine = std::dynamic_pointer_cast<detail::AffineKernel const>(kernels.back());
+        auto affine = std::dynamic_pointer_cast<detail::AffineKernel const>(kernel);
+        if (prevAffine && affine) {
+            kernels.back() = detail::AffineKernel::compose(*prevAffine, *affine);
+            return;
+        }
+    }
+    kernels.push_back(kernel);
+}
+
+/**
+Append `kernel` to a list of parallel kernels, flattening nested parallel kernels
+*/
+void appendToParallel(std::shared_ptr<detail::Kernel const> const & kernel,
+                      std::vector<std::shared_ptr<detail::Kernel const>> & kernels) {
+    if (auto parallel = std::dynamic_pointer_cast<detail::ParallelKernel const>(kernel)) {
+        for (auto const & child : parallel->getKernels()) {
+            appendToParallel(child, kernels);
+        }
+        return;
+    }
+    kernels.push_back(kernel);
+}
+
+std::shared_ptr<detail::Kernel const> compileCmpMap(AstMapping * map, bool forward) {
+    AstMapping * rawMap1;
+    AstMapping * rawMap2;
+    int series, invert1, invert2;
+    astDecompose(map, &rawMap1, &rawMap2, &series, &invert1, &invert2);
+    auto map1 = makeRawPtr(rawMap1);
+    auto map2 = makeRawPtr(rawMap2);
+    assertOK();
+    // The compound mapping applies each component with the Invert value recorded when it was built,
+    // which may differ from the component's current Invert value
+    bool const cmpForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    bool const flip1 = static_cast<bool>(invert1) != static_cast<bool>(astGetI(rawMap1, "Invert"));
+    bool const flip2 = static_cast<bool>(invert2) != static_cast<bool>(astGetI(rawMap2, "Invert"));
+    assertOK();
+    auto kernel1 = detail::compileKernel(rawMap1, cmpForward != flip1);
+    auto kernel2 = detail::compileKernel(rawMap2, cmpForward != flip2);
+
+    std::vector<std::shared_ptr<detail::Kernel const>> kernels;
+    if (series) {
+        appendToSeries(cmpForward ? kernel1 : kernel2, kernels);
+        appendToSeries(cmpForward ? kernel2 : kernel1, kernels);
+        if (kernels.size() == 1) {
+            return kernels[0];
+        }
+        return std::make_shared<detail::SeriesKernel>(kernels);
+    }
+    appendToParallel(kernel1, kernels);
+    appendToParallel(kernel2, kernels);
+    return std::make_shared<detail::ParallelKernel>(kernels);
+}
+
+}  // anonymous namespace
+
+namespace detail {
+
+std::shared_ptr<Kernel const> compileKernel(AstMapping * map, bool forward) {
+    if (astIsACmpMap(map)) {
+        return compileCmpMap(map, forward);
+    }
+    if (astIsAFrameSet(map)) {
+        // the Base and Current attributes already allow for the FrameSet being inverted
+        auto frameSetMap = makeRawPtr(astGetMapping(map, AST__BASE, AST__CURRENT));
+        assertOK();
+        return compileKernel(asMapping(frameSetMap), forward);
+    }
+    if (astIsAFrame(map)) {
+        // a Frame is a unit mapping
+        int const nAxes = astGetI(map, "Naxes");
+        assertOK();
+        std::vector<double> matrix(nAxes * nAxes, 0.0);
+        for (int i = 0; i < nAxes; ++i) {
+            matrix[i * nAxes + i] = 1.0;
+        }
+        return std::make_shared<AffineKernel>(matrix, std::vector<double>(nAxes, 0.0));
+    }
+    assertOK();
+
+    std::shared_ptr<Kernel const> kernel;
+    if (astGetI(map, "IsLinear")) {
+        kernel = makeAffineKernel(map, forward);
+    } else if (isClass(map, "PolyMap")) {
+        kernel = makePolyKernel(map, forward);
+    } else if (isClass(map, "ChebyMap")) {
+        kernel = makeChebyKernel(map, forward);
+    } else if (isClass(map, "LutMap")) {
+        kernel = makeLutKernel(map, forward);
+    } else if (isClass(map, "IntraMap")) {
+        kernel = makeGridKernel(map, forward);
+    } else if (isClass(map, "SphMap")) {
+        kernel = makeSphKernel(map, forward);
+    } else if (isClass(map, "UnitNormMap")) {
+        kernel = makeUnitNormKernel(map, forward);
+    }
+    assertOK();
+    if (!kernel) {
+        kernel = std::make_shared<AstKernel>(map, forward);
+    }
+    return kernel;
+}
+
+std::shared_ptr<Kernel const> makeChebyKernel(AstMapping * map, bool forward) {
+    // read the coefficients and box from an uninverted copy, so the meaning of "forward" is unambiguous
+    bool const useForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    auto chebyMap = makeRawPtr(astCopy(map));
+    astSetI(chebyMap.get(), "Invert", 0);
+    std::vector<double> const coeffs = readPolyCoeffs(asMapping(chebyMap), useForward);
+    if (coeffs.empty()) {
+        return nullptr;
+    }
+    int const nIn = astGetI(chebyMap.get(), useForward ? "Nin" : "Nout");
+    int const nOut = astGetI(chebyMap.get(), useForward ? "Nout" : "Nin");
+    std::vector<double> lbnd(nIn);
+    std::vector<double> ubnd(nIn);
+    astChebyDomain(chebyMap.get(), static_cast<int>(useForward), lbnd.data(), ubnd.data());
+    assertOK();
+    for (int i = 0; i < nIn; ++i) {
+        if ((lbnd[i] == AST__BAD) || (ubnd[i] == AST__BAD) || !(ubnd[i] > lbnd[i])) {
+            return nullptr;
+        }
+    }
+    auto kernel = std::make_shared<ChebyKernel>(nIn, nOut, coeffs, lbnd, ubnd);
+
+    // check the kernel against AST at a few points scattered over the box,
+    // in case the coefficients do not mean what they are expected to
+    int const nChecks = 9;
+    std::vector<double> in(nIn * nChecks);
+    for (int i = 0; i < nIn; ++i) {
+        for (int k = 0; k < nChecks; ++k) {
+            double const frac = (((k * (2 * i + 3)) % nChecks) + 0.5) / nChecks;
+            in[i * nChecks + k] = lbnd[i] + frac * (ubnd[i] - lbnd[i]);
+        }
+    }
+    std::vector<double> expected(nOut * nChecks);
+    std::vector<double> actual(nOut * nChecks);
+    astTranN(chebyMap.get(), nChecks, nIn, nChecks, in.data(), static_cast<int>(useForward), nOut, nChecks,
+             expected.data());
+    assertOK();
+    kernel->apply(in.data(), nChecks, nChecks, actual.data(), nChecks);
+    double scale = 0.0;
+    for (std::size_t t = 0; t < coeffs.size(); t += 2 + nIn) {
+        scale += std::fabs(coeffs[t]);
+    }
+    for (int k = 0; k < nOut * nChecks; ++k) {
+        if (!(std::fabs(actual[k] - expected[k]) <= 1e-10 * (1.0 + scale))) {
+            return nullptr;
+        }
+    }
+    return kernel;
+}
+
+std::shared_ptr<Kernel const> makeLutKernel(AstMapping * map, bool forward) {
+    bool const isNearest = astGetI(map, "LutInterp") != 0;
+    bool const isInverted = astGetI(map, "Invert");
+    assertOK();
+    std::vector<double> lut;
+    double start, inc;
+    if (isNearest || !readLutMap(map, lut, start, inc)) {
+        return nullptr;
+    }
+    if (!(forward != isInverted) && !LutKernel::isStrictlyMonotonic(lut)) {
+        return nullptr;
+    }
+    // check the table against AST at a few points either side of and within the table,
+    // in case its description was not read as intended
+    LutKernel tableKernel(lut, start, inc, true);
+    int const nChecks = 9;
+    std::vector<double> in(nChecks);
+    for (int i = 0; i < nChecks; ++i) {
+        in[i] = start + inc * (lut.size() - 1) * (i - 1.0) / (nChecks - 3);
+    }
+    std::vector<double> expected(nChecks);
+    std::vector<double> actual(nChecks);
+    astTranN(map, nChecks, 1, nChecks, in.data(), static_cast<int>(!isInverted), 1, nChecks, expected.data());
+    assertOK();
+    tableKernel.apply(in.data(), nChecks, nChecks, actual.data(), nChecks);
+    double const scale = std::max(std::fabs(*std::min_element(lut.begin(), lut.end())),
+                                  std::fabs(*std::max_element(lut.begin(), lut.end())));
+    for (int i = 0; i < nChecks; ++i) {
+        if (!(std::fabs(actual[i] - expected[i]) <= 1e-10 * (1.0 + scale))) {
+            return nullptr;
+        }
+    }
+    return std::make_shared<LutKernel>(lut, start, inc, forward != isInverted);
+}
+
+std::shared_ptr<Kernel const> makeSphKernel(AstMapping * map, bool forward) {
+    bool const useForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    double const polarLong = astGetD(map, "PolarLong");
+    assertOK();
+    auto kernel = std::make_shared<SphKernel>(polarLong, useForward);
+
+    // check the kernel against AST at points in each octant, at both poles and, going forward, at zero,
+    // in case the conventions for these differ
+    std::vector<double> const vectors = {
+        1.0, -0.5, 0.25, -2.0, 3.0, 0.0, 0.0, 0.0, 1e-3,   // x
+        0.5, 1.5, -0.75, -1.0, -0.1, 0.0, 0.0, 0.0, -4.0,  // y
+        0.3, -0.2, 2.0, -0.6, 0.0, 1.0, -2.0, 0.0, 0.5,    // z
+    };
+    std::vector<double> const angles = {
+        0.0, 1.0, -2.0, 3.5, -0.7, 7.0, 2.5, -3.0, 0.2,                       // longitude
+        0.0, 0.5, -1.2, 0.1, -0.3, 1.5707963267948966, -1.5707963267948966, 1.0, -0.9,  // latitude
+    };
+    if (!matchesAst(*kernel, map, forward, useForward ? vectors : angles, 9)) {
+        return nullptr;
+    }
+    return kernel;
+}
+
+std::shared_ptr<Kernel const> makeUnitNormKernel(AstMapping * map, bool forward) {
+    bool const isInverted = astGetI(map, "Invert");
+    int const nAxes = astGetI(map, isInverted ? "Nout" : "Nin");
+    assertOK();
+    // AST does not report the centre, but it is the inverse transform of a zero vector with a norm of 1
+    std::vector<double> probe(nAxes + 1, 0.0);
+    probe[nAxes] = 1.0;
+    std::vector<double> centre(nAxes);
+    astTranN(map, 1, nAxes + 1, 1, probe.data(), static_cast<int>(isInverted), nAxes, 1, centre.data());
+    assertOK();
+    if (std::find(centre.begin(), centre.end(), AST__BAD) != centre.end()) {
+        return nullptr;
+    }
+    bool const useForward = forward != isInverted;
+    auto kernel = std::make_shared<UnitNormKernel>(centre, useForward);
+
+    // check the kernel against AST at a few points, the last of which is the centre going forward
+    // and has a norm of zero going back
+    int const nIn = kernel->getNin();
+    int const nChecks = 6;
+    std::vector<double> in(nIn * nChecks);
+    for (int i = 0; i < nIn; ++i) {
+        for (int k = 0; k < nChecks - 1; ++k) {
+            in[i * nChecks + k] = ((k * (2 * i + 3)) % 7 - 3) * 0.75 + 0.1 * i;
+        }
+        in[i * nChecks + nChecks - 1] = useForward ? centre[i] : 0.0;
+    }
+    if (!matchesAst(*kernel, map, forward, in, nChecks)) {
+        return nullptr;
+    }
+    return kernel;
+}
+
+}  // namespace detail
+
+CompiledMapping::CompiledMapping(Mapping const & map) :
+    _nIn(map.getNin()),
+    _nOut(map.getNout()),
+    _forward(),
+    _inverse()
+{
+    Mapping simpMap = map.simplify();
+    auto rawMap = reinterpret_cast<AstMapping *>(simpMap.getRawPtr());
+    if (simpMap.getTranForward()) {
+        _forward = detail::compileKernel(rawMap, true);
+    }
+    if (simpMap.getTranInverse()) {
+        _inverse = detail::compileKernel(rawMap, false);
+    }
+}
+
+std::vector<std::string> CompiledMapping::getPlan(bool forward) const {
+    std::vector<std::string> steps;
+    _getKernel(forward).describe(steps);
+    return steps;
+}
+
+bool CompiledMapping::isNative(bool forward) const {
+    return _getKernel(forward).isNative();
+}
+
+detail::Kernel const & CompiledMapping::_getKernel(bool forward) const {
+    auto const & kernel = forward ? _forward : _inverse;
+    if (!kernel) {
+        throw std::runtime_error(forward ? "The forward transform is not available"
+                                         : "The inverse transform is not available");
+    }
+    return *kernel;
+}
+
+void CompiledMapping::_tran(ConstArray2D const & from, bool doForward, StridedArray2D const & to) const {
+    detail::Kernel const & kernel = _getKernel(doForward);
+    int const nFromAxes = kernel.getNin();
+    int const nToAxes = kernel.getNout();
+    detail::assertEqual(from.getSize<1>(), "from.size[1]", nFromAxes, "from coords");
+    detail::assertEqual(to.getSize<1>(), "to.size[1]", nToAxes, "to coords");
+    detail::assertEqual(from.getSize<0>(), "from.size[0]", to.getSize<0>(), "to.size[0]");
+    std::size_t const nPts = from.getSize<0>();
+
+    // kernels work on axis-major data, so gather each chunk into a scratch buffer and scatter it back
+    ScratchBuffer fromT(nFromAxes * CHUNK_SIZE);
+    ScratchBuffer toT(nToAxes * CHUNK_SIZE);
+    for (std::size_t start = 0; start < nPts; start += CHUNK_SIZE) {
+        int const nChunk = std::min<std::size_t>(CHUNK_SIZE, nPts - start);
+        detail::gatherAxisMajor(from, start, nChunk, fromT.data(), CHUNK_SIZE);
+        kernel.apply(fromT.data(), CHUNK_SIZE, nChunk, toT.data(), CHUNK_SIZE);
+        detail::scatterAxisMajor(toT.data(), CHUNK_SIZE, start, nChunk, to);
+    }
+}
+
+}  // namespace ast
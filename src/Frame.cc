@@ -19,26 +19,210 @@
  * the GNU General Public License along with this program.  If not, 
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
 
+#include "astshim/detail.h"
 #include "astshim/CmpFrame.h"
 #include "astshim/Frame.h"
 #include "astshim/FrameSet.h"
 
 namespace ast {
 
-    FrameSet Frame::convert(Frame const & to, std::string const & domainlist) {
+namespace {
+
+    // Identifies a frame by the hash and length of its description
+    typedef std::pair<std::size_t, std::size_t> Fingerprint;
+
+    // Identifies a call to astConvert: fingerprints of "from" and "to", and the domain list
+    typedef std::tuple<Fingerprint, Fingerprint, std::string> ConvertKey;
+
+    Fingerprint getFingerprint(std::string const & description) {
+        return std::make_pair(std::hash<std::string>()(description), description.size());
+    }
+
+    /**
+    A result of astConvert, kept unlocked so any thread may lock it,
+    and the values it set for the Base attribute of "from" and "to" (0 if not a FrameSet)
+
+    The full descriptions of "from" and "to" are kept so a lookup can tell a match
+    from frames whose fingerprints merely collide.
+    */
+    class ConvertResult {
+    public:
+        ConvertResult(AstFrameSet * frameSet, int fromBase, int toBase, std::string const & fromDescription,
+                      std::string const & toDescription) :
+            frameSet(frameSet), fromBase(fromBase), toBase(toBase), fromDescription(fromDescription),
+            toDescription(toDescription)
+        {
+            astUnlock(frameSet, 0);
+        }
+
+        ~ConvertResult() {
+            astLock(frameSet, 1);
+            astAnnul(frameSet);
+        }
+
+        ConvertResult(ConvertResult const &) = delete;
+        ConvertResult & operator=(ConvertResult const &) = delete;
+
+        /// Is this the result for frames with these descriptions?
+        bool matches(std::string const & from, std::string const & to) const {
+            return (fromDescription == from) && (toDescription == to);
+        }
+
+        AstFrameSet * const frameSet;
+        int const fromBase;
+        int const toBase;
+        std::string const fromDescription;
+        std::string const toDescription;
+    };
+
+    // Results cached by Frame::convert, shared by all threads
+    class ConvertCache {
+    public:
+        ConvertCache() : mutex(), maxEntries(0), entries(), index() {}
+
+        // Discard the least recently used results until there are no more than maxEntries
+        void trim() {
+            while (entries.size() > maxEntries) {
+                index.erase(entries.back().first);
+                entries.pop_back();
+            }
+        }
+
+        typedef std::list<std::pair<ConvertKey, std::shared_ptr<ConvertResult const>>> EntryList;
+
+        std::mutex mutex;
+        std::size_t maxEntries;
+        EntryList entries;  // most recently used first
+        std::map<ConvertKey, EntryList::iterator> index;
+    };
+
+    ConvertCache & getConvertCache() {
+        // never destroyed, so that it may be used until the program exits
+        static ConvertCache * cache = new ConvertCache();
+        return *cache;
+    }
+
+    // Call astConvert, throwing notfound_error if it finds no conversion
+    AstFrameSet * findConversion(Frame const & from, Frame const & to, std::string const & domainlist) {
         auto * rawframeset = reinterpret_cast<AstFrameSet *>(
-            astConvert(getRawPtr(), to.getRawPtr(), domainlist.c_str())
+            astConvert(from.getRawPtr(), to.getRawPtr(), domainlist.c_str())
         );
         assertOK();
         if (!rawframeset) {
             throw notfound_error("convert found no suitable frame set");
         }
+        return rawframeset;
+    }
+
+}  // anonymous namespace
+
+    std::size_t getConvertCacheSize() {
+        ConvertCache & cache = getConvertCache();
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        return cache.maxEntries;
+    }
+
+    void setConvertCacheSize(std::size_t maxEntries) {
+        ConvertCache & cache = getConvertCache();
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        cache.maxEntries = maxEntries;
+        cache.trim();
+    }
+
+    void clearConvertCache() {
+        ConvertCache & cache = getConvertCache();
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        cache.index.clear();
+        cache.entries.clear();
+    }
+
+    FrameSet Frame::convert(Frame const & to, std::string const & domainlist) {
+        if (isFrozen() || to.isFrozen()) {
+            // astConvert may set the Base attribute of both frames, which frozen frames must keep
+            return copy()->convert(*to.copy(), domainlist);
+        }
+        // astConvert may set the Base attribute of both frames, so anything cached from them is stale
+        Frame & mutableTo = const_cast<Frame &>(to);
+        ConvertCache & cache = getConvertCache();
+        if (getConvertCacheSize() == 0) {
+            auto * rawframeset = findConversion(*this, to, domainlist);
+            _clearCaches();
+            mutableTo._clearCaches();
+            return FrameSet(rawframeset);
+        }
+
+        std::string const fromDescription = show();
+        std::string const toDescription = to.show();
+        ConvertKey const key(getFingerprint(fromDescription), getFingerprint(toDescription), domainlist);
+        std::shared_ptr<ConvertResult const> result;
+        {
+            std::lock_guard<std::mutex> guard(cache.mutex);
+            auto const it = cache.index.find(key);
+            if ((it != cache.index.end()) && it->second->second->matches(fromDescription, toDescription)) {
+                cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+                result = it->second->second;
+            }
+        }
+        if (result) {
+            // set Base as astConvert would have
+            if (result->fromBase > 0) {
+                astSetI(getRawPtr(), "Base", result->fromBase);
+            }
+            if (result->toBase > 0) {
+                astSetI(to.getRawPtr(), "Base", result->toBase);
+            }
+            assertOK();
+        } else {
+            // cache the result unsimplified, so that it is the same as the result without the cache;
+            // annul it if getting Base throws
+            std::unique_ptr<AstObject, void (*)(AstObject *)> rawframeset(
+                    reinterpret_cast<AstObject *>(findConversion(*this, to, domainlist)),
+                    &detail::annulAstObject);
+            int const fromBase = astIsAFrameSet(getRawPtr()) ? getI("Base") : 0;
+            int const toBase = astIsAFrameSet(to.getRawPtr()) ? astGetI(to.getRawPtr(), "Base") : 0;
+            assertOK();
+            result = std::make_shared<ConvertResult const>(reinterpret_cast<AstFrameSet *>(rawframeset.get()),
+                                                           fromBase, toBase, fromDescription, toDescription);
+            rawframeset.release();
+
+            std::lock_guard<std::mutex> guard(cache.mutex);
+            auto const it = cache.index.find(key);
+            if ((it != cache.index.end()) && !it->second->second->matches(fromDescription, toDescription)) {
+                // frames whose fingerprints collide: keep the latest
+                cache.entries.erase(it->second);
+                cache.index.erase(it);
+            }
+            if ((cache.maxEntries > 0) && (cache.index.count(key) == 0)) {
+                cache.entries.emplace_front(key, result);
+                cache.index[key] = cache.entries.begin();
+                cache.trim();
+            }
+        }
+        _clearCaches();
+        mutableTo._clearCaches();
+
+        astLock(result->frameSet, 1);
+        auto * rawframeset = reinterpret_cast<AstFrameSet *>(astCopy(result->frameSet));
+        astUnlock(result->frameSet, 0);
+        assertOK();
         return FrameSet(rawframeset);
     }
 
     FrameSet Frame::findFrame(Frame & tmplt, std::string const & domainlist) {
+        if (isFrozen()) {
+            // astFindFrame may set the Current attribute of a FrameSet, which a frozen one must keep
+            return copy()->findFrame(tmplt, domainlist);
+        }
         auto * rawframeset = reinterpret_cast<AstFrameSet *>(
             astFindFrame(getRawPtr(), tmplt.getRawPtr(), domainlist.c_str())
         );
@@ -46,6 +230,7 @@ namespace ast {
         if (!rawframeset) {
             throw notfound_error("findFrame found no suitable frame set");
         }
+        _clearCaches();
         return FrameSet(rawframeset);
     }
 
@@ -0,0 +1,296 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/threads.h"
+#include "astshim/FrameSet.h"
+
+namespace ast {
+
+namespace {
+
+int const INITIAL_SEGMENTS = 4;  // number of segments each edge of the box starts with
+int const MAX_DEPTH = 12;        // maximum number of times each initial segment may be bisected
+
+// A point on the boundary of the box, and the segment that starts there
+struct BoundaryPoint {
+    double s;        // position along the boundary: edge number + fraction of that edge
+    Object::PointD point;  // coordinates in the current frame
+    int depth;       // number of bisections that produced the segment starting at this point
+    bool done;       // does the segment starting at this point need no further bisection?
+};
+
+/// Return the base frame position of boundary position `s` (see BoundaryPoint)
+void boundaryToBase(double s, Object::PointD const & lbnd, Object::PointD const & ubnd, double * base) {
+    int const edge = std::min(static_cast<int>(s), 3);
+    double const frac = s - edge;
+    switch (edge) {
+        case 0:
+            base[0] = lbnd[0] + frac * (ubnd[0] - lbnd[0]);
+            base[1] = lbnd[1];
+            break;
+        case 1:
+            base[0] = ubnd[0];
+            base[1] = lbnd[1] + frac * (ubnd[1] - lbnd[1]);
+            break;
+        case 2:
+            base[0] = ubnd[0] - frac * (ubnd[0] - lbnd[0]);
+            base[1] = ubnd[1];
+            break;
+        default:
+            base[0] = lbnd[0];
+            base[1] = ubnd[1] - frac * (ubnd[1] - lbnd[1]);
+            break;
+    }
+}
+
+/// Return the distance of `point` from the geodesic through `start` and `end`, or NaN if undefined
+double offGeodesic(Frame const & frame, Object::PointD const & start, Object::PointD const & end,
+                   Object::PointD const & point) {
+    return std::fabs(frame.resolve(start, end, point).d2);
+}
+
+bool isFinite(Object::PointD const & point) {
+    for (double val : point) {
+        if (!std::isfinite(val)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Return the mapping between two frames of a FrameSet, as found by AST
+AstMapping * findMapping(AstObject * frameSet, int ind1, int ind2) {
+    auto * map = reinterpret_cast<AstMapping *>(astGetMapping(frameSet, ind1, ind2));
+    assertOK();
+    if (map == nullptr) {
+        throw std::runtime_error("getMapping failed (returned a null mapping)");
+    }
+    return map;
+}
+
+}  // anonymous namespace
+
+Mapping FrameSet::getMapping(int ind1, int ind2) const {
+    std::unique_lock<std::mutex> lock(*_cacheMutex);
+    if (!_cacheMappings) {
+        lock.unlock();
+        return Mapping(findMapping(getRawPtr(), ind1, ind2));
+    }
+    // key on frame indices, so BASE and CURRENT share entries with the indices they refer to
+    int const from = ind1 == BASE ? getBase() : (ind1 == CURRENT ? getCurrent() : ind1);
+    int const to = ind2 == BASE ? getBase() : (ind2 == CURRENT ? getCurrent() : ind2);
+    auto const key = std::make_pair(from, to);
+    // another wrapper of the AST object (e.g. one made by casting this) may have modified it
+    if (_getModificationCount() != _mappingsModifications) {
+        _mappings.clear();
+        _mappingsModifications = _getModificationCount();
+    }
+    auto it = _mappings.find(key);
+    if (it == _mappings.end()) {
+        // keep the cached mapping unlocked, so a thread that later locks this FrameSet can use it
+        std::shared_ptr<Mapping> cached(new Mapping(findMapping(getRawPtr(), from, to)), [](Mapping * map) {
+            map->lock(true);
+            delete map;
+        });
+        cached->unlock();
+        it = _mappings.emplace(key, cached).first;
+    }
+    // hold the cached mapping, in case another thread clears the cache once the lock is released
+    std::shared_ptr<Mapping> const cachedPtr = it->second;
+    lock.unlock();
+    Mapping & cached = *cachedPtr;
+    cached.lock(true);
+    auto * map = reinterpret_cast<AstMapping *>(astCopy(cached.getRawPtr()));
+    cached.unlock();
+    return Mapping(map);
+}
+
+Array2D FrameSet::skyFootprint(PointD const & lbnd, PointD const & ubnd, double tol) const {
+    detail::assertEqual(getNin(), "getNin()", 2, "number of axes of a box");
+    detail::assertEqual(lbnd.size(), "lbnd.size()", 2, "number of axes of a box");
+    detail::assertEqual(ubnd.size(), "ubnd.size()", 2, "number of axes of a box");
+    if (!(tol > 0)) {
+        std::ostringstream os;
+        os << "tol = " << tol << " must be positive";
+        throw std::invalid_argument(os.str());
+    }
+    int const nOut = getNout();
+
+    // Bisect segments of the boundary until each is close enough to a geodesic. Each round transforms
+    // the midpoints of all segments that are not done in one call, then inserts those that are needed.
+    std::vector<BoundaryPoint> boundary;
+    for (int i = 0; i < 4 * INITIAL_SEGMENTS; ++i) {
+        boundary.push_back({static_cast<double>(i) / INITIAL_SEGMENTS, PointD(nOut), 0, false});
+    }
+    Array2D basePoints = ndarray::allocate(boundary.size(), 2);
+    for (std::size_t i = 0; i < boundary.size(); ++i) {
+        boundaryToBase(boundary[i].s, lbnd, ubnd, basePoints[i].getData());
+    }
+    Array2D points = tran(basePoints);
+    for (std::size_t i = 0; i < boundary.size(); ++i) {
+        std::copy(points[i].begin(), points[i].end(), boundary[i].point.begin());
+    }
+    while (true) {
+        std::vector<std::size_t> pending;
+        for (std::size_t i = 0; i < boundary.size(); ++i) {
+            if (!boundary[i].done) {
+                pending.push_back(i);
+            }
+        }
+        if (pending.empty()) {
+            break;
+        }
+        basePoints = ndarray::allocate(pending.size(), 2);
+        std::vector<double> midS(pending.size());
+        for (std::size_t j = 0; j < pending.size(); ++j) {
+            std::size_t const i = pending[j];
+            double const endS = i + 1 < boundary.size() ? boundary[i + 1].s : 4.0;
+            midS[j] = 0.5 * (boundary[i].s + endS);
+            boundaryToBase(midS[j], lbnd, ubnd, basePoints[j].getData());
+        }
+        points = tran(basePoints);
+
+        std::vector<BoundaryPoint> refined;
+        refined.reserve(boundary.size() + pending.size());
+        for (std::size_t i = 0, j = 0; i < boundary.size(); ++i) {
+            refined.push_back(boundary[i]);
+            if ((j == pending.size()) || (pending[j] != i)) {
+                continue;
+            }
+            BoundaryPoint & start = refined.back();
+            PointD const & end = boundary[(i + 1) % boundary.size()].point;
+            PointD mid(points[j].begin(), points[j].end());
+            bool const finite = isFinite(start.point) && isFinite(end) && isFinite(mid);
+            bool const bisect = (start.depth < MAX_DEPTH) &&
+                                (finite ? !(offGeodesic(*this, start.point, end, mid) <= tol)
+                                        : (isFinite(start.point) || isFinite(end) || isFinite(mid)));
+            if (bisect) {
+                ++start.depth;
+                refined.push_back({midS[j], mid, start.depth, false});
+            } else {
+                start.done = true;
+            }
+            ++j;
+        }
+        boundary.swap(refined);
+    }
+
+    // Drop points with undefined coordinates
+    std::vector<PointD> vertices;
+    for (auto const & bp : boundary) {
+        if (isFinite(bp.point)) {
+            vertices.push_back(bp.point);
+        }
+    }
+
+    // Drop vertices that lie within tol of the geodesic between the vertices kept either side of them
+    std::size_t const nVertices = vertices.size();
+    std::vector<std::size_t> kept;
+    if (nVertices <= 3) {
+        for (std::size_t i = 0; i < nVertices; ++i) {
+            kept.push_back(i);
+        }
+    } else {
+        for (std::size_t start = 0; start < nVertices; ) {
+            kept.push_back(start);
+            // find the furthest end such that every vertex between start and end can be dropped
+            std::size_t end = start + 1;
+            while (end < nVertices) {
+                PointD const & endPoint = vertices[(end + 1) % nVertices];
+                bool canDrop = true;
+                for (std::size_t i = start + 1; canDrop && (i <= end); ++i) {
+                    canDrop = offGeodesic(*this, vertices[start], endPoint, vertices[i]) <= tol;
+                }
+                if (!canDrop) {
+                    break;
+                }
+                ++end;
+            }
+            start = end;
+        }
+    }
+
+    Array2D result = ndarray::allocate(kept.size(), nOut);
+    for (std::size_t i = 0; i < kept.size(); ++i) {
+        std::copy(vertices[kept[i]].begin(), vertices[kept[i]].end(), result[i].begin());
+    }
+    return result;
+}
+
+std::vector<Array2D> FrameSet::skyFootprints(std::vector<std::shared_ptr<FrameSet>> const & frameSets,
+                                             std::vector<PointD> const & lbnds,
+                                             std::vector<PointD> const & ubnds, double tol, int nThreads) {
+    detail::assertEqual(lbnds.size(), "lbnds.size()", frameSets.size(), "frameSets.size()");
+    detail::assertEqual(ubnds.size(), "ubnds.size()", frameSets.size(), "frameSets.size()");
+    std::size_t const nFrameSets = frameSets.size();
+    std::vector<Array2D> result(nFrameSets);
+    nThreads = detail::getNumThreads(nThreads, nFrameSets);
+    if (nThreads == 1) {
+        for (std::size_t i = 0; i < nFrameSets; ++i) {
+            result[i] = frameSets[i]->skyFootprint(lbnds[i], ubnds[i], tol);
+        }
+        return result;
+    }
+
+    // AST objects may only be used by the thread that has locked them, so each worker thread locks
+    // a copy made (and unlocked) by this thread; this thread locks them again before they are freed
+    std::vector<std::shared_ptr<FrameSet>> copies;
+    copies.reserve(nFrameSets);
+    for (auto const & frameSet : frameSets) {
+        copies.push_back(frameSet->copy());
+        copies.back()->unlock();
+    }
+    auto relockAll = [&copies]() {
+        for (auto & copy : copies) {
+            copy->lock(true);
+        }
+    };
+    try {
+        detail::parallelFor(nThreads, nFrameSets, [&](int, std::size_t i) {
+            copies[i]->lock(true);
+            try {
+                result[i] = copies[i]->skyFootprint(lbnds[i], ubnds[i], tol);
+            } catch (...) {
+                copies[i]->unlock();
+                throw;
+            }
+            copies[i]->unlock();
+        });
+    } catch (...) {
+        relockAll();
+        throw;
+    }
+    relockAll();
+    return result;
+}
+
+}  // namespace ast
@@ -0,0 +1,411 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/kernels.h"
+#include "astshim/GridMap.h"
+#include "astshim/ScratchArena.h"
+
+namespace ast {
+
+namespace {
+
+// Name under which the transformation function of a GridMap is registered with AST
+char const * const GRID_MAP_FUNCTION = "AstshimGridMap";
+
+// First word of the IntraFlag of a GridMap; the digit is the version of the format
+std::string const GRID_MAP_PREFIX = "GridMap1 ";
+
+// Number of hexadecimal digits in the ID that follows GRID_MAP_PREFIX in the IntraFlag of a GridMap
+std::size_t const GRID_MAP_ID_SIZE = 16;
+
+// Number of tables whose parsed form is kept in memory
+std::size_t const FIELD_CACHE_SIZE = 16;
+
+// Number of points converted between AST's and astshim's bad values at a time
+int const CALLBACK_CHUNK_SIZE = 1024;
+
+double const NaN = std::numeric_limits<double>::quiet_NaN();
+
+/**
+Return the 64-bit FNV-1a hash of a string
+
+Unlike std::hash, the value does not depend on the platform, so it can be stored.
+*/
+std::uint64_t fnv1a(std::string const & text) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+Describe a table as the IntraFlag of a GridMap
+
+The format is "GridMap1 <id> <interp> <nx> <ny> <x0> <y0> <sx> <sy> :" followed by the values
+of dx and then dy, where <id> is the FNV-1a hash of everything after it, as GRID_MAP_ID_SIZE
+hexadecimal digits. The ID is short, so finding a parsed table by it is fast, but it is only
+a hash, so a table found by ID is used only if the rest of the IntraFlag matches too.
+*/
+std::string formatField(detail::GridField const & field) {
+    std::ostringstream body;
+    body << std::setprecision(17) << (field.bicubic ? "bicubic" : "bilinear") << " " << field.nx << " "
+         << field.ny << " " << field.x0 << " " << field.y0 << " " << field.sx << " " << field.sy << " :";
+    for (double val : field.dx) {
+        body << " " << val;
+    }
+    for (double val : field.dy) {
+        body << " " << val;
+    }
+    std::string const bodyText = body.str();
+
+    std::ostringstream os;
+    os << GRID_MAP_PREFIX << std::hex << std::setfill('0') << std::setw(GRID_MAP_ID_SIZE) << fnv1a(bodyText)
+       << " " << bodyText;
+    return os.str();
+}
+
+/// Return the ID in the IntraFlag of a GridMap (see formatField)
+std::string getFieldId(char const * flag) {
+    return std::string(flag + GRID_MAP_PREFIX.size(), GRID_MAP_ID_SIZE);
+}
+
+/**
+Parse the IntraFlag of a GridMap, as written by formatField
+
+@throw std::runtime_error if the text cannot be parsed
+*/
+std::shared_ptr<detail::GridField const> parseField(std::string const & text) {
+    std::istringstream is(text.substr(GRID_MAP_PREFIX.size()));
+    auto field = std::make_shared<detail::GridField>();
+    std::string id, interp, colon;
+    is >> id >> interp >> field->nx >> field->ny >> field->x0 >> field->y0 >> field->sx >> field->sy
+       >> colon;
+    if (!is || (id.size() != GRID_MAP_ID_SIZE) || (colon != ":") ||
+        ((interp != "bilinear") && (interp != "bicubic")) || (field->nx < 0) || (field->ny < 0)) {
+        throw std::runtime_error("Cannot parse the table of a GridMap");
+    }
+    field->bicubic = interp == "bicubic";
+    std::size_t const nGrid = static_cast<std::size_t>(field->nx) * field->ny;
+    field->dx.resize(nGrid);
+    field->dy.resize(nGrid);
+    for (auto & val : field->dx) {
+        is >> val;
+    }
+    for (auto & val : field->dy) {
+        is >> val;
+    }
+    if (!is) {
+        throw std::runtime_error("Cannot parse the table of a GridMap");
+    }
+    return field;
+}
+
+/// A parsed table, and the kernels that transform with it
+struct FieldEntry {
+    std::string id;    // the ID in the IntraFlag (see formatField)
+    std::string flag;  // the whole IntraFlag
+    std::shared_ptr<detail::GridField const> field;
+    std::shared_ptr<detail::GridKernel const> kernels[2];  // forward [0] and inverse [1]
+};
+
+/**
+Parsed tables, most recently used first, shared by all threads
+
+AST calls the transformation function of a GridMap with only the AST object, so the table must be
+found from the IntraFlag on every call; this saves parsing it each time. Entries are found by the ID
+in the IntraFlag, and used only if the whole IntraFlag matches, so tables whose IDs collide are
+each parsed correctly (if not cached together).
+*/
+class FieldCache {
+public:
+    FieldCache() : _mutex(), _entries() {}
+
+    /**
+    Return the entry for the IntraFlag of a GridMap, parsing and adding it if necessary
+
+    @param[in] flag  The IntraFlag of a GridMap, as returned by getGridMapFlag
+    */
+    std::shared_ptr<FieldEntry const> get(char const * flag) {
+        std::string const id = getFieldId(flag);
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+                if ((*it)->id == id) {
+                    if ((*it)->flag != flag) {
+                        break;  // a different table whose ID collides; add will replace it
+                    }
+                    _entries.splice(_entries.begin(), _entries, it);
+                    return _entries.front();
+                }
+            }
+        }
+        // parse outside the lock; if another thread parses the same table, either result will do
+        std::string const flagText(flag);
+        return add(flagText, parseField(flagText));
+    }
+
+    /**
+    Add an entry for the IntraFlag of a GridMap, replacing any with the same ID
+
+    @param[in] flag  The IntraFlag of a GridMap
+    @param[in] field  The table it describes
+    */
+    std::shared_ptr<FieldEntry const> add(std::string const & flag,
+                                          std::shared_ptr<detail::GridField const> const & field) {
+        auto entry = std::make_shared<FieldEntry>();
+        entry->id = getFieldId(flag.c_str());
+        entry->flag = flag;
+        entry->field = field;
+        entry->kernels[0] = std::make_shared<detail::GridKernel>(field, true);
+        entry->kernels[1] = std::make_shared<detail::GridKernel>(field, false);
+        std::lock_guard<std::mutex> guard(_mutex);
+        _entries.remove_if([&entry](std::shared_ptr<FieldEntry const> const & other) {
+            return other->id == entry->id;
+        });
+        _entries.push_front(entry);
+        while (_entries.size() > FIELD_CACHE_SIZE) {
+            _entries.pop_back();
+        }
+        return entry;
+    }
+
+private:
+    std::mutex _mutex;
+    std::list<std::shared_ptr<FieldEntry const>> _entries;
+};
+
+FieldCache & getFieldCache() {
+    // never destroyed, so that it may be used until the program exits
+    static FieldCache * cache = new FieldCache();
+    return *cache;
+}
+
+/**
+Return the IntraFlag of `obj` if it is a GridMap, else nullptr
+
+The text is held by AST, which reuses the memory after many more calls to astGetC, so use it at once;
+it is not copied, as the transformation function of a GridMap needs it on every call.
+*/
+char const * getGridMapFlag(AstObject * obj) {
+    if (!astIsAIntraMap(obj)) {
+        return nullptr;
+    }
+    char const * rawFlag = astGetC(obj, "IntraFlag");
+    assertOK();
+    if (!rawFlag || (std::strncmp(rawFlag, GRID_MAP_PREFIX.c_str(), GRID_MAP_PREFIX.size()) != 0) ||
+        (std::strlen(rawFlag) < GRID_MAP_PREFIX.size() + GRID_MAP_ID_SIZE)) {
+        return nullptr;
+    }
+    return rawFlag;
+}
+
+/**
+Transformation function of a GridMap, as called by AST
+
+Errors cannot be thrown through AST, so if the table cannot be read all outputs are bad.
+*/
+void transformGridMap(AstMapping * map, int nPts, int nIn, double const * ptrIn[], int forward, int nOut,
+                      double * ptrOut[]) {
+    std::shared_ptr<FieldEntry const> entry;
+    try {
+        char const * flag = getGridMapFlag(reinterpret_cast<AstObject *>(map));
+        if (flag && (nIn == 2) && (nOut == 2)) {
+            entry = getFieldCache().get(flag);
+        }
+    } catch (...) {
+        entry.reset();
+    }
+    if (!entry) {
+        for (int j = 0; j < nOut; ++j) {
+            std::fill(ptrOut[j], ptrOut[j] + nPts, AST__BAD);
+        }
+        return;
+    }
+    detail::GridKernel const & kernel = *entry->kernels[forward ? 0 : 1];
+    ScratchBuffer in(2 * CALLBACK_CHUNK_SIZE);
+    ScratchBuffer out(2 * CALLBACK_CHUNK_SIZE);
+    for (int start = 0; start < nPts; start += CALLBACK_CHUNK_SIZE) {
+        int const nChunk = std::min(CALLBACK_CHUNK_SIZE, nPts - start);
+        for (int i = 0; i < 2; ++i) {
+            for (int k = 0; k < nChunk; ++k) {
+                double const val = ptrIn[i][start + k];
+                in[i * CALLBACK_CHUNK_SIZE + k] = val == AST__BAD ? NaN : val;
+            }
+        }
+        kernel.apply(in.data(), CALLBACK_CHUNK_SIZE, nChunk, out.data(), CALLBACK_CHUNK_SIZE);
+        for (int j = 0; j < 2; ++j) {
+            for (int k = 0; k < nChunk; ++k) {
+                double const val = out[j * CALLBACK_CHUNK_SIZE + k];
+                ptrOut[j][start + k] = std::isnan(val) ? AST__BAD : val;
+            }
+        }
+    }
+}
+
+/**
+Register the transformation function of a GridMap with AST, if not already done
+
+This must be done before a GridMap is made or read from a Channel.
+*/
+void registerGridMap() {
+    static std::once_flag registered;
+    std::call_once(registered, []() {
+        astIntraReg(GRID_MAP_FUNCTION, 2, 2, &transformGridMap, AST__SIMPFI | AST__SIMPIF,
+                    "Add a displacement interpolated in a table on a regular 2-D grid", "astshim",
+                    "https://github.com/lsst/astshim");
+        assertOK();
+    });
+}
+
+// Register when astshim is loaded, so GridMaps may be read from a Channel before any is constructed
+bool const GRID_MAP_REGISTERED = []() {
+    try {
+        registerGridMap();
+    } catch (...) {
+        return false;
+    }
+    return true;
+}();
+
+AstIntraMap * makeRawGridMap(ndarray::Array<double, 2, 2> const & dx, ndarray::Array<double, 2, 2> const & dy,
+                             std::vector<double> const & origin, std::vector<double> const & spacing,
+                             GridInterp interp, std::string const & options) {
+    detail::assertEqual(dx.getSize<0>(), "dx.getSize<0>()", dy.getSize<0>(), "dy.getSize<0>()");
+    detail::assertEqual(dx.getSize<1>(), "dx.getSize<1>()", dy.getSize<1>(), "dy.getSize<1>()");
+    detail::assertEqual(origin.size(), "origin.size()", 2, "number of axes");
+    detail::assertEqual(spacing.size(), "spacing.size()", 2, "number of axes");
+    auto field = std::make_shared<detail::GridField>();
+    field->nx = dx.getSize<1>();
+    field->ny = dx.getSize<0>();
+    field->x0 = origin[0];
+    field->y0 = origin[1];
+    field->sx = spacing[0];
+    field->sy = spacing[1];
+    field->bicubic = interp == GridInterp::BICUBIC;
+    field->dx.assign(dx.getData(), dx.getData() + dx.getNumElements());
+    field->dy.assign(dy.getData(), dy.getData() + dy.getNumElements());
+    std::string const flag = formatField(*field);
+    // saves parsing the table when it is first used
+    getFieldCache().add(flag, field);
+
+    registerGridMap();
+    auto * rawMap = reinterpret_cast<AstObject *>(astIntraMap(GRID_MAP_FUNCTION, 2, 2, options.c_str()));
+    assertOK(rawMap);
+    astSetC(rawMap, "IntraFlag", flag.c_str());
+    assertOK(rawMap);
+    return reinterpret_cast<AstIntraMap *>(rawMap);
+}
+
+Array2D toArray(std::vector<double> const & values, int nx, int ny) {
+    Array2D result = ndarray::allocate(ny, nx);
+    std::copy(values.begin(), values.end(), result.getData());
+    return result;
+}
+
+}  // anonymous namespace
+
+namespace detail {
+
+std::shared_ptr<Kernel const> makeGridKernel(AstMapping * map, bool forward) {
+    bool const useForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    assertOK();
+    char const * flag = getGridMapFlag(reinterpret_cast<AstObject *>(map));
+    if (!flag) {
+        return nullptr;
+    }
+    return getFieldCache().get(flag)->kernels[useForward ? 0 : 1];
+}
+
+}  // namespace detail
+
+GridMap::GridMap(ndarray::Array<double, 2, 2> const & dx, ndarray::Array<double, 2, 2> const & dy,
+                 std::vector<double> const & origin, std::vector<double> const & spacing, GridInterp interp,
+                 std::string const & options) :
+    Mapping(reinterpret_cast<AstMapping *>(makeRawGridMap(dx, dy, origin, spacing, interp, options)))
+{}
+
+GridMap::GridMap(AstIntraMap * rawptr) :
+    Mapping(reinterpret_cast<AstMapping *>(rawptr))
+{
+    if (!getGridMapFlag(getRawPtr())) {
+        std::ostringstream os;
+        os << "this is a " << getClass() << ", which is not a GridMap";
+        throw std::invalid_argument(os.str());
+    }
+}
+
+bool GridMap::isGridMap(Object const & obj) {
+    return getGridMapFlag(obj.getRawPtr()) != nullptr;
+}
+
+GridInterp GridMap::getInterp() const {
+    return _getField()->bicubic ? GridInterp::BICUBIC : GridInterp::BILINEAR;
+}
+
+std::vector<double> GridMap::getOrigin() const {
+    auto const field = _getField();
+    return std::vector<double>{field->x0, field->y0};
+}
+
+std::vector<double> GridMap::getSpacing() const {
+    auto const field = _getField();
+    return std::vector<double>{field->sx, field->sy};
+}
+
+Array2D GridMap::getDx() const {
+    auto const field = _getField();
+    return toArray(field->dx, field->nx, field->ny);
+}
+
+Array2D GridMap::getDy() const {
+    auto const field = _getField();
+    return toArray(field->dy, field->nx, field->ny);
+}
+
+std::shared_ptr<detail::GridField const> GridMap::_getField() const {
+    char const * flag = getGridMapFlag(getRawPtr());
+    if (!flag) {
+        throw std::runtime_error("this is not a GridMap");
+    }
+    return getFieldCache().get(flag)->field;
+}
+
+}  // namespace ast
@@ -0,0 +1,128 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsstcorp.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+
+#include "astshim/base.h"
+#include "astshim/CmpMap.h"
+#include "astshim/Interner.h"
+#include "astshim/Mapping.h"
+#include "astshim/ParallelMap.h"
+#include "astshim/SeriesMap.h"
+
+namespace ast {
+
+namespace {
+
+/**
+Return a deep copy of a component of a compound mapping, inverted as the compound mapping uses it
+*/
+std::shared_ptr<Mapping> getComponent(AstMapping * rawComponent, bool invert) {
+    auto component = Mapping(rawComponent).copy();
+    return component->isInverted() == invert ? component : component->getInverse();
+}
+
+}  // anonymous namespace
+
+std::size_t Interner::size() const {
+    std::size_t n = 0;
+    for (auto const & bucket : _entries) {
+        for (auto const & entry : bucket.second) {
+            if (!entry.object.expired()) {
+                ++n;
+            }
+        }
+    }
+    return n;
+}
+
+void Interner::purge() {
+    for (auto it = _entries.begin(); it != _entries.end(); ) {
+        auto & bucket = it->second;
+        for (auto entryIt = bucket.begin(); entryIt != bucket.end(); ) {
+            entryIt = entryIt->object.expired() ? bucket.erase(entryIt) : entryIt + 1;
+        }
+        it = bucket.empty() ? _entries.erase(it) : std::next(it);
+    }
+}
+
+std::shared_ptr<Object const> Interner::_intern(Object const & obj) {
+    ++_nLookups;
+    std::string const content = obj.show();
+    std::type_index const type(typeid(obj));
+    auto & bucket = _entries[std::hash<std::string>()(content)];
+    for (auto it = bucket.begin(); it != bucket.end(); ) {
+        auto pooled = it->object.lock();
+        if (!pooled) {
+            it = bucket.erase(it);
+            continue;
+        }
+        if ((it->type == type) && (it->contentSize == content.size()) && (pooled->show() == content)) {
+            ++_nHits;
+            _bytesSaved += pooled->getObjSize();
+            return pooled;
+        }
+        ++it;
+    }
+    auto pooled = _makePooled(obj, content);
+    pooled->_freeze();
+    // _makePooled may have interned components, which can rehash _entries, so look up the bucket again
+    _entries[std::hash<std::string>()(content)].push_back({pooled, type, content.size()});
+    return pooled;
+}
+
+std::shared_ptr<Object const> Interner::_makePooled(Object const & obj, std::string const & content) {
+    auto const * cmpMap = dynamic_cast<CmpMap const *>(&obj);
+    if (cmpMap || ((typeid(obj) == typeid(Mapping)) && (obj.getClass() == "CmpMap"))) {
+        // rebuild the compound mapping from interned components
+        AstMapping * rawMap1;
+        AstMapping * rawMap2;
+        int series, invert1, invert2;
+        astDecompose(obj.getRawPtr(), &rawMap1, &rawMap2, &series, &invert1, &invert2);
+        assertOK();
+        auto map1 = getComponent(rawMap1, invert1);
+        auto map2 = getComponent(rawMap2, invert2);
+        auto pooledMap1 = intern<Mapping>(*map1);
+        auto pooledMap2 = intern<Mapping>(*map2);
+        // the pooled components must stay in the pool for as long as the rebuilt mapping uses them
+        auto deleter = [pooledMap1, pooledMap2](CmpMap * map) { delete map; };
+        std::shared_ptr<CmpMap> rebuilt;
+        if (dynamic_cast<SeriesMap const *>(&obj)) {
+            rebuilt.reset(new SeriesMap(*pooledMap1, *pooledMap2), deleter);
+        } else if (dynamic_cast<ParallelMap const *>(&obj)) {
+            rebuilt.reset(new ParallelMap(*pooledMap1, *pooledMap2), deleter);
+        } else {
+            rebuilt.reset(new CmpMap(*pooledMap1, *pooledMap2, series), deleter);
+        }
+        // attributes of the compound mapping itself (e.g. Ident) are not carried over,
+        // so only use the rebuilt mapping if it is identical to the original
+        if (rebuilt->show() == content) {
+            return rebuilt;
+        }
+    }
+    return std::shared_ptr<Object const>(obj.copy());
+}
+
+}  // namespace ast
@@ -20,18 +20,134 @@
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 #include "ndarray.h"
 
 #include "astshim/base.h"
 #include "astshim/detail.h"
+#include "astshim/detail/threads.h"
 
 #include "astshim/MapBox.h"
 #include "astshim/Mapping.h"
+#include "astshim/ScratchArena.h"
 
 namespace ast {
 
+namespace {
+
+int const MAX_SAMPLED_AXES = 10;
+
+/*
+Compute the output bounds of box `i` with astMapBox, for a mapping locked by the calling thread
+*/
+void mapBoxExact(AstMapping * map, ConstArray2D const & lbnd, ConstArray2D const & ubnd,
+                 Array2D const & lbndOut, Array2D const & ubndOut, std::size_t i) {
+    int const nIn = lbnd.getSize<1>();
+    int const nOut = lbndOut.getSize<1>();
+    std::vector<double> boxLbnd(lbnd[i].begin(), lbnd[i].end());
+    std::vector<double> boxUbnd(ubnd[i].begin(), ubnd[i].end());
+    std::vector<double> xl(nIn);
+    std::vector<double> xu(nIn);
+    for (int outCoord = 1; outCoord <= nOut; ++outCoord) {
+        double lbndOut_i;
+        double ubndOut_i;
+        astMapBox(map, boxLbnd.data(), boxUbnd.data(), true, outCoord, &lbndOut_i, &ubndOut_i,
+                  xl.data(), xu.data());
+        assertOK();
+        double const nan = std::numeric_limits<double>::quiet_NaN();
+        lbndOut[i][outCoord - 1] = lbndOut_i != AST__BAD ? lbndOut_i : nan;
+        ubndOut[i][outCoord - 1] = ubndOut_i != AST__BAD ? ubndOut_i : nan;
+    }
+}
+
+/*
+Compute the output bounds of box `i` by transforming the corners and `nSamples` points along the interior
+of each edge in one call to astTranN, for a mapping locked by the calling thread
+
+The bounds of the transformed points are padded by a quarter of the largest second difference between
+neighbouring points along an edge: between two samples a quadratic can exceed them by at most an eighth
+of its second difference, so this covers an extremum between samples if the mapping is smooth
+on the scale of the sampling, and adds nothing for a linear mapping.
+*/
+void mapBoxSampled(AstMapping * map, ConstArray2D const & lbnd, ConstArray2D const & ubnd,
+                   Array2D const & lbndOut, Array2D const & ubndOut, std::size_t i, int nSamples) {
+    int const nIn = lbnd.getSize<1>();
+    int const nOut = lbndOut.getSize<1>();
+    int const nCorners = 1 << nIn;
+    // each edge varies along one axis, with the other axes at a corner whose bit for that axis is 0
+    int const nPts = nCorners + nIn * (nCorners / 2) * nSamples;
+    int const nEdges = nIn * (nCorners / 2);
+    ScratchBuffer from(static_cast<std::size_t>(nPts) * nIn);
+    // index of each point along each edge, in order: a corner, the samples and the opposite corner
+    std::vector<int> edgePts;
+    edgePts.reserve(static_cast<std::size_t>(nEdges) * (nSamples + 2));
+    ScratchBuffer to(static_cast<std::size_t>(nPts) * nOut);
+    auto setCorner = [&](int pt, int corner) {
+        for (int axis = 0; axis < nIn; ++axis) {
+            from[axis * nPts + pt] = (corner >> axis) & 1 ? ubnd[i][axis] : lbnd[i][axis];
+        }
+    };
+    int pt = 0;
+    for (int corner = 0; corner < nCorners; ++corner) {
+        setCorner(pt++, corner);
+    }
+    for (int edgeAxis = 0; edgeAxis < nIn; ++edgeAxis) {
+        double const lo = lbnd[i][edgeAxis];
+        double const hi = ubnd[i][edgeAxis];
+        for (int corner = 0; corner < nCorners; ++corner) {
+            if ((corner >> edgeAxis) & 1) {
+                continue;
+            }
+            edgePts.push_back(corner);
+            for (int k = 1; k <= nSamples; ++k) {
+                setCorner(pt, corner);
+                from[edgeAxis * nPts + pt] = lo + (hi - lo) * k / (nSamples + 1.0);
+                edgePts.push_back(pt);
+                ++pt;
+            }
+            edgePts.push_back(corner | (1 << edgeAxis));
+        }
+    }
+    astTranN(map, nPts, nIn, nPts, from.data(), true, nOut, nPts, to.data());
+    assertOK();
+    auto isGood = [](double val) { return (val != AST__BAD) && std::isfinite(val); };
+    for (int axis = 0; axis < nOut; ++axis) {
+        double const * toAxis = to.data() + static_cast<std::size_t>(axis) * nPts;
+        double minVal = std::numeric_limits<double>::infinity();
+        double maxVal = -std::numeric_limits<double>::infinity();
+        for (int j = 0; j < nPts; ++j) {
+            if (isGood(toAxis[j])) {
+                minVal = std::min(minVal, toAxis[j]);
+                maxVal = std::max(maxVal, toAxis[j]);
+            }
+        }
+        double maxSecondDiff = 0;
+        for (int edge = 0; edge < nEdges; ++edge) {
+            int const * pts = edgePts.data() + static_cast<std::size_t>(edge) * (nSamples + 2);
+            for (int k = 1; k <= nSamples; ++k) {
+                double const prev = toAxis[pts[k - 1]];
+                double const val = toAxis[pts[k]];
+                double const next = toAxis[pts[k + 1]];
+                if (isGood(prev) && isGood(val) && isGood(next)) {
+                    maxSecondDiff = std::max(maxSecondDiff, std::abs(prev - 2 * val + next));
+                }
+            }
+        }
+        bool const found = minVal <= maxVal;
+        lbndOut[i][axis] = found ? minVal - maxSecondDiff / 4 : std::numeric_limits<double>::quiet_NaN();
+        ubndOut[i][axis] = found ? maxVal + maxSecondDiff / 4 : std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+}  // anonymous namespace
+
 MapBox::MapBox(Mapping const & map,
                 std::vector<double> const & lbnd,
                 std::vector<double> const & ubnd,
@@ -97,4 +213,120 @@ void MapBox::_compute(Mapping const & map,
     detail::astBadToNan(xu);
 }
 
-}  // namespace ast
\ No newline at end of file
+void mapBoxes(std::vector<std::shared_ptr<Mapping>> const & maps, ConstArray2D const & lbnd,
+              ConstArray2D const & ubnd, Array2D const & lbndOut, Array2D const & ubndOut, int nSamples,
+              int nThreads) {
+    std::size_t const nBoxes = lbnd.getSize<0>();
+    if (maps.empty() || ((maps.size() != 1) && (maps.size() != nBoxes))) {
+        std::ostringstream os;
+        os << "maps.size() = " << maps.size() << "; must be 1 or the number of boxes = " << nBoxes;
+        throw std::invalid_argument(os.str());
+    }
+    int const nIn = maps[0]->getNin();
+    int const nOut = maps[0]->getNout();
+    for (auto const & map : maps) {
+        detail::assertEqual(map->getNin(), "map.getNin()", nIn, "maps[0].getNin()");
+        detail::assertEqual(map->getNout(), "map.getNout()", nOut, "maps[0].getNout()");
+    }
+    detail::assertEqual(lbnd.getSize<1>(), "lbnd.getSize<1>()", nIn, "number of input axes");
+    detail::assertEqual(ubnd.getSize<0>(), "ubnd.getSize<0>()", nBoxes, "number of boxes");
+    detail::assertEqual(ubnd.getSize<1>(), "ubnd.getSize<1>()", nIn, "number of input axes");
+    detail::assertEqual(lbndOut.getSize<0>(), "lbndOut.getSize<0>()", nBoxes, "number of boxes");
+    detail::assertEqual(lbndOut.getSize<1>(), "lbndOut.getSize<1>()", nOut, "number of output axes");
+    detail::assertEqual(ubndOut.getSize<0>(), "ubndOut.getSize<0>()", nBoxes, "number of boxes");
+    detail::assertEqual(ubndOut.getSize<1>(), "ubndOut.getSize<1>()", nOut, "number of output axes");
+    if (nSamples < 0) {
+        std::ostringstream os;
+        os << "nSamples = " << nSamples << " < 0";
+        throw std::invalid_argument(os.str());
+    }
+    if ((nSamples > 0) && (nIn > MAX_SAMPLED_AXES)) {
+        std::ostringstream os;
+        os << "nIn = " << nIn << " > " << MAX_SAMPLED_AXES << " is not supported when sampling";
+        throw std::invalid_argument(os.str());
+    }
+    auto computeBox = [&](AstObject * map, std::size_t i) {
+        if (nSamples == 0) {
+            mapBoxExact(reinterpret_cast<AstMapping *>(map), lbnd, ubnd, lbndOut, ubndOut, i);
+        } else {
+            mapBoxSampled(reinterpret_cast<AstMapping *>(map), lbnd, ubnd, lbndOut, ubndOut, i, nSamples);
+        }
+    };
+
+    if (maps.size() == 1) {
+        // share the boxes among the threads, each of which uses its own copy of the mapping
+        nThreads = detail::getNumThreads(nThreads, nBoxes);
+        detail::ThreadCopies copies(maps[0]->getRawPtr(), nThreads);
+        detail::parallelFor(nThreads, nBoxes, [&](int threadIndex, std::size_t i) {
+            AstObject * map = copies.lock(threadIndex);
+            try {
+                computeBox(map, i);
+            } catch (...) {
+                copies.unlock(threadIndex);
+                throw;
+            }
+            copies.unlock(threadIndex);
+        });
+        return;
+    }
+
+    // group the boxes by mapping, so that each mapping is copied at most once
+    std::unordered_map<AstObject *, std::size_t> groupIndex;
+    std::vector<AstObject *> groupMaps;
+    std::vector<std::vector<std::size_t>> groupBoxes;
+    for (std::size_t i = 0; i < nBoxes; ++i) {
+        AstObject * rawMap = maps[i]->getRawPtr();
+        auto const inserted = groupIndex.emplace(rawMap, groupMaps.size());
+        if (inserted.second) {
+            groupMaps.push_back(rawMap);
+            groupBoxes.emplace_back();
+        }
+        groupBoxes[inserted.first->second].push_back(i);
+    }
+    nThreads = detail::getNumThreads(nThreads, groupMaps.size());
+    auto processGroup = [&](std::size_t group) {
+        for (std::size_t i : groupBoxes[group]) {
+            computeBox(groupMaps[group], i);
+        }
+    };
+    if (nThreads == 1) {
+        for (std::size_t group = 0; group < groupMaps.size(); ++group) {
+            processGroup(group);
+        }
+        return;
+    }
+
+    // AST objects may only be used by the thread that has locked them, so each worker thread locks
+    // a deep copy made (and unlocked) by this thread; this thread locks them again before they are freed.
+    // Deep copies share no component objects, so a worker never waits for a lock held by another.
+    std::vector<std::shared_ptr<Mapping>> copies;
+    copies.reserve(groupMaps.size());
+    for (std::size_t group = 0; group < groupMaps.size(); ++group) {
+        copies.push_back(maps[groupBoxes[group][0]]->copy());
+        copies.back()->unlock();
+        groupMaps[group] = copies.back()->getRawPtr();
+    }
+    auto relockAll = [&copies]() {
+        for (auto & copy : copies) {
+            copy->lock(true);
+        }
+    };
+    try {
+        detail::parallelFor(nThreads, groupMaps.size(), [&](int, std::size_t group) {
+            copies[group]->lock(true);
+            try {
+                processGroup(group);
+            } catch (...) {
+                copies[group]->unlock();
+                throw;
+            }
+            copies[group]->unlock();
+        });
+    } catch (...) {
+        relockAll();
+        throw;
+    }
+    relockAll();
+}
+
+}  // namespace ast
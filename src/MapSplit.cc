@@ -32,8 +32,7 @@
 namespace ast {
 
 MapSplit::MapSplit(Mapping const & map, std::vector<int> const & in) {
-    std::vector<int> locOut;
-    locOut.reserve(map.getNout());  // the max # of elements astMapSplit may set
+    std::vector<int> locOut(map.getNout());  // the max # of elements astMapSplit may set
     AstMapping * rawSplitMap;
     astMapSplit(map.getRawPtr(), in.size(), in.data(), locOut.data(), &rawSplitMap);
     assertOK();
@@ -19,19 +19,473 @@
  * the GNU General Public License along with this program.  If not, 
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "astshim/base.h"
 #include "astshim/detail.h"
+#include "astshim/detail/kernels.h"
+#include "astshim/CompiledMapping.h"
+#include "astshim/MapSplit.h"
 #include "astshim/Mapping.h"
 #include "astshim/ParallelMap.h"
+#include "astshim/PointStream.h"
+#include "astshim/ScratchArena.h"
 #include "astshim/SeriesMap.h"
 
 namespace ast {
 
+namespace {
+
+// Largest number of points, or leading dimension, that AST's transformation functions accept
+std::size_t const MAX_AST_SIZE = std::numeric_limits<int>::max();
+
+std::atomic<std::size_t> tranChunkSizeValue(1 << 16);
+
+// Smallest grid for which Mapping::_tranGrid looks for independent groups of axes;
+// looking costs a few calls to astMapSplit, which is not worth it for small grids
+std::size_t const MIN_SEPARABLE_GRID_SIZE = 4096;
+
+// Largest number of times Mapping::tranInverseIterative halves a Newton step that does not reduce
+// the residual
+int const MAX_STEP_HALVINGS = 10;
+
+// Smallest number of points for which Mapping::_tran looks for a native kernel;
+// looking costs a few calls to AST, which is not worth it for a few points
+std::size_t const MIN_FAST_TRAN_SIZE = 256;
+
+// Number of input buffers, and of output buffers, used by Mapping::_tranStream
+int const N_STREAM_BUFFERS = 2;
+
+/// A chunk of points passed between the threads of Mapping::_tranStream
+struct StreamChunk {
+    int buffer;        // index of the buffer holding the points
+    std::size_t nPts;  // number of points in the buffer; 0 marks the end of the stream
+};
+
+/**
+A queue of chunks passed between the threads of Mapping::_tranStream
+
+Each buffer is in at most one queue at a time, so a queue never holds more than N_STREAM_BUFFERS chunks.
+Closing the queue wakes every thread waiting on it, and makes pop fail from then on,
+so that all threads stop promptly when one of them fails.
+*/
+class ChunkQueue {
+public:
+    ChunkQueue() : _mutex(), _ready(), _chunks(), _isClosed(false) {}
+
+    /// Add a chunk, unless the queue is closed
+    void push(StreamChunk const & chunk) {
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            if (_isClosed) {
+                return;
+            }
+            _chunks.push_back(chunk);
+        }
+        _ready.notify_one();
+    }
+
+    /// Wait for the next chunk; return false if the queue is closed
+    bool pop(StreamChunk & chunk) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _ready.wait(lock, [this] { return _isClosed || !_chunks.empty(); });
+        if (_isClosed) {
+            return false;
+        }
+        chunk = _chunks.front();
+        _chunks.pop_front();
+        return true;
+    }
+
+    /// Close the queue, discarding any chunks in it
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(_mutex);
+            _isClosed = true;
+            _chunks.clear();
+        }
+        _ready.notify_all();
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::deque<StreamChunk> _chunks;
+    bool _isClosed;
+};
+
+/**
+Closes the queues of Mapping::_tranStream and joins its helper threads when it returns or throws
+*/
+class StreamThreadsGuard {
+public:
+    StreamThreadsGuard(std::vector<ChunkQueue *> const & queues, std::vector<std::thread *> const & threads)
+            : _queues(queues), _threads(threads) {}
+
+    ~StreamThreadsGuard() { stop(); }
+
+    StreamThreadsGuard(StreamThreadsGuard const &) = delete;
+    StreamThreadsGuard & operator=(StreamThreadsGuard const &) = delete;
+
+    /// Close all queues, which makes every thread stop soon; safe to call from any of the threads
+    void closeQueues() {
+        for (auto queue : _queues) {
+            queue->close();
+        }
+    }
+
+    /// Close all queues and wait for all threads to finish; call only from the thread that owns this
+    void stop() {
+        closeQueues();
+        for (auto thread : _threads) {
+            if (thread->joinable()) {
+                thread->join();
+            }
+        }
+    }
+
+private:
+    std::vector<ChunkQueue *> const _queues;
+    std::vector<std::thread *> const _threads;
+};
+
+/**
+Return a MapSplit for the given 1-based inputs of `map`, or nullptr if they do not feed a separate
+set of outputs
+*/
+std::unique_ptr<MapSplit> trySplit(Mapping const & map, std::vector<int> const & in) {
+    try {
+        return std::unique_ptr<MapSplit>(new MapSplit(map, in));
+    } catch (std::runtime_error const &) {
+        return nullptr;
+    }
+}
+
+/**
+Replace `AST__BAD` with a quiet NaN in an axis-major buffer of nAxes rows of nPts values
+*/
+void badToNan(double * data, std::size_t ld, int nAxes, std::size_t nPts) {
+    for (int i = 0; i < nAxes; ++i) {
+        double * axisData = data + i * ld;
+        for (std::size_t j = 0; j < nPts; ++j) {
+            if (axisData[j] == AST__BAD) {
+                axisData[j] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+}
+
+}  // anonymous namespace
+
+namespace detail {
+
+/**
+The part of a Mapping needed to compute some of its outputs; see Mapping::tranOutputs
+
+Like the AST copies in CompiledMapping, `map` is kept unlocked between uses, so whichever thread
+is using the Mapping that caches it can lock it.
+*/
+struct ReducedMapping {
+    ReducedMapping() : map(), inAxes() {}
+    ~ReducedMapping() {
+        if (map) {
+            map->lock(true);
+        }
+    }
+
+    std::shared_ptr<Mapping> map;  // computes the requested outputs; null if they cannot be split off
+    std::vector<int> inAxes;       // the inputs of the full mapping used by `map` (0-based)
+};
+
+/**
+A native kernel that Mapping::_tran uses instead of astTranN; see Mapping::_getFastTran
+*/
+struct FastTran {
+    FastTran() : kernel(), badIsAllBad(false), isSelection(false) {}
+
+    /// Transform axis-major data, as Kernel::apply, giving the same bad values as AST
+    void apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+        kernel->apply(in, ldIn, nPts, out, ldOut);
+        if (!badIsAllBad) {
+            return;
+        }
+        for (int i = 0; i < kernel->getNin(); ++i) {
+            double const * inRow = in + i * ldIn;
+            for (int k = 0; k < nPts; ++k) {
+                if (std::isnan(inRow[k])) {
+                    for (int j = 0; j < kernel->getNout(); ++j) {
+                        out[j * ldOut + k] = std::numeric_limits<double>::quiet_NaN();
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+    Transform points held in any layout without transposing them, for a kernel that is a selection
+
+    Each output is a copy of an input column or a constant, so a whole array is copied one
+    column at a time, or as a single block if every output is the input with the same index
+    and both arrays have the same layout.
+    */
+    void select(ConstArray2D const & from, StridedArray2D const & to) const {
+        auto const & affine = static_cast<AffineKernel const &>(*kernel);
+        std::vector<int> const & source = affine.getSource();
+        int const nOut = kernel->getNout();
+        std::size_t const nPts = from.getSize<0>();
+        bool isIdentity = kernel->getNin() == nOut;
+        for (int j = 0; j < nOut; ++j) {
+            isIdentity = isIdentity && (source[j] == j);
+        }
+        bool const sameStrides = (from.getStride<0>() == to.getStride<0>()) &&
+                                 (from.getStride<1>() == to.getStride<1>());
+        bool const isContiguous =
+            (from.getStride<1>() == 1 && from.getStride<0>() == nOut) ||
+            (from.getStride<0>() == 1 && static_cast<std::size_t>(from.getStride<1>()) == nPts);
+        if (isIdentity && sameStrides && isContiguous) {
+            std::copy(from.getData(), from.getData() + nPts * nOut, to.getData());
+            return;
+        }
+        // strides may be negative (e.g. for a reversed view), so index with signed offsets
+        std::ptrdiff_t const nSignedPts = nPts;
+        for (int j = 0; j < nOut; ++j) {
+            double * toCol = to.getData() + j * to.getStride<1>();
+            std::ptrdiff_t const toStride = to.getStride<0>();
+            if (source[j] < 0) {
+                double const value = affine.getOffset()[j];
+                for (std::ptrdiff_t k = 0; k < nSignedPts; ++k) {
+                    toCol[k * toStride] = value;
+                }
+                continue;
+            }
+            double const * fromCol = from.getData() + source[j] * from.getStride<1>();
+            std::ptrdiff_t const fromStride = from.getStride<0>();
+            for (std::ptrdiff_t k = 0; k < nSignedPts; ++k) {
+                toCol[k * toStride] = fromCol[k * fromStride];
+            }
+        }
+    }
+
+    std::shared_ptr<Kernel const> kernel;  // null if astTranN must be used
+    bool badIsAllBad;                      // does a bad value in any input make all outputs bad?
+    bool isSelection;   // is each output a copy of one input or a constant? (kernel is an AffineKernel)
+};
+
+}  // namespace detail
+
+namespace {
+
+bool isBad(double value) { return std::isnan(value) || (value == AST__BAD); }
+
+/**
+Return a native kernel for a MatrixMap, PermMap or UnitMap, found by transforming the origin
+and the unit vectors
+
+The matrix elements and constants found this way are exactly those AST uses, as each output
+is a sum of products with 0 and 1 (or a constant, which may be bad, for a PermMap).
+One more point per input, with that input bad, shows which outputs AST makes bad.
+*/
+std::shared_ptr<detail::FastTran const> makeLinearFastTran(AstMapping * map, bool forward) {
+    auto fastTran = std::make_shared<detail::FastTran>();
+    int const nIn = astGetI(map, forward ? "Nin" : "Nout");
+    int const nOut = astGetI(map, forward ? "Nout" : "Nin");
+    assertOK();
+    // point 0 is the origin, point 1 + i is unit vector i and point 1 + nIn + i has input i bad
+    int const nProbes = 1 + 2 * nIn;
+    std::vector<double> in(nIn * nProbes, 0.0);
+    for (int i = 0; i < nIn; ++i) {
+        in[i * nProbes + 1 + i] = 1.0;
+        in[i * nProbes + 1 + nIn + i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    std::vector<double> out(nOut * nProbes);
+    astTranN(map, nProbes, nIn, nProbes, in.data(), static_cast<int>(forward), nOut, nProbes, out.data());
+    assertOK();
+    std::vector<double> matrix(nOut * nIn);
+    std::vector<double> offset(nOut);
+    for (int j = 0; j < nOut; ++j) {
+        double const * outRow = out.data() + j * nProbes;
+        if (std::all_of(outRow, outRow + 1 + nIn, isBad)) {
+            // a bad constant
+            offset[j] = std::numeric_limits<double>::quiet_NaN();
+            continue;
+        }
+        offset[j] = outRow[0];
+        for (int i = 0; i < nIn; ++i) {
+            matrix[j * nIn + i] = outRow[1 + i] - outRow[0];
+        }
+    }
+    if (std::any_of(matrix.begin(), matrix.end(), isBad)) {
+        return fastTran;
+    }
+    for (int j = 0; j < nOut; ++j) {
+        for (int i = 0; i < nIn; ++i) {
+            if ((matrix[j * nIn + i] == 0) && isBad(out[j * nProbes + 1 + nIn + i])) {
+                fastTran->badIsAllBad = true;
+            }
+        }
+    }
+    auto kernel = std::make_shared<detail::AffineKernel>(matrix, offset);
+    fastTran->kernel = kernel;
+    if (kernel->isPermutation() && !fastTran->badIsAllBad) {
+        fastTran->isSelection = true;
+        for (int j = 0; j < nOut; ++j) {
+            int const i = kernel->getSource()[j];
+            if ((i >= 0) && ((matrix[j * nIn + i] != 1) || (offset[j] != 0))) {
+                fastTran->isSelection = false;
+            }
+        }
+    }
+    return fastTran;
+}
+
+/**
+LU-decompose an n x n row-major matrix in place, with partial pivoting
+
+@return false if the matrix is singular (or not finite)
+*/
+bool luDecompose(double * a, int * perm, int n) {
+    for (int i = 0; i < n; ++i) {
+        perm[i] = i;
+    }
+    for (int k = 0; k < n; ++k) {
+        int pivot = k;
+        for (int i = k + 1; i < n; ++i) {
+            if (std::fabs(a[i * n + k]) > std::fabs(a[pivot * n + k])) {
+                pivot = i;
+            }
+        }
+        if (!std::isfinite(a[pivot * n + k]) || (a[pivot * n + k] == 0)) {
+            return false;
+        }
+        if (pivot != k) {
+            std::swap_ranges(a + k * n, a + (k + 1) * n, a + pivot * n);
+            std::swap(perm[k], perm[pivot]);
+        }
+        for (int i = k + 1; i < n; ++i) {
+            double const factor = a[i * n + k] /= a[k * n + k];
+            for (int j = k + 1; j < n; ++j) {
+                a[i * n + j] -= factor * a[k * n + j];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+Solve lu x = b, where `lu` and `perm` are from luDecompose; x is returned in b
+*/
+void luSolve(double const * lu, int const * perm, int n, double * b) {
+    std::vector<double> x(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = b[perm[i]];
+        for (int j = 0; j < i; ++j) {
+            x[i] -= lu[i * n + j] * x[j];
+        }
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        for (int j = i + 1; j < n; ++j) {
+            x[i] -= lu[i * n + j] * x[j];
+        }
+        x[i] /= lu[i * n + i];
+    }
+    std::copy(x.begin(), x.end(), b);
+}
+
+/**
+Estimate the Jacobians of a mapping by forward differences, with one call to Mapping::tran
+
+@param[in] map  The mapping, which has n inputs and n outputs
+@param[in] x  Points at which to find the Jacobians, with dimensions (nPts, n)
+@param[in] fx  `map` applied to `x`
+@param[in] indices  Indices of the points for which Jacobians are wanted
+@param[out] jac  Jacobian of point `indices[m]` at `jac[m*n*n]`: n x n row-major, output by input
+*/
+void findJacobians(Mapping const & map, ConstArray2D const & x, ConstArray2D const & fx,
+                   std::vector<std::size_t> const & indices, std::vector<double> & jac) {
+    int const n = x.getSize<1>();
+    std::size_t const nActive = indices.size();
+    Array2D shifted = ndarray::allocate(nActive * n, n);
+    std::vector<double> steps(nActive * n);
+    for (std::size_t m = 0; m < nActive; ++m) {
+        for (int i = 0; i < n; ++i) {
+            auto row = shifted[m * n + i];
+            std::copy(x[indices[m]].begin(), x[indices[m]].end(), row.begin());
+            double const value = x[indices[m]][i];
+            double const step = std::sqrt(std::numeric_limits<double>::epsilon()) *
+                                std::max(std::fabs(value), 1.0);
+            row[i] = value + step;
+            steps[m * n + i] = row[i] - value;  // the step actually taken, after rounding
+        }
+    }
+    Array2D fShifted = map.tran(shifted);
+    jac.resize(nActive * n * n);
+    for (std::size_t m = 0; m < nActive; ++m) {
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                jac[(m * n + j) * n + i] = (fShifted[m * n + i][j] - fx[indices[m]][j]) / steps[m * n + i];
+            }
+        }
+    }
+}
+
+/// Return the sum of squared residuals of one point, or infinity if a residual is not finite
+template <typename Row1, typename Row2>
+double sumSquares(Row1 const & fx, Row2 const & to) {
+    double sum = 0;
+    auto fxIter = fx.begin();
+    for (auto toIter = to.begin(); toIter != to.end(); ++toIter, ++fxIter) {
+        double const diff = *fxIter - *toIter;
+        sum += diff * diff;
+    }
+    return std::isfinite(sum) ? sum : std::numeric_limits<double>::infinity();
+}
+
+/// Is each output of one point within tol of its target?
+template <typename Row1, typename Row2>
+bool isConverged(Row1 const & fx, Row2 const & to, double tol) {
+    auto fxIter = fx.begin();
+    for (auto toIter = to.begin(); toIter != to.end(); ++toIter, ++fxIter) {
+        if (!(std::fabs(*fxIter - *toIter) <= tol)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
+std::size_t getTranChunkSize() { return tranChunkSizeValue.load(); }
+
+void setTranChunkSize(std::size_t nPts) {
+    if (nPts == 0) {
+        throw std::invalid_argument("nPts = 0; a chunk must hold at least one point");
+    }
+    if (nPts > MAX_AST_SIZE) {
+        std::ostringstream os;
+        os << "nPts = " << nPts << " > " << MAX_AST_SIZE << ", the most points AST can transform at once";
+        throw std::invalid_argument(os.str());
+    }
+    tranChunkSizeValue.store(nPts);
+}
+
+CompiledMapping Mapping::freeze() const {
+    return CompiledMapping(*this);
+}
+
 SeriesMap Mapping::of(Mapping const & first) const {
     return SeriesMap(first, *this);
 }
@@ -40,25 +494,413 @@ ParallelMap Mapping::over(Mapping const & first) const {
     return ParallelMap(first, *this);
 }
 
+void Mapping::tranOutputs(
+    ConstArray2D const & from,
+    std::vector<int> const & outAxes,
+    StridedArray2D const & to
+) const {
+    int const nIn = getNin();
+    int const nOut = getNout();
+    detail::assertEqual(from.getSize<1>(), "from.size[1]", nIn, "input coords");
+    detail::assertEqual(to.getSize<1>(), "to.size[1]", outAxes.size(), "outAxes.size()");
+    detail::assertEqual(to.getSize<0>(), "to.size[0]", from.getSize<0>(), "from.size[0]");
+    if (outAxes.empty()) {
+        throw std::invalid_argument("outAxes is empty");
+    }
+    std::vector<bool> isWanted(nOut, false);
+    for (int axis : outAxes) {
+        if ((axis < 1) || (axis > nOut)) {
+            std::ostringstream os;
+            os << "output axis " << axis << " not in range [1, " << nOut << "]";
+            throw std::invalid_argument(os.str());
+        }
+        if (isWanted[axis - 1]) {
+            std::ostringstream os;
+            os << "output axis " << axis << " is listed more than once";
+            throw std::invalid_argument(os.str());
+        }
+        isWanted[axis - 1] = true;
+    }
+
+    std::size_t const nPts = from.getSize<0>();
+    // hold the reduced mapping, in case another thread modifying this mapping clears the cache
+    std::shared_ptr<detail::ReducedMapping const> const reducedPtr = _getReducedMapping(outAxes);
+    detail::ReducedMapping const & reduced = *reducedPtr;
+    if (!reduced.map) {
+        // compute all outputs and keep the ones wanted
+        Array2D allTo = ndarray::allocate(nPts, nOut);
+        _tran(from, true, allTo);
+        for (std::size_t i = 0; i < nPts; ++i) {
+            for (std::size_t k = 0; k < outAxes.size(); ++k) {
+                to[i][k] = allTo[i][outAxes[k] - 1];
+            }
+        }
+        return;
+    }
+
+    Array2D reducedFrom = ndarray::allocate(nPts, reduced.inAxes.size());
+    for (std::size_t i = 0; i < nPts; ++i) {
+        for (std::size_t k = 0; k < reduced.inAxes.size(); ++k) {
+            reducedFrom[i][k] = from[i][reduced.inAxes[k]];
+        }
+    }
+    reduced.map->lock(true);
+    try {
+        reduced.map->_tran(reducedFrom, true, to);
+    } catch (...) {
+        reduced.map->unlock();
+        throw;
+    }
+    reduced.map->unlock();
+}
+
+ndarray::Array<bool, 1, 1> Mapping::tranInverseIterative(
+    ConstArray2D const & to,
+    ConstArray2D const & seed,
+    StridedArray2D const & from,
+    double tol,
+    int maxIter
+) const {
+    int const n = getNin();
+    detail::assertEqual(getNout(), "getNout()", n, "getNin(), as needed to solve by Newton iteration");
+    detail::assertEqual(to.getSize<1>(), "to.size[1]", n, "output coords");
+    detail::assertEqual(from.getSize<1>(), "from.size[1]", n, "input coords");
+    detail::assertEqual(from.getSize<0>(), "from.size[0]", to.getSize<0>(), "to.size[0]");
+    detail::assertEqual(seed.getSize<1>(), "seed.size[1]", n, "input coords");
+    std::size_t const nPts = to.getSize<0>();
+    if ((seed.getSize<0>() != 1) && (seed.getSize<0>() != nPts)) {
+        std::ostringstream os;
+        os << "seed.size[0] = " << seed.getSize<0>() << " must be 1 or to.size[0] = " << nPts;
+        throw std::invalid_argument(os.str());
+    }
+    if (!(tol > 0)) {
+        std::ostringstream os;
+        os << "tol = " << tol << " must be positive";
+        throw std::invalid_argument(os.str());
+    }
+    if (maxIter < 0) {
+        std::ostringstream os;
+        os << "maxIter = " << maxIter << " must not be negative";
+        throw std::invalid_argument(os.str());
+    }
+    if (!getTranForward()) {
+        throw std::runtime_error("The forward transform is not available");
+    }
+    ndarray::Array<bool, 1, 1> converged = ndarray::allocate(nPts);
+    std::fill(converged.begin(), converged.end(), false);
+    if (nPts == 0) {
+        return converged;
+    }
+
+    Array2D x = ndarray::allocate(nPts, n);
+    if (seed.getSize<0>() == nPts) {
+        x.deep() = seed;
+    } else {
+        // invert the linear approximation at the seed point
+        Array2D x0 = ndarray::copy(seed);
+        Array2D fx0 = tran(x0);
+        std::vector<double> jac;
+        findJacobians(*this, x0, fx0, {0}, jac);
+        std::vector<int> perm(n);
+        bool const isSolvable = luDecompose(jac.data(), perm.data(), n);
+        std::vector<double> step(n);
+        for (std::size_t k = 0; k < nPts; ++k) {
+            std::copy(x0[0].begin(), x0[0].end(), x[k].begin());
+            if (!isSolvable) {
+                continue;
+            }
+            for (int j = 0; j < n; ++j) {
+                step[j] = to[k][j] - fx0[0][j];
+            }
+            luSolve(jac.data(), perm.data(), n, step.data());
+            if (std::all_of(step.begin(), step.end(), [](double v) { return std::isfinite(v); })) {
+                for (int i = 0; i < n; ++i) {
+                    x[k][i] += step[i];
+                }
+            }
+        }
+    }
+    Array2D fx = tran(x);
+
+    // points still being iterated
+    std::vector<std::size_t> active;
+    for (std::size_t k = 0; k < nPts; ++k) {
+        if (std::any_of(to[k].begin(), to[k].end(), [](double v) { return std::isnan(v); })) {
+            std::fill(x[k].begin(), x[k].end(), std::numeric_limits<double>::quiet_NaN());
+        } else {
+            active.push_back(k);
+        }
+    }
+    std::vector<double> jac;
+    std::vector<int> perm(n);
+    for (int iter = 0; iter <= maxIter; ++iter) {
+        std::vector<std::size_t> stillActive;
+        for (std::size_t k : active) {
+            converged[k] = isConverged(fx[k], to[k], tol);
+            if (!converged[k]) {
+                stillActive.push_back(k);
+            }
+        }
+        active.swap(stillActive);
+        if (active.empty() || (iter == maxIter)) {
+            break;
+        }
+
+        // Newton step for each active point; points whose Jacobian is singular stop here
+        findJacobians(*this, x, fx, active, jac);
+        std::size_t const nActive = active.size();
+        Array2D steps = ndarray::allocate(nActive, n);
+        std::vector<double> sumSq(nActive);
+        std::vector<std::size_t> searching;  // indices into active
+        for (std::size_t m = 0; m < nActive; ++m) {
+            std::size_t const k = active[m];
+            double * mJac = jac.data() + m * n * n;
+            sumSq[m] = sumSquares(fx[k], to[k]);
+            if (!luDecompose(mJac, perm.data(), n)) {
+                continue;
+            }
+            for (int j = 0; j < n; ++j) {
+                steps[m][j] = to[k][j] - fx[k][j];
+            }
+            luSolve(mJac, perm.data(), n, steps[m].getData());
+            searching.push_back(m);
+        }
+
+        // damp each step by halving it until the residual decreases; points that cannot improve stop here
+        std::vector<std::size_t> improved;
+        double scale = 1.0;
+        for (int halving = 0; !searching.empty() && (halving <= MAX_STEP_HALVINGS); ++halving, scale *= 0.5) {
+            Array2D trial = ndarray::allocate(searching.size(), n);
+            for (std::size_t t = 0; t < searching.size(); ++t) {
+                std::size_t const m = searching[t];
+                for (int i = 0; i < n; ++i) {
+                    trial[t][i] = x[active[m]][i] + scale * steps[m][i];
+                }
+            }
+            Array2D fTrial = tran(trial);
+            std::vector<std::size_t> stillSearching;
+            for (std::size_t t = 0; t < searching.size(); ++t) {
+                std::size_t const m = searching[t];
+                std::size_t const k = active[m];
+                if (sumSquares(fTrial[t], to[k]) < sumSq[m]) {
+                    x[k].deep() = trial[t];
+                    fx[k].deep() = fTrial[t];
+                    improved.push_back(k);
+                } else {
+                    stillSearching.push_back(m);
+                }
+            }
+            searching.swap(stillSearching);
+        }
+        std::sort(improved.begin(), improved.end());
+        active.swap(improved);
+    }
+    from.deep() = x;
+    return converged;
+}
+
+void Mapping::_discardStaleCaches() const {
+    // another wrapper of the AST object (e.g. one made by casting this) may have modified it
+    std::size_t const modifications = _getModificationCount();
+    if (modifications != _cachedModifications) {
+        _reducedMappings.clear();
+        _fastTrans[0].reset();
+        _fastTrans[1].reset();
+        _cachedModifications = modifications;
+    }
+}
+
+std::shared_ptr<detail::FastTran const> Mapping::_getFastTran(bool doForward) const {
+    std::lock_guard<std::mutex> lock(*_cacheMutex);
+    _discardStaleCaches();
+    auto & fastTran = _fastTrans[doForward ? 0 : 1];
+    if (fastTran) {
+        return fastTran;
+    }
+    // Only kernels that give exactly the results AST would are used, so results do not depend on
+    // how many points are transformed at once; freeze() compiles other mappings into native kernels.
+    auto rawMap = reinterpret_cast<AstMapping *>(getRawPtr());
+    std::unique_ptr<Mapping> frameSetMap;
+    if (astIsAFrameSet(rawMap)) {
+        // a FrameSet transforms points by the mapping from its base frame to its current frame
+        auto rawFrameSetMap = reinterpret_cast<AstMapping *>(astGetMapping(rawMap, AST__BASE, AST__CURRENT));
+        assertOK(reinterpret_cast<AstObject *>(rawFrameSetMap));
+        frameSetMap.reset(new Mapping(rawFrameSetMap));
+        rawMap = rawFrameSetMap;
+    }
+    bool const hasTran = astGetI(rawMap, doForward ? "TranForward" : "TranInverse");
+    assertOK();
+    if (hasTran && (astIsAMatrixMap(rawMap) || astIsAPermMap(rawMap) || astIsAUnitMap(rawMap))) {
+        fastTran = makeLinearFastTran(rawMap, doForward);
+    } else {
+        fastTran = std::make_shared<detail::FastTran>();
+    }
+    return fastTran;
+}
+
+std::shared_ptr<detail::ReducedMapping const> Mapping::_getReducedMapping(
+    std::vector<int> const & outAxes
+) const {
+    std::lock_guard<std::mutex> lock(*_cacheMutex);
+    _discardStaleCaches();
+    auto const it = _reducedMappings.find(outAxes);
+    if (it != _reducedMappings.end()) {
+        return it->second;
+    }
+    // MapSplit splits a mapping by its inputs, so split the inverted mapping and invert the result
+    auto reduced = std::make_shared<detail::ReducedMapping>();
+    auto split = trySplit(*getInverse(), outAxes);
+    if (split && !split->origOut.empty()) {
+        auto map = split->splitMap->getInverse();
+        if (map->getTranForward()) {
+            for (int in : split->origOut) {
+                reduced->inAxes.push_back(in - 1);
+            }
+            map->unlock();
+            reduced->map = map;
+        }
+    }
+    _reducedMappings[outAxes] = reduced;
+    return reduced;
+}
+
 void Mapping::_tran(
-    Array2D const & from,
+    ConstArray2D const & from,
     bool doForward,
-    Array2D & to
+    StridedArray2D const & to
 ) const {
     int const nFromAxes = doForward ? getNin()  : getNout();
     int const nToAxes   = doForward ? getNout() : getNin();
     detail::assertEqual(from.getSize<1>(), "from.size[1]", nFromAxes, "from coords");
     detail::assertEqual(to.getSize<1>(), "to.size[1]", nToAxes, "to coords");
     detail::assertEqual(from.getSize<0>(), "from.size[1]", to.getSize<0>(), "to.size[1]");
-    int const nPts = from.getSize<0>();
+    std::size_t const nPts = from.getSize<0>();
+    std::size_t const chunkSize = std::max<std::size_t>(std::min(nPts, getTranChunkSize()), 1);
     // astTranN uses fortran ordering x0, x1, x2, ..., y0, y1, y2, ..., ... so transpose in and out
-    Array2D fromT = ndarray::copy(from.transpose());
-    Array2D toT = ndarray::allocate(ndarray::makeVector(nToAxes, nPts));
-    astTranN(getRawPtr(), nPts, nFromAxes, nPts, fromT.getData(),
-             static_cast<int>(doForward), nToAxes, nPts, toT.getData());
-    assertOK();
-    to.transpose() = toT;
-    detail::astBadToNan(to);
+    // one chunk at a time, unless the arrays are already in that order
+    std::size_t fromStride = detail::getAxisMajorStride(from);
+    if (fromStride > MAX_AST_SIZE) {
+        fromStride = 0;
+    }
+    std::size_t toStride = detail::getAxisMajorStride(to);
+    if (toStride > MAX_AST_SIZE) {
+        toStride = 0;
+    }
+    std::shared_ptr<detail::FastTran const> fastTran;
+    if (nPts >= MIN_FAST_TRAN_SIZE) {
+        fastTran = _getFastTran(doForward);
+        if (!fastTran->kernel) {
+            fastTran.reset();
+        }
+    }
+    if (fastTran && fastTran->isSelection) {
+        fastTran->select(from, to);
+        return;
+    }
+    ScratchBuffer fromT(fromStride == 0 ? nFromAxes * chunkSize : 0);
+    ScratchBuffer toT(toStride == 0 ? nToAxes * chunkSize : 0);
+    for (std::size_t start = 0; start < nPts; start += chunkSize) {
+        std::size_t const nChunk = std::min(chunkSize, nPts - start);
+        double const * fromData = from.getData() + start;
+        if (fromStride == 0) {
+            detail::gatherAxisMajor(from, start, nChunk, fromT.data(), chunkSize);
+            fromData = fromT.data();
+        }
+        double * toData = toStride == 0 ? toT.data() : to.getData() + start;
+        int const toDim = toStride == 0 ? chunkSize : toStride;
+        int const fromDim = fromStride == 0 ? chunkSize : fromStride;
+        if (fastTran) {
+            fastTran->apply(fromData, fromDim, nChunk, toData, toDim);
+        } else {
+            astTranN(getRawPtr(), nChunk, nFromAxes, fromDim, fromData, static_cast<int>(doForward), nToAxes,
+                     toDim, toData);
+            assertOK();
+            badToNan(toData, toDim, nToAxes, nChunk);
+        }
+        if (toStride == 0) {
+            detail::scatterAxisMajor(toData, chunkSize, start, nChunk, to);
+        }
+    }
+}
+
+std::size_t Mapping::_tranStream(
+    PointReader & reader,
+    PointWriter & writer,
+    std::size_t chunkSize,
+    bool doForward
+) const {
+    int const nFromAxes = doForward ? getNin()  : getNout();
+    int const nToAxes   = doForward ? getNout() : getNin();
+    detail::assertEqual(reader.getNaxes(), "reader.getNaxes()", nFromAxes, "from coords");
+    detail::assertEqual(writer.getNaxes(), "writer.getNaxes()", nToAxes, "to coords");
+    if (chunkSize == 0) {
+        chunkSize = getTranChunkSize();
+    }
+    // One reader thread fills input buffers and one writer thread empties output buffers, for the whole
+    // stream, while this thread transforms. Buffers circulate between a queue of empty buffers and
+    // a queue of full ones, so the reader and writer each run at most N_STREAM_BUFFERS - 1 chunks ahead
+    // or behind. If any thread fails, it closes all the queues, which stops the others.
+    std::vector<Array2D> fromBufs, toBufs;
+    ChunkQueue emptyFrom, fullFrom, emptyTo, fullTo;
+    for (int i = 0; i < N_STREAM_BUFFERS; ++i) {
+        fromBufs.push_back(ndarray::allocate(chunkSize, nFromAxes));
+        toBufs.push_back(ndarray::allocate(chunkSize, nToAxes));
+        emptyFrom.push(StreamChunk{i, 0});
+        emptyTo.push(StreamChunk{i, 0});
+    }
+    std::exception_ptr readError, writeError;
+    std::thread readerThread, writerThread;
+    StreamThreadsGuard threadsGuard({&emptyFrom, &fullFrom, &emptyTo, &fullTo},
+                                    {&readerThread, &writerThread});
+    readerThread = std::thread([&] {
+        try {
+            StreamChunk chunk;
+            while (emptyFrom.pop(chunk)) {
+                chunk.nPts = reader.read(fromBufs[chunk.buffer]);
+                fullFrom.push(chunk);
+                if (chunk.nPts == 0) {
+                    break;
+                }
+            }
+        } catch (...) {
+            readError = std::current_exception();
+            threadsGuard.closeQueues();
+        }
+    });
+    writerThread = std::thread([&] {
+        try {
+            StreamChunk chunk;
+            while (fullTo.pop(chunk) && (chunk.nPts > 0)) {
+                writer.write(toBufs[chunk.buffer][ndarray::view(0, chunk.nPts)()]);
+                emptyTo.push(chunk);
+            }
+        } catch (...) {
+            writeError = std::current_exception();
+            threadsGuard.closeQueues();
+        }
+    });
+
+    std::size_t nTotal = 0;
+    StreamChunk fromChunk, toChunk;
+    while (fullFrom.pop(fromChunk) && (fromChunk.nPts > 0) && emptyTo.pop(toChunk)) {
+        toChunk.nPts = fromChunk.nPts;
+        _tran(fromBufs[fromChunk.buffer][ndarray::view(0, fromChunk.nPts)()], doForward,
+              toBufs[toChunk.buffer][ndarray::view(0, toChunk.nPts)()]);
+        nTotal += fromChunk.nPts;
+        emptyFrom.push(fromChunk);
+        fullTo.push(toChunk);
+    }
+    // let the writer finish the chunks it has been given before stopping everything
+    fullTo.push(StreamChunk{0, 0});
+    writerThread.join();
+    threadsGuard.stop();
+    if (readError) {
+        std::rethrow_exception(readError);
+    }
+    if (writeError) {
+        std::rethrow_exception(writeError);
+    }
+    return nTotal;
 }
 
 void Mapping::_tranGrid(
@@ -67,20 +909,199 @@ void Mapping::_tranGrid(
     double tol,
     int maxpix,
     bool doForward,
-    Array2D & to
+    StridedArray2D const & to
 ) const {
     int const nFromAxes = doForward ? getNin()  : getNout();
     int const nToAxes   = doForward ? getNout() : getNin();
     detail::assertEqual(lbnd.size(), "lbnd.size", nFromAxes, "from coords");
     detail::assertEqual(ubnd.size(), "ubnd.size", nFromAxes, "from coords");
     detail::assertEqual(to.getSize<1>(), "to.size[0]", nToAxes, "to coords");
-    int const nPts = to.getSize<0>();
-    Array2D toT = ndarray::allocate(ndarray::makeVector(nToAxes, nPts));
-    astTranGrid(getRawPtr(), nFromAxes, lbnd.data(), ubnd.data(),
-                tol, maxpix, static_cast<int>(doForward), nToAxes, nPts, toT.getData());
-    assertOK();
-    to.transpose() = toT;
-    detail::astBadToNan(to);
+    std::vector<std::size_t> extents(nFromAxes);
+    std::size_t nPts = 1;
+    for (int i = 0; i < nFromAxes; ++i) {
+        if (ubnd[i] < lbnd[i]) {
+            std::ostringstream os;
+            os << "ubnd[" << i << "] = " << ubnd[i] << " < lbnd[" << i << "] = " << lbnd[i];
+            throw std::invalid_argument(os.str());
+        }
+        extents[i] = static_cast<std::size_t>(ubnd[i] - lbnd[i]) + 1;
+        nPts *= extents[i];
+    }
+    detail::assertEqual(to.getSize<0>(), "to.size[0]", nPts, "number of grid points");
+    if ((nFromAxes > 1) && (nPts >= MIN_SEPARABLE_GRID_SIZE) &&
+        _tranGridSeparable(lbnd, ubnd, tol, maxpix, doForward, to)) {
+        return;
+    }
+    std::size_t const chunkSize = std::min(nPts, getTranChunkSize());
+
+    // The grid is transformed in blocks that each fit in one chunk. The first axis varies fastest,
+    // so a block that spans the full extent of the first splitAxis axes, a range of rows along splitAxis
+    // and a single value along each later axis is a contiguous range of grid points.
+    int splitAxis = 0;
+    std::size_t blockSize = 1;  // number of grid points spanned by the axes before splitAxis
+    while ((splitAxis < nFromAxes) && (blockSize * extents[splitAxis] <= chunkSize)) {
+        blockSize *= extents[splitAxis];
+        ++splitAxis;
+    }
+    std::size_t const rowsPerChunk = splitAxis < nFromAxes ? chunkSize / blockSize : 1;
+
+    std::size_t toStride = detail::getAxisMajorStride(to);
+    if (toStride > MAX_AST_SIZE) {
+        toStride = 0;
+    }
+    ScratchBuffer toT(toStride == 0 ? nToAxes * chunkSize : 0);
+    PointI chunkLbnd(lbnd);
+    PointI chunkUbnd(ubnd);
+    for (std::size_t start = 0; start < nPts; ) {
+        // set the bounds of the chunk starting at grid point `start`
+        std::size_t nChunk = blockSize;
+        std::size_t index = start / blockSize;
+        for (int i = splitAxis; i < nFromAxes; ++i) {
+            int const pos = lbnd[i] + static_cast<int>(index % extents[i]);
+            index /= extents[i];
+            if (i == splitAxis) {
+                std::size_t const nRows = std::min<std::size_t>(rowsPerChunk, ubnd[i] - pos + 1);
+                chunkLbnd[i] = pos;
+                chunkUbnd[i] = pos + static_cast<int>(nRows) - 1;
+                nChunk *= nRows;
+            } else {
+                chunkLbnd[i] = pos;
+                chunkUbnd[i] = pos;
+            }
+        }
+
+        double * toData = toStride == 0 ? toT.data() : to.getData() + start;
+        int const toDim = toStride == 0 ? chunkSize : toStride;
+        astTranGrid(getRawPtr(), nFromAxes, chunkLbnd.data(), chunkUbnd.data(),
+                    tol, maxpix, static_cast<int>(doForward), nToAxes, toDim, toData);
+        assertOK();
+        badToNan(toData, toDim, nToAxes, nChunk);
+        if (toStride == 0) {
+            detail::scatterAxisMajor(toData, chunkSize, start, nChunk, to);
+        }
+        start += nChunk;
+    }
+}
+
+bool Mapping::_tranGridSeparable(
+    PointI const & lbnd,
+    PointI const & ubnd,
+    double tol,
+    int maxpix,
+    bool doForward,
+    StridedArray2D const & to
+) const {
+    // MapSplit splits a mapping by its inputs, so the inverse direction uses the inverted mapping
+    std::shared_ptr<Mapping> inverse;
+    if (!doForward) {
+        inverse = getInverse();
+    }
+    Mapping const & map = doForward ? *this : *inverse;
+    int const nFromAxes = map.getNin();
+    int const nToAxes = map.getNout();
+
+    // Partition the input axes into groups that each feed their own outputs: first single axes,
+    // then pairs (such as the two sky axes of a spectral cube), then all the axes that remain
+    std::vector<std::unique_ptr<MapSplit>> groups;
+    std::vector<int> remaining;  // 1-based input axes not yet in a group
+    for (int i = 1; i <= nFromAxes; ++i) {
+        remaining.push_back(i);
+    }
+    for (int groupSize = 1; (groupSize <= 2) && (remaining.size() > 1); ++groupSize) {
+        for (std::size_t i = 0; i < remaining.size(); ) {
+            std::unique_ptr<MapSplit> split;
+            std::size_t j = i + 1;
+            if (groupSize == 1) {
+                split = trySplit(map, {remaining[i]});
+            } else {
+                for (; !split && (j < remaining.size()); ++j) {
+                    split = trySplit(map, {remaining[i], remaining[j]});
+                }
+                --j;
+            }
+            if (!split) {
+                ++i;
+                continue;
+            }
+            groups.push_back(std::move(split));
+            if (groupSize == 2) {
+                remaining.erase(remaining.begin() + j);
+            }
+            remaining.erase(remaining.begin() + i);
+        }
+    }
+    if (groups.empty()) {
+        return false;
+    }
+    if (!remaining.empty()) {
+        auto split = trySplit(map, remaining);
+        if (!split) {
+            return false;
+        }
+        groups.push_back(std::move(split));
+    }
+
+    // Every output must come from exactly one group (an output that depends on no input,
+    // such as a PermMap constant, belongs to none)
+    std::vector<int> nSources(nToAxes, 0);
+    for (auto const & group : groups) {
+        for (int out : group->origOut) {
+            ++nSources[out - 1];
+        }
+    }
+    if (std::any_of(nSources.begin(), nSources.end(), [](int n) { return n != 1; })) {
+        return false;
+    }
+
+    // Transform the sub-grid of each group, and record where each input axis appears in it
+    int const nGroups = groups.size();
+    std::vector<Array2D> subResults;
+    std::vector<int> axisGroup(nFromAxes);
+    std::vector<std::size_t> axisStride(nFromAxes);  // stride of the axis in its group's sub-grid
+    std::vector<std::size_t> extents(nFromAxes);
+    for (int g = 0; g < nGroups; ++g) {
+        MapSplit const & group = *groups[g];
+        PointI subLbnd, subUbnd;
+        std::size_t subSize = 1;
+        for (int in : group.origIn) {
+            int const axis = in - 1;
+            subLbnd.push_back(lbnd[axis]);
+            subUbnd.push_back(ubnd[axis]);
+            extents[axis] = static_cast<std::size_t>(ubnd[axis] - lbnd[axis]) + 1;
+            axisGroup[axis] = g;
+            axisStride[axis] = subSize;
+            subSize *= extents[axis];
+        }
+        Array2D subResult = ndarray::allocate(subSize, group.origOut.size());
+        group.splitMap->_tranGrid(subLbnd, subUbnd, tol, maxpix, true, subResult);
+        subResults.push_back(subResult);
+    }
+
+    // Broadcast the sub-grid results to the full grid, whose first axis varies fastest
+    std::size_t const nPts = to.getSize<0>();
+    std::ptrdiff_t const ptStride = to.getStrides()[0];
+    std::ptrdiff_t const axisStep = to.getStrides()[1];
+    std::vector<std::size_t> pos(nFromAxes, 0);
+    std::vector<std::size_t> subIndex(nGroups, 0);
+    for (std::size_t pt = 0; pt < nPts; ++pt) {
+        double * toPt = to.getData() + static_cast<std::ptrdiff_t>(pt) * ptStride;
+        for (int g = 0; g < nGroups; ++g) {
+            std::vector<int> const & origOut = groups[g]->origOut;
+            double const * subPt = subResults[g][subIndex[g]].getData();
+            for (std::size_t k = 0; k < origOut.size(); ++k) {
+                toPt[(origOut[k] - 1) * axisStep] = subPt[k];
+            }
+        }
+        for (int axis = 0; axis < nFromAxes; ++axis) {
+            subIndex[axisGroup[axis]] += axisStride[axis];
+            if (++pos[axis] < extents[axis]) {
+                break;
+            }
+            subIndex[axisGroup[axis]] -= extents[axis] * axisStride[axis];
+            pos[axis] = 0;
+        }
+    }
+    return true;
 }
 
 }  // namespace ast
@@ -19,9 +19,14 @@
  * the GNU General Public License along with this program.  If not, 
  * see <https://www.lsstcorp.org/LegalNotices/>.
  */
+#include <algorithm>
+#include <map>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "astshim/base.h"
 #include "astshim/Object.h"
@@ -42,8 +47,147 @@ extern "C" void sinkToOstream(const char *text) {
     (*osptr) << text << std::endl;
 }
 
+/**
+Walk the components of an object, adding the memory used by each to a MemoryReport
+*/
+class MemoryWalker {
+public:
+    explicit MemoryWalker(MemoryReport & report) : _report(report), _handles(), _unique() {}
+
+    ~MemoryWalker() {
+        for (AstObject * handle : _handles) {
+            astAnnul(handle);
+        }
+    }
+
+    MemoryWalker(MemoryWalker const &) = delete;
+    MemoryWalker & operator=(MemoryWalker const &) = delete;
+
+    /**
+    Add the memory used by an object and its components to the report, and return its ObjSize
+
+    Takes ownership of `obj`, which may be nullptr (e.g. a missing component).
+    */
+    std::size_t walk(AstObject * obj) {
+        if (!obj) {
+            return 0;
+        }
+        _handles.push_back(obj);
+        std::size_t const size = astGetI(obj, "ObjSize");
+        std::string const className = astGetC(obj, "Class");
+        assertOK();
+
+        // ObjSize includes the components, so subtract them to get the memory used by obj itself
+        std::size_t componentBytes = 0;
+        if (astIsAFrameSet(obj)) {
+            int const nFrame = astGetI(obj, "Nframe");
+            int const base = astGetI(obj, "Base");
+            assertOK();
+            for (int i = 1; i <= nFrame; ++i) {
+                componentBytes += walk(reinterpret_cast<AstObject *>(astGetFrame(obj, i)));
+            }
+            std::vector<AstObject *> leaves;  // simple mappings of this FrameSet already counted
+            for (int i = 1; i <= nFrame; ++i) {
+                if (i != base) {
+                    auto * map = astGetMapping(obj, base, i);
+                    assertOK();
+                    componentBytes += _walkLeaves(reinterpret_cast<AstObject *>(map), leaves);
+                }
+            }
+        } else if (astIsACmpMap(obj) || astIsATranMap(obj) || astIsACmpFrame(obj)) {
+            AstMapping * map1;
+            AstMapping * map2;
+            int series, invert1, invert2;
+            astDecompose(obj, &map1, &map2, &series, &invert1, &invert2);
+            assertOK();
+            componentBytes += walk(reinterpret_cast<AstObject *>(map1));
+            componentBytes += walk(reinterpret_cast<AstObject *>(map2));
+        }
+        bool const isNew = _isNew(obj, className, size);
+        _add(className, size > componentBytes ? size - componentBytes : 0, isNew, astIsAFrameSet(obj));
+        return size;
+    }
+
+private:
+    /**
+    Walk the simple mappings that make up one of a FrameSet's mappings, skipping any in `leaves`
+
+    Takes ownership of `map`; returns the total ObjSize of the simple mappings walked.
+    */
+    std::size_t _walkLeaves(AstObject * map, std::vector<AstObject *> & leaves) {
+        _handles.push_back(map);
+        if (astIsACmpMap(map)) {
+            AstMapping * map1;
+            AstMapping * map2;
+            int series, invert1, invert2;
+            astDecompose(map, &map1, &map2, &series, &invert1, &invert2);
+            assertOK();
+            std::size_t const bytes1 = _walkLeaves(reinterpret_cast<AstObject *>(map1), leaves);
+            return bytes1 + _walkLeaves(reinterpret_cast<AstObject *>(map2), leaves);
+        }
+        // UnitMaps are made by astGetMapping for frames that share a node
+        bool const isCounted = std::any_of(leaves.begin(), leaves.end(), [map](AstObject * leaf) {
+            return astSame(leaf, map);
+        });
+        if (isCounted || astIsAUnitMap(map)) {
+            return 0;
+        }
+        leaves.push_back(map);
+        return walk(reinterpret_cast<AstObject *>(astClone(map)));
+    }
+
+    /**
+    Is obj a different AST object from all those walked so far?
+
+    Each AST pointer is a separate handle (e.g. astDecompose returns a new one each time it is called),
+    so pointers cannot be compared; only objects of the same class and size can be the same,
+    so astSame is only called on those.
+    */
+    bool _isNew(AstObject * obj, std::string const & className, std::size_t size) {
+        std::vector<AstObject *> & candidates = _unique[std::make_pair(className, size)];
+        for (AstObject * other : candidates) {
+            if (astSame(other, obj)) {
+                return false;
+            }
+        }
+        candidates.push_back(obj);
+        return true;
+    }
+
+    void _add(std::string const & className, std::size_t bytes, bool isNew, bool isEstimate) {
+        MemoryUsage & usage = _report.byClass[className];
+        ++usage.nObjects;
+        usage.totalBytes += bytes;
+        usage.isEstimate = usage.isEstimate || isEstimate;
+        _report.totalBytes += bytes;
+        _report.isEstimate = _report.isEstimate || isEstimate;
+        if (isNew) {
+            ++usage.nUnique;
+            usage.uniqueBytes += bytes;
+            usage.largestBytes = std::max(usage.largestBytes, bytes);
+            _report.uniqueBytes += bytes;
+        }
+    }
+
+    MemoryReport & _report;
+    std::vector<AstObject *> _handles;  // AST pointers to annul when done
+    // one pointer to each distinct AST object walked, by class name and ObjSize
+    std::map<std::pair<std::string, std::size_t>, std::vector<AstObject *>> _unique;
+};
+
 } // anonymous namespace
 
+MemoryReport Object::memoryReport() const {
+    MemoryReport report;
+    {
+        MemoryWalker walker(report);
+        walker.walk(reinterpret_cast<AstObject *>(astClone(getRawPtr())));
+    }
+    assertOK();
+    report.sharedBytes = report.totalBytes - report.uniqueBytes;
+    return report;
+}
+
 void Object::show(std::ostream & os) const {
 
     auto ch = astChannel(nullptr, sinkToOstream, "");
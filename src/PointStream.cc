@@ -0,0 +1,178 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/PointStream.h"
+
+namespace ast {
+
+namespace {
+
+void assertNaxes(Array2D const & points, int nAxes) {
+    detail::assertEqual(points.getSize<1>(), "points.size[1]", nAxes, "nAxes");
+}
+
+std::string formatErrno(std::string const & msg, std::string const & path) {
+    std::ostringstream os;
+    os << msg << " \"" << path << "\": " << std::strerror(errno);
+    return os.str();
+}
+
+}  // anonymous namespace
+
+PointReader::PointReader(int nAxes) : _nAxes(nAxes) {
+    if (nAxes < 1) {
+        std::ostringstream os;
+        os << "nAxes = " << nAxes << " < 1";
+        throw std::invalid_argument(os.str());
+    }
+}
+
+PointWriter::PointWriter(int nAxes) : _nAxes(nAxes) {
+    if (nAxes < 1) {
+        std::ostringstream os;
+        os << "nAxes = " << nAxes << " < 1";
+        throw std::invalid_argument(os.str());
+    }
+}
+
+std::size_t IStreamPointReader::read(Array2D const & points) {
+    assertNaxes(points, getNaxes());
+    std::size_t const pointSize = sizeof(double) * getNaxes();
+    _istream.read(reinterpret_cast<char *>(points.getData()), points.getSize<0>() * pointSize);
+    if (_istream.bad()) {
+        throw std::runtime_error("Error reading points from stream");
+    }
+    std::size_t const nBytes = _istream.gcount();
+    if (nBytes % pointSize != 0) {
+        std::ostringstream os;
+        os << "Stream ended part way through a point: read " << nBytes
+           << " bytes, which is not a multiple of " << pointSize;
+        throw std::runtime_error(os.str());
+    }
+    return nBytes / pointSize;
+}
+
+MmapPointReader::MmapPointReader(std::string const & path, int nAxes) :
+    PointReader(nAxes),
+    _path(path),
+    _data(nullptr),
+    _nPts(0),
+    _nextPt(0)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(formatErrno("Failed to open file", path));
+    }
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        throw std::runtime_error(formatErrno("Failed to stat file", path));
+    }
+    std::size_t const nBytes = fileStat.st_size;
+    std::size_t const pointSize = sizeof(double) * nAxes;
+    if (nBytes % pointSize != 0) {
+        ::close(fd);
+        std::ostringstream os;
+        os << "File \"" << path << "\" has " << nBytes << " bytes, which is not a whole number of "
+           << nAxes << "-axis points";
+        throw std::runtime_error(os.str());
+    }
+    _nPts = nBytes / pointSize;
+    if (nBytes > 0) {
+        void * data = ::mmap(nullptr, nBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error(formatErrno("Failed to memory-map file", path));
+        }
+        _data = data;
+        // the file is read once from start to end, so let the kernel read ahead and drop old pages
+        ::madvise(_data, nBytes, MADV_SEQUENTIAL);
+    }
+    // the mapping remains valid after the file descriptor is closed
+    ::close(fd);
+}
+
+MmapPointReader::~MmapPointReader() {
+    if (_data) {
+        ::munmap(_data, _nPts * sizeof(double) * getNaxes());
+    }
+}
+
+std::size_t MmapPointReader::read(Array2D const & points) {
+    assertNaxes(points, getNaxes());
+    std::size_t const nRead = std::min<std::size_t>(points.getSize<0>(), _nPts - _nextPt);
+    if (nRead > 0) {
+        double const * src = reinterpret_cast<double const *>(_data) + _nextPt * getNaxes();
+        std::copy(src, src + nRead * getNaxes(), points.getData());
+        _nextPt += nRead;
+    }
+    return nRead;
+}
+
+void OStreamPointWriter::write(Array2D const & points) {
+    assertNaxes(points, getNaxes());
+    _ostream.write(reinterpret_cast<char const *>(points.getData()),
+                   points.getSize<0>() * sizeof(double) * getNaxes());
+    if (!_ostream) {
+        throw std::runtime_error("Error writing points to stream");
+    }
+}
+
+FilePointWriter::FilePointWriter(std::string const & path, int nAxes) :
+    PointWriter(nAxes),
+    _path(path),
+    _ofstream(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc)
+{
+    if (!_ofstream) {
+        std::ostringstream os;
+        os << "Failed to open file \"" << path << "\" for writing";
+        throw std::runtime_error(os.str());
+    }
+}
+
+void FilePointWriter::write(Array2D const & points) {
+    assertNaxes(points, getNaxes());
+    _ofstream.write(reinterpret_cast<char const *>(points.getData()),
+                    points.getSize<0>() * sizeof(double) * getNaxes());
+    // flush so the data is on disk once tranStream returns, even if this writer lives on
+    _ofstream.flush();
+    if (!_ofstream) {
+        std::ostringstream os;
+        os << "Error writing points to file \"" << _path << "\"";
+        throw std::runtime_error(os.str());
+    }
+}
+
+}  // namespace ast
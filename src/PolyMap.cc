@@ -0,0 +1,389 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/detail/threads.h"
+#include "astshim/PolyMap.h"
+
+namespace ast {
+
+namespace {
+
+// Identifies a call to astPolyTran by the hash and length of a description of the PolyMap and arguments
+typedef std::pair<std::size_t, std::size_t> Fingerprint;
+
+/**
+A PolyMap made by astPolyTran, kept unlocked so any thread may lock it
+*/
+class PolyTranResult {
+public:
+    PolyTranResult(AstPolyMap * polyMap, std::string const & description) :
+        polyMap(polyMap), description(description)
+    {
+        astUnlock(polyMap, 0);
+    }
+
+    ~PolyTranResult() {
+        astLock(polyMap, 1);
+        astAnnul(polyMap);
+    }
+
+    PolyTranResult(PolyTranResult const &) = delete;
+    PolyTranResult & operator=(PolyTranResult const &) = delete;
+
+    AstPolyMap * const polyMap;
+    // the request it answers (see describePolyTran), to tell a match from a fingerprint collision
+    std::string const description;
+};
+
+// Results cached by PolyMap::polyTran, shared by all threads
+class PolyTranCache {
+public:
+    PolyTranCache() : mutex(), maxEntries(0), dir(), entries(), index() {}
+
+    // Discard the least recently used results until there are no more than maxEntries
+    void trim() {
+        while (entries.size() > maxEntries) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    typedef std::list<std::pair<Fingerprint, std::shared_ptr<PolyTranResult const>>> EntryList;
+
+    std::mutex mutex;
+    std::size_t maxEntries;
+    std::string dir;
+    EntryList entries;  // most recently used first
+    std::map<Fingerprint, EntryList::iterator> index;
+};
+
+PolyTranCache & getPolyTranCache() {
+    // never destroyed, so that it may be used until the program exits
+    static PolyTranCache * cache = new PolyTranCache();
+    return *cache;
+}
+
+/**
+Describe a call to astPolyTran: the description of the PolyMap followed by the arguments
+*/
+std::string describePolyTran(PolyMap const & polyMap, bool forward, double acc, double maxacc, int maxorder,
+                             std::vector<double> const & lbnd, std::vector<double> const & ubnd) {
+    std::ostringstream os;
+    os << polyMap.show();
+    os << std::setprecision(17) << "polyTran forward=" << forward << " acc=" << acc << " maxacc=" << maxacc
+       << " maxorder=" << maxorder << " lbnd=";
+    for (double val : lbnd) {
+        os << val << " ";
+    }
+    os << "ubnd=";
+    for (double val : ubnd) {
+        os << val << " ";
+    }
+    os << "\n";
+    return os.str();
+}
+
+std::string getCachePath(std::string const & dir, Fingerprint const & fingerprint) {
+    std::ostringstream os;
+    os << dir << "/polyTran-" << std::hex << std::setfill('0') << std::setw(16) << fingerprint.first
+       << "-" << fingerprint.second << ".ast";
+    return os.str();
+}
+
+/**
+Read a result from a file written by writeCacheFile; return nullptr if there is none for `description`
+
+A cache file holds the length of the description on the first line, then the description,
+then the result as written by astToString.
+*/
+AstPolyMap * readCacheFile(std::string const & path, std::string const & description) {
+    std::ifstream is(path);
+    std::size_t length = 0;
+    if (!(is >> length) || (length != description.size()) || (is.get() != '\n')) {
+        return nullptr;
+    }
+    std::string fileDescription(length, '\0');
+    if (!is.read(&fileDescription[0], length) || (fileDescription != description)) {
+        return nullptr;
+    }
+    std::string const text((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    auto * rawObj = reinterpret_cast<AstObject *>(astFromString(text.c_str()));
+    if (!astOK) {
+        // an unreadable file is not an error: the result is computed again
+        astClearStatus;
+        return nullptr;
+    }
+    if (!rawObj || !astIsAPolyMap(rawObj)) {
+        if (rawObj) {
+            astAnnul(rawObj);
+        }
+        return nullptr;
+    }
+    return reinterpret_cast<AstPolyMap *>(rawObj);
+}
+
+/**
+Save a result in a cache file; failures are ignored, as the file is only an optimization
+*/
+void writeCacheFile(std::string const & path, std::string const & description, AstPolyMap * polyMap) {
+    char * rawText = astToString(polyMap);
+    if (!astOK) {
+        astClearStatus;
+        return;
+    }
+    std::string const text(rawText);
+    astFree(rawText);
+
+    // write under a name no other thread or process uses, then rename, so readers never see part of a file
+    std::random_device random;
+    std::ostringstream tempPath;
+    tempPath << path << ".tmp" << std::hex << random() << random();
+    {
+        std::ofstream os(tempPath.str());
+        os << description.size() << "\n" << description << text;
+        if (!os) {
+            os.close();
+            std::remove(tempPath.str().c_str());
+            return;
+        }
+    }
+    if (std::rename(tempPath.str().c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.str().c_str());
+    }
+}
+
+}  // anonymous namespace
+
+std::size_t getPolyTranCacheSize() {
+    PolyTranCache & cache = getPolyTranCache();
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    return cache.maxEntries;
+}
+
+void setPolyTranCacheSize(std::size_t maxEntries) {
+    PolyTranCache & cache = getPolyTranCache();
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    cache.maxEntries = maxEntries;
+    cache.trim();
+}
+
+void clearPolyTranCache() {
+    PolyTranCache & cache = getPolyTranCache();
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    cache.index.clear();
+    cache.entries.clear();
+}
+
+std::string getPolyTranCacheDir() {
+    PolyTranCache & cache = getPolyTranCache();
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    return cache.dir;
+}
+
+void setPolyTranCacheDir(std::string const & dir) {
+    PolyTranCache & cache = getPolyTranCache();
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    cache.dir = dir;
+}
+
+PolyMap PolyMap::polyTran(
+    bool forward,
+    double acc,
+    double maxacc,
+    int maxorder,
+    std::vector<double> const & lbnd,
+    std::vector<double> const & ubnd
+) {
+    auto const desSize = static_cast<std::size_t>(forward ? getNin() : getNout());
+    if (lbnd.size() != desSize) {
+        std::ostringstream os;
+        os << "lbnd.size() = " << lbnd.size() << " != " << desSize
+            << " = " << (forward ? "getNin()" : "getNout()");
+        throw std::invalid_argument(os.str());
+    }
+    if (ubnd.size() != desSize) {
+        std::ostringstream os;
+        os << "ubnd.size() = " << ubnd.size() << " != " << desSize
+            << " = " << (forward ? "getNin()" : "getNout()");
+        throw std::invalid_argument(os.str());
+    }
+
+    PolyTranCache & cache = getPolyTranCache();
+    std::size_t maxEntries;
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        maxEntries = cache.maxEntries;
+        dir = cache.dir;
+    }
+    if ((maxEntries == 0) && dir.empty()) {
+        void * map = astPolyTran(this->getRawPtr(), static_cast<int>(forward), acc, maxacc, maxorder,
+                                 lbnd.data(), ubnd.data());
+        return PolyMap(reinterpret_cast<AstPolyMap *>(map));
+    }
+
+    std::string const description = describePolyTran(*this, forward, acc, maxacc, maxorder, lbnd, ubnd);
+    Fingerprint const key(std::hash<std::string>()(description), description.size());
+    std::shared_ptr<PolyTranResult const> result;
+    if (maxEntries > 0) {
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        auto const it = cache.index.find(key);
+        if ((it != cache.index.end()) && (it->second->second->description == description)) {
+            cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+            result = it->second->second;
+        }
+    }
+    if (!result) {
+        std::string const path = dir.empty() ? "" : getCachePath(dir, key);
+        AstPolyMap * rawPolyMap = path.empty() ? nullptr : readCacheFile(path, description);
+        if (!rawPolyMap) {
+            rawPolyMap = reinterpret_cast<AstPolyMap *>(astPolyTran(
+                this->getRawPtr(), static_cast<int>(forward), acc, maxacc, maxorder, lbnd.data(),
+                ubnd.data()));
+            assertOK(reinterpret_cast<AstObject *>(rawPolyMap));
+            if (!path.empty()) {
+                writeCacheFile(path, description, rawPolyMap);
+            }
+        }
+        result = std::make_shared<PolyTranResult const>(rawPolyMap, description);
+
+        std::lock_guard<std::mutex> guard(cache.mutex);
+        auto const it = cache.index.find(key);
+        if ((it != cache.index.end()) && (it->second->second->description != description)) {
+            // requests whose fingerprints collide: keep the latest
+            cache.entries.erase(it->second);
+            cache.index.erase(it);
+        }
+        if ((cache.maxEntries > 0) && (cache.index.count(key) == 0)) {
+            cache.entries.emplace_front(key, result);
+            cache.index[key] = cache.entries.begin();
+            cache.trim();
+        }
+    }
+
+    astLock(result->polyMap, 1);
+    auto * rawCopy = reinterpret_cast<AstPolyMap *>(astCopy(result->polyMap));
+    astUnlock(result->polyMap, 0);
+    assertOK();
+    return PolyMap(rawCopy);
+}
+
+std::vector<std::shared_ptr<PolyMap>> PolyMap::polyTrans(
+    std::vector<std::shared_ptr<PolyMap>> const & polyMaps,
+    bool forward,
+    double acc,
+    double maxacc,
+    int maxorder,
+    std::vector<double> const & lbnd,
+    std::vector<double> const & ubnd,
+    int nThreads
+) {
+    // fit each distinct PolyMap once
+    std::vector<std::size_t> firstIndex(polyMaps.size());  // index of the first PolyMap with the same content
+    std::vector<std::size_t> distinct;
+    {
+        std::map<std::string, std::size_t> seen;
+        for (std::size_t i = 0; i < polyMaps.size(); ++i) {
+            auto const inserted = seen.emplace(polyMaps[i]->show(), i);
+            firstIndex[i] = inserted.first->second;
+            if (inserted.second) {
+                distinct.push_back(i);
+            }
+        }
+    }
+    std::size_t const nDistinct = distinct.size();
+    std::vector<std::shared_ptr<PolyMap>> fits(nDistinct);
+    nThreads = detail::getNumThreads(nThreads, nDistinct);
+    if (nThreads == 1) {
+        for (std::size_t j = 0; j < nDistinct; ++j) {
+            fits[j] = std::make_shared<PolyMap>(
+                polyMaps[distinct[j]]->polyTran(forward, acc, maxacc, maxorder, lbnd, ubnd));
+        }
+    } else {
+        // AST objects may only be used by the thread that has locked them, so each worker thread locks
+        // a copy made (and unlocked) by this thread, and unlocks the PolyMap it makes;
+        // this thread locks them all again once the workers are done
+        std::vector<std::shared_ptr<PolyMap>> copies;
+        copies.reserve(nDistinct);
+        for (std::size_t i : distinct) {
+            copies.push_back(polyMaps[i]->copy());
+            copies.back()->unlock();
+        }
+        auto relockAll = [&copies, &fits]() {
+            for (auto & copy : copies) {
+                copy->lock(true);
+            }
+            for (auto & fit : fits) {
+                if (fit) {
+                    fit->lock(true);
+                }
+            }
+        };
+        try {
+            detail::parallelFor(nThreads, nDistinct, [&](int, std::size_t j) {
+                copies[j]->lock(true);
+                try {
+                    auto fit = std::make_shared<PolyMap>(
+                        copies[j]->polyTran(forward, acc, maxacc, maxorder, lbnd, ubnd));
+                    fit->unlock();
+                    fits[j] = fit;
+                } catch (...) {
+                    copies[j]->unlock();
+                    throw;
+                }
+                copies[j]->unlock();
+            });
+        } catch (...) {
+            relockAll();
+            throw;
+        }
+        relockAll();
+    }
+
+    std::vector<std::shared_ptr<PolyMap>> result(polyMaps.size());
+    std::vector<std::size_t> fitIndex(polyMaps.size());
+    for (std::size_t j = 0; j < nDistinct; ++j) {
+        fitIndex[distinct[j]] = j;
+    }
+    for (std::size_t i = 0; i < polyMaps.size(); ++i) {
+        auto const & fit = fits[fitIndex[firstIndex[i]]];
+        result[i] = firstIndex[i] == i ? fit : fit->copy();
+    }
+    return result;
+}
+
+}  // namespace ast
@@ -0,0 +1,315 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/threads.h"
+#include "astshim/MapBox.h"
+#include "astshim/Mapping.h"
+#include "astshim/Rebinner.h"
+#include "astshim/UnitMap.h"
+
+namespace ast {
+
+namespace {
+
+double const BADVAL = -std::numeric_limits<double>::max();
+
+// A partial accumulator covering the output footprint of one input image
+struct Accumulator {
+    std::vector<double> image;
+    std::vector<double> variance;
+    std::vector<double> weights;
+    std::int64_t nused;
+};
+
+/// Return the AST flags for astRebinSeq, excluding AST__REBININIT and AST__REBINEND
+int getFlags(RebinControl const & ctrl, bool useVariance) {
+    int flags = AST__USEBAD;
+    if (ctrl.conserveFlux) {
+        flags |= AST__CONSERVEFLUX;
+    }
+    if (ctrl.genVariance) {
+        flags |= AST__GENVAR;
+    } else if (useVariance) {
+        flags |= AST__USEVAR;
+    }
+    if (ctrl.varianceWeight) {
+        flags |= AST__VARWGT;
+    }
+    return flags;
+}
+
+/// Return the kernel parameters, padded with zeros (which select AST's defaults)
+std::vector<double> getParams(RebinControl const & ctrl) {
+    std::vector<double> params(ctrl.params);
+    params.resize(std::max<std::size_t>(params.size(), 4), 0.0);
+    return params;
+}
+
+/// Return how many output pixels beyond an input pixel's footprint the spreading kernel may reach
+int getKernelPad(RebinControl const & ctrl) {
+    switch (ctrl.kernel) {
+        case ResampleKernel::NEAREST:
+            return 1;
+        case ResampleKernel::LINEAR:
+            return 2;
+        default:
+            // the other kernels extend params[0] pixels either side, with a default of 2
+            double const halfWidth = ctrl.params.empty() ? 0.0 : ctrl.params[0];
+            return static_cast<int>(std::ceil(std::max(halfWidth, 2.0))) + 1;
+    }
+}
+
+}  // anonymous namespace
+
+Rebinner::Rebinner(std::vector<int> const & lbnd, std::vector<int> const & ubnd, RebinControl const & ctrl)
+        : _lbnd(lbnd), _ubnd(ubnd), _ctrl(ctrl), _width(0), _height(0), _nImages(0),
+          _inputVariance(false), _nused(0), _image(), _variance(), _weights() {
+    detail::assertEqual(lbnd.size(), "lbnd.size()", 2, "number of image axes");
+    detail::assertEqual(ubnd.size(), "ubnd.size()", 2, "number of image axes");
+    for (int i = 0; i < 2; ++i) {
+        if (ubnd[i] < lbnd[i]) {
+            std::ostringstream os;
+            os << "ubnd[" << i << "] = " << ubnd[i] << " < lbnd[" << i << "] = " << lbnd[i];
+            throw std::invalid_argument(os.str());
+        }
+    }
+    if (ctrl.tileSize < 1) {
+        std::ostringstream os;
+        os << "ctrl.tileSize = " << ctrl.tileSize << " < 1";
+        throw std::invalid_argument(os.str());
+    }
+    _width = ubnd[0] - lbnd[0] + 1;
+    _height = ubnd[1] - lbnd[1] + 1;
+    reset();
+}
+
+void Rebinner::add(Mapping const & map, ndarray::Array<double const, 2, 2> const & image,
+                   ndarray::Array<double const, 2, 2> const & variance, std::vector<int> const & lbnd) {
+    add(map, image, variance, ndarray::Array<int const, 2, 2>(), lbnd);
+}
+
+void Rebinner::add(Mapping const & map, ndarray::Array<double const, 2, 2> const & image,
+                   ndarray::Array<double const, 2, 2> const & variance,
+                   ndarray::Array<int const, 2, 2> const & mask, std::vector<int> const & lbnd) {
+    detail::assertEqual(map.getNin(), "map.getNin()", 2, "number of image axes");
+    detail::assertEqual(map.getNout(), "map.getNout()", 2, "number of image axes");
+    detail::assertEqual(lbnd.size(), "lbnd.size()", 2, "number of image axes");
+    if (!variance.isEmpty() && (variance.getShape() != image.getShape())) {
+        throw std::invalid_argument("variance and image shapes differ");
+    }
+    if (!mask.isEmpty() && (mask.getShape() != image.getShape())) {
+        throw std::invalid_argument("mask and image shapes differ");
+    }
+    bool const useVariance = !variance.isEmpty();
+    if (_ctrl.varianceWeight && !useVariance) {
+        throw std::invalid_argument("variance must be provided when ctrl.varianceWeight is true");
+    }
+    if (!_ctrl.genVariance && (_nImages > 0) && (useVariance != _inputVariance)) {
+        throw std::invalid_argument(
+                "variance must be provided for all images or none, unless ctrl.genVariance is true");
+    }
+    int const width = image.getSize<1>();
+    int const height = image.getSize<0>();
+    if ((width == 0) || (height == 0)) {
+        return;
+    }
+
+    // find the region of the output that this image can contribute to
+    int const pad = getKernelPad(_ctrl);
+    MapBox const mapBox(map, {lbnd[0] - 0.5, lbnd[1] - 0.5},
+                        {lbnd[0] + width - 0.5, lbnd[1] + height - 0.5});
+    int footLbnd[2];
+    int footUbnd[2];
+    for (int i = 0; i < 2; ++i) {
+        footLbnd[i] = std::max(static_cast<double>(_lbnd[i]), std::floor(mapBox.lbndOut[i] + 0.5) - pad);
+        footUbnd[i] = std::min(static_cast<double>(_ubnd[i]), std::ceil(mapBox.ubndOut[i] - 0.5) + pad);
+    }
+    if (!_ctrl.genVariance && useVariance && _variance.empty()) {
+        _variance.assign(_image.size(), 0.0);
+    }
+    _inputVariance = useVariance;
+    ++_nImages;
+    if ((footUbnd[0] < footLbnd[0]) || (footUbnd[1] < footLbnd[1])) {
+        return;
+    }
+    std::size_t const footWidth = footUbnd[0] - footLbnd[0] + 1;
+    std::size_t const footHeight = footUbnd[1] - footLbnd[1] + 1;
+    std::size_t const footPix = footWidth * footHeight;
+    std::size_t const nWeights = _weights.size() / _image.size();
+
+    auto const in = detail::markBadPixels(image, mask, _ctrl.badMask, BADVAL);
+    ndarray::Array<double const, 2, 2> inVar;
+    if (useVariance) {
+        inVar = detail::markBadPixels(variance, mask, _ctrl.badMask, BADVAL);
+    }
+    int const lbndIn[2] = {lbnd[0], lbnd[1]};
+    int const ubndIn[2] = {lbnd[0] + width - 1, lbnd[1] + height - 1};
+    auto const params = getParams(_ctrl);
+    int const flags = getFlags(_ctrl, useVariance);
+
+    // rebin contiguous groups of tiles into partial accumulators, one group per thread
+    int const nTilesX = (width + _ctrl.tileSize - 1) / _ctrl.tileSize;
+    int const nTilesY = (height + _ctrl.tileSize - 1) / _ctrl.tileSize;
+    std::size_t const nTiles = static_cast<std::size_t>(nTilesX) * nTilesY;
+    int const nThreads = detail::getNumThreads(_ctrl.nThreads, nTiles);
+    detail::ThreadCopies copies(map.getRawPtr(), nThreads);
+    std::vector<Accumulator> partials(nThreads);
+    detail::parallelFor(nThreads, nThreads, [&](int threadIndex, std::size_t group) {
+        // allocate (and so first touch) the partial accumulator on the thread that fills it
+        Accumulator & acc = partials[group];
+        acc.image.assign(footPix, 0.0);
+        acc.variance.assign(_variance.empty() ? 0 : footPix, 0.0);
+        acc.weights.assign(nWeights * footPix, 0.0);
+        acc.nused = 0;
+        auto tileMap = reinterpret_cast<AstMapping *>(copies.lock(threadIndex));
+        try {
+            for (std::size_t tile = group * nTiles / nThreads, end = (group + 1) * nTiles / nThreads;
+                 tile < end; ++tile) {
+                int const x0 = (tile % nTilesX) * _ctrl.tileSize;
+                int const y0 = (tile / nTilesX) * _ctrl.tileSize;
+                int const tileLbnd[2] = {lbndIn[0] + x0, lbndIn[1] + y0};
+                int const tileUbnd[2] = {lbndIn[0] + std::min(x0 + _ctrl.tileSize, width) - 1,
+                                         lbndIn[1] + std::min(y0 + _ctrl.tileSize, height) - 1};
+                astRebinSeqD(tileMap, _ctrl.wlim, 2, lbndIn, ubndIn, in.getData(),
+                             useVariance ? inVar.getData() : nullptr, static_cast<int>(_ctrl.kernel),
+                             params.data(), flags, _ctrl.tol, _ctrl.maxpix, BADVAL, 2, footLbnd, footUbnd,
+                             tileLbnd, tileUbnd, acc.image.data(),
+                             acc.variance.empty() ? nullptr : acc.variance.data(), acc.weights.data(),
+                             &acc.nused);
+                assertOK();
+            }
+        } catch (...) {
+            copies.unlock(threadIndex);
+            throw;
+        }
+        copies.unlock(threadIndex);
+    });
+
+    // add the partial accumulators to the output in group order, sharing the rows among threads
+    std::size_t const nPix = _image.size();
+    std::size_t const nRows = nWeights * footHeight;
+    detail::parallelFor(detail::getNumThreads(_ctrl.nThreads, nRows), nRows, [&](int, std::size_t row) {
+        std::size_t const plane = row / footHeight;
+        std::size_t const y = row % footHeight;
+        std::size_t const footStart = plane * footPix + y * footWidth;
+        std::size_t const start = plane * nPix + (footLbnd[1] - _lbnd[1] + y) * _width +
+                                  (footLbnd[0] - _lbnd[0]);
+        for (auto const & acc : partials) {
+            for (std::size_t x = 0; x < footWidth; ++x) {
+                _weights[start + x] += acc.weights[footStart + x];
+            }
+            if (plane > 0) {
+                continue;
+            }
+            for (std::size_t x = 0; x < footWidth; ++x) {
+                _image[start + x] += acc.image[footStart + x];
+            }
+            if (!_variance.empty()) {
+                for (std::size_t x = 0; x < footWidth; ++x) {
+                    _variance[start + x] += acc.variance[footStart + x];
+                }
+            }
+        }
+    });
+    for (auto const & acc : partials) {
+        _nused += acc.nused;
+    }
+}
+
+int Rebinner::finish(ndarray::Array<double, 2, 2> const & image,
+                     ndarray::Array<double, 2, 2> const & variance) const {
+    detail::assertEqual(image.getSize<0>(), "image height", _height, "output height");
+    detail::assertEqual(image.getSize<1>(), "image width", _width, "output width");
+    if (!variance.isEmpty()) {
+        if (!hasVariance()) {
+            throw std::invalid_argument("variance was requested but is not being accumulated");
+        }
+        if (variance.getShape() != image.getShape()) {
+            throw std::invalid_argument("variance and image shapes differ");
+        }
+    }
+    std::copy(_image.begin(), _image.end(), image.getData());
+    std::vector<double> varianceBuffer;
+    double * outVar = nullptr;
+    if (hasVariance()) {
+        if (variance.isEmpty()) {
+            varianceBuffer = _variance;
+            outVar = varianceBuffer.data();
+        } else {
+            std::copy(_variance.begin(), _variance.end(), variance.getData());
+            outVar = variance.getData();
+        }
+    }
+    std::vector<double> weights(_weights);
+    std::int64_t nused = _nused;
+    auto const params = getParams(_ctrl);
+    int const flags = getFlags(_ctrl, _inputVariance) | AST__REBINEND;
+
+    // with no input data astRebinSeq just normalizes the accumulators; the mapping is not used
+    UnitMap const unitMap(2);
+    int const lbnd[2] = {_lbnd[0], _lbnd[1]};
+    int const ubnd[2] = {_ubnd[0], _ubnd[1]};
+    astRebinSeqD(unitMap.getRawPtr(), _ctrl.wlim, 2, lbnd, ubnd, nullptr, nullptr,
+                 static_cast<int>(_ctrl.kernel), params.data(), flags, _ctrl.tol, _ctrl.maxpix, BADVAL, 2,
+                 lbnd, ubnd, lbnd, ubnd, image.getData(), outVar, weights.data(), &nused);
+    assertOK();
+
+    int nBad = 0;
+    double * imageData = image.getData();
+    for (std::size_t i = 0; i < _image.size(); ++i) {
+        if (imageData[i] == BADVAL) {
+            imageData[i] = std::numeric_limits<double>::quiet_NaN();
+            ++nBad;
+        }
+    }
+    if (!variance.isEmpty()) {
+        double * varianceData = variance.getData();
+        for (std::size_t i = 0; i < _image.size(); ++i) {
+            if (varianceData[i] == BADVAL) {
+                varianceData[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+    return nBad;
+}
+
+void Rebinner::reset() {
+    std::size_t const nPix = static_cast<std::size_t>(_width) * _height;
+    _nImages = 0;
+    _inputVariance = false;
+    _nused = 0;
+    _image.assign(nPix, 0.0);
+    _variance.assign(_ctrl.genVariance ? nPix : 0, 0.0);
+    _weights.assign(_ctrl.genVariance ? 2 * nPix : nPix, 0.0);
+}
+
+}  // namespace ast
@@ -0,0 +1,234 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/threads.h"
+#include "astshim/Mapping.h"
+#include "astshim/Resample.h"
+
+namespace ast {
+
+namespace {
+
+int callResample(AstMapping * map, int const lbndIn[], int const ubndIn[], double const * in,
+                 double const * inVar, int interp, double const * params, int flags, double tol, int maxpix,
+                 double badval, int const lbndOut[], int const ubndOut[], int const lbnd[], int const ubnd[],
+                 double * out, double * outVar) {
+    return astResampleD(map, 2, lbndIn, ubndIn, in, inVar, interp, nullptr, params, flags, tol, maxpix,
+                        badval, 2, lbndOut, ubndOut, lbnd, ubnd, out, outVar);
+}
+
+int callResample(AstMapping * map, int const lbndIn[], int const ubndIn[], float const * in,
+                 float const * inVar, int interp, double const * params, int flags, double tol, int maxpix,
+                 float badval, int const lbndOut[], int const ubndOut[], int const lbnd[], int const ubnd[],
+                 float * out, float * outVar) {
+    return astResampleF(map, 2, lbndIn, ubndIn, in, inVar, interp, nullptr, params, flags, tol, maxpix,
+                        badval, 2, lbndOut, ubndOut, lbnd, ubnd, out, outVar);
+}
+
+template <typename T1, typename T2>
+void assertSameShape(ndarray::Array<T1, 2, 2> const & arr, std::string const & arrName,
+                     ndarray::Array<T2, 2, 2> const & image, std::string const & imageName) {
+    if (!arr.isEmpty() && (arr.getShape() != image.getShape())) {
+        std::ostringstream os;
+        os << arrName << " shape = (" << arr.template getSize<0>() << ", " << arr.template getSize<1>()
+           << ") != " << imageName << " shape = (" << image.template getSize<0>() << ", "
+           << image.template getSize<1>() << ")";
+        throw std::invalid_argument(os.str());
+    }
+}
+
+template <typename T>
+int resampleImpl(Mapping const & map, ndarray::Array<T const, 2, 2> const & srcImage,
+                 ndarray::Array<T const, 2, 2> const & srcVariance,
+                 ndarray::Array<int const, 2, 2> const & srcMask, std::vector<int> const & srcLbnd,
+                 ndarray::Array<T, 2, 2> const & dstImage, ndarray::Array<T, 2, 2> const & dstVariance,
+                 ndarray::Array<int, 2, 2> const & dstMask, std::vector<int> const & dstLbnd,
+                 ResampleControl const & ctrl) {
+    detail::assertEqual(map.getNin(), "getNin()", 2, "number of image axes");
+    detail::assertEqual(map.getNout(), "getNout()", 2, "number of image axes");
+    detail::assertEqual(srcLbnd.size(), "srcLbnd.size()", 2, "number of image axes");
+    detail::assertEqual(dstLbnd.size(), "dstLbnd.size()", 2, "number of image axes");
+    assertSameShape(srcVariance, "srcVariance", srcImage, "srcImage");
+    assertSameShape(srcMask, "srcMask", srcImage, "srcImage");
+    assertSameShape(dstVariance, "dstVariance", dstImage, "dstImage");
+    assertSameShape(dstMask, "dstMask", dstImage, "dstImage");
+    if (srcVariance.isEmpty() != dstVariance.isEmpty()) {
+        throw std::invalid_argument("srcVariance and dstVariance must both be provided or both be empty");
+    }
+    if (ctrl.tileSize < 1) {
+        std::ostringstream os;
+        os << "ctrl.tileSize = " << ctrl.tileSize << " < 1";
+        throw std::invalid_argument(os.str());
+    }
+    bool const useVariance = !srcVariance.isEmpty();
+    // AST also marks destination pixels that receive no data with badval, so it must differ from every
+    // source pixel, or a genuine value (e.g. copied by the nearest neighbour kernel) would become NaN
+    T const badval = detail::chooseBadValue<T>({srcImage, srcVariance});
+
+    auto const in = detail::markBadPixels(srcImage, srcMask, ctrl.badMask, badval);
+    ndarray::Array<T const, 2, 2> inVar;
+    if (useVariance) {
+        inVar = detail::markBadPixels(srcVariance, srcMask, ctrl.badMask, badval);
+    }
+    // markBadPixels only copies a plane that has bad pixels, and AST need only look for them if it did
+    bool const hasBadPixels = (in.getData() != srcImage.getData()) ||
+                              (useVariance && (inVar.getData() != srcVariance.getData()));
+    int const lbndIn[2] = {srcLbnd[0], srcLbnd[1]};
+    int const ubndIn[2] = {srcLbnd[0] + static_cast<int>(srcImage.template getSize<1>()) - 1,
+                           srcLbnd[1] + static_cast<int>(srcImage.template getSize<0>()) - 1};
+    int const width = dstImage.template getSize<1>();
+    int const height = dstImage.template getSize<0>();
+    int const lbndOut[2] = {dstLbnd[0], dstLbnd[1]};
+    int const ubndOut[2] = {dstLbnd[0] + width - 1, dstLbnd[1] + height - 1};
+
+    // AST reads as many parameters as the kernel needs, so pad with zeros (which select AST's defaults)
+    std::vector<double> params(ctrl.params);
+    params.resize(std::max<std::size_t>(params.size(), 4), 0.0);
+    int const flags = (hasBadPixels ? AST__USEBAD : 0) | (ctrl.conserveFlux ? AST__CONSERVEFLUX : 0) |
+                      (useVariance ? AST__USEVAR : 0);
+
+    int const nTilesX = (width + ctrl.tileSize - 1) / ctrl.tileSize;
+    int const nTilesY = (height + ctrl.tileSize - 1) / ctrl.tileSize;
+    std::size_t const nTiles = static_cast<std::size_t>(nTilesX) * nTilesY;
+    int const nThreads = detail::getNumThreads(ctrl.nThreads, nTiles);
+    detail::ThreadCopies copies(map.getRawPtr(), nThreads);
+    std::atomic<int> nBad(0);
+    detail::parallelFor(nThreads, nTiles, [&](int threadIndex, std::size_t tile) {
+        int const x0 = (tile % nTilesX) * ctrl.tileSize;
+        int const y0 = (tile / nTilesX) * ctrl.tileSize;
+        int const x1 = std::min(x0 + ctrl.tileSize, width);
+        int const y1 = std::min(y0 + ctrl.tileSize, height);
+        int const lbnd[2] = {lbndOut[0] + x0, lbndOut[1] + y0};
+        int const ubnd[2] = {lbndOut[0] + x1 - 1, lbndOut[1] + y1 - 1};
+
+        auto tileMap = reinterpret_cast<AstMapping *>(copies.lock(threadIndex));
+        int const nBadTile = callResample(tileMap, lbndIn, ubndIn, in.getData(),
+                                          useVariance ? inVar.getData() : nullptr,
+                                          static_cast<int>(ctrl.kernel), params.data(), flags, ctrl.tol,
+                                          ctrl.maxpix, badval, lbndOut, ubndOut, lbnd, ubnd,
+                                          dstImage.getData(), useVariance ? dstVariance.getData() : nullptr);
+        try {
+            assertOK();
+        } catch (...) {
+            copies.unlock(threadIndex);
+            throw;
+        }
+        copies.unlock(threadIndex);
+        nBad += nBadTile;
+
+        // replace bad values with NaN and set the mask, while the tile is in cache
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                bool const isBad = dstImage[y][x] == badval;
+                if (isBad) {
+                    dstImage[y][x] = std::numeric_limits<T>::quiet_NaN();
+                }
+                if (useVariance && (dstVariance[y][x] == badval)) {
+                    dstVariance[y][x] = std::numeric_limits<T>::quiet_NaN();
+                }
+                if (!dstMask.isEmpty()) {
+                    int & maskPix = dstMask[y][x];
+                    maskPix = isBad ? (maskPix | ctrl.noDataMask) : (maskPix & ~ctrl.noDataMask);
+                }
+            }
+        }
+    });
+    return nBad;
+}
+
+}  // anonymous namespace
+
+int Mapping::resample(ndarray::Array<double const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                      ndarray::Array<double, 2, 2> const & dstImage, PointI const & dstLbnd,
+                      ResampleControl const & ctrl) const {
+    return resampleImpl<double>(*this, srcImage, {}, {}, srcLbnd, dstImage, {}, {}, dstLbnd, ctrl);
+}
+
+int Mapping::resample(ndarray::Array<float const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                      ndarray::Array<float, 2, 2> const & dstImage, PointI const & dstLbnd,
+                      ResampleControl const & ctrl) const {
+    return resampleImpl<float>(*this, srcImage, {}, {}, srcLbnd, dstImage, {}, {}, dstLbnd, ctrl);
+}
+
+int Mapping::resample(ndarray::Array<double const, 2, 2> const & srcImage,
+                      ndarray::Array<double const, 2, 2> const & srcVariance,
+                      ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                      ndarray::Array<double, 2, 2> const & dstImage,
+                      ndarray::Array<double, 2, 2> const & dstVariance,
+                      ndarray::Array<int, 2, 2> const & dstMask, PointI const & dstLbnd,
+                      ResampleControl const & ctrl) const {
+    return resampleImpl<double>(*this, srcImage, srcVariance, srcMask, srcLbnd, dstImage, dstVariance,
+                                dstMask, dstLbnd, ctrl);
+}
+
+int Mapping::resample(ndarray::Array<float const, 2, 2> const & srcImage,
+                      ndarray::Array<float const, 2, 2> const & srcVariance,
+                      ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                      ndarray::Array<float, 2, 2> const & dstImage,
+                      ndarray::Array<float, 2, 2> const & dstVariance,
+                      ndarray::Array<int, 2, 2> const & dstMask, PointI const & dstLbnd,
+                      ResampleControl const & ctrl) const {
+    return resampleImpl<float>(*this, srcImage, srcVariance, srcMask, srcLbnd, dstImage, dstVariance,
+                               dstMask, dstLbnd, ctrl);
+}
+
+int Mapping::resample(ndarray::Array<double const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                      ndarray::Array<double, 2, 2> const & dstImage, PointI const & dstLbnd) const {
+    return resample(srcImage, srcLbnd, dstImage, dstLbnd, ResampleControl());
+}
+
+int Mapping::resample(ndarray::Array<float const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                      ndarray::Array<float, 2, 2> const & dstImage, PointI const & dstLbnd) const {
+    return resample(srcImage, srcLbnd, dstImage, dstLbnd, ResampleControl());
+}
+
+int Mapping::resample(ndarray::Array<double const, 2, 2> const & srcImage,
+                      ndarray::Array<double const, 2, 2> const & srcVariance,
+                      ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                      ndarray::Array<double, 2, 2> const & dstImage,
+                      ndarray::Array<double, 2, 2> const & dstVariance,
+                      ndarray::Array<int, 2, 2> const & dstMask, PointI const & dstLbnd) const {
+    return resample(srcImage, srcVariance, srcMask, srcLbnd, dstImage, dstVariance, dstMask, dstLbnd,
+                    ResampleControl());
+}
+
+int Mapping::resample(ndarray::Array<float const, 2, 2> const & srcImage,
+                      ndarray::Array<float const, 2, 2> const & srcVariance,
+                      ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                      ndarray::Array<float, 2, 2> const & dstImage,
+                      ndarray::Array<float, 2, 2> const & dstVariance,
+                      ndarray::Array<int, 2, 2> const & dstMask, PointI const & dstLbnd) const {
+    return resample(srcImage, srcVariance, srcMask, srcLbnd, dstImage, dstVariance, dstMask, dstLbnd,
+                    ResampleControl());
+}
+
+}  // namespace ast
@@ -0,0 +1,116 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <memory>
+
+#include "astshim/ScratchArena.h"
+
+namespace ast {
+
+namespace {
+
+// Number of doubles in a 64-byte cache line
+std::size_t const LINE_SIZE = 8;
+
+}  // anonymous namespace
+
+ScratchArena::Block::Block(std::size_t size) :
+    storage(new double[size + LINE_SIZE - 1]),
+    data(nullptr),
+    size(size),
+    used(0)
+{
+    // new only guarantees alignment for double, so allocate up to a line extra and skip to a line boundary
+    void * start = storage.get();
+    std::size_t space = (size + LINE_SIZE - 1) * sizeof(double);
+    data = static_cast<double *>(std::align(LINE_SIZE * sizeof(double), size * sizeof(double), start, space));
+}
+
+ScratchArena & ScratchArena::get() {
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+std::size_t ScratchArena::getCapacity() const {
+    std::size_t capacity = 0;
+    for (auto const & block : _blocks) {
+        capacity += block.size;
+    }
+    return capacity * sizeof(double);
+}
+
+std::size_t ScratchArena::trim() {
+    std::size_t const oldCapacity = getCapacity();
+    while (!_blocks.empty() && (_blocks.back().used == 0)) {
+        _blocks.pop_back();
+    }
+    _highWaterMark = _inUse;
+    return oldCapacity - getCapacity();
+}
+
+double * ScratchArena::_borrow(std::size_t size) {
+    if ((_inUse == 0) && (_blocks.size() > 1)) {
+        // merge the blocks, so the memory needed so far is available as a single block from now on
+        std::size_t const capacity = getCapacity() / sizeof(double);
+        _blocks.clear();
+        _blocks.emplace_back(capacity);
+    }
+    if (_blocks.empty() || (_blocks.back().used + size > _blocks.back().size)) {
+        // grow geometrically, so a thread settles on a fixed amount of memory after a few calls
+        std::size_t const capacity = getCapacity() / sizeof(double);
+        _blocks.emplace_back(std::max(size, capacity));
+    }
+    Block & block = _blocks.back();
+    double * data = block.data + block.used;
+    block.used += size;
+    _inUse += size;
+    _highWaterMark = std::max(_highWaterMark, _inUse);
+    return data;
+}
+
+void ScratchArena::_return(std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+    // buffers are returned in the reverse order they were borrowed,
+    // so this one is at the end of the last block that is in use
+    for (auto block = _blocks.rbegin(); block != _blocks.rend(); ++block) {
+        if (block->used > 0) {
+            block->used -= size;
+            _inUse -= size;
+            return;
+        }
+    }
+}
+
+ScratchBuffer::ScratchBuffer(std::size_t size) :
+    _arena(ScratchArena::get()),
+    _size(size),
+    _paddedSize((size + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE),
+    _data(_arena._borrow(_paddedSize))
+{}
+
+ScratchBuffer::~ScratchBuffer() {
+    _arena._return(_paddedSize);
+}
+
+}  // namespace ast
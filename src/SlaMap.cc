@@ -0,0 +1,458 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/Mapping.h"
+#include "astshim/SlaMap.h"
+
+namespace ast {
+
+namespace {
+
+// Number of sky positions at which a rotation is fit, and at which it is then checked
+int const N_FIT_POINTS = 200;
+int const N_CHECK_POINTS = 1000;
+
+double const PI = 3.14159265358979323846;
+
+// Largest angular difference, in radians, allowed between an SlaMap and its separated conversions
+double const MAX_SPLIT_ERROR = 1e-13;
+
+typedef std::unique_ptr<AstObject, void (*)(AstObject *)> RawPtr;
+
+RawPtr makeRawPtr(void * rawptr) {
+    return RawPtr(reinterpret_cast<AstObject *>(rawptr), &detail::annulAstObject);
+}
+
+AstMapping * asMapping(RawPtr const & ptr) {
+    return reinterpret_cast<AstMapping *>(ptr.get());
+}
+
+/// Return the number of arguments taken by an SlaMap conversion, or -1 if the conversion is not known
+int getSlaArgCount(std::string const & cvt) {
+    static std::pair<char const *, int> const argCounts[] = {
+        {"ADDET", 1}, {"SUBET", 1}, {"PREBN", 2}, {"PREC", 2}, {"FK45Z", 1}, {"FK54Z", 1},
+        {"AMP", 2}, {"MAP", 2}, {"ECLEQ", 1}, {"EQECL", 1}, {"GALEQ", 0}, {"EQGAL", 0},
+        {"HFK5Z", 1}, {"FK5HZ", 1}, {"GALSUP", 0}, {"SUPGAL", 0}, {"J2000H", 0}, {"HJ2000", 0},
+        {"R2H", 1}, {"H2R", 1}, {"HPCEQ", 4}, {"EQHPC", 4}, {"HPREQ", 4}, {"EQHPR", 4},
+        {"HEEQ", 1}, {"EQHE", 1}, {"H2E", 2}, {"E2H", 2},
+    };
+    for (auto const & argCount : argCounts) {
+        if (cvt == argCount.first) {
+            return argCount.second;
+        }
+    }
+    return -1;
+}
+
+/**
+Return positions spread evenly over the sky (a Fibonacci lattice), axis-major: longitudes then latitudes
+
+@param[in] nPts  Number of positions
+@param[in] offset  Fraction of a turn by which to rotate the lattice in longitude,
+                so lattices of different offsets have no positions in common.
+*/
+std::vector<double> makeSkyLattice(int nPts, double offset) {
+    double const goldenAngle = PI * (3.0 - std::sqrt(5.0));
+    std::vector<double> sky(2 * nPts);
+    for (int k = 0; k < nPts; ++k) {
+        sky[k] = std::fmod((k + offset) * goldenAngle, 2.0 * PI);
+        sky[nPts + k] = std::asin(1.0 - (2.0 * k + 1.0) / nPts);
+    }
+    return sky;
+}
+
+/**
+Convert positions (lon, lat), axis-major, to unit vectors, axis-major
+
+@return false if any position is bad
+*/
+bool toUnitVectors(std::vector<double> const & sky, int nPts, std::vector<double> & vec) {
+    vec.resize(3 * nPts);
+    for (int k = 0; k < nPts; ++k) {
+        double const lon = sky[k];
+        double const lat = sky[nPts + k];
+        if ((lon == AST__BAD) || (lat == AST__BAD) || !std::isfinite(lon) || !std::isfinite(lat)) {
+            return false;
+        }
+        vec[k] = std::cos(lat) * std::cos(lon);
+        vec[nPts + k] = std::cos(lat) * std::sin(lon);
+        vec[2 * nPts + k] = std::sin(lat);
+    }
+    return true;
+}
+
+/// Transform positions, axis-major, by the forward transform of each of a run of steps in turn
+std::vector<double> transformSky(std::vector<RawPtr>::const_iterator begin,
+                                 std::vector<RawPtr>::const_iterator end, std::vector<double> const & sky,
+                                 int nPts) {
+    std::vector<double> in(sky);
+    std::vector<double> out(sky.size());
+    for (auto step = begin; step != end; ++step) {
+        astTranN(asMapping(*step), nPts, 2, nPts, in.data(), 1, 2, nPts, out.data());
+        assertOK();
+        std::swap(in, out);
+    }
+    return in;
+}
+
+/**
+Return the largest angular separation, in radians, between corresponding unit vectors, axis-major,
+after normalizing the first
+*/
+double maxSeparation(std::vector<double> const & vec1, std::vector<double> const & vec2, int nPts) {
+    double maxSep = 0.0;
+    for (int k = 0; k < nPts; ++k) {
+        double const norm = std::sqrt(vec1[k] * vec1[k] + vec1[nPts + k] * vec1[nPts + k] +
+                                      vec1[2 * nPts + k] * vec1[2 * nPts + k]);
+        double chord2 = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double const diff = vec1[i * nPts + k] / norm - vec2[i * nPts + k];
+            chord2 += diff * diff;
+        }
+        double const sep = 2.0 * std::asin(std::min(1.0, 0.5 * std::sqrt(chord2)));
+        if (std::isnan(sep)) {
+            return sep;  // e.g. from a zero vector
+        }
+        maxSep = std::max(maxSep, sep);
+    }
+    return maxSep;
+}
+
+/**
+Fit a 3x3 matrix to a run of steps, as a linear transformation of unit vectors
+
+@return the matrix, row-major, or an empty vector if it does not reproduce the steps to within `maxError`
+*/
+std::vector<double> fitRotation(std::vector<RawPtr>::const_iterator begin,
+                                std::vector<RawPtr>::const_iterator end, double maxError) {
+    std::vector<double> const fitSky = makeSkyLattice(N_FIT_POINTS, 0.0);
+    std::vector<double> fitIn, fitOut;
+    if (!toUnitVectors(fitSky, N_FIT_POINTS, fitIn) ||
+        !toUnitVectors(transformSky(begin, end, fitSky, N_FIT_POINTS), N_FIT_POINTS, fitOut)) {
+        return std::vector<double>();
+    }
+
+    // least squares: matrix = (sum of out in^T) (sum of in in^T)^-1
+    double outIn[3][3] = {};
+    double inIn[3][3] = {};
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < N_FIT_POINTS; ++k) {
+                outIn[i][j] += fitOut[i * N_FIT_POINTS + k] * fitIn[j * N_FIT_POINTS + k];
+                inIn[i][j] += fitIn[i * N_FIT_POINTS + k] * fitIn[j * N_FIT_POINTS + k];
+            }
+        }
+    }
+    // the lattice covers the sky, so inIn is close to N_FIT_POINTS/3 times the identity
+    double cofactor[3][3];
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            int const i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+            int const j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            cofactor[j][i] = inIn[i1][j1] * inIn[i2][j2] - inIn[i1][j2] * inIn[i2][j1];
+        }
+    }
+    double const det =
+        inIn[0][0] * cofactor[0][0] + inIn[0][1] * cofactor[1][0] + inIn[0][2] * cofactor[2][0];
+    std::vector<double> matrix(9, 0.0);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            for (int m = 0; m < 3; ++m) {
+                matrix[i * 3 + j] += outIn[i][m] * cofactor[m][j] / det;
+            }
+        }
+    }
+
+    // check the matrix at other positions
+    std::vector<double> const checkSky = makeSkyLattice(N_CHECK_POINTS, 0.5);
+    std::vector<double> checkIn, checkOut;
+    if (!toUnitVectors(checkSky, N_CHECK_POINTS, checkIn) ||
+        !toUnitVectors(transformSky(begin, end, checkSky, N_CHECK_POINTS), N_CHECK_POINTS, checkOut)) {
+        return std::vector<double>();
+    }
+    std::vector<double> predicted(3 * N_CHECK_POINTS, 0.0);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < N_CHECK_POINTS; ++k) {
+                predicted[i * N_CHECK_POINTS + k] += matrix[i * 3 + j] * checkIn[j * N_CHECK_POINTS + k];
+            }
+        }
+    }
+    if (!(maxSeparation(predicted, checkOut, N_CHECK_POINTS) <= maxError)) {
+        return std::vector<double>();
+    }
+    return matrix;
+}
+
+/**
+Append copies of the individual conversions of an SlaMap to a list of steps
+
+The conversions are read from the description of the SlaMap, as written by Object::show.
+
+@param[in] map  The SlaMap
+@param[in] forward  Use the forward transform of `map`?
+@param[in,out] steps  The steps, each to be applied by its forward transform
+@return true if the conversions were read and together reproduce `map`, else false
+    (in which case `steps` is unchanged)
+*/
+bool appendSlaSteps(AstMapping * map, bool forward, std::vector<RawPtr> & steps) {
+    // read the conversions from an uninverted copy, so the meaning of "forward" is unambiguous
+    bool const useForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+    auto slaMap = makeRawPtr(astCopy(map));
+    astSetI(slaMap.get(), "Invert", 0);
+    assertOK();
+    std::istringstream is(Mapping(reinterpret_cast<AstMapping *>(astClone(slaMap.get()))).show());
+    int nSla = -1;
+    std::vector<std::string> cvts;
+    std::vector<std::vector<double>> args;
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream ls(line);
+        std::string key, equals;
+        if (!(ls >> key >> equals) || (equals != "=")) {
+            continue;
+        }
+        if (key == "Nsla") {
+            ls >> nSla;
+            continue;
+        }
+        // conversion i is "Sla<i>" and its arguments are "Sla<i>a", "Sla<i>b", ...
+        if ((key.size() < 4) || (key.compare(0, 3, "Sla") != 0) || !std::isdigit(key[3])) {
+            continue;
+        }
+        std::size_t const end = key.find_first_not_of("0123456789", 3);
+        int const index = std::stoi(key.substr(3, end - 3)) - 1;
+        if ((index < 0) || (index >= nSla)) {
+            return false;  // Nsla is written before the conversions
+        }
+        if (cvts.size() <= static_cast<std::size_t>(index)) {
+            cvts.resize(index + 1);
+            args.resize(index + 1);
+        }
+        if (end == std::string::npos) {
+            std::size_t const quote1 = line.find('"');
+            std::size_t const quote2 = line.find('"', quote1 + 1);
+            if ((quote1 == std::string::npos) || (quote2 == std::string::npos)) {
+                return false;
+            }
+            cvts[index] = line.substr(quote1 + 1, quote2 - quote1 - 1);
+        } else if ((end + 1 == key.size()) && std::islower(key[end])) {
+            double value;
+            if (!(ls >> value)) {
+                return false;
+            }
+            std::size_t const argIndex = key[end] - 'a';
+            if (args[index].size() <= argIndex) {
+                args[index].resize(argIndex + 1, AST__BAD);
+            }
+            args[index][argIndex] = value;
+        }
+    }
+    if ((nSla < 1) || (cvts.size() != static_cast<std::size_t>(nSla))) {
+        return false;
+    }
+
+    std::vector<RawPtr> slaSteps;
+    for (int i = 0; i < nSla; ++i) {
+        int const nArgs = getSlaArgCount(cvts[i]);
+        if ((nArgs < 0) || (args[i].size() < static_cast<std::size_t>(nArgs)) ||
+            (std::find(args[i].begin(), args[i].begin() + nArgs, AST__BAD) != args[i].begin() + nArgs)) {
+            return false;
+        }
+        auto step = makeRawPtr(astSlaMap(0, ""));
+        astSlaAdd(reinterpret_cast<AstSlaMap *>(step.get()), cvts[i].c_str(), nArgs, args[i].data());
+        assertOK();
+        slaSteps.push_back(std::move(step));
+    }
+    if (!useForward) {
+        std::reverse(slaSteps.begin(), slaSteps.end());
+        for (auto const & step : slaSteps) {
+            astInvert(step.get());
+        }
+        assertOK();
+    }
+
+    // check that the conversions reproduce the SlaMap, in case its description was not read as intended
+    std::vector<double> const checkSky = makeSkyLattice(N_CHECK_POINTS, 0.25);
+    std::vector<double> expectedSky(checkSky.size());
+    astTranN(map, N_CHECK_POINTS, 2, N_CHECK_POINTS, checkSky.data(), static_cast<int>(forward), 2,
+             N_CHECK_POINTS, expectedSky.data());
+    assertOK();
+    std::vector<double> actual, expected;
+    if (!toUnitVectors(transformSky(slaSteps.begin(), slaSteps.end(), checkSky, N_CHECK_POINTS),
+                       N_CHECK_POINTS, actual) ||
+        !toUnitVectors(expectedSky, N_CHECK_POINTS, expected) ||
+        !(maxSeparation(actual, expected, N_CHECK_POINTS) <= MAX_SPLIT_ERROR)) {
+        return false;
+    }
+    for (auto & step : slaSteps) {
+        steps.push_back(std::move(step));
+    }
+    return true;
+}
+
+/**
+Append the series components of a mapping to a list of steps, splitting SlaMaps into their conversions
+
+@param[in] map  The mapping
+@param[in] forward  Use the forward transform of `map`?
+@param[in,out] steps  The steps, each to be applied by its forward transform
+*/
+void appendSteps(AstMapping * map, bool forward, std::vector<RawPtr> & steps) {
+    if (astIsACmpMap(map)) {
+        AstMapping * rawMap1;
+        AstMapping * rawMap2;
+        int series, invert1, invert2;
+        astDecompose(map, &rawMap1, &rawMap2, &series, &invert1, &invert2);
+        auto map1 = makeRawPtr(rawMap1);
+        auto map2 = makeRawPtr(rawMap2);
+        assertOK();
+        if (series) {
+            // The compound mapping applies each component with the Invert value recorded when it was built,
+            // which may differ from the component's current Invert value
+            bool const cmpForward = forward != static_cast<bool>(astGetI(map, "Invert"));
+            bool const flip1 = static_cast<bool>(invert1) != static_cast<bool>(astGetI(rawMap1, "Invert"));
+            bool const flip2 = static_cast<bool>(invert2) != static_cast<bool>(astGetI(rawMap2, "Invert"));
+            assertOK();
+            if (cmpForward) {
+                appendSteps(rawMap1, cmpForward != flip1, steps);
+                appendSteps(rawMap2, cmpForward != flip2, steps);
+            } else {
+                appendSteps(rawMap2, cmpForward != flip2, steps);
+                appendSteps(rawMap1, cmpForward != flip1, steps);
+            }
+            return;
+        }
+    } else if (astIsASlaMap(map) && appendSlaSteps(map, forward, steps)) {
+        return;
+    }
+    assertOK();
+    auto step = makeRawPtr(astCopy(map));
+    if (!forward) {
+        astInvert(step.get());
+    }
+    assertOK();
+    steps.push_back(std::move(step));
+}
+
+/// Can a step be part of a rotation?
+bool isSkyStep(RawPtr const & step) {
+    bool const isSky = (astGetI(step.get(), "Nin") == 2) && (astGetI(step.get(), "Nout") == 2) &&
+                       astGetI(step.get(), "TranForward");
+    assertOK();
+    return isSky;
+}
+
+/// Return (inverse SphMap, MatrixMap, SphMap) for a rotation matrix
+RawPtr makeRotationMap(std::vector<double> const & matrix) {
+    auto toVector = makeRawPtr(astSphMap(""));
+    astInvert(toVector.get());
+    auto rotation = makeRawPtr(astMatrixMap(3, 3, 0, matrix.data(), ""));
+    auto toSky = makeRawPtr(astSphMap(""));
+    auto rotateVector = makeRawPtr(astCmpMap(toVector.get(), rotation.get(), 1, ""));
+    auto rotationMap = makeRawPtr(astCmpMap(rotateVector.get(), toSky.get(), 1, ""));
+    assertOK();
+    return rotationMap;
+}
+
+}  // anonymous namespace
+
+Mapping optimizeSkyConversion(Mapping const & map, double maxError) {
+    if ((map.getNin() != 2) || (map.getNout() != 2)) {
+        std::ostringstream os;
+        os << "map has " << map.getNin() << " inputs and " << map.getNout()
+           << " outputs; must have 2 of each";
+        throw std::invalid_argument(os.str());
+    }
+    if (!(maxError > 0)) {
+        std::ostringstream os;
+        os << "maxError = " << maxError << " must be positive";
+        throw std::invalid_argument(os.str());
+    }
+    auto simplified = makeRawPtr(nullptr);
+    if (astIsAFrameSet(map.getRawPtr())) {
+        // the Base and Current attributes already allow for the FrameSet being inverted
+        auto frameSetMap = makeRawPtr(astGetMapping(map.getRawPtr(), AST__BASE, AST__CURRENT));
+        assertOK();
+        simplified = makeRawPtr(astSimplify(frameSetMap.get()));
+    } else {
+        simplified = makeRawPtr(astSimplify(map.getRawPtr()));
+    }
+    assertOK();
+
+    std::vector<RawPtr> steps;
+    appendSteps(asMapping(simplified), true, steps);
+
+    // replace the longest run that is a rotation starting at each step, if any
+    std::vector<RawPtr> optimized;
+    bool isChanged = false;
+    for (auto begin = steps.cbegin(); begin != steps.cend();) {
+        std::vector<double> matrix;
+        auto runEnd = begin;
+        bool isNonlinear = false;
+        for (auto end = begin; (end != steps.cend()) && isSkyStep(*end);) {
+            isNonlinear = isNonlinear || !astGetI(end->get(), "IsLinear");
+            assertOK();
+            ++end;
+            std::vector<double> runMatrix = fitRotation(begin, end, maxError);
+            if (runMatrix.empty()) {
+                break;
+            }
+            if (isNonlinear) {
+                matrix = std::move(runMatrix);
+                runEnd = end;
+            }
+        }
+        if (matrix.empty()) {
+            optimized.push_back(makeRawPtr(astClone(begin->get())));
+            ++begin;
+        } else {
+            optimized.push_back(makeRotationMap(matrix));
+            isChanged = true;
+            begin = runEnd;
+        }
+    }
+    assertOK();
+    if (!isChanged) {
+        return Mapping(reinterpret_cast<AstMapping *>(simplified.release()));
+    }
+
+    auto result = std::move(optimized[0]);
+    for (std::size_t i = 1; i < optimized.size(); ++i) {
+        result = makeRawPtr(astCmpMap(result.get(), optimized[i].get(), 1, ""));
+        assertOK();
+    }
+    return Mapping(reinterpret_cast<AstMapping *>(result.release()));
+}
+
+}  // namespace ast
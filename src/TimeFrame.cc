@@ -0,0 +1,111 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail/kernels.h"
+#include "astshim/FrameSet.h"
+#include "astshim/Mapping.h"
+#include "astshim/TimeFrame.h"
+
+namespace ast {
+
+namespace {
+
+// Number of times TimeFrame::convertTimes converts per evaluation of the conversion it allows
+// tabulateKernel; a table is only worth making for many more times than it takes to make
+std::size_t const TIMES_PER_TABLE_EVALUATION = 4;
+
+/**
+Return a table of the 1-D conversion `source` over the range of the good values in `times`, or nullptr
+if there are none, any is infinite or AST__BAD, or `source` cannot be tabulated in `maxEvaluations`
+evaluations
+*/
+std::shared_ptr<detail::Kernel const> makeTable(detail::Kernel const & source, double const * times,
+                                                std::size_t nPts, std::size_t maxEvaluations) {
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -lo;
+    for (std::size_t k = 0; k < nPts; ++k) {
+        double const value = times[k];
+        if (std::isnan(value)) {
+            continue;
+        }
+        if (std::isinf(value) || (value == AST__BAD)) {
+            return nullptr;
+        }
+        lo = std::min(lo, value);
+        hi = std::max(hi, value);
+    }
+    if (!(lo <= hi)) {
+        return nullptr;
+    }
+    return detail::tabulateKernel(source, lo, hi, maxEvaluations);
+}
+
+}  // anonymous namespace
+
+ndarray::Array<double, 1, 1> TimeFrame::convertTimes(TimeFrame const & to,
+                                                     ndarray::Array<double const, 1, 0> const & times) {
+    FrameSet conversion = convert(to);
+    std::size_t const nPts = times.getSize<0>();
+    // a single column, so it is the axis-major buffer AST and the table want
+    Array2D from = ndarray::allocate(nPts, 1);
+    for (std::size_t k = 0; k < nPts; ++k) {
+        from[k][0] = times[k];
+    }
+
+    // a conversion that includes a TimeMap (e.g. for leap seconds or the TDB series) is tabulated,
+    // which is much faster than AST converting each time; anything else is left to AST
+    Mapping const simplified = conversion.getMapping().simplify();
+    auto const source = detail::compileKernel(reinterpret_cast<AstMapping *>(simplified.getRawPtr()), true);
+    std::vector<std::string> steps;
+    source->describe(steps);
+    std::shared_ptr<detail::Kernel const> table;
+    if ((source->getNin() == 1) && (source->getNout() == 1) &&
+        (std::find(steps.begin(), steps.end(), "TimeMap") != steps.end())) {
+        table = makeTable(*source, from.getData(), nPts, nPts / TIMES_PER_TABLE_EVALUATION);
+    }
+
+    ndarray::Array<double, 1, 1> result = ndarray::allocate(nPts);
+    if (table) {
+        for (std::size_t start = 0; start < nPts; start += getTranChunkSize()) {
+            int const nChunk = static_cast<int>(std::min(nPts - start, getTranChunkSize()));
+            table->apply(from.getData() + start, nChunk, nChunk, result.getData() + start, nChunk);
+        }
+    } else {
+        Array2D const to2D = conversion.tran(from);
+        for (std::size_t k = 0; k < nPts; ++k) {
+            result[k] = to2D[k][0];
+        }
+    }
+    return result;
+}
+
+}  // namespace ast
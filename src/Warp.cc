@@ -0,0 +1,354 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "ndarray.h"
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/threads.h"
+#include "astshim/detail/vecmath.h"
+#include "astshim/Mapping.h"
+#include "astshim/ScratchArena.h"
+#include "astshim/Warp.h"
+
+namespace ast {
+
+namespace {
+
+double const PI = 3.14159265358979323846;
+
+/*
+Interpolation kernels: N taps per axis, the first at offset FIRST from floor(x).
+computeWeights sets the normalized weights of the taps for fractional position dx in [0, 1),
+given the sine and cosine of theta = ANGLE_SCALE * dx, which warpBlock computes for a whole row at once
+if USES_ANGLE.
+*/
+struct BilinearKernel {
+    static int const N = 2;
+    static int const FIRST = 0;
+    static bool const USES_ANGLE = false;
+    static double getAngle(double) { return 0.0; }
+
+    static void computeWeights(double dx, double, double, double weights[N]) {
+        weights[0] = 1.0 - dx;
+        weights[1] = dx;
+    }
+};
+
+struct Lanczos3Kernel {
+    static int const N = 6;
+    static int const FIRST = -2;
+    static bool const USES_ANGLE = true;
+    static double getAngle(double dx) { return PI * dx / 3.0; }
+
+    static void computeWeights(double dx, double sinTheta, double cosTheta, double weights[N]) {
+        if (dx == 0.0) {
+            std::fill(weights, weights + N, 0.0);
+            weights[-FIRST] = 1.0;
+            return;
+        }
+        // Tap j is at t = dx - j, with weight sinc(t) sinc(t / 3) = 3 sin(pi t) sin(pi t / 3) / (pi t)^2,
+        // where sin(pi t) = (-1)^j sin(pi dx) and sin(pi t / 3) = sin(theta - pi j / 3).
+        // The factor 3 sin(pi dx) / pi^2 is the same for every tap, so it cancels when normalizing.
+        static double const cosJ[N] = {-0.5, 0.5, 1.0, 0.5, -0.5, -1.0};
+        static double const sinJ[N] = {-0.8660254037844386, -0.8660254037844386, 0.0,
+                                       0.8660254037844386, 0.8660254037844386, 0.0};
+        double sum = 0.0;
+        for (int i = 0; i < N; ++i) {
+            double const t = dx - (i + FIRST);
+            double const sinPiT3 = sinTheta * cosJ[i] - cosTheta * sinJ[i];
+            weights[i] = ((i % 2 == 0) ? sinPiT3 : -sinPiT3) / (t * t);  // j = i - 2 has the parity of i
+            sum += weights[i];
+        }
+        for (int i = 0; i < N; ++i) {
+            weights[i] /= sum;
+        }
+    }
+};
+
+/*
+Set `sine` and `cosine` to the sine and cosine of Kernel::getAngle of the fractional part
+of each of `n` positions (in array index units), if the kernel uses them
+*/
+template <typename Kernel>
+void computeAngles(double const * coords, double offset, int n, double * angle, double * sine,
+                   double * cosine) {
+    if (!Kernel::USES_ANGLE) {
+        return;
+    }
+    for (int k = 0; k < n; ++k) {
+        double const pos = coords[k] - offset;
+        angle[k] = Kernel::getAngle(pos - std::floor(pos));
+    }
+    detail::sinCosN(angle, n, sine, cosine);
+}
+
+/*
+Find the taps of a kernel for position `pos` (in array index units) along an axis of `size` pixels.
+
+Taps with zero weight are trimmed, so that e.g. a pixel that lands exactly on a source pixel
+can be interpolated right up to the edge of the source image.
+Sets `start` to the array index of the first tap with nonzero weight and [`lo`, `hi`) to the range
+of such taps in `weights`; returns false if they do not all lie within the image.
+`sinTheta` and `cosTheta` are as computed by computeAngles.
+*/
+template <typename Kernel>
+bool findTaps(double pos, int size, double sinTheta, double cosTheta, double weights[Kernel::N], int & start,
+              int & lo, int & hi) {
+    double const ipos = std::floor(pos);
+    if (!(ipos > -Kernel::N) || !(ipos < size + Kernel::N)) {  // also rejects NaN
+        return false;
+    }
+    Kernel::computeWeights(pos - ipos, sinTheta, cosTheta, weights);
+    lo = 0;
+    hi = Kernel::N;
+    while ((lo < hi) && (weights[lo] == 0.0)) {
+        ++lo;
+    }
+    while ((hi > lo) && (weights[hi - 1] == 0.0)) {
+        --hi;
+    }
+    start = static_cast<int>(ipos) + Kernel::FIRST + lo;
+    return (start >= 0) && (start + (hi - lo) <= size);
+}
+
+template <typename T>
+struct WarpImages {
+    ndarray::Array<T const, 2, 2> srcImage;
+    ndarray::Array<int const, 2, 2> srcMask;
+    ndarray::Array<T, 2, 2> dstImage;
+    ndarray::Array<int, 2, 2> dstMask;
+};
+
+/*
+Interpolate one block of the destination, given the source coordinates of its pixels
+(axis-major: x for every pixel, then y for every pixel, with x varying fastest).
+
+Returns the number of pixels that receive no data.
+*/
+template <typename T, typename Kernel>
+int warpBlock(WarpImages<T> const & images, WarpControl const & ctrl, double const * coords,
+              double const srcOffset[2], int x0, int x1, int y0, int y1) {
+    T const nan = std::numeric_limits<T>::quiet_NaN();
+    int const srcWidth = images.srcImage.template getSize<1>();
+    int const srcHeight = images.srcImage.template getSize<0>();
+    std::size_t const srcStride = srcWidth;
+    std::size_t const dstStride = images.dstImage.template getSize<1>();
+    T const * srcData = images.srcImage.getData();
+    int const * srcMaskData = images.srcMask.isEmpty() ? nullptr : images.srcMask.getData();
+    bool const hasDstMask = !images.dstMask.isEmpty();
+    int const nRowPix = x1 - x0;
+    std::size_t const nBlockPix = static_cast<std::size_t>(nRowPix) * (y1 - y0);
+    double const * xCoords = coords;
+    double const * yCoords = coords + nBlockPix;
+
+    // the angles used by the kernel, and their sines and cosines along x and y, for one row
+    ScratchBuffer angles(5 * static_cast<std::size_t>(nRowPix));
+    double * const angle = angles.data();
+    double * const sinX = angle + nRowPix;
+    double * const cosX = sinX + nRowPix;
+    double * const sinY = cosX + nRowPix;
+    double * const cosY = sinY + nRowPix;
+
+    int nNoData = 0;
+    double wx[Kernel::N];
+    double wy[Kernel::N];
+    for (int y = y0, i = 0; y < y1; ++y) {
+        T * dstRow = images.dstImage.getData() + static_cast<std::size_t>(y) * dstStride;
+        int * dstMaskRow = hasDstMask ? images.dstMask.getData() + static_cast<std::size_t>(y) * dstStride
+                                      : nullptr;
+        computeAngles<Kernel>(xCoords + i, srcOffset[0], nRowPix, angle, sinX, cosX);
+        computeAngles<Kernel>(yCoords + i, srcOffset[1], nRowPix, angle, sinY, cosY);
+        for (int x = x0, k = 0; x < x1; ++x, ++i, ++k) {
+            int xStart, xLo, xHi, yStart, yLo, yHi;
+            if ((xCoords[i] == AST__BAD) || (yCoords[i] == AST__BAD) ||
+                !findTaps<Kernel>(xCoords[i] - srcOffset[0], srcWidth, sinX[k], cosX[k], wx, xStart, xLo,
+                                  xHi) ||
+                !findTaps<Kernel>(yCoords[i] - srcOffset[1], srcHeight, sinY[k], cosY[k], wy, yStart, yLo,
+                                  yHi)) {
+                dstRow[x] = nan;
+                if (hasDstMask) {
+                    dstMaskRow[x] = ctrl.noDataMask;
+                }
+                ++nNoData;
+                continue;
+            }
+            int const nx = xHi - xLo;
+            int const ny = yHi - yLo;
+            double sum = 0.0;
+            for (int j = 0; j < ny; ++j) {
+                T const * srcRow = srcData + (yStart + j) * srcStride + xStart;
+                double rowSum = 0.0;
+                for (int k = 0; k < nx; ++k) {
+                    rowSum += wx[xLo + k] * srcRow[k];
+                }
+                sum += wy[yLo + j] * rowSum;
+            }
+            int maskVal = 0;
+            if (srcMaskData) {
+                for (int j = 0; j < ny; ++j) {
+                    int const * srcMaskRow = srcMaskData + (yStart + j) * srcStride + xStart;
+                    for (int k = 0; k < nx; ++k) {
+                        maskVal |= srcMaskRow[k];
+                    }
+                }
+                if (maskVal & ctrl.badMask) {
+                    sum = nan;
+                }
+            }
+            // NaN source pixels propagate through the sum
+            dstRow[x] = static_cast<T>(sum);
+            if (hasDstMask) {
+                dstMaskRow[x] = maskVal;
+            }
+        }
+    }
+    return nNoData;
+}
+
+template <typename T>
+int warpImpl(Mapping const & map, WarpImages<T> const & images, std::vector<int> const & srcLbnd,
+             std::vector<int> const & dstLbnd, WarpControl const & ctrl) {
+    detail::assertEqual(map.getNin(), "getNin()", 2, "number of image axes");
+    detail::assertEqual(map.getNout(), "getNout()", 2, "number of image axes");
+    detail::assertEqual(srcLbnd.size(), "srcLbnd.size()", 2, "number of image axes");
+    detail::assertEqual(dstLbnd.size(), "dstLbnd.size()", 2, "number of image axes");
+    if (!images.srcMask.isEmpty() && (images.srcMask.getShape() != images.srcImage.getShape())) {
+        throw std::invalid_argument("srcMask and srcImage shapes differ");
+    }
+    if (!images.dstMask.isEmpty() && (images.dstMask.getShape() != images.dstImage.getShape())) {
+        throw std::invalid_argument("dstMask and dstImage shapes differ");
+    }
+    if (ctrl.blockSize < 1) {
+        std::ostringstream os;
+        os << "ctrl.blockSize = " << ctrl.blockSize << " < 1";
+        throw std::invalid_argument(os.str());
+    }
+    int const width = images.dstImage.template getSize<1>();
+    int const height = images.dstImage.template getSize<0>();
+    double const srcOffset[2] = {static_cast<double>(srcLbnd[0]), static_cast<double>(srcLbnd[1])};
+
+    int const nBlocksX = (width + ctrl.blockSize - 1) / ctrl.blockSize;
+    int const nBlocksY = (height + ctrl.blockSize - 1) / ctrl.blockSize;
+    std::size_t const nBlocks = static_cast<std::size_t>(nBlocksX) * nBlocksY;
+    int const nThreads = detail::getNumThreads(ctrl.nThreads, nBlocks);
+    detail::ThreadCopies copies(map.getRawPtr(), nThreads);
+    std::atomic<int> nNoData(0);
+    detail::parallelFor(nThreads, nBlocks, [&](int threadIndex, std::size_t block) {
+        int const x0 = (block % nBlocksX) * ctrl.blockSize;
+        int const y0 = (block / nBlocksX) * ctrl.blockSize;
+        int const x1 = std::min(x0 + ctrl.blockSize, width);
+        int const y1 = std::min(y0 + ctrl.blockSize, height);
+        int const lbnd[2] = {dstLbnd[0] + x0, dstLbnd[1] + y0};
+        int const ubnd[2] = {dstLbnd[0] + x1 - 1, dstLbnd[1] + y1 - 1};
+        int const nBlockPix = (x1 - x0) * (y1 - y0);
+
+        // Source coordinates of the block, from the inverse of the mapping. This calls astTranGrid
+        // (with forward=0) rather than tranGridInverse because it must use this thread's copy of
+        // the mapping, not the shared one, and because warpBlock wants AST__BAD for undefined positions
+        // and the pixels in AST's axis-major order, which tranGridInverse would convert.
+        ScratchBuffer coords(2 * nBlockPix);
+        AstObject * blockMap = copies.lock(threadIndex);
+        astTranGrid(blockMap, 2, lbnd, ubnd, ctrl.tol, ctrl.maxpix, 0, 2, nBlockPix, coords.data());
+        try {
+            assertOK();
+        } catch (...) {
+            copies.unlock(threadIndex);
+            throw;
+        }
+        copies.unlock(threadIndex);
+
+        switch (ctrl.kernel) {
+            case WarpKernel::BILINEAR:
+                nNoData += warpBlock<T, BilinearKernel>(images, ctrl, coords.data(), srcOffset,
+                                                         x0, x1, y0, y1);
+                break;
+            case WarpKernel::LANCZOS3:
+                nNoData += warpBlock<T, Lanczos3Kernel>(images, ctrl, coords.data(), srcOffset,
+                                                         x0, x1, y0, y1);
+                break;
+        }
+    });
+    return nNoData;
+}
+
+}  // anonymous namespace
+
+int Mapping::warp(ndarray::Array<double const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                  ndarray::Array<double, 2, 2> const & dstImage, PointI const & dstLbnd,
+                  WarpControl const & ctrl) const {
+    return warpImpl(*this, WarpImages<double>{srcImage, {}, dstImage, {}}, srcLbnd, dstLbnd, ctrl);
+}
+
+int Mapping::warp(ndarray::Array<float const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                  ndarray::Array<float, 2, 2> const & dstImage, PointI const & dstLbnd,
+                  WarpControl const & ctrl) const {
+    return warpImpl(*this, WarpImages<float>{srcImage, {}, dstImage, {}}, srcLbnd, dstLbnd, ctrl);
+}
+
+int Mapping::warp(ndarray::Array<double const, 2, 2> const & srcImage,
+                  ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                  ndarray::Array<double, 2, 2> const & dstImage, ndarray::Array<int, 2, 2> const & dstMask,
+                  PointI const & dstLbnd, WarpControl const & ctrl) const {
+    return warpImpl(*this, WarpImages<double>{srcImage, srcMask, dstImage, dstMask}, srcLbnd, dstLbnd,
+                    ctrl);
+}
+
+int Mapping::warp(ndarray::Array<float const, 2, 2> const & srcImage,
+                  ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                  ndarray::Array<float, 2, 2> const & dstImage, ndarray::Array<int, 2, 2> const & dstMask,
+                  PointI const & dstLbnd, WarpControl const & ctrl) const {
+    return warpImpl(*this, WarpImages<float>{srcImage, srcMask, dstImage, dstMask}, srcLbnd, dstLbnd,
+                    ctrl);
+}
+
+int Mapping::warp(ndarray::Array<double const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                  ndarray::Array<double, 2, 2> const & dstImage, PointI const & dstLbnd) const {
+    return warp(srcImage, srcLbnd, dstImage, dstLbnd, WarpControl());
+}
+
+int Mapping::warp(ndarray::Array<float const, 2, 2> const & srcImage, PointI const & srcLbnd,
+                  ndarray::Array<float, 2, 2> const & dstImage, PointI const & dstLbnd) const {
+    return warp(srcImage, srcLbnd, dstImage, dstLbnd, WarpControl());
+}
+
+int Mapping::warp(ndarray::Array<double const, 2, 2> const & srcImage,
+                  ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                  ndarray::Array<double, 2, 2> const & dstImage, ndarray::Array<int, 2, 2> const & dstMask,
+                  PointI const & dstLbnd) const {
+    return warp(srcImage, srcMask, srcLbnd, dstImage, dstMask, dstLbnd, WarpControl());
+}
+
+int Mapping::warp(ndarray::Array<float const, 2, 2> const & srcImage,
+                  ndarray::Array<int const, 2, 2> const & srcMask, PointI const & srcLbnd,
+                  ndarray::Array<float, 2, 2> const & dstImage, ndarray::Array<int, 2, 2> const & dstMask,
+                  PointI const & dstLbnd) const {
+    return warp(srcImage, srcMask, srcLbnd, dstImage, dstMask, dstLbnd, WarpControl());
+}
+
+}  // namespace ast
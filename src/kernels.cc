@@ -0,0 +1,1378 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/kernels.h"
+#include "astshim/detail/vecmath.h"
+#include "astshim/ScratchArena.h"
+
+namespace ast {
+namespace detail {
+
+namespace {
+
+double const NaN = std::numeric_limits<double>::quiet_NaN();
+
+// Number of points in each block of AffineKernel's general path: 256 points of a few dozen
+// input and output rows fit in a typical L2 cache
+int const AFFINE_BLOCK_SIZE = 256;
+
+// Number of outputs computed together by AffineKernel's general path, so each input is loaded once for all
+int const AFFINE_TILE_SIZE = 4;
+
+// Number of points in each block of ChebyKernel; each level of its recursion uses 3 rows of a block
+int const CHEBY_BLOCK_SIZE = 256;
+
+// Number of points in each block of PolyKernel, so its table of powers has a fixed size
+int const POLY_BLOCK_SIZE = 256;
+
+// Number of points in each block of GridKernel's forward transform
+int const GRID_BLOCK_SIZE = 256;
+
+// Maximum number of Newton iterations, and the tolerance on the residual relative to the grid spacing
+// and the size of the coordinates, used by GridKernel's inverse transform
+int const GRID_INVERSE_MAX_ITER = 50;
+double const GRID_INVERSE_TOLERANCE = 1e-12;
+
+// Number of points in each block of SphKernel, whose rows of trigonometric functions then stay in cache
+int const SPH_BLOCK_SIZE = 256;
+
+// Largest number of table intervals LutKernel searches one by one; larger ranges are bisected
+int const LUT_LINEAR_SEARCH_SIZE = 8;
+
+// Number of points in each block of PiecewiseCubicKernel
+int const PIECEWISE_BLOCK_SIZE = 256;
+
+// Number of segments tabulateKernel starts with, before any is split
+int const TABLE_INITIAL_SEGMENTS = 16;
+
+// Number of closely spaced points in each of the 3 sets from which tabulateKernel estimates rounding error
+int const TABLE_NOISE_PROBE_SIZE = 8;
+
+// Number of points scattered over the range at which tabulateKernel checks the finished table
+int const TABLE_N_CHECKS = 1000;
+
+// Largest rounding error, relative to 1 + the largest output, of a kernel that tabulateKernel will tabulate
+double const TABLE_MAX_NOISE = 1e-10;
+
+#if !(defined(AST__THREADSAFE) && AST__THREADSAFE)
+// Serializes the calls to AST made by every AstKernel, since AST's error status and memory management
+// are shared by all threads unless AST is built with thread support
+std::mutex astKernelMutex;
+#endif
+
+/**
+Compute the weights of bicubic convolution (Keys, a = -0.5) for the 4 grid points around a position
+
+@param[in] t  Fractional position between the second and third grid points, in [0, 1]
+@param[out] weights  The weight of each grid point
+@param[out] derivs  The derivative of each weight with respect to `t`; ignored if null
+*/
+inline void cubicWeights(double t, double * weights, double * derivs) {
+    double const t2 = t * t;
+    double const t3 = t2 * t;
+    weights[0] = -0.5 * t3 + t2 - 0.5 * t;
+    weights[1] = 1.5 * t3 - 2.5 * t2 + 1.0;
+    weights[2] = -1.5 * t3 + 2.0 * t2 + 0.5 * t;
+    weights[3] = 0.5 * t3 - 0.5 * t2;
+    if (derivs) {
+        derivs[0] = -1.5 * t2 + 2.0 * t - 0.5;
+        derivs[1] = 4.5 * t2 - 5.0 * t;
+        derivs[2] = -4.5 * t2 + 4.0 * t + 0.5;
+        derivs[3] = 1.5 * t2 - t;
+    }
+}
+
+std::string getRawClass(AstMapping * map) {
+    char const * rawClass = astGetC(map, "Class");
+    assertOK();
+    return std::string(rawClass);
+}
+
+int sumNin(std::vector<std::shared_ptr<Kernel const>> const & kernels) {
+    int nIn = 0;
+    for (auto const & kernel : kernels) {
+        nIn += kernel->getNin();
+    }
+    return nIn;
+}
+
+int sumNout(std::vector<std::shared_ptr<Kernel const>> const & kernels) {
+    int nOut = 0;
+    for (auto const & kernel : kernels) {
+        nOut += kernel->getNout();
+    }
+    return nOut;
+}
+
+}  // anonymous namespace
+
+AffineKernel::AffineKernel(std::vector<double> const & matrix, std::vector<double> const & offset) :
+    Kernel(offset.empty() ? 0 : matrix.size() / offset.size(), offset.size()),
+    _matrix(matrix),
+    _offset(offset),
+    _isDiagonal(false),
+    _isPermutation(true),
+    _source()
+{
+    if (offset.empty() || (matrix.size() != static_cast<std::size_t>(getNin() * getNout()))) {
+        std::ostringstream os;
+        os << "matrix.size() = " << matrix.size() << " is not a multiple of offset.size() = "
+            << offset.size();
+        throw std::invalid_argument(os.str());
+    }
+    int const nIn = getNin();
+    int const nOut = getNout();
+    _isDiagonal = nIn == nOut;
+    _source.assign(nOut, -1);
+    for (int j = 0; j < nOut; ++j) {
+        for (int i = 0; i < nIn; ++i) {
+            if (_matrix[j * nIn + i] == 0) {
+                continue;
+            }
+            if (i != j) {
+                _isDiagonal = false;
+            }
+            if (_source[j] >= 0) {
+                _isPermutation = false;
+            }
+            _source[j] = i;
+        }
+    }
+    if (!_isPermutation) {
+        _source.clear();
+    }
+}
+
+void AffineKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    if (_isDiagonal) {
+        _applyDiagonal(in, ldIn, nPts, out, ldOut);
+    } else if (_isPermutation) {
+        _applyPermutation(in, ldIn, nPts, out, ldOut);
+    } else {
+        _applyGeneral(in, ldIn, nPts, out, ldOut);
+    }
+}
+
+void AffineKernel::_applyDiagonal(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nAxes = getNin();
+    for (int j = 0; j < nAxes; ++j) {
+        double const a = _matrix[j * nAxes + j];
+        double const b = _offset[j];
+        double const * inRow = in + j * ldIn;
+        double * outRow = out + j * ldOut;
+        if (a == 0) {
+            std::fill(outRow, outRow + nPts, b);
+        } else if (b == 0) {
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] = a * inRow[k];
+            }
+        } else {
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] = a * inRow[k] + b;
+            }
+        }
+    }
+}
+
+void AffineKernel::_applyPermutation(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nIn = getNin();
+    for (int j = 0; j < getNout(); ++j) {
+        double * outRow = out + j * ldOut;
+        double const b = _offset[j];
+        int const i = _source[j];
+        if (i < 0) {
+            std::fill(outRow, outRow + nPts, b);
+            continue;
+        }
+        double const a = _matrix[j * nIn + i];
+        double const * inRow = in + i * ldIn;
+        if ((a == 1) && (b == 0)) {
+            std::copy(inRow, inRow + nPts, outRow);
+        } else {
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] = a * inRow[k] + b;
+            }
+        }
+    }
+}
+
+void AffineKernel::_applyGeneral(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nIn = getNin();
+    int const nOut = getNout();
+    for (int start = 0; start < nPts; start += AFFINE_BLOCK_SIZE) {
+        int const nBlock = std::min(AFFINE_BLOCK_SIZE, nPts - start);
+        int j0 = 0;
+        for (; j0 + AFFINE_TILE_SIZE <= nOut; j0 += AFFINE_TILE_SIZE) {
+            double * o0 = out + j0 * ldOut + start;
+            double * o1 = o0 + ldOut;
+            double * o2 = o1 + ldOut;
+            double * o3 = o2 + ldOut;
+            std::fill(o0, o0 + nBlock, _offset[j0]);
+            std::fill(o1, o1 + nBlock, _offset[j0 + 1]);
+            std::fill(o2, o2 + nBlock, _offset[j0 + 2]);
+            std::fill(o3, o3 + nBlock, _offset[j0 + 3]);
+            for (int i = 0; i < nIn; ++i) {
+                double const a0 = _matrix[j0 * nIn + i];
+                double const a1 = _matrix[(j0 + 1) * nIn + i];
+                double const a2 = _matrix[(j0 + 2) * nIn + i];
+                double const a3 = _matrix[(j0 + 3) * nIn + i];
+                double const * inRow = in + i * ldIn + start;
+                if ((a0 != 0) && (a1 != 0) && (a2 != 0) && (a3 != 0)) {
+                    for (int k = 0; k < nBlock; ++k) {
+                        double const x = inRow[k];
+                        o0[k] += a0 * x;
+                        o1[k] += a1 * x;
+                        o2[k] += a2 * x;
+                        o3[k] += a3 * x;
+                    }
+                    continue;
+                }
+                // zero elements must be skipped, not multiplied, so handle the outputs one at a time
+                double const as[AFFINE_TILE_SIZE] = {a0, a1, a2, a3};
+                double * os[AFFINE_TILE_SIZE] = {o0, o1, o2, o3};
+                for (int t = 0; t < AFFINE_TILE_SIZE; ++t) {
+                    if (as[t] == 0) {
+                        continue;
+                    }
+                    for (int k = 0; k < nBlock; ++k) {
+                        os[t][k] += as[t] * inRow[k];
+                    }
+                }
+            }
+        }
+        for (int j = j0; j < nOut; ++j) {
+            double * outRow = out + j * ldOut + start;
+            std::fill(outRow, outRow + nBlock, _offset[j]);
+            for (int i = 0; i < nIn; ++i) {
+                double const a = _matrix[j * nIn + i];
+                if (a == 0) {
+                    continue;
+                }
+                double const * inRow = in + i * ldIn + start;
+                for (int k = 0; k < nBlock; ++k) {
+                    outRow[k] += a * inRow[k];
+                }
+            }
+        }
+    }
+}
+
+std::shared_ptr<AffineKernel> AffineKernel::compose(AffineKernel const & first, AffineKernel const & second) {
+    assertEqual(first.getNout(), "first.getNout()", second.getNin(), "second.getNin()");
+    int const nIn = first.getNin();
+    int const nMid = first.getNout();
+    int const nOut = second.getNout();
+    std::vector<double> matrix(nOut * nIn, 0.0);
+    std::vector<double> offset(second._offset);
+    for (int j = 0; j < nOut; ++j) {
+        for (int k = 0; k < nMid; ++k) {
+            double const a = second._matrix[j * nMid + k];
+            if (a == 0) {
+                continue;
+            }
+            offset[j] += a * first._offset[k];
+            for (int i = 0; i < nIn; ++i) {
+                matrix[j * nIn + i] += a * first._matrix[k * nIn + i];
+            }
+        }
+    }
+    return std::make_shared<AffineKernel>(matrix, offset);
+}
+
+PolyKernel::PolyKernel(int nIn, int nOut, std::vector<double> const & coeffs) :
+    Kernel(nIn, nOut),
+    _terms(),
+    _maxPower(0)
+{
+    int const rowLen = 2 + nIn;
+    if (coeffs.size() % rowLen != 0) {
+        std::ostringstream os;
+        os << "coeffs.size() = " << coeffs.size() << " is not a multiple of 2 + nIn = " << rowLen;
+        throw std::invalid_argument(os.str());
+    }
+    int const nTerms = coeffs.size() / rowLen;
+    _terms.reserve(nTerms);
+    for (int t = 0; t < nTerms; ++t) {
+        double const * row = coeffs.data() + t * rowLen;
+        Term term;
+        term.coeff = row[0];
+        term.out = static_cast<int>(std::lround(row[1])) - 1;
+        if ((term.out < 0) || (term.out >= nOut)) {
+            std::ostringstream os;
+            os << "coefficient " << t << " is for output " << term.out + 1 << ", not in range [1, "
+                << nOut << "]";
+            throw std::invalid_argument(os.str());
+        }
+        for (int i = 0; i < nIn; ++i) {
+            int const power = static_cast<int>(std::lround(row[2 + i]));
+            if (power < 0) {
+                throw std::invalid_argument("polynomial powers must not be negative");
+            }
+            term.powers.push_back(power);
+            _maxPower = std::max(_maxPower, power);
+        }
+        _terms.push_back(term);
+    }
+}
+
+void PolyKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nIn = getNin();
+    int const nPowers = _maxPower + 1;
+    // powers[(i * nPowers + p) * POLY_BLOCK_SIZE + k] = in[i][start + k]^p for the current block
+    ScratchBuffer powers(nIn * nPowers * POLY_BLOCK_SIZE);
+    ScratchBuffer product(POLY_BLOCK_SIZE);
+    for (int start = 0; start < nPts; start += POLY_BLOCK_SIZE) {
+        int const nBlock = std::min(POLY_BLOCK_SIZE, nPts - start);
+        for (int i = 0; i < nIn; ++i) {
+            double const * inRow = in + i * ldIn + start;
+            double * powRow = powers.data() + i * nPowers * POLY_BLOCK_SIZE;
+            std::fill(powRow, powRow + nBlock, 1.0);
+            for (int p = 1; p < nPowers; ++p) {
+                double * prevRow = powRow + (p - 1) * POLY_BLOCK_SIZE;
+                double * curRow = powRow + p * POLY_BLOCK_SIZE;
+                for (int k = 0; k < nBlock; ++k) {
+                    curRow[k] = prevRow[k] * inRow[k];
+                }
+            }
+        }
+
+        for (int j = 0; j < getNout(); ++j) {
+            std::fill(out + j * ldOut + start, out + j * ldOut + start + nBlock, 0.0);
+        }
+        for (auto const & term : _terms) {
+            std::fill(product.data(), product.data() + nBlock, term.coeff);
+            for (int i = 0; i < nIn; ++i) {
+                if (term.powers[i] == 0) {
+                    continue;
+                }
+                double const * powRow = powers.data() + (i * nPowers + term.powers[i]) * POLY_BLOCK_SIZE;
+                for (int k = 0; k < nBlock; ++k) {
+                    product[k] *= powRow[k];
+                }
+            }
+            double * outRow = out + term.out * ldOut + start;
+            for (int k = 0; k < nBlock; ++k) {
+                outRow[k] += product[k];
+            }
+        }
+    }
+
+    // like AST, a bad value for any input gives bad values for all outputs
+    for (int i = 0; i < nIn; ++i) {
+        double const * inRow = in + i * ldIn;
+        for (int k = 0; k < nPts; ++k) {
+            if (std::isnan(inRow[k])) {
+                for (int j = 0; j < getNout(); ++j) {
+                    out[j * ldOut + k] = NaN;
+                }
+            }
+        }
+    }
+}
+
+ChebyKernel::ChebyKernel(int nIn, int nOut, std::vector<double> const & coeffs,
+                         std::vector<double> const & lbnd, std::vector<double> const & ubnd) :
+    Kernel(nIn, nOut),
+    _series(nOut),
+    _lbnd(lbnd),
+    _ubnd(ubnd)
+{
+    assertEqual(lbnd.size(), "lbnd.size()", static_cast<std::size_t>(nIn), "nIn");
+    assertEqual(ubnd.size(), "ubnd.size()", static_cast<std::size_t>(nIn), "nIn");
+    for (int i = 0; i < nIn; ++i) {
+        if (!(ubnd[i] > lbnd[i])) {
+            std::ostringstream os;
+            os << "ubnd[" << i << "] = " << ubnd[i] << " <= lbnd[" << i << "] = " << lbnd[i];
+            throw std::invalid_argument(os.str());
+        }
+    }
+    int const rowLen = 2 + nIn;
+    if (coeffs.size() % rowLen != 0) {
+        std::ostringstream os;
+        os << "coeffs.size() = " << coeffs.size() << " is not a multiple of 2 + nIn = " << rowLen;
+        throw std::invalid_argument(os.str());
+    }
+    int const nTerms = coeffs.size() / rowLen;
+    std::vector<int> outs(nTerms);
+    std::vector<int> degrees(nTerms * nIn);
+    for (auto & series : _series) {
+        series.shape.assign(nIn, 1);
+    }
+    for (int t = 0; t < nTerms; ++t) {
+        double const * row = coeffs.data() + t * rowLen;
+        outs[t] = static_cast<int>(std::lround(row[1])) - 1;
+        if ((outs[t] < 0) || (outs[t] >= nOut)) {
+            std::ostringstream os;
+            os << "coefficient " << t << " is for output " << outs[t] + 1 << ", not in range [1, "
+                << nOut << "]";
+            throw std::invalid_argument(os.str());
+        }
+        for (int i = 0; i < nIn; ++i) {
+            int const degree = static_cast<int>(std::lround(row[2 + i]));
+            if (degree < 0) {
+                throw std::invalid_argument("Chebyshev polynomial degrees must not be negative");
+            }
+            degrees[t * nIn + i] = degree;
+            int & size = _series[outs[t]].shape[i];
+            size = std::max(size, degree + 1);
+        }
+    }
+    for (auto & series : _series) {
+        series.strides.assign(nIn, 1);
+        for (int i = nIn - 2; i >= 0; --i) {
+            series.strides[i] = series.strides[i + 1] * series.shape[i + 1];
+        }
+        series.coeffs.assign(series.strides[0] * series.shape[0], 0.0);
+    }
+    for (int t = 0; t < nTerms; ++t) {
+        Series & series = _series[outs[t]];
+        std::size_t index = 0;
+        for (int i = 0; i < nIn; ++i) {
+            index += degrees[t * nIn + i] * series.strides[i];
+        }
+        series.coeffs[index] += coeffs[t * rowLen];
+    }
+}
+
+void ChebyKernel::_clenshaw(Series const & series, int axis, std::size_t offset, double const * u, int nPts,
+                            double * result, double * scratch) const {
+    // b1 and b2 are the previous two terms of the recurrence b_k = c_k + 2 u b_{k+1} - b_{k+2};
+    // for all but the last input each c_k is itself a series in the remaining inputs
+    double * b1 = scratch;
+    double * b2 = scratch + CHEBY_BLOCK_SIZE;
+    double * term = scratch + 2 * CHEBY_BLOCK_SIZE;
+    double * childScratch = scratch + 3 * CHEBY_BLOCK_SIZE;
+    double const * uRow = u + axis * CHEBY_BLOCK_SIZE;
+    bool const isLast = axis + 1 == getNin();
+    std::size_t const stride = series.strides[axis];
+    std::fill(b1, b1 + nPts, 0.0);
+    std::fill(b2, b2 + nPts, 0.0);
+    for (int k = series.shape[axis] - 1; k >= 1; --k) {
+        if (isLast) {
+            double const coeff = series.coeffs[offset + k];
+            for (int p = 0; p < nPts; ++p) {
+                double const b0 = coeff + 2.0 * uRow[p] * b1[p] - b2[p];
+                b2[p] = b1[p];
+                b1[p] = b0;
+            }
+        } else {
+            _clenshaw(series, axis + 1, offset + k * stride, u, nPts, term, childScratch);
+            for (int p = 0; p < nPts; ++p) {
+                double const b0 = term[p] + 2.0 * uRow[p] * b1[p] - b2[p];
+                b2[p] = b1[p];
+                b1[p] = b0;
+            }
+        }
+    }
+    if (isLast) {
+        double const coeff = series.coeffs[offset];
+        for (int p = 0; p < nPts; ++p) {
+            result[p] = coeff + uRow[p] * b1[p] - b2[p];
+        }
+    } else {
+        _clenshaw(series, axis + 1, offset, u, nPts, term, childScratch);
+        for (int p = 0; p < nPts; ++p) {
+            result[p] = term[p] + uRow[p] * b1[p] - b2[p];
+        }
+    }
+}
+
+void ChebyKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nIn = getNin();
+    // u holds the inputs of one block scaled to [-1, 1]; scratch holds 3 rows per level of recursion
+    ScratchBuffer u(nIn * CHEBY_BLOCK_SIZE);
+    ScratchBuffer scratch(3 * nIn * CHEBY_BLOCK_SIZE);
+    std::vector<double> center(nIn);
+    std::vector<double> scale(nIn);
+    for (int i = 0; i < nIn; ++i) {
+        center[i] = 0.5 * (_ubnd[i] + _lbnd[i]);
+        scale[i] = 2.0 / (_ubnd[i] - _lbnd[i]);
+    }
+    for (int start = 0; start < nPts; start += CHEBY_BLOCK_SIZE) {
+        int const nBlock = std::min(CHEBY_BLOCK_SIZE, nPts - start);
+        for (int i = 0; i < nIn; ++i) {
+            double const * inRow = in + i * ldIn + start;
+            double * uRow = u.data() + i * CHEBY_BLOCK_SIZE;
+            for (int p = 0; p < nBlock; ++p) {
+                uRow[p] = (inRow[p] - center[i]) * scale[i];
+            }
+        }
+        for (int j = 0; j < getNout(); ++j) {
+            _clenshaw(_series[j], 0, 0, u.data(), nBlock, out + j * ldOut + start, scratch.data());
+        }
+        for (int i = 0; i < nIn; ++i) {
+            double const * inRow = in + i * ldIn + start;
+            for (int p = 0; p < nBlock; ++p) {
+                if (!((inRow[p] >= _lbnd[i]) && (inRow[p] <= _ubnd[i]))) {
+                    for (int j = 0; j < getNout(); ++j) {
+                        out[j * ldOut + start + p] = NaN;
+                    }
+                }
+            }
+        }
+    }
+}
+
+LutKernel::LutKernel(std::vector<double> const & lut, double start, double inc, bool forward) :
+    Kernel(1, 1),
+    _lut(lut),
+    _start(start),
+    _inc(inc),
+    _forward(forward),
+    _sign(1.0),
+    _bucketOrigin(0.0),
+    _bucketScale(0.0),
+    _buckets()
+{
+    if (lut.size() < 2) {
+        std::ostringstream os;
+        os << "lut.size() = " << lut.size() << " < 2";
+        throw std::invalid_argument(os.str());
+    }
+    if (!(inc != 0) || !std::isfinite(inc) || !std::isfinite(start)) {
+        std::ostringstream os;
+        os << "start = " << start << " and inc = " << inc << " must be finite and inc must not be 0";
+        throw std::invalid_argument(os.str());
+    }
+    if (forward) {
+        return;
+    }
+    if (!isStrictlyMonotonic(lut)) {
+        throw std::invalid_argument("the inverse needs a table that is strictly monotonic");
+    }
+    if (lut.back() < lut.front()) {
+        _sign = -1.0;
+        for (auto & value : _lut) {
+            value = -value;
+        }
+    }
+    int const nIntervals = _lut.size() - 1;
+    _bucketOrigin = _lut.front();
+    _bucketScale = nIntervals / (_lut.back() - _lut.front());
+    _buckets.resize(nIntervals + 1);
+    int interval = 0;
+    for (int b = 0; b < nIntervals; ++b) {
+        double const edge = _bucketOrigin + b / _bucketScale;
+        while ((interval < nIntervals - 1) && (_lut[interval + 1] <= edge)) {
+            ++interval;
+        }
+        _buckets[b] = interval;
+    }
+    _buckets[nIntervals] = nIntervals - 1;
+}
+
+bool LutKernel::isStrictlyMonotonic(std::vector<double> const & lut) {
+    if (lut.size() < 2) {
+        return false;
+    }
+    bool const increasing = lut[1] > lut[0];
+    for (std::size_t i = 1; i < lut.size(); ++i) {
+        if (increasing ? !(lut[i] > lut[i - 1]) : !(lut[i] < lut[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int LutKernel::_findInterval(double value) const {
+    int const nIntervals = _buckets.size() - 1;
+    double const b = std::floor((value - _bucketOrigin) * _bucketScale);
+    int const bucket = b < 0 ? 0 : (b >= nIntervals ? nIntervals - 1 : static_cast<int>(b));
+    int lo = _buckets[bucket];
+    int const hi = _buckets[bucket + 1];
+    if (hi - lo <= LUT_LINEAR_SEARCH_SIZE) {
+        while ((lo < hi) && (_lut[lo + 1] <= value)) {
+            ++lo;
+        }
+    } else {
+        lo = std::upper_bound(_lut.begin() + lo + 1, _lut.begin() + hi + 1, value) - _lut.begin() - 1;
+    }
+    // allow for rounding in the bucket number
+    while ((lo > 0) && (_lut[lo] > value)) {
+        --lo;
+    }
+    return lo;
+}
+
+void LutKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    double const * lut = _lut.data();
+    double const maxInterval = _lut.size() - 2;
+    if (_forward) {
+        for (int k = 0; k < nPts; ++k) {
+            double const x = (in[k] - _start) / _inc;
+            if (std::isnan(x)) {
+                out[k] = NaN;
+                continue;
+            }
+            double const fl = std::floor(x);
+            int const i = fl < 0 ? 0 : static_cast<int>(std::min(fl, maxInterval));
+            out[k] = lut[i] + (x - i) * (lut[i + 1] - lut[i]);
+        }
+        return;
+    }
+    for (int k = 0; k < nPts; ++k) {
+        double const value = _sign * in[k];
+        if (std::isnan(value)) {
+            out[k] = NaN;
+            continue;
+        }
+        int const i = _findInterval(value);
+        double const x = i + (value - lut[i]) / (lut[i + 1] - lut[i]);
+        out[k] = _start + x * _inc;
+    }
+}
+
+GridKernel::GridKernel(std::shared_ptr<GridField const> const & field, bool forward) :
+    Kernel(2, 2),
+    _field(field),
+    _forward(forward)
+{
+    if ((field->nx < 2) || (field->ny < 2)) {
+        std::ostringstream os;
+        os << "grid is " << field->nx << " x " << field->ny << " points; it must be at least 2 x 2";
+        throw std::invalid_argument(os.str());
+    }
+    if (!(field->sx > 0) || !(field->sy > 0)) {
+        std::ostringstream os;
+        os << "grid spacing (" << field->sx << ", " << field->sy << ") must be positive";
+        throw std::invalid_argument(os.str());
+    }
+    std::size_t const nGrid = static_cast<std::size_t>(field->nx) * field->ny;
+    assertEqual(field->dx.size(), "dx.size()", nGrid, "number of grid points");
+    assertEqual(field->dy.size(), "dy.size()", nGrid, "number of grid points");
+}
+
+void GridKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    if (_forward) {
+        _applyForward(in, ldIn, nPts, out, ldOut);
+    } else {
+        _applyInverse(in, ldIn, nPts, out, ldOut);
+    }
+    // like AST, a bad value for either input gives bad values for both outputs
+    for (int k = 0; k < nPts; ++k) {
+        if (std::isnan(in[k]) || std::isnan(in[ldIn + k])) {
+            out[k] = NaN;
+            out[ldOut + k] = NaN;
+        }
+    }
+}
+
+void GridKernel::_applyForward(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    GridField const & field = *_field;
+    double const maxX = field.nx - 1;
+    double const maxY = field.ny - 1;
+    double const * gridDx = field.dx.data();
+    double const * gridDy = field.dy.data();
+    // for each point of a block: the index of the grid point at the lower left corner of its cell,
+    // and its fractional position within the cell
+    ScratchBuffer cell(GRID_BLOCK_SIZE);
+    ScratchBuffer fracX(GRID_BLOCK_SIZE);
+    ScratchBuffer fracY(GRID_BLOCK_SIZE);
+    for (int start = 0; start < nPts; start += GRID_BLOCK_SIZE) {
+        int const nBlock = std::min(GRID_BLOCK_SIZE, nPts - start);
+        double const * xIn = in + start;
+        double const * yIn = in + ldIn + start;
+        double * xOut = out + start;
+        double * yOut = out + ldOut + start;
+
+        for (int k = 0; k < nBlock; ++k) {
+            double const gx = std::min(std::max((xIn[k] - field.x0) / field.sx, 0.0), maxX);
+            double const gy = std::min(std::max((yIn[k] - field.y0) / field.sy, 0.0), maxY);
+            double const ix = std::min(std::floor(gx), maxX - 1);
+            double const iy = std::min(std::floor(gy), maxY - 1);
+            cell[k] = iy * field.nx + ix;
+            fracX[k] = gx - ix;
+            fracY[k] = gy - iy;
+        }
+
+        if (!field.bicubic) {
+            for (int k = 0; k < nBlock; ++k) {
+                std::size_t const i00 = static_cast<std::size_t>(cell[k]);
+                std::size_t const i10 = i00 + field.nx;
+                double const fx = fracX[k];
+                double const fy = fracY[k];
+                double const w00 = (1.0 - fx) * (1.0 - fy);
+                double const w01 = fx * (1.0 - fy);
+                double const w10 = (1.0 - fx) * fy;
+                double const w11 = fx * fy;
+                xOut[k] = xIn[k] + w00 * gridDx[i00] + w01 * gridDx[i00 + 1] + w10 * gridDx[i10] +
+                          w11 * gridDx[i10 + 1];
+                yOut[k] = yIn[k] + w00 * gridDy[i00] + w01 * gridDy[i00 + 1] + w10 * gridDy[i10] +
+                          w11 * gridDy[i10 + 1];
+            }
+            continue;
+        }
+        for (int k = 0; k < nBlock; ++k) {
+            int const ix = static_cast<int>(cell[k]) % field.nx;
+            int const iy = static_cast<int>(cell[k]) / field.nx;
+            double wx[4], wy[4];
+            cubicWeights(fracX[k], wx, nullptr);
+            cubicWeights(fracY[k], wy, nullptr);
+            int cols[4];
+            for (int c = 0; c < 4; ++c) {
+                cols[c] = std::min(std::max(ix - 1 + c, 0), field.nx - 1);
+            }
+            double sumDx = 0.0;
+            double sumDy = 0.0;
+            for (int r = 0; r < 4; ++r) {
+                std::size_t const rowStart =
+                        static_cast<std::size_t>(std::min(std::max(iy - 1 + r, 0), field.ny - 1)) * field.nx;
+                double rowDx = 0.0;
+                double rowDy = 0.0;
+                for (int c = 0; c < 4; ++c) {
+                    rowDx += wx[c] * gridDx[rowStart + cols[c]];
+                    rowDy += wx[c] * gridDy[rowStart + cols[c]];
+                }
+                sumDx += wy[r] * rowDx;
+                sumDy += wy[r] * rowDy;
+            }
+            xOut[k] = xIn[k] + sumDx;
+            yOut[k] = yIn[k] + sumDy;
+        }
+    }
+}
+
+void GridKernel::_displacement(double x, double y, double & dx, double & dy, double * gradient) const {
+    GridField const & field = *_field;
+    double const maxX = field.nx - 1;
+    double const maxY = field.ny - 1;
+    double const rawX = (x - field.x0) / field.sx;
+    double const rawY = (y - field.y0) / field.sy;
+    double const gx = std::min(std::max(rawX, 0.0), maxX);
+    double const gy = std::min(std::max(rawY, 0.0), maxY);
+    // beyond the grid the displacement is constant along the clamped axis
+    double const scaleX = (rawX == gx) ? 1.0 / field.sx : 0.0;
+    double const scaleY = (rawY == gy) ? 1.0 / field.sy : 0.0;
+    int const ix = static_cast<int>(std::min(std::floor(gx), maxX - 1));
+    int const iy = static_cast<int>(std::min(std::floor(gy), maxY - 1));
+    double const fx = gx - ix;
+    double const fy = gy - iy;
+
+    double const * grids[2] = {field.dx.data(), field.dy.data()};
+    double values[2];
+    for (int g = 0; g < 2; ++g) {
+        double const * grid = grids[g];
+        double value = 0.0;
+        double dByX = 0.0;
+        double dByY = 0.0;
+        if (!field.bicubic) {
+            std::size_t const i00 = static_cast<std::size_t>(iy) * field.nx + ix;
+            std::size_t const i10 = i00 + field.nx;
+            double const bottom = grid[i00] + fx * (grid[i00 + 1] - grid[i00]);
+            double const top = grid[i10] + fx * (grid[i10 + 1] - grid[i10]);
+            value = bottom + fy * (top - bottom);
+            dByX = (1.0 - fy) * (grid[i00 + 1] - grid[i00]) + fy * (grid[i10 + 1] - grid[i10]);
+            dByY = top - bottom;
+        } else {
+            double wx[4], wy[4], dwx[4], dwy[4];
+            cubicWeights(fx, wx, dwx);
+            cubicWeights(fy, wy, dwy);
+            for (int r = 0; r < 4; ++r) {
+                std::size_t const rowStart =
+                        static_cast<std::size_t>(std::min(std::max(iy - 1 + r, 0), field.ny - 1)) * field.nx;
+                double row = 0.0;
+                double rowByX = 0.0;
+                for (int c = 0; c < 4; ++c) {
+                    double const sample = grid[rowStart + std::min(std::max(ix - 1 + c, 0), field.nx - 1)];
+                    row += wx[c] * sample;
+                    rowByX += dwx[c] * sample;
+                }
+                value += wy[r] * row;
+                dByX += wy[r] * rowByX;
+                dByY += dwy[r] * row;
+            }
+        }
+        values[g] = value;
+        if (gradient) {
+            gradient[2 * g] = dByX * scaleX;
+            gradient[2 * g + 1] = dByY * scaleY;
+        }
+    }
+    dx = values[0];
+    dy = values[1];
+}
+
+void GridKernel::_applyInverse(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    double const spacing = std::min(_field->sx, _field->sy);
+    for (int k = 0; k < nPts; ++k) {
+        double const u = in[k];
+        double const v = in[ldIn + k];
+        if (std::isnan(u) || std::isnan(v)) {
+            continue;  // apply sets the outputs
+        }
+        double const tol = GRID_INVERSE_TOLERANCE * (spacing + std::fabs(u) + std::fabs(v));
+        double dx, dy;
+        _displacement(u, v, dx, dy, nullptr);
+        double x = u - dx;
+        double y = v - dy;
+        bool converged = false;
+        for (int iter = 0; iter < GRID_INVERSE_MAX_ITER; ++iter) {
+            double gradient[4];
+            _displacement(x, y, dx, dy, gradient);
+            double const resX = x + dx - u;
+            double const resY = y + dy - v;
+            if ((std::fabs(resX) <= tol) && (std::fabs(resY) <= tol)) {
+                converged = true;
+                break;
+            }
+            // solve (I + gradient) step = residual
+            double const a = 1.0 + gradient[0];
+            double const b = gradient[1];
+            double const c = gradient[2];
+            double const d = 1.0 + gradient[3];
+            double const det = a * d - b * c;
+            if (!(det > 0.0)) {
+                break;
+            }
+            x -= (d * resX - b * resY) / det;
+            y -= (a * resY - c * resX) / det;
+        }
+        out[k] = converged ? x : NaN;
+        out[ldOut + k] = converged ? y : NaN;
+    }
+}
+
+SphKernel::SphKernel(double polarLong, bool forward) :
+    Kernel(forward ? 3 : 2, forward ? 2 : 3),
+    _polarLong(polarLong),
+    _forward(forward)
+{}
+
+void SphKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    ScratchBuffer scratch(4 * SPH_BLOCK_SIZE);
+    for (int start = 0; start < nPts; start += SPH_BLOCK_SIZE) {
+        int const nBlock = std::min(SPH_BLOCK_SIZE, nPts - start);
+        if (_forward) {
+            double const * x = in + start;
+            double const * y = x + ldIn;
+            double const * z = y + ldIn;
+            double * lon = out + start;
+            double * lat = lon + ldOut;
+            double * r = scratch.data();
+            for (int k = 0; k < nBlock; ++k) {
+                r[k] = std::sqrt(x[k] * x[k] + y[k] * y[k]);
+            }
+            atan2N(y, x, nBlock, lon);
+            atan2N(z, r, nBlock, lat);
+            for (int k = 0; k < nBlock; ++k) {
+                if (r[k] == 0.0) {
+                    // a pole, or bad if the vector is zero
+                    lon[k] = z[k] == 0.0 ? NaN : _polarLong;
+                }
+                if (std::isnan(lon[k]) || std::isnan(lat[k])) {
+                    lon[k] = NaN;
+                    lat[k] = NaN;
+                }
+            }
+        } else {
+            double const * lon = in + start;
+            double const * lat = lon + ldIn;
+            double * x = out + start;
+            double * y = x + ldOut;
+            double * z = y + ldOut;
+            double * sinLon = scratch.data();
+            double * cosLon = sinLon + SPH_BLOCK_SIZE;
+            double * sinLat = cosLon + SPH_BLOCK_SIZE;
+            double * cosLat = sinLat + SPH_BLOCK_SIZE;
+            sinCosN(lon, nBlock, sinLon, cosLon);
+            sinCosN(lat, nBlock, sinLat, cosLat);
+            for (int k = 0; k < nBlock; ++k) {
+                // 0, or NaN if either input is bad
+                double const bad = (lon[k] - lon[k]) + (lat[k] - lat[k]);
+                x[k] = cosLat[k] * cosLon[k] + bad;
+                y[k] = cosLat[k] * sinLon[k] + bad;
+                z[k] = sinLat[k] + bad;
+            }
+        }
+    }
+}
+
+UnitNormKernel::UnitNormKernel(std::vector<double> const & centre, bool forward) :
+    Kernel(static_cast<int>(centre.size()) + (forward ? 0 : 1),
+           static_cast<int>(centre.size()) + (forward ? 1 : 0)),
+    _centre(centre),
+    _forward(forward)
+{
+    if (centre.empty()) {
+        throw std::invalid_argument("a UnitNormKernel needs at least one axis");
+    }
+}
+
+void UnitNormKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nAxes = _centre.size();
+    if (_forward) {
+        // the norm of a bad offset is bad, and the unit vector of a zero offset is 0/0
+        double * norm = out + nAxes * ldOut;
+        std::fill(norm, norm + nPts, 0.0);
+        for (int i = 0; i < nAxes; ++i) {
+            double const * inRow = in + i * ldIn;
+            double * outRow = out + i * ldOut;
+            double const centre = _centre[i];
+            for (int k = 0; k < nPts; ++k) {
+                double const offset = inRow[k] - centre;
+                outRow[k] = offset;
+                norm[k] += offset * offset;
+            }
+        }
+        for (int k = 0; k < nPts; ++k) {
+            norm[k] = std::sqrt(norm[k]);
+        }
+        for (int i = 0; i < nAxes; ++i) {
+            double * outRow = out + i * ldOut;
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] /= norm[k];
+            }
+        }
+    } else {
+        double const * norm = in + nAxes * ldIn;
+        ScratchBuffer badBuffer(nPts);
+        double * bad = badBuffer.data();
+        std::fill(bad, bad + nPts, 0.0);
+        for (int i = 0; i < nAxes; ++i) {
+            double const * inRow = in + i * ldIn;
+            double * outRow = out + i * ldOut;
+            double const centre = _centre[i];
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] = inRow[k] * norm[k] + centre;
+                // 0, or NaN if any output so far is bad
+                bad[k] += outRow[k] - outRow[k];
+            }
+        }
+        for (int i = 0; i < nAxes; ++i) {
+            double * outRow = out + i * ldOut;
+            for (int k = 0; k < nPts; ++k) {
+                outRow[k] += bad[k];
+            }
+        }
+    }
+}
+
+PiecewiseCubicKernel::PiecewiseCubicKernel(std::vector<double> const & start,
+                                           std::vector<double> const & scale,
+                                           std::vector<double> const & y0, std::vector<double> const & d1,
+                                           std::vector<double> const & d2, std::vector<double> const & d3) :
+    Kernel(1, 1),
+    _start(start),
+    _scale(scale),
+    _y0(y0),
+    _d1(d1),
+    _d2(d2),
+    _d3(d3)
+{
+    std::size_t const nSegments = start.size();
+    if (nSegments == 0) {
+        throw std::invalid_argument("A PiecewiseCubicKernel needs at least one segment");
+    }
+    if ((scale.size() != nSegments) || (y0.size() != nSegments) || (d1.size() != nSegments) ||
+        (d2.size() != nSegments) || (d3.size() != nSegments)) {
+        std::ostringstream os;
+        os << "start has " << nSegments << " elements, but scale, y0, d1, d2 and d3 have " << scale.size()
+           << ", " << y0.size() << ", " << d1.size() << ", " << d2.size() << " and " << d3.size();
+        throw std::invalid_argument(os.str());
+    }
+    for (std::size_t i = 1; i < nSegments; ++i) {
+        if (!(start[i] > start[i - 1])) {
+            std::ostringstream os;
+            os << "start[" << i << "] = " << start[i] << " <= start[" << i - 1 << "] = " << start[i - 1];
+            throw std::invalid_argument(os.str());
+        }
+    }
+}
+
+void PiecewiseCubicKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nSegments = getNSegments();
+    // for each point of a block: its segment, and its position within the segment
+    ScratchBuffer segment(PIECEWISE_BLOCK_SIZE);
+    ScratchBuffer position(PIECEWISE_BLOCK_SIZE);
+    int current = 0;
+    for (int start = 0; start < nPts; start += PIECEWISE_BLOCK_SIZE) {
+        int const nBlock = std::min(PIECEWISE_BLOCK_SIZE, nPts - start);
+        double const * xIn = in + start;
+        double * yOut = out + start;
+
+        for (int k = 0; k < nBlock; ++k) {
+            double const x = xIn[k];
+            bool const inCurrent = (x >= _start[current]) &&
+                                   ((current + 1 == nSegments) || (x < _start[current + 1]));
+            if (!inCurrent && !std::isnan(x)) {
+                // the last segment that starts at or before x, or the first segment if none does
+                auto const next = std::upper_bound(_start.begin(), _start.end(), x);
+                current = std::max(static_cast<int>(next - _start.begin()) - 1, 0);
+            }
+            segment[k] = current;
+            position[k] = (x - _start[current]) * _scale[current];
+        }
+
+        for (int k = 0; k < nBlock; ++k) {
+            std::size_t const i = static_cast<std::size_t>(segment[k]);
+            double const s = position[k];
+            yOut[k] = _y0[i] + s * (_d1[i] + (s - 1.0) * (_d2[i] + (s - 2.0) * _d3[i]));
+        }
+    }
+}
+
+namespace {
+
+/// One segment of a PiecewiseCubicKernel, while a table is being made
+struct CubicSegment {
+    double start;
+    double scale;
+    double y0;
+    double d1;
+    double d2;
+    double d3;
+
+    /**
+    Make the segment through values at 4 equally spaced points
+
+    @param[in] a  The first point
+    @param[in] b  The last point; if equal to `a` the segment is constant
+    @param[in] y  The values at a, (2a + b)/3, (a + 2b)/3 and b
+    */
+    CubicSegment(double a, double b, double const * y) :
+        start(a),
+        scale(b > a ? 3.0 / (b - a) : 0.0),
+        y0(y[0])
+    {
+        // differences of neighbouring values first, so they are exact for values that nearly agree
+        double const e1 = y[1] - y[0];
+        double const e2 = y[2] - y[1];
+        double const e3 = y[3] - y[2];
+        d1 = e1;
+        d2 = 0.5 * (e2 - e1);
+        d3 = ((e3 - e2) - (e2 - e1)) / 6.0;
+        if (scale == 0.0) {
+            d1 = d2 = d3 = 0.0;
+        }
+    }
+
+    double operator()(double x) const {
+        double const s = (x - start) * scale;
+        return y0 + s * (d1 + (s - 1.0) * (d2 + (s - 2.0) * d3));
+    }
+};
+
+}  // anonymous namespace
+
+std::shared_ptr<Kernel const> tabulateKernel(Kernel const & source, double lo, double hi,
+                                             std::size_t maxEvaluations) {
+    if ((source.getNin() != 1) || (source.getNout() != 1) || !std::isfinite(lo) || !std::isfinite(hi) ||
+        !(lo <= hi)) {
+        return nullptr;
+    }
+    if (maxEvaluations < static_cast<std::size_t>(3 * TABLE_NOISE_PROBE_SIZE + 7 * TABLE_INITIAL_SEGMENTS +
+                                                  TABLE_N_CHECKS)) {
+        return nullptr;
+    }
+    std::size_t nEvaluations = 0;
+    // evaluate `source` at `x`; return false if it gives a bad value or the evaluations run out
+    auto evaluate = [&source, &nEvaluations, maxEvaluations](std::vector<double> const & x,
+                                                             std::vector<double> & y) {
+        nEvaluations += x.size();
+        if (nEvaluations > maxEvaluations) {
+            return false;
+        }
+        int const n = static_cast<int>(x.size());
+        y.resize(n);
+        source.apply(x.data(), n, n, y.data(), n);
+        return std::all_of(y.begin(), y.end(), [](double value) { return std::isfinite(value); });
+    };
+    double const epsilon = std::numeric_limits<double>::epsilon();
+
+    // estimate the rounding error of `source` from the scatter of its values about a straight line,
+    // at closely spaced points at either end and in the middle of the range
+    int const nProbe = TABLE_NOISE_PROBE_SIZE;
+    std::vector<double> probeX;
+    for (double centre : {lo, lo + 0.5 * (hi - lo), hi}) {
+        double const spacing = std::max(1e-9 * (hi - lo), 64.0 * epsilon * std::max(std::fabs(centre), 1.0));
+        double const first = std::max(lo, std::min(centre, hi - (nProbe - 1) * spacing));
+        for (int j = 0; j < nProbe; ++j) {
+            probeX.push_back(first + j * spacing);
+        }
+    }
+    std::vector<double> probeY;
+    if (!evaluate(probeX, probeY)) {
+        return nullptr;
+    }
+    double scatter[3];
+    double maxAbs = 0.0;
+    for (int c = 0; c < 3; ++c) {
+        double const * x = probeX.data() + c * nProbe;
+        double const * y = probeY.data() + c * nProbe;
+        double const slope = (y[nProbe - 1] - y[0]) / (x[nProbe - 1] - x[0]);
+        scatter[c] = 0.0;
+        for (int j = 0; j < nProbe; ++j) {
+            scatter[c] = std::max(scatter[c], std::fabs(y[j] - (y[0] + slope * (x[j] - x[0]))));
+            maxAbs = std::max(maxAbs, std::fabs(y[j]));
+        }
+    }
+    // the median, in case a jump lies within one set of points
+    std::sort(scatter, scatter + 3);
+    double const noise = scatter[1];
+    if (!(noise <= TABLE_MAX_NOISE * (1.0 + maxAbs))) {
+        return nullptr;
+    }
+    double const tolerance = 2.0 * std::max(noise, epsilon * maxAbs);
+
+    // split segments until each matches `source` between the points it was made from;
+    // a segment whose ends are adjacent doubles has a jump between them and is replaced by its start
+    std::vector<CubicSegment> segments;
+    std::vector<std::pair<double, double>> pending;
+    for (int i = 0; i < TABLE_INITIAL_SEGMENTS; ++i) {
+        double const a = lo + (hi - lo) * i / TABLE_INITIAL_SEGMENTS;
+        bool const isLast = (i + 1 == TABLE_INITIAL_SEGMENTS);
+        double const b = isLast ? hi : lo + (hi - lo) * (i + 1) / TABLE_INITIAL_SEGMENTS;
+        if ((a < b) || (isLast && pending.empty())) {
+            pending.emplace_back(a, b);
+        }
+    }
+    while (!pending.empty()) {
+        std::vector<double> x;
+        for (auto const & ends : pending) {
+            for (int j = 0; j < 6; ++j) {
+                x.push_back(ends.first + (ends.second - ends.first) * j / 6.0);
+            }
+            x.push_back(ends.second);
+        }
+        std::vector<double> y;
+        if (!evaluate(x, y)) {
+            return nullptr;
+        }
+        std::vector<std::pair<double, double>> next;
+        for (std::size_t p = 0; p < pending.size(); ++p) {
+            double const a = pending[p].first;
+            double const b = pending[p].second;
+            double const * segX = x.data() + 7 * p;
+            double const * segY = y.data() + 7 * p;
+            double const nodes[4] = {segY[0], segY[2], segY[4], segY[6]};
+            CubicSegment const segment(a, b, nodes);
+            bool matches = true;
+            for (int j = 1; j < 7; j += 2) {
+                matches = matches && (std::fabs(segment(segX[j]) - segY[j]) <= tolerance);
+            }
+            double const middle = a + 0.5 * (b - a);
+            if (matches || (a == b)) {
+                segments.push_back(segment);
+            } else if ((middle > a) && (middle < b)) {
+                next.emplace_back(a, middle);
+                next.emplace_back(middle, b);
+            } else {
+                double const startValue[4] = {segY[0], segY[0], segY[0], segY[0]};
+                segments.emplace_back(a, a, startValue);
+                if (b == hi) {
+                    double const endValue[4] = {segY[6], segY[6], segY[6], segY[6]};
+                    segments.emplace_back(b, b, endValue);
+                }
+            }
+        }
+        pending.swap(next);
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](CubicSegment const & seg1, CubicSegment const & seg2) { return seg1.start < seg2.start; });
+    std::size_t const nSegments = segments.size();
+    std::vector<double> start(nSegments), scale(nSegments), y0(nSegments), d1(nSegments), d2(nSegments),
+            d3(nSegments);
+    for (std::size_t i = 0; i < nSegments; ++i) {
+        start[i] = segments[i].start;
+        scale[i] = segments[i].scale;
+        y0[i] = segments[i].y0;
+        d1[i] = segments[i].d1;
+        d2[i] = segments[i].d2;
+        d3[i] = segments[i].d3;
+    }
+    auto table = std::make_shared<PiecewiseCubicKernel>(start, scale, y0, d1, d2, d3);
+
+    // check the table at points scattered over the range (a Weyl sequence), in case `source` varies
+    // on scales shorter than a segment in a way that the points each segment was checked at missed
+    double const goldenFraction = 0.61803398874989485;
+    std::vector<double> checkX(TABLE_N_CHECKS);
+    for (int k = 0; k < TABLE_N_CHECKS; ++k) {
+        checkX[k] = lo + (hi - lo) * std::fmod((k + 0.5) * goldenFraction, 1.0);
+    }
+    std::vector<double> expected;
+    if (!evaluate(checkX, expected)) {
+        return nullptr;
+    }
+    std::vector<double> actual(TABLE_N_CHECKS);
+    table->apply(checkX.data(), TABLE_N_CHECKS, TABLE_N_CHECKS, actual.data(), TABLE_N_CHECKS);
+    for (int k = 0; k < TABLE_N_CHECKS; ++k) {
+        if (!(std::fabs(actual[k] - expected[k]) <= tolerance)) {
+            return nullptr;
+        }
+    }
+    return table;
+}
+
+SeriesKernel::SeriesKernel(std::vector<std::shared_ptr<Kernel const>> const & kernels) :
+    Kernel(kernels.empty() ? 0 : kernels.front()->getNin(), kernels.empty() ? 0 : kernels.back()->getNout()),
+    _kernels(kernels),
+    _maxAxes(0)
+{
+    if (kernels.empty()) {
+        throw std::invalid_argument("a SeriesKernel needs at least one kernel");
+    }
+    for (std::size_t i = 1; i < kernels.size(); ++i) {
+        assertEqual(kernels[i - 1]->getNout(), "nOut of previous kernel", kernels[i]->getNin(),
+                    "nIn of next kernel");
+        _maxAxes = std::max(_maxAxes, kernels[i]->getNin());
+    }
+}
+
+bool SeriesKernel::isNative() const {
+    for (auto const & kernel : _kernels) {
+        if (!kernel->isNative()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SeriesKernel::describe(std::vector<std::string> & steps) const {
+    for (auto const & kernel : _kernels) {
+        kernel->describe(steps);
+    }
+}
+
+void SeriesKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nKernels = _kernels.size();
+    if (nKernels == 1) {
+        _kernels[0]->apply(in, ldIn, nPts, out, ldOut);
+        return;
+    }
+    // ping-pong between two scratch buffers for the intermediate results
+    ScratchBuffer bufA(_maxAxes * nPts);
+    ScratchBuffer bufB(_maxAxes * nPts);
+    double const * src = in;
+    int ldSrc = ldIn;
+    for (int i = 0; i < nKernels; ++i) {
+        bool const isLast = i == nKernels - 1;
+        double * dest = isLast ? out : (i % 2 == 0 ? bufA.data() : bufB.data());
+        int const ldDest = isLast ? ldOut : nPts;
+        _kernels[i]->apply(src, ldSrc, nPts, dest, ldDest);
+        src = dest;
+        ldSrc = ldDest;
+    }
+}
+
+ParallelKernel::ParallelKernel(std::vector<std::shared_ptr<Kernel const>> const & kernels) :
+    Kernel(sumNin(kernels), sumNout(kernels)),
+    _kernels(kernels)
+{
+    if (kernels.empty()) {
+        throw std::invalid_argument("a ParallelKernel needs at least one kernel");
+    }
+}
+
+bool ParallelKernel::isNative() const {
+    for (auto const & kernel : _kernels) {
+        if (!kernel->isNative()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ParallelKernel::describe(std::vector<std::string> & steps) const {
+    for (auto const & kernel : _kernels) {
+        kernel->describe(steps);
+    }
+}
+
+void ParallelKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int inAxis = 0;
+    int outAxis = 0;
+    for (auto const & kernel : _kernels) {
+        kernel->apply(in + inAxis * ldIn, ldIn, nPts, out + outAxis * ldOut, ldOut);
+        inAxis += kernel->getNin();
+        outAxis += kernel->getNout();
+    }
+}
+
+AstKernel::AstKernel(AstMapping * map, bool forward) :
+    Kernel(astGetI(map, forward ? "Nin" : "Nout"), astGetI(map, forward ? "Nout" : "Nin")),
+    _map(reinterpret_cast<AstMapping *>(astCopy(map))),
+    _forward(forward),
+    _className(getRawClass(map)),
+    _mutex()
+{
+    assertOK();
+    // let whichever thread calls apply lock the copy
+    astUnlock(_map, 0);
+}
+
+AstKernel::~AstKernel() {
+    astLock(_map, 1);
+    astAnnul(_map);
+}
+
+void AstKernel::apply(double const * in, int ldIn, int nPts, double * out, int ldOut) const {
+    int const nIn = getNin();
+    int const nOut = getNout();
+    ScratchBuffer inCopy(nIn * nPts);
+    for (int i = 0; i < nIn; ++i) {
+        double const * inRow = in + i * ldIn;
+        double * copyRow = inCopy.data() + i * nPts;
+        for (int k = 0; k < nPts; ++k) {
+            copyRow[k] = std::isnan(inRow[k]) ? AST__BAD : inRow[k];
+        }
+    }
+    {
+#if defined(AST__THREADSAFE) && AST__THREADSAFE
+        // AST's status is per thread, so only calls that share this copy of the mapping must wait
+        std::lock_guard<std::mutex> guard(_mutex);
+#else
+        std::lock_guard<std::mutex> guard(astKernelMutex);
+#endif
+        astLock(_map, 1);
+        astTranN(_map, nPts, nIn, nPts, inCopy.data(), static_cast<int>(_forward), nOut, ldOut, out);
+        // check (and clear) the status before another thread can change it, and before unlocking,
+        // which AST would skip while the status is bad
+        try {
+            assertOK();
+        } catch (...) {
+            astUnlock(_map, 0);
+            throw;
+        }
+        astUnlock(_map, 0);
+    }
+    for (int j = 0; j < nOut; ++j) {
+        double * outRow = out + j * ldOut;
+        for (int k = 0; k < nPts; ++k) {
+            if (outRow[k] == AST__BAD) {
+                outRow[k] = NaN;
+            }
+        }
+    }
+}
+
+}}  // namespace ast::detail
@@ -0,0 +1,125 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "astshim/base.h"
+#include "astshim/detail.h"
+#include "astshim/detail/threads.h"
+
+namespace ast {
+namespace detail {
+
+int getNumThreads(int nThreads, std::size_t nItems) {
+    if (nThreads < 0) {
+        std::ostringstream os;
+        os << "nThreads = " << nThreads << " < 0";
+        throw std::invalid_argument(os.str());
+    }
+#if defined(AST__THREADSAFE) && AST__THREADSAFE
+    if (nThreads == 0) {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return static_cast<int>(std::max<std::size_t>(1, std::min<std::size_t>(nThreads, nItems)));
+#else
+    return 1;
+#endif
+}
+
+void parallelFor(int nThreads, std::size_t nItems, std::function<void(int, std::size_t)> const & func) {
+    std::atomic<std::size_t> nextItem(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+    auto work = [&](int threadIndex) {
+        try {
+            for (std::size_t item = nextItem++; (item < nItems) && !failed; item = nextItem++) {
+                func(threadIndex, item);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(errorMutex);
+            if (!failed.exchange(true)) {
+                firstError = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads - 1);
+    for (int i = 1; i < nThreads; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+ThreadCopies::ThreadCopies(AstObject * object, int nThreads) : _object(object), _copies(nThreads, nullptr) {
+    try {
+        for (int i = 1; i < nThreads; ++i) {
+            _copies[i] = reinterpret_cast<AstObject *>(astCopy(object));
+            assertOK();
+            astUnlock(_copies[i], 0);
+        }
+    } catch (...) {
+        for (auto copy : _copies) {
+            if (copy) {
+                astLock(copy, 1);
+                annulAstObject(copy);
+            }
+        }
+        throw;
+    }
+}
+
+ThreadCopies::~ThreadCopies() {
+    for (auto copy : _copies) {
+        if (copy) {
+            astLock(copy, 1);
+            annulAstObject(copy);
+        }
+    }
+}
+
+AstObject * ThreadCopies::lock(int threadIndex) const {
+    if (threadIndex == 0) {
+        return _object;
+    }
+    astLock(_copies.at(threadIndex), 1);
+    return _copies[threadIndex];
+}
+
+void ThreadCopies::unlock(int threadIndex) const {
+    if (threadIndex != 0) {
+        astUnlock(_copies.at(threadIndex), 0);
+    }
+}
+
+}}  // namespace ast::detail
@@ -0,0 +1,177 @@
+/*
+ * LSST Data Management System
+ * Copyright 2016  AURA/LSST.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <https://www.lsstcorp.org/LegalNotices/>.
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "astshim/detail/vecmath.h"
+
+namespace ast {
+namespace detail {
+
+namespace {
+
+// Largest angle reduced by sinCosN itself: n pi/2 is then exact to well below 1e-16 using PIO2_1..3
+double const SINCOS_MAX_ANGLE = 524288.0;  // 2^19
+
+// Adding and subtracting this rounds a double of magnitude below 2^51 to the nearest integer
+double const ROUND_TO_INT = 6755399441055744.0;  // 1.5 * 2^52
+
+double const TWO_OVER_PI = 6.36619772367581382433e-01;
+
+// pi/2 split into three parts of 33 bits each, so n * PIO2_1 and n * PIO2_2 are exact for n < 2^20
+double const PIO2_1 = 1.57079632673412561417e+00;
+double const PIO2_2 = 6.07710050630396597660e-11;
+double const PIO2_3 = 2.02226624871116645580e-21;
+
+// pi/4, pi/2 and pi, each as the nearest double plus the remainder
+double const PIO4_HI = 7.85398163397448278999e-01;
+double const PIO4_LO = 3.06161699786838301793e-17;
+double const PIO2_HI = 1.57079632679489655800e+00;
+double const PIO2_LO = 6.12323399573676603587e-17;
+double const PI_HI = 3.14159265358979311600e+00;
+double const PI_LO = 1.22464679914735317720e-16;
+
+double const TAN_PIO8 = 4.14213562373095034e-01;
+
+// Minimax polynomials from fdlibm: sin(r) and cos(r) for |r| <= pi/4 and atan(u) for |u| <= 7/16
+double const SIN_1 = -1.66666666666666324348e-01;
+double const SIN_2 = 8.33333333332248946124e-03;
+double const SIN_3 = -1.98412698298579493134e-04;
+double const SIN_4 = 2.75573137070700676789e-06;
+double const SIN_5 = -2.50507602534068634195e-08;
+double const SIN_6 = 1.58969099521155010221e-10;
+
+double const COS_1 = 4.16666666666666019037e-02;
+double const COS_2 = -1.38888888888741095749e-03;
+double const COS_3 = 2.48015872894767294178e-05;
+double const COS_4 = -2.75573143513906633035e-07;
+double const COS_5 = 2.08757232129817482790e-09;
+double const COS_6 = -1.13596475577881948265e-11;
+
+double const ATAN_0 = 3.33333333333329318027e-01;
+double const ATAN_1 = -1.99999999998764832476e-01;
+double const ATAN_2 = 1.42857142725034663711e-01;
+double const ATAN_3 = -1.11111104054623557880e-01;
+double const ATAN_4 = 9.09088713343650656196e-02;
+double const ATAN_5 = -7.69187620504482999495e-02;
+double const ATAN_6 = 6.66107313738753120669e-02;
+double const ATAN_7 = -5.83357013379057348645e-02;
+double const ATAN_8 = 4.97687799461593236017e-02;
+double const ATAN_9 = -3.65315727442169155270e-02;
+double const ATAN_10 = 1.62858201153657823623e-02;
+
+std::uint64_t const SIGN_BIT = std::uint64_t(1) << 63;
+
+/*
+The loops below select between values with bit masks rather than conditional expressions:
+compilers will not vectorize a conditional expression that might raise a floating point exception
+unless told that exceptions do not matter, but they vectorize integer operations on the bits
+of doubles (which memcpy expresses without undefined behaviour) at any optimization level that vectorizes.
+*/
+
+inline std::uint64_t toBits(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline double fromBits(std::uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// Return a mask of all ones if the sign bit of `value` is set, else all zeros
+inline std::uint64_t signMask(double value) { return -(toBits(value) >> 63); }
+
+/// Return `ifSet` where `mask` is all ones and `ifClear` where it is all zeros
+inline double select(std::uint64_t mask, double ifSet, double ifClear) {
+    return fromBits((toBits(ifSet) & mask) | (toBits(ifClear) & ~mask));
+}
+
+}  // anonymous namespace
+
+void sinCosN(double const * angle, int n, double * sine, double * cosine) {
+    std::uint64_t nLarge = 0;
+    for (int k = 0; k < n; ++k) {
+        // NaN is not large, but then every result is NaN anyway
+        std::uint64_t const isLarge = signMask(SINCOS_MAX_ANGLE - std::fabs(angle[k]));
+        nLarge += isLarge & 1;
+        double const x = select(isLarge, 0.0, angle[k]);
+        // x = q pi/2 + r, with |r| <= pi/4; the low bits of `shifted` are those of q
+        double const shifted = x * TWO_OVER_PI + ROUND_TO_INT;
+        std::uint64_t const q = toBits(shifted);
+        double const fq = shifted - ROUND_TO_INT;
+        double const r = ((x - fq * PIO2_1) - fq * PIO2_2) - fq * PIO2_3;
+        double const z = r * r;
+        double const s = r + (z * r) * (SIN_1 + z * (SIN_2 + z * (SIN_3 + z * (SIN_4 + z * (SIN_5 +
+                                                                                         z * SIN_6)))));
+        double const hz = 0.5 * z;
+        double const w = 1.0 - hz;
+        double const cPoly = z * z * (COS_1 + z * (COS_2 + z * (COS_3 + z * (COS_4 + z * (COS_5 +
+                                                                                       z * COS_6)))));
+        double const c = w + (((1.0 - w) - hz) + cPoly);
+        // sin(x) is s, c, -s or -c and cos(x) is c, -s, -c or s for q = 0, 1, 2 or 3 (mod 4)
+        std::uint64_t const isOdd = -(q & 1);
+        sine[k] = fromBits(toBits(select(isOdd, c, s)) ^ ((q & 2) << 62));
+        cosine[k] = fromBits(toBits(select(isOdd, s, c)) ^ (((q + 1) & 2) << 62));
+    }
+    if (nLarge > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (std::fabs(angle[k]) > SINCOS_MAX_ANGLE) {
+                sine[k] = std::sin(angle[k]);
+                cosine[k] = std::cos(angle[k]);
+            }
+        }
+    }
+}
+
+void atan2N(double const * y, double const * x, int n, double * angle) {
+    for (int k = 0; k < n; ++k) {
+        double const ax = std::fabs(x[k]);
+        double const ay = std::fabs(y[k]);
+        std::uint64_t const isSteep = signMask(ax - ay);
+        double const t = select(isSteep, ax, ay) / select(isSteep, ay, ax);
+        // atan(t) for 0 <= t <= 1 is pi/4 + atan((t - 1) / (t + 1)) if t > tan(pi/8)
+        std::uint64_t const isReduced = signMask(TAN_PIO8 - t);
+        double const u = select(isReduced, (t - 1.0) / (t + 1.0), t);
+        double const z = u * u;
+        double const w = z * z;
+        double const evenTerms = z * (ATAN_0 + w * (ATAN_2 + w * (ATAN_4 + w * (ATAN_6 + w * (ATAN_8 +
+                                                                                           w * ATAN_10)))));
+        double const oddTerms = w * (ATAN_1 + w * (ATAN_3 + w * (ATAN_5 + w * (ATAN_7 + w * ATAN_9))));
+        double a = u - u * (evenTerms + oddTerms);
+        a = select(isReduced, PIO4_HI + (a + PIO4_LO), a);
+        a = select(isSteep, (PIO2_HI - a) + PIO2_LO, a);
+        a = select(signMask(x[k]), (PI_HI - a) + PI_LO, a);
+        angle[k] = fromBits((toBits(a) & ~SIGN_BIT) | (toBits(y[k]) & SIGN_BIT));
+    }
+    // NaN inputs give NaN, as they should; other NaNs come from 0/0 or inf/inf
+    for (int k = 0; k < n; ++k) {
+        if (std::isnan(angle[k]) && !std::isnan(x[k]) && !std::isnan(y[k])) {
+            angle[k] = std::atan2(y[k], x[k]);
+        }
+    }
+}
+
+}}  // namespace ast::detail
@@ -0,0 +1,155 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+from numpy.polynomial import chebyshev
+
+import astshim
+from astshim.test import MappingTestCase
+
+
+def normalize(indata, lbnd, ubnd):
+    """Scale each column of indata to [-1, 1] over the box [lbnd, ubnd]"""
+    lbnd = np.array(lbnd)
+    ubnd = np.array(ubnd)
+    return (2.0 * indata - (ubnd + lbnd)) / (ubnd - lbnd)
+
+
+def evaluateSeries(coeffs, nOut, indata, lbnd, ubnd):
+    """Evaluate ChebyMap coefficients directly, term by term"""
+    scaled = normalize(indata, lbnd, ubnd)
+    outdata = np.zeros((len(indata), nOut))
+    for row in coeffs:
+        term = np.full(len(indata), row[0])
+        for i, degree in enumerate(row[2:]):
+            term *= chebyshev.chebval(scaled[:, i], [0] * int(degree) + [1])
+        outdata[:, int(row[1]) - 1] += term
+    return outdata
+
+
+class TestChebyMap(MappingTestCase):
+
+    def setUp(self):
+        self.lbnd_f = [-2.0, 0.5]
+        self.ubnd_f = [3.0, 4.5]
+        self.coeff_f = np.array([
+            [1.5, 1, 0, 0],
+            [2.0, 1, 1, 0],
+            [-0.02, 1, 3, 2],
+            [0.2, 2, 0, 0],
+            [2.5, 2, 0, 1],
+            [0.01, 2, 2, 4],
+        ])
+
+    def test_ChebyMapForward(self):
+        chebymap = astshim.ChebyMap(self.coeff_f, 2, self.lbnd_f, self.ubnd_f)
+        self.assertEqual(chebymap.getClass(), "ChebyMap")
+        self.assertEqual(chebymap.getNin(), 2)
+        self.assertEqual(chebymap.getNout(), 2)
+        self.assertTrue(chebymap.getTranForward())
+        self.assertFalse(chebymap.getTranInverse())
+
+        self.checkBasicSimplify(chebymap)
+        self.checkCopy(chebymap)
+        self.checkPersistence(chebymap)
+
+        domain = chebymap.getDomain(True)
+        np.testing.assert_equal(domain.lbnd, self.lbnd_f)
+        np.testing.assert_equal(domain.ubnd, self.ubnd_f)
+
+        indata = np.array([
+            [-2.0, 0.5],
+            [0.0, 1.0],
+            [2.5, 4.0],
+            [3.0, 4.5],
+        ])
+        outdata = chebymap.tran(indata)
+        expected = evaluateSeries(self.coeff_f, 2, indata, self.lbnd_f, self.ubnd_f)
+        np.testing.assert_allclose(outdata, expected, atol=1e-12)
+
+        # points outside the box have bad outputs
+        outside = chebymap.tran(np.array([[-2.5, 1.0], [0.0, 5.0]]))
+        self.assertTrue(np.all(np.isnan(outside)))
+
+    def test_ChebyMapBidirectional(self):
+        # a linear forward transform and its exact inverse
+        lbnd_f = [0.0]
+        ubnd_f = [10.0]
+        coeff_f = np.array([
+            [5.0, 1, 0],
+            [5.0, 1, 1],
+        ])
+        # out = x over [0, 10], so the inverse is x = out over [0, 10]
+        chebymap = astshim.ChebyMap(coeff_f, coeff_f, lbnd_f, ubnd_f, lbnd_f, ubnd_f)
+        self.assertTrue(chebymap.getTranInverse())
+        indata = np.array([[0.0], [2.5], [7.0], [10.0]])
+        np.testing.assert_allclose(chebymap.tran(indata), indata, atol=1e-12)
+        self.checkRoundTrip(chebymap, indata)
+        domain = chebymap.getDomain(False)
+        np.testing.assert_equal(domain.lbnd, lbnd_f)
+        np.testing.assert_equal(domain.ubnd, ubnd_f)
+
+        with self.assertRaises(Exception):
+            astshim.ChebyMap(coeff_f, coeff_f, lbnd_f, ubnd_f, [0.0, 1.0], [1.0, 2.0])
+        with self.assertRaises(Exception):
+            astshim.ChebyMap(coeff_f, 1, lbnd_f, [1.0, 2.0])
+        with self.assertRaises(Exception):
+            astshim.ChebyMap(coeff_f, 0, lbnd_f, ubnd_f)
+
+    def test_ChebyMapPolyTran(self):
+        chebymap = astshim.ChebyMap(self.coeff_f, 2, self.lbnd_f, self.ubnd_f)
+        fitted = chebymap.polyTran(False, 1.0e-8, 1.0e-6, 10)
+        self.assertIsInstance(fitted, astshim.ChebyMap)
+        self.assertTrue(fitted.getTranInverse())
+        rng = np.random.RandomState(3)
+        indata = np.column_stack([
+            rng.uniform(-1.5, 2.5, size=50),
+            rng.uniform(1.0, 4.0, size=50),
+        ])
+        np.testing.assert_allclose(fitted.tranInverse(fitted.tran(indata)), indata, atol=1e-5)
+
+        boxed = chebymap.polyTran(False, 1.0e-8, 1.0e-6, 10, [0.0, 0.0], [10.0, 12.0])
+        domain = boxed.getDomain(False)
+        np.testing.assert_equal(domain.lbnd, [0.0, 0.0])
+        np.testing.assert_equal(domain.ubnd, [10.0, 12.0])
+        with self.assertRaises(Exception):
+            chebymap.polyTran(False, 1.0e-8, 1.0e-6, 10, [0.0], [10.0, 12.0])
+
+    def test_ChebyMapFitsChan(self):
+        chebymap = astshim.ChebyMap(self.coeff_f, 2, self.lbnd_f, self.ubnd_f)
+        ss = astshim.StringStream()
+        fc = astshim.FitsChan(ss, "Encoding=NATIVE")
+        self.assertEqual(fc.write(chebymap), 1)
+        fc.clearCard()
+        readmap = astshim.ChebyMap(fc.read())
+        self.assertEqual(readmap.show(), chebymap.show())
+
+    def test_ChebyMapLargeBatch(self):
+        """Test transforming many points, by AST and natively
+
+        Mapping.tran gives the same results however many points it is given;
+        a frozen mapping evaluates them natively.
+        """
+        chebymap = astshim.ChebyMap(self.coeff_f, 2, self.lbnd_f, self.ubnd_f)
+        rng = np.random.RandomState(5)
+        nPts = 2000
+        indata = np.column_stack([
+            rng.uniform(-2.2, 3.2, size=nPts),
+            rng.uniform(0.3, 4.7, size=nPts),
+        ])
+        indata[17, 1] = np.nan
+        outdata = chebymap.tran(indata)
+        expected = np.concatenate([chebymap.tran(indata[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(outdata, expected)
+        self.assertTrue(np.all(np.isnan(outdata[17])))
+        np.testing.assert_allclose(chebymap.freeze().tran(indata), outdata, rtol=1e-12, atol=1e-12)
+
+        compiled = chebymap.polyTran(False, 1.0e-8, 1.0e-6, 10).freeze()
+        self.assertEqual(compiled.getPlan(), ["Cheby"])
+        self.assertEqual(compiled.getPlan(False), ["Cheby"])
+        inside = indata[np.all(np.isfinite(outdata), axis=1)]
+        np.testing.assert_allclose(compiled.tran(inside), chebymap.tran(inside), rtol=1e-12, atol=1e-12)
+
+
+if __name__ == "__main__":
+    unittest.main()
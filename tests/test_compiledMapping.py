@@ -0,0 +1,144 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+
+import astshim
+from astshim.test import MappingTestCase
+
+
+class TestCompiledMapping(MappingTestCase):
+
+    def setUp(self):
+        self.frompos = np.array([
+            [1, 3],
+            [2, 99.9],
+            [-6, -5.1],
+            [30, 21],
+            [0.2, 0],
+        ], dtype=float)
+
+    def checkCompiled(self, amap, frompos, native=True):
+        """Check that a compiled mapping matches the original in both directions
+        """
+        compiled = amap.freeze()
+        self.assertEqual(compiled.getNin(), amap.getNin())
+        self.assertEqual(compiled.getNout(), amap.getNout())
+        self.assertEqual(compiled.isNative(), native)
+        topos = amap.tran(frompos)
+        self.assertTrue(np.allclose(compiled.tran(frompos), topos))
+        if amap.getTranInverse():
+            self.assertTrue(compiled.getTranInverse())
+            self.assertTrue(np.allclose(compiled.tranInverse(topos), amap.tranInverse(topos)))
+        return compiled
+
+    def test_CompiledLinear(self):
+        """A series of linear mappings compiles to a single affine kernel"""
+        shiftmap = astshim.ShiftMap([-0.5, 1.2])
+        zoommap = astshim.ZoomMap(2, 1.3)
+        matrixmap = astshim.MatrixMap(np.array([[1.0, 0.5], [-0.3, 2.0]]))
+        sermap = matrixmap.of(zoommap).of(shiftmap)
+        compiled = self.checkCompiled(sermap, self.frompos)
+        self.assertEqual(compiled.getPlan(), ["Affine"])
+        self.assertEqual(compiled.getPlan(False), ["Affine"])
+
+    def test_CompiledPolyMap(self):
+        coeff_f = np.array([
+            [1.2, 1, 2, 0],
+            [-0.5, 1, 1, 1],
+            [1.0, 2, 0, 1],
+        ])
+        polymap = astshim.PolyMap(coeff_f, 2)
+        compiled = polymap.freeze()
+        self.assertEqual(compiled.getPlan(), ["Poly"])
+        self.assertTrue(np.allclose(compiled.tran(self.frompos), polymap.tran(self.frompos)))
+
+        # the inverse is iterative, so it is evaluated by AST
+        self.assertTrue(compiled.getTranInverse())
+        self.assertFalse(compiled.isNative(False))
+
+    def test_CompiledParallel(self):
+        coeff_f = np.array([
+            [2.0, 1, 2],
+            [1.0, 1, 0],
+        ])
+        polymap = astshim.PolyMap(coeff_f, 1)
+        zoommap = astshim.ZoomMap(1, 3.5)
+        parmap = zoommap.over(polymap)
+        compiled = self.checkCompiled(parmap, self.frompos)
+        self.assertEqual(compiled.getPlan(), ["Poly", "Affine"])
+
+    def test_CompiledFallback(self):
+        """Mappings without a native kernel are evaluated by AST"""
+        pcdmap = astshim.PcdMap(1e-6, [0.5, -1.0])
+        zoommap = astshim.ZoomMap(2, 0.5)
+        sermap = zoommap.of(pcdmap)
+        compiled = self.checkCompiled(sermap, self.frompos, native=False)
+        self.assertIn("PcdMap", compiled.getPlan())
+
+    def test_CompiledUnitNormMap(self):
+        unitnormmap = astshim.UnitNormMap([1.5, -2.0])
+        zoommap = astshim.ZoomMap(3, 0.5)
+        sermap = zoommap.of(unitnormmap)
+        compiled = self.checkCompiled(sermap, self.frompos)
+        self.assertEqual(compiled.getPlan(), ["UnitNorm", "Affine"])
+        self.assertEqual(compiled.getPlan(False), ["Affine", "UnitNorm"])
+
+    def test_CompiledSkyChain(self):
+        """Unit vectors rotated between spherical coordinates are evaluated natively
+        by CompiledMapping, and by AST however many points Mapping.tran is given
+        """
+        angle = 0.3
+        rotation = np.array([
+            [np.cos(angle), -np.sin(angle), 0.0],
+            [np.sin(angle), np.cos(angle), 0.0],
+            [0.0, 0.0, 1.0],
+        ])
+        sphmap = astshim.SphMap()
+        skymap = sphmap.of(astshim.MatrixMap(rotation)).of(sphmap.getInverse())
+        compiled = skymap.freeze()
+        self.assertEqual(compiled.getPlan(), ["Sph", "Affine", "Sph"])
+
+        rng = np.random.RandomState(13)
+        nPts = 2000
+        frompos = np.column_stack([
+            rng.uniform(-np.pi, np.pi, size=nPts),
+            rng.uniform(-1.5, 1.5, size=nPts),
+        ])
+        frompos[10, 1] = np.nan
+        topos = skymap.tran(frompos)
+        # small batches are transformed by AST
+        predpos = np.concatenate([skymap.tran(frompos[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(topos, predpos)
+        np.testing.assert_allclose(compiled.tran(frompos), predpos, rtol=0, atol=1e-14)
+        self.assertTrue(np.all(np.isnan(topos[10])))
+
+    def test_CompiledManyPoints(self):
+        """Transform more points than fit in one chunk"""
+        zoommap = astshim.ZoomMap(2, 1.3)
+        frompos = np.random.uniform(-100, 100, size=(2001, 2))
+        compiled = zoommap.freeze()
+        self.assertTrue(np.allclose(compiled.tran(frompos), frompos * 1.3))
+
+    def test_CompiledMemoryLayout(self):
+        """Any memory layout may be used for input and output"""
+        zoommap = astshim.ZoomMap(2, 1.3)
+        compiled = zoommap.freeze()
+        predpos = self.frompos * 1.3
+        for layout in ("C", "F"):
+            topos = np.zeros(self.frompos.shape, order=layout)
+            compiled.tran(np.array(self.frompos, order=layout), topos)
+            self.assertTrue(np.allclose(topos, predpos))
+        self.assertTrue(np.allclose(compiled.tran(self.frompos[::2]), predpos[::2]))
+
+    def test_CompiledIsSnapshot(self):
+        """Compiling copies what it needs, so the plan outlives the mapping"""
+        pcdmap = astshim.PcdMap(1e-6, [0.5, -1.0])
+        topos = pcdmap.tran(self.frompos)
+        compiled = pcdmap.freeze()
+        del pcdmap
+        self.assertTrue(np.allclose(compiled.tran(self.frompos), topos))
+
+
+if __name__ == "__main__":
+    unittest.main()
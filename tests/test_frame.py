@@ -86,6 +86,34 @@ class TestFrame(MappingTestCase):
         fset2 = fset.findFrame(nframe)
         self.assertEqual(fset2.getClass(), "FrameSet")
 
+    def test_FrameConvertCache(self):
+        self.assertEqual(astshim.getConvertCacheSize(), 0)
+        uncached = astshim.SkyFrame().convert(astshim.SkyFrame("System=FK4"))
+        astshim.setConvertCacheSize(2)
+        try:
+            self.assertEqual(astshim.getConvertCacheSize(), 2)
+            skyframe = astshim.SkyFrame()
+            fk4frame = astshim.SkyFrame("System=FK4")
+            fset1 = skyframe.convert(fk4frame)
+            # the cache returns the same result as convert without it
+            self.assertEqual(fset1.show(), uncached.show())
+            # an identical frame finds the cached result, which is a separate copy
+            fset2 = astshim.SkyFrame().convert(astshim.SkyFrame("System=FK4"))
+            self.assertFalse(fset1.same(fset2))
+            self.assertEqual(fset1.show(), fset2.show())
+            frompos = np.array([[0.1, 0.2], [1.5, -0.7]])
+            self.assertTrue(np.allclose(fset2.tran(frompos), uncached.tran(frompos)))
+
+            # a different domain list is a different entry
+            fset3 = skyframe.convert(fk4frame, "SKY")
+            self.assertTrue(np.allclose(fset3.tran(frompos), uncached.tran(frompos)))
+
+            astshim.clearConvertCache()
+            self.assertEqual(astshim.getConvertCacheSize(), 2)
+        finally:
+            astshim.setConvertCacheSize(0)
+        self.assertEqual(astshim.getConvertCacheSize(), 0)
+
     def test_FrameDistance(self):
         frame = astshim.Frame(2)
         distance = frame.distance([0, 0], [4, 3])
@@ -1,6 +1,9 @@
 from __future__ import absolute_import, division, print_function
 import unittest
 
+import numpy as np
+from numpy.testing import assert_allclose
+
 import astshim
 from astshim.test import MappingTestCase
 
@@ -34,6 +37,131 @@ class TestFrameSet(MappingTestCase):
         self.checkCopy(frameset)
         self.checkPersistence(frameset)
 
+    def test_FrameSetCacheMappings(self):
+        frameset = astshim.FrameSet(astshim.Frame(2))
+        frameset.addFrame(1, astshim.ZoomMap(2, 1.5), astshim.Frame(2))
+        frameset.addFrame(2, astshim.ShiftMap([1.0, -2.0]), astshim.Frame(2))
+        self.assertFalse(frameset.getCacheMappings())
+        frameset.setCacheMappings(True)
+        self.assertTrue(frameset.getCacheMappings())
+        frompos = np.array([[1.0, 2.0], [-3.0, 4.0]])
+
+        # each call returns a separate copy, and BASE and CURRENT share entries with their indices
+        mapping1 = frameset.getMapping()
+        mapping2 = frameset.getMapping(1, 3)
+        self.assertFalse(mapping1.same(mapping2))
+        self.assertEqual(mapping1.show(), mapping2.show())
+        assert_allclose(mapping1.tran(frompos), frompos * 1.5 + [1.0, -2.0])
+
+        # the cache is cleared when the FrameSet changes
+        frameset.remapFrame(3, astshim.ZoomMap(2, 2.0))
+        assert_allclose(frameset.getMapping().tran(frompos), (frompos * 1.5 + [1.0, -2.0]) * 2.0)
+        frameset.setCurrent(2)
+        assert_allclose(frameset.getMapping().tran(frompos), frompos * 1.5)
+        frameset.addFrame(1, astshim.ZoomMap(2, 3.0), astshim.Frame(2))
+        assert_allclose(frameset.getMapping().tran(frompos), frompos * 3.0)
+        frameset.removeFrame(4)
+        assert_allclose(frameset.getMapping(1, 2).tran(frompos), frompos * 1.5)
+
+        # and when it changes through another FrameSet that shares its AST object
+        cast = astshim.FrameSet(frameset)
+        cast.remapFrame(2, astshim.ZoomMap(2, 4.0))
+        assert_allclose(frameset.getMapping(1, 2).tran(frompos), frompos * 1.5 * 4.0)
+
+        # copies do not cache
+        self.assertFalse(frameset.copy().getCacheMappings())
+        frameset.setCacheMappings(False)
+        assert_allclose(frameset.getMapping(1, 2).tran(frompos), frompos * 1.5 * 4.0)
+
+    def test_FrameSetSharedTran(self):
+        """Test that a FrameSet cast from another sees changes made through either one
+
+        The casts share one AST object, so the native kernels they cache for tran must be discarded
+        whichever of them changes it.
+        """
+        matrix1 = np.array([[1.0, 2.0], [3.0, 4.0]])
+        matrix2 = np.array([[0.5, -1.0], [2.0, 0.25]])
+        frameset = astshim.FrameSet(astshim.Frame(2))
+        frameset.addFrame(1, astshim.MatrixMap(matrix1), astshim.Frame(2))
+        frameset.addFrame(2, astshim.MatrixMap(matrix2), astshim.Frame(2))
+        cast = astshim.FrameSet(frameset)
+        frompos = np.random.RandomState(5).uniform(-10, 10, size=(1000, 2))
+        assert_allclose(cast.tran(frompos), frompos.dot(matrix1.T).dot(matrix2.T))
+
+        frameset.setCurrent(2)
+        assert_allclose(cast.tran(frompos), frompos.dot(matrix1.T))
+        cast.setCurrent(3)
+        assert_allclose(frameset.tran(frompos), frompos.dot(matrix1.T).dot(matrix2.T))
+
+    def makeSkyFrameSet(self, scale):
+        """Make a FrameSet from pixels to sky with a zenithal equidistant projection
+
+        (not gnomonic, which maps straight lines to great circles); scale is the pixel scale in radians
+        """
+        frameset = astshim.FrameSet(astshim.Frame(2, "Domain=PIXELS"))
+        wcsmap = astshim.WcsMap(2, astshim.WcsType_ARC, 1, 2)
+        pixelToSky = wcsmap.getInverse().of(astshim.ZoomMap(2, scale))
+        frameset.addFrame(1, pixelToSky, astshim.SkyFrame())
+        return frameset
+
+    def test_SkyFootprintLinear(self):
+        """A linear mapping needs just the corners of the box
+        """
+        frameset = astshim.FrameSet(astshim.Frame(2))
+        frameset.addFrame(1, astshim.ZoomMap(2, 1.5), astshim.Frame(2))
+        footprint = frameset.skyFootprint([0, 0], [100, 50], 1e-6)
+        assert_allclose(footprint, [[0, 0], [150, 0], [150, 75], [0, 75]])
+
+    def test_SkyFootprint(self):
+        lbnd = [-2000, -2000]
+        ubnd = [2000, 2000]
+        frameset = self.makeSkyFrameSet(1e-4)
+        tol = 1e-7
+        footprint = frameset.skyFootprint(lbnd, ubnd, tol)
+        self.assertEqual(footprint.shape[1], 2)
+        # the first vertex is the lower corner; every vertex is on the boundary
+        assert_allclose(footprint[0], frameset.tran(np.array([lbnd], dtype=float))[0])
+        # the edges of the box are curved on the sky
+        self.assertGreater(len(footprint), 4)
+
+        # every densely sampled boundary point lies within tol of the polygon
+        edge = np.linspace(-2000, 2000, 201)
+        boundary = np.concatenate([
+            np.column_stack([edge, np.full_like(edge, -2000)]),
+            np.column_stack([np.full_like(edge, 2000), edge]),
+            np.column_stack([edge[::-1], np.full_like(edge, 2000)]),
+            np.column_stack([np.full_like(edge, -2000), edge[::-1]]),
+        ])
+        for point in frameset.tran(boundary):
+            minDist = min(
+                abs(frameset.resolve(footprint[i], footprint[(i + 1) % len(footprint)], point).d2)
+                for i in range(len(footprint))
+            )
+            self.assertLess(minDist, 2 * tol)
+
+        # a coarse tolerance needs fewer vertices
+        coarse = frameset.skyFootprint(lbnd, ubnd, 1e-3)
+        self.assertGreaterEqual(len(coarse), 4)
+        self.assertLess(len(coarse), len(footprint))
+
+        with self.assertRaises(Exception):
+            frameset.skyFootprint(lbnd, ubnd, 0)
+        with self.assertRaises(Exception):
+            frameset.skyFootprint([0, 0, 0], ubnd, tol)
+
+    def test_SkyFootprints(self):
+        framesets = [self.makeSkyFrameSet(scale) for scale in (1e-5, 2e-5, 5e-5)]
+        lbnds = [[0, 0], [-100, 0], [0, -2000]]
+        ubnds = [[4000, 2000], [1000, 2000], [2000, 2000]]
+        tol = 1e-7
+        for nThreads in (1, 3, 0):
+            footprints = astshim.FrameSet.skyFootprints(framesets, lbnds, ubnds, tol, nThreads)
+            self.assertEqual(len(footprints), len(framesets))
+            for frameset, lbnd, ubnd, footprint in zip(framesets, lbnds, ubnds, footprints):
+                assert_allclose(footprint, frameset.skyFootprint(lbnd, ubnd, tol))
+        with self.assertRaises(Exception):
+            astshim.FrameSet.skyFootprints(framesets, lbnds[1:], ubnds, tol)
+
 
 if __name__ == "__main__":
     unittest.main()
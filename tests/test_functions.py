@@ -15,6 +15,20 @@ class TestFunctions(unittest.TestCase):
         self.assertTrue(astshim.escapes(0))
         self.assertFalse(astshim.escapes())
 
+    def test_tranChunkSize(self):
+        oldChunkSize = astshim.getTranChunkSize()
+        self.assertGreater(oldChunkSize, 0)
+        try:
+            astshim.setTranChunkSize(5)
+            self.assertEqual(astshim.getTranChunkSize(), 5)
+            with self.assertRaises(Exception):
+                astshim.setTranChunkSize(2**31)
+            with self.assertRaises(Exception):
+                astshim.setTranChunkSize(0)
+            self.assertEqual(astshim.getTranChunkSize(), 5)
+        finally:
+            astshim.setTranChunkSize(oldChunkSize)
+
 
 if __name__ == "__main__":
     unittest.main()
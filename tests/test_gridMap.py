@@ -0,0 +1,148 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+
+import astshim
+from astshim.test import MappingTestCase
+
+
+class TestGridMap(MappingTestCase):
+
+    def setUp(self):
+        self.origin = [-1.0, 2.0]
+        self.spacing = [0.5, 0.25]
+        ny, nx = 5, 7
+        xx = self.origin[0] + self.spacing[0] * np.arange(nx)
+        yy = self.origin[1] + self.spacing[1] * np.arange(ny)
+        self.xgrid, self.ygrid = np.meshgrid(xx, yy)
+        self.dx = 0.01 * self.xgrid * self.ygrid
+        self.dy = 0.02 * np.sin(self.xgrid) - 0.01 * self.ygrid
+
+    def makeGridMap(self, interp=astshim.GridInterp_BILINEAR):
+        return astshim.GridMap(self.dx, self.dy, self.origin, self.spacing, interp)
+
+    def test_GridMapBasics(self):
+        gridmap = self.makeGridMap()
+        self.assertEqual(gridmap.getClass(), "IntraMap")
+        self.assertTrue(astshim.GridMap.isGridMap(gridmap))
+        self.assertFalse(astshim.GridMap.isGridMap(astshim.UnitMap(2)))
+        self.assertEqual(gridmap.getNin(), 2)
+        self.assertEqual(gridmap.getNout(), 2)
+        self.assertTrue(gridmap.getTranForward())
+        self.assertTrue(gridmap.getTranInverse())
+        self.assertEqual(gridmap.getInterp(), astshim.GridInterp_BILINEAR)
+        self.assertEqual(gridmap.getOrigin(), self.origin)
+        self.assertEqual(gridmap.getSpacing(), self.spacing)
+        np.testing.assert_equal(gridmap.getDx(), self.dx)
+        np.testing.assert_equal(gridmap.getDy(), self.dy)
+
+        self.checkBasicSimplify(gridmap)
+        self.checkCopy(gridmap)
+        self.checkPersistence(gridmap)
+
+        with self.assertRaises(Exception):
+            astshim.GridMap(astshim.UnitMap(2))
+
+    def test_GridMapInterpolation(self):
+        for interp in (astshim.GridInterp_BILINEAR, astshim.GridInterp_BICUBIC):
+            gridmap = self.makeGridMap(interp)
+            self.assertEqual(gridmap.getInterp(), interp)
+
+            # grid points are displaced by exactly the tabulated values
+            indata = np.column_stack([self.xgrid.ravel(), self.ygrid.ravel()])
+            expected = np.column_stack([indata[:, 0] + self.dx.ravel(), indata[:, 1] + self.dy.ravel()])
+            np.testing.assert_allclose(gridmap.tran(indata), expected, atol=1e-14)
+
+            # beyond the grid the displacement is that at the nearest edge
+            outside = np.array([[-5.0, 2.5], [0.0, 10.0]])
+            edge = np.array([[-1.0, 2.5], [0.0, 3.0]])
+            np.testing.assert_allclose(gridmap.tran(outside) - outside, gridmap.tran(edge) - edge,
+                                       atol=1e-14)
+
+            # bad inputs give bad outputs
+            self.assertTrue(np.all(np.isnan(gridmap.tran(np.array([[np.nan, 2.5]])))))
+
+        # bilinear interpolation at the middle of a cell is the mean of its corners
+        gridmap = self.makeGridMap()
+        middle = np.array([[self.xgrid[1, 2] + 0.25, self.ygrid[1, 2] + 0.125]])
+        expected = middle + [
+            self.dx[1:3, 2:4].mean(),
+            self.dy[1:3, 2:4].mean(),
+        ]
+        np.testing.assert_allclose(gridmap.tran(middle), expected, atol=1e-14)
+
+    def test_GridMapRoundTrip(self):
+        rng = np.random.RandomState(7)
+        indata = np.column_stack([
+            rng.uniform(-1.0, 2.0, size=100),
+            rng.uniform(2.0, 3.0, size=100),
+        ])
+        for interp in (astshim.GridInterp_BILINEAR, astshim.GridInterp_BICUBIC):
+            gridmap = self.makeGridMap(interp)
+            self.checkRoundTrip(gridmap, indata)
+            np.testing.assert_allclose(gridmap.tranInverse(gridmap.tran(indata)), indata, atol=1e-10)
+
+            inverted = gridmap.getInverse()
+            np.testing.assert_allclose(inverted.tran(gridmap.tran(indata)), indata, atol=1e-10)
+
+    def test_GridMapChannel(self):
+        gridmap = self.makeGridMap(astshim.GridInterp_BICUBIC)
+        ss = astshim.StringStream()
+        chan = astshim.Channel(ss)
+        chan.write(gridmap)
+        ss.sinkToSource()
+        readmap = astshim.GridMap(chan.read())
+        self.assertEqual(readmap.getInterp(), astshim.GridInterp_BICUBIC)
+        np.testing.assert_equal(readmap.getDx(), self.dx)
+        np.testing.assert_equal(readmap.getDy(), self.dy)
+        indata = np.array([[0.1, 2.3], [1.7, 2.9]])
+        np.testing.assert_equal(readmap.tran(indata), gridmap.tran(indata))
+
+    def test_GridMapSeries(self):
+        gridmap = self.makeGridMap()
+        shift = [0.3, -0.1]
+        seriesmap = gridmap.of(astshim.ShiftMap(shift))
+        indata = np.array([[0.1, 2.3], [1.7, 2.9], [-0.4, 2.05]])
+        np.testing.assert_allclose(seriesmap.tran(indata), gridmap.tran(indata + shift), atol=1e-14)
+        self.checkRoundTrip(seriesmap, indata)
+
+    def test_GridMapLargeBatch(self):
+        """Test transforming many points, by AST and natively
+
+        Mapping.tran gives the same results however many points it is given; a frozen mapping
+        evaluates them natively, from the same table that AST's transformation function uses.
+        """
+        gridmap = self.makeGridMap(astshim.GridInterp_BICUBIC)
+        rng = np.random.RandomState(5)
+        nPts = 2000
+        indata = np.column_stack([
+            rng.uniform(-1.5, 2.5, size=nPts),
+            rng.uniform(1.8, 3.2, size=nPts),
+        ])
+        indata[17, 1] = np.nan
+        outdata = gridmap.tran(indata)
+        expected = np.concatenate([gridmap.tran(indata[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(outdata, expected)
+        self.assertTrue(np.all(np.isnan(outdata[17])))
+
+        compiled = gridmap.freeze()
+        self.assertEqual(compiled.getPlan(), ["Grid"])
+        self.assertEqual(compiled.getPlan(False), ["Grid"])
+        np.testing.assert_allclose(compiled.tran(indata), outdata, rtol=1e-14, atol=1e-14)
+        np.testing.assert_allclose(compiled.tranInverse(outdata), gridmap.tranInverse(outdata),
+                                   rtol=1e-14, atol=1e-14)
+
+    def test_GridMapErrors(self):
+        with self.assertRaises(Exception):
+            astshim.GridMap(self.dx, self.dy[:, :-1].copy(), self.origin, self.spacing)
+        with self.assertRaises(Exception):
+            astshim.GridMap(self.dx[:1].copy(), self.dy[:1].copy(), self.origin, self.spacing)
+        with self.assertRaises(Exception):
+            astshim.GridMap(self.dx, self.dy, self.origin, [0.5, 0.0])
+        with self.assertRaises(Exception):
+            astshim.GridMap(self.dx, self.dy, [0.0], self.spacing)
+
+
+if __name__ == "__main__":
+    unittest.main()
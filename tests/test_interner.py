@@ -0,0 +1,112 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+from numpy.testing import assert_allclose
+
+import astshim
+
+
+class TestInterner(unittest.TestCase):
+
+    def setUp(self):
+        self.coeff_f = np.array([
+            [1.2, 1, 2, 0],
+            [-0.5, 1, 1, 1],
+            [1.0, 2, 0, 1],
+        ])
+        self.frompos = np.array([
+            [1.0, 0.0],
+            [2.0, 1.0],
+            [3.0, 2.0],
+        ])
+
+    def test_InternerIdentical(self):
+        interner = astshim.Interner()
+        polymap1 = astshim.PolyMap(self.coeff_f, 2)
+        polymap2 = astshim.PolyMap(self.coeff_f, 2)
+        pooled1 = interner.intern(polymap1)
+        pooled2 = interner.intern(polymap2)
+        self.assertTrue(pooled1.same(pooled2))
+        # the pool holds copies
+        self.assertFalse(pooled1.same(polymap1))
+        self.assertEqual(interner.getNumLookups(), 2)
+        self.assertEqual(interner.getNumHits(), 1)
+        self.assertEqual(interner.getBytesSaved(), pooled1.getObjSize())
+        self.assertEqual(interner.size(), 1)
+        assert_allclose(pooled2.tran(self.frompos), polymap2.tran(self.frompos))
+
+        # objects that differ are not shared
+        polymap3 = astshim.PolyMap(self.coeff_f, 2)
+        polymap3.setIdent("other")
+        self.assertFalse(interner.intern(polymap3).same(pooled1))
+        self.assertEqual(interner.getNumHits(), 1)
+
+        # pooled objects, and objects cast from them, are frozen; modify a copy instead
+        self.assertTrue(pooled1.isFrozen())
+        self.assertFalse(polymap1.isFrozen())
+        with self.assertRaises(Exception):
+            pooled1.setIdent("modified")
+        with self.assertRaises(Exception):
+            astshim.PolyMap(pooled1).set("Report=1")
+        self.assertEqual(pooled1.getIdent(), "")
+        modified = pooled1.copy()
+        self.assertFalse(modified.isFrozen())
+        modified.setIdent("modified")
+        self.assertEqual(modified.getIdent(), "modified")
+        self.assertEqual(pooled1.getIdent(), "")
+        self.assertTrue(interner.intern(polymap1).same(pooled1))
+
+    def test_InternerComponents(self):
+        """Compound mappings share identical components
+        """
+        interner = astshim.Interner()
+        seriesmaps = [astshim.PolyMap(self.coeff_f, 2).of(astshim.ShiftMap([offset, 0.0]))
+                      for offset in (1.0, 2.0, 3.0)]
+        pooled = [interner.intern(seriesmap) for seriesmap in seriesmaps]
+        # each SeriesMap and its ShiftMap is new, but the PolyMap is found twice
+        self.assertEqual(interner.getNumHits(), 2)
+        self.assertEqual(interner.size(), 7)
+        for seriesmap, pooledmap in zip(seriesmaps, pooled):
+            self.assertEqual(pooledmap.show(), seriesmap.show())
+            assert_allclose(pooledmap.tran(self.frompos), seriesmap.tran(self.frompos))
+
+        # interning an identical compound mapping returns the pooled one
+        seriesmap = astshim.PolyMap(self.coeff_f, 2).of(astshim.ShiftMap([2.0, 0.0]))
+        self.assertTrue(interner.intern(seriesmap).same(pooled[1]))
+
+    def test_InternerPurge(self):
+        interner = astshim.Interner()
+        pooled = interner.intern(astshim.ZoomMap(2, 1.5))
+        interner.intern(astshim.ZoomMap(2, 2.5))
+        # the second ZoomMap is no longer used
+        self.assertEqual(interner.size(), 1)
+        interner.purge()
+        self.assertEqual(interner.size(), 1)
+        self.assertTrue(interner.intern(astshim.ZoomMap(2, 1.5)).same(pooled))
+
+    def test_InternerFrameSet(self):
+        interner = astshim.Interner()
+        framesets = []
+        for i in range(2):
+            frameset = astshim.FrameSet(astshim.Frame(2))
+            frameset.addFrame(1, astshim.ZoomMap(2, 1.5), astshim.Frame(2))
+            framesets.append(frameset)
+        pooled = [interner.intern(frameset) for frameset in framesets]
+        self.assertTrue(pooled[0].same(pooled[1]))
+        self.assertIsInstance(pooled[0], astshim.FrameSet)
+
+        # a frozen FrameSet cannot be modified, but can be converted without being modified
+        with self.assertRaises(Exception):
+            pooled[0].addFrame(1, astshim.ZoomMap(2, 2.0), astshim.Frame(2))
+        with self.assertRaises(Exception):
+            pooled[0].setCurrent(1)
+        self.assertEqual(pooled[0].getNframe(), 2)
+        self.assertEqual(pooled[0].getCurrent(), 2)
+        conversion = pooled[0].convert(astshim.Frame(2))
+        self.assertIsNotNone(conversion)
+        self.assertEqual(pooled[0].getBase(), 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -40,6 +40,49 @@ class TestLutMap(MappingTestCase):
         self.assertEqual(lutmap.getLutInterp(), 0)
         self.assertAlmostEqual(lutmap.getLutEpsilon(), sys.float_info.epsilon, delta=1e-18)
 
+    def test_LutMapLargeTable(self):
+        """Test transforming many points through a large table, by AST and natively
+
+        Mapping.tran gives the same results however many points it is given;
+        a frozen mapping evaluates them natively.
+        """
+        rng = np.random.RandomState(12)
+        nLut = 10000
+        increasing = np.cumsum(rng.uniform(0.01, 1.0, size=nLut))
+        for lut, start, inc in (
+            (increasing, -5.0, 0.25),
+            (-increasing, 3.0, 0.5),
+            (increasing, 100.0, -0.1),
+            (np.sin(np.arange(nLut) * 0.01), 0.0, 1.0),
+        ):
+            lutmap = astshim.LutMap(lut, start, inc)
+            for amap in (lutmap, lutmap.getInverse()):
+                nPts = 2000
+                compiled = amap.freeze()
+                for forward in (True, False):
+                    if not (amap.getTranForward() if forward else amap.getTranInverse()):
+                        continue
+                    tran = amap.tran if forward else amap.tranInverse
+                    compiledTran = compiled.tran if forward else compiled.tranInverse
+                    if forward == (amap is lutmap):
+                        # table inputs, including some beyond each end of the table
+                        lo, hi = sorted([start - 0.1 * nLut * inc, start + 1.1 * nLut * inc])
+                    else:
+                        lo, hi = lut.min() - 50, lut.max() + 50
+                    indata = rng.uniform(lo, hi, size=(nPts, 1))
+                    indata[17, 0] = np.nan
+                    outdata = tran(indata)
+                    expected = np.concatenate([tran(indata[i:i + 100]) for i in range(0, nPts, 100)])
+                    np.testing.assert_array_equal(outdata, expected)
+                    np.testing.assert_allclose(compiledTran(indata), outdata, rtol=1e-10, atol=1e-10)
+
+        lutmap = astshim.LutMap(increasing, -5.0, 0.25)
+        compiled = lutmap.freeze()
+        self.assertEqual(compiled.getPlan(), ["Lut"])
+        self.assertEqual(compiled.getPlan(False), ["Lut"])
+        indata = rng.uniform(-5, 2000, size=(50, 1))
+        np.testing.assert_allclose(compiled.tran(indata), lutmap.tran(indata), rtol=1e-10)
+
 
 if __name__ == "__main__":
     unittest.main()
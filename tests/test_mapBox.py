@@ -44,6 +44,74 @@ class TestMapBox(MappingTestCase):
             self.assertAlmostEqual(mapbox.xl[i, i], mapbox2.xl[i, i])
             self.assertAlmostEqual(mapbox.xu[i, i], mapbox2.xu[i, i])
 
+    def test_mapBoxes(self):
+        """Test the batch version of MapBox, in both modes"""
+        nBoxes = 20
+        lbnd = np.random.uniform(-10, 0, size=(nBoxes, 2))
+        ubnd = np.random.uniform(1, 10, size=(nBoxes, 2))
+        maps = [astshim.ZoomMap(2, zoom) for zoom in np.linspace(0.5, 2.0, nBoxes)]
+        # include a non-linear mapping whose maximum x is in the middle of an edge,
+        # for which sampling gives a slightly larger box
+        polymap = astshim.PolyMap(np.array([
+            [1.0, 1, 1, 0], [-0.05, 1, 0, 2],
+            [1.0, 2, 0, 1],
+        ]), 2)
+        maps[-1] = polymap
+
+        for nThreads in (1, 3, 0):
+            lbndOut = np.zeros((nBoxes, 2))
+            ubndOut = np.zeros((nBoxes, 2))
+            astshim.mapBoxes(maps, lbnd, ubnd, lbndOut, ubndOut, 0, nThreads)
+            for i in range(nBoxes):
+                mapbox = astshim.MapBox(maps[i], lbnd[i], ubnd[i])
+                self.assertTrue(np.allclose(lbndOut[i], mapbox.lbndOut))
+                self.assertTrue(np.allclose(ubndOut[i], mapbox.ubndOut))
+
+            sampledLbndOut = np.zeros((nBoxes, 2))
+            sampledUbndOut = np.zeros((nBoxes, 2))
+            astshim.mapBoxes(maps, lbnd, ubnd, sampledLbndOut, sampledUbndOut, 5, nThreads)
+            self.assertTrue(np.allclose(sampledLbndOut[:-1], lbndOut[:-1]))
+            self.assertTrue(np.allclose(sampledUbndOut[:-1], ubndOut[:-1]))
+            self.assertTrue(np.all(sampledLbndOut[-1] <= lbndOut[-1] + 1e-10))
+            self.assertTrue(np.all(sampledUbndOut[-1] >= ubndOut[-1] - 1e-10))
+            self.assertTrue(np.allclose(sampledLbndOut[-1], lbndOut[-1], atol=0.5))
+            self.assertTrue(np.allclose(sampledUbndOut[-1], ubndOut[-1], atol=0.5))
+
+        # a single mapping is used for every box
+        zoommap = astshim.ZoomMap(2, 3.0)
+        lbndOut = np.zeros((nBoxes, 2))
+        ubndOut = np.zeros((nBoxes, 2))
+        astshim.mapBoxes([zoommap], lbnd, ubnd, lbndOut, ubndOut, 0, 3)
+        self.assertTrue(np.allclose(lbndOut, lbnd * 3.0))
+        self.assertTrue(np.allclose(ubndOut, ubnd * 3.0))
+
+        with self.assertRaises(Exception):
+            astshim.mapBoxes(maps[:2], lbnd, ubnd, lbndOut, ubndOut)
+        with self.assertRaises(Exception):
+            astshim.mapBoxes(maps, lbnd, ubnd, lbndOut[1:], ubndOut)
+        with self.assertRaises(Exception):
+            astshim.mapBoxes(maps, lbnd, ubnd, lbndOut, ubndOut, -1)
+
+    def test_mapBoxesBetweenSamples(self):
+        """Test that sampled mapBoxes covers an extreme value that lies between samples"""
+        # x - x^2 has its maximum of 0.25 at x = 0.5, which is not one of the samples at x = 1/3, 2/3;
+        # the largest sampled value is 2/9
+        polymap = astshim.PolyMap(np.array([
+            [1.0, 1, 1, 0], [-1.0, 1, 2, 0],
+            [1.0, 2, 0, 1],
+        ]), 2)
+        lbnd = np.array([[0.0, 0.0]])
+        ubnd = np.array([[1.0, 1.0]])
+        lbndOut = np.zeros((1, 2))
+        ubndOut = np.zeros((1, 2))
+        astshim.mapBoxes([polymap], lbnd, ubnd, lbndOut, ubndOut, 2)
+        self.assertGreaterEqual(ubndOut[0, 0], 0.25)
+        self.assertLessEqual(lbndOut[0, 0], 0.0)
+        self.assertLess(ubndOut[0, 0], 0.3)
+        # the second axis is linear, so its bounds are not padded
+        self.assertAlmostEqual(lbndOut[0, 1], 0.0)
+        self.assertAlmostEqual(ubndOut[0, 1], 1.0)
+
 
 if __name__ == "__main__":
     unittest.main()
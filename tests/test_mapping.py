@@ -139,6 +139,138 @@ class TestMapping(MappingTestCase):
         self.assertTrue(simpmap.getTranForward())
         self.assertTrue(simpmap.getTranInverse())
 
+    def test_MappingTranMemoryLayout(self):
+        """Test tran and tranInverse with C-ordered, Fortran-ordered and non-contiguous arrays"""
+        frompos = np.array([
+            [1, 3],
+            [2, 99],
+            [-6, -5],
+            [30, 21],
+            [0, 0],
+        ], dtype=float)
+        predpos = frompos * self.zoom
+        for layout in ("C", "F"):
+            layoutpos = np.array(frompos, order=layout)
+            self.assertTrue(np.allclose(self.zoommap.tran(layoutpos), predpos))
+            self.assertTrue(np.allclose(self.zoommap.tranInverse(predpos), frompos))
+
+            topos = np.zeros(frompos.shape, order=layout)
+            self.zoommap.tran(layoutpos, topos)
+            self.assertTrue(np.allclose(topos, predpos))
+
+        # every other row of a larger array
+        widepos = np.zeros((2 * len(frompos), self.nin))
+        widepos[::2] = frompos
+        self.assertTrue(np.allclose(self.zoommap.tran(widepos[::2]), predpos))
+        topos = np.zeros(widepos.shape)
+        self.zoommap.tran(widepos[::2], topos[::2])
+        self.assertTrue(np.allclose(topos[::2], predpos))
+        self.assertTrue(np.all(topos[1::2] == 0))
+
+        # reversed views, whose point stride is negative
+        self.assertTrue(np.allclose(self.zoommap.tran(frompos[::-1]), predpos[::-1]))
+        topos = np.zeros(frompos.shape)
+        self.zoommap.tran(frompos, topos[::-1])
+        self.assertTrue(np.allclose(topos[::-1], predpos))
+        permmap = astshim.PermMap([2, 1], [2, 1])
+        manypos = np.random.uniform(-100, 100, size=(1000, 2))
+        np.testing.assert_equal(permmap.tran(manypos[::-1]), manypos[::-1, ::-1])
+        topos = np.zeros(manypos.shape)
+        permmap.tran(manypos, topos[::-1])
+        np.testing.assert_equal(topos[::-1], manypos[:, ::-1])
+
+    def test_MappingTranChunks(self):
+        """Test tran and tranGridForward with arrays larger than getTranChunkSize()"""
+        oldChunkSize = astshim.getTranChunkSize()
+        astshim.setTranChunkSize(7)
+        try:
+            frompos = np.random.uniform(-100, 100, size=(100, self.nin))
+            for layout in ("C", "F"):
+                layoutpos = np.array(frompos, order=layout)
+                topos = np.zeros(frompos.shape, order=layout)
+                self.zoommap.tran(layoutpos, topos)
+                self.assertTrue(np.allclose(topos, frompos * self.zoom))
+                self.assertTrue(np.allclose(self.zoommap.tranInverse(topos), frompos))
+
+            # grid points are in order with the first axis varying fastest
+            lbnd = [1, -2]
+            ubnd = [4, 6]
+            xvals, yvals = np.meshgrid(np.arange(lbnd[0], ubnd[0] + 1), np.arange(lbnd[1], ubnd[1] + 1))
+            gridpos = np.column_stack((xvals.ravel(), yvals.ravel()))
+            for layout in ("C", "F"):
+                topos = np.zeros(gridpos.shape, order=layout)
+                self.zoommap.tranGridForward(lbnd, ubnd, 0, 100, topos)
+                self.assertTrue(np.allclose(topos, gridpos * self.zoom))
+        finally:
+            astshim.setTranChunkSize(oldChunkSize)
+
+    def test_MappingTranGridSeparable(self):
+        """Test tranGridForward and tranGridInverse with mappings whose axes are independent groups"""
+        angle = 0.3
+        rotmap = astshim.MatrixMap([[np.cos(angle), -np.sin(angle)], [np.sin(angle), np.cos(angle)]])
+        zoommap = astshim.ZoomMap(1, 2.5)
+        permmap = astshim.PermMap([2, 3, 1], [3, 1, 2])
+        sepmap = permmap.of(astshim.ParallelMap(rotmap, zoommap))
+        matrix = np.array([[1.0, 0.2, -0.1], [0.3, 0.9, 0.05], [-0.2, 0.1, 1.1]])
+        nonsepmap = astshim.MatrixMap(matrix)
+
+        # large enough that the grid is searched for independent axes
+        lbnd = [-3, 1, 0]
+        ubnd = [36, 30, 4]
+        axisvals = [np.arange(lb, ub + 1, dtype=float) for lb, ub in zip(lbnd, ubnd)]
+        # grid points are in order with the first axis varying fastest
+        gridpos = np.column_stack([vals.ravel(order="F")
+                                   for vals in np.meshgrid(*axisvals, indexing="ij")])
+        for amap in (sepmap, nonsepmap):
+            for layout in ("C", "F"):
+                topos = np.zeros(gridpos.shape, order=layout)
+                amap.tranGridForward(lbnd, ubnd, 0, 100, topos)
+                self.assertTrue(np.allclose(topos, amap.tran(gridpos)))
+                amap.tranGridInverse(lbnd, ubnd, 0, 100, topos)
+                self.assertTrue(np.allclose(topos, amap.tranInverse(gridpos)))
+
+    def test_MappingTranOutputs(self):
+        """Test tranOutputs, which computes only some of the outputs"""
+        angle = 0.3
+        rotmap = astshim.MatrixMap([[np.cos(angle), -np.sin(angle)], [np.sin(angle), np.cos(angle)]])
+        permmap = astshim.PermMap([2, 3, 1], [3, 1, 2])
+        sepmap = permmap.of(astshim.ParallelMap(rotmap, astshim.ZoomMap(1, 2.5)))
+        matrix = np.array([[1.0, 0.2, -0.1], [0.3, 0.9, 0.05], [-0.2, 0.1, 1.1]])
+        nonsepmap = astshim.MatrixMap(matrix)
+
+        frompos = np.random.uniform(-100, 100, size=(20, 3))
+        for amap in (sepmap, nonsepmap):
+            topos = amap.tran(frompos)
+            # the second [1] reuses the cached reduced mapping
+            for outAxes in ([1], [3, 2], [2, 1, 3], [1]):
+                predpos = topos[:, np.array(outAxes) - 1]
+                self.assertTrue(np.allclose(amap.tranOutputs(frompos, outAxes), predpos))
+                for layout in ("C", "F"):
+                    outpos = np.zeros(predpos.shape, order=layout)
+                    amap.tranOutputs(np.array(frompos, order=layout), outAxes, outpos)
+                    self.assertTrue(np.allclose(outpos, predpos))
+            for outAxes in ([], [0], [4], [1, 1]):
+                with self.assertRaises(Exception):
+                    amap.tranOutputs(frompos, outAxes)
+
+        # cached reduced mappings are discarded when the mapping changes
+        frameSet = astshim.FrameSet(astshim.Frame(3))
+        frameSet.addFrame(1, sepmap, astshim.Frame(3))
+        predpos = sepmap.tran(frompos)[:, 2:3]
+        self.assertTrue(np.allclose(frameSet.tranOutputs(frompos, [3]), predpos))
+        frameSet.addFrame(frameSet.CURRENT, astshim.ZoomMap(3, 2.0), astshim.Frame(3))
+        self.assertTrue(np.allclose(frameSet.tranOutputs(frompos, [3]), 2.0 * predpos))
+        frameSet.setCurrent(2)
+        self.assertTrue(np.allclose(frameSet.tranOutputs(frompos, [3]), predpos))
+
+        # and also when the mapping is changed through another wrapper of the same AST object
+        cast = astshim.FrameSet(frameSet)
+        self.assertTrue(np.allclose(cast.tranOutputs(frompos, [3]), predpos))
+        frameSet.setCurrent(3)
+        self.assertTrue(np.allclose(cast.tranOutputs(frompos, [3]), 2.0 * predpos))
+        cast.setCurrent(2)
+        self.assertTrue(np.allclose(frameSet.tranOutputs(frompos, [3]), predpos))
+
     def test_MapSplit(self):
         """Test MapSplit for a simple case"""
         for i in range(self.nin):
@@ -70,6 +70,40 @@ class TestMatrixMap(MappingTestCase):
         ], dtype=float)
         self.assertTrue(np.allclose(pout, despout))
 
+    def test_MatrixMapLargeBatch(self):
+        """Test transforming enough points to use the native matrix kernels
+
+        Small batches are transformed by AST, so they provide the expected values,
+        including which outputs a bad input makes bad; the native kernels give exactly the same results.
+        """
+        rng = np.random.RandomState(42)
+        nPts = 1000
+        fullMatrix = rng.uniform(-1, 1, size=(12, 10))
+        fullMatrix[3, 4] = 0.0
+        permMatrix = np.zeros((4, 4))
+        for i, j in enumerate([2, 0, 3, 1]):
+            permMatrix[i, j] = 2.0 if i == 0 else 1.0
+        for mm in (
+            astshim.MatrixMap(fullMatrix),
+            astshim.MatrixMap(np.ascontiguousarray(fullMatrix[0:10])),
+            astshim.MatrixMap(permMatrix),
+            astshim.MatrixMap([-1.0, 2.0, 0.5]),
+            astshim.SeriesMap(astshim.MatrixMap(np.ascontiguousarray(fullMatrix[0:10])),
+                              astshim.MatrixMap(fullMatrix)),
+        ):
+            pin = rng.uniform(-10, 10, size=(nPts, mm.getNin()))
+            pin[5, 0] = np.nan
+            pout = mm.tran(pin)
+            self.assertEqual(pout.shape, (nPts, mm.getNout()))
+            for start in range(0, 20, 5):
+                np.testing.assert_array_equal(pout[start:start + 5], mm.tran(pin[start:start + 5]))
+            if mm.getTranInverse():
+                np.testing.assert_allclose(mm.tranInverse(pout)[6:], pin[6:], atol=1e-10)
+
+        mm = astshim.MatrixMap(fullMatrix)
+        pin = rng.uniform(-10, 10, size=(nPts, 10))
+        np.testing.assert_allclose(mm.tran(pin), np.dot(pin, fullMatrix.T), rtol=1e-13, atol=1e-13)
+
     def test_makeBadMatrixMap(self):
         """Show a mysterious memory error yet to be diagnosed
 
@@ -92,6 +92,43 @@ class TestObject(ObjectTestCase):
         cp = obj.copy()
         self.assertEquals(cp.getIdent(), "initial_ident")
 
+    def test_memoryReport(self):
+        """Test memoryReport for simple, compound and shared objects"""
+        zoommap = astshim.ZoomMap(2, 1.3)
+        report = zoommap.memoryReport()
+        self.assertEqual(report.totalBytes, zoommap.getObjSize())
+        self.assertEqual(report.uniqueBytes, zoommap.getObjSize())
+        self.assertEqual(report.sharedBytes, 0)
+        self.assertEqual(list(report.byClass.keys()), ["ZoomMap"])
+        self.assertEqual(report.byClass["ZoomMap"].nObjects, 1)
+        self.assertFalse(report.isEstimate)
+        self.assertFalse(report.byClass["ZoomMap"].isEstimate)
+
+        # a compound mapping that uses the same large LutMap twice
+        lutmap = astshim.LutMap(list(range(10000)), 1.0, 0.5)
+        parmap = astshim.ParallelMap(lutmap, lutmap)
+        report = parmap.memoryReport()
+        lutUsage = report.byClass["LutMap"]
+        self.assertEqual(lutUsage.nObjects, 2)
+        self.assertEqual(lutUsage.nUnique, 1)
+        self.assertGreater(lutUsage.largestBytes, 10000 * 8)
+        self.assertEqual(lutUsage.totalBytes, 2 * lutUsage.uniqueBytes)
+        self.assertEqual(report.totalBytes, parmap.getObjSize())
+        self.assertEqual(report.sharedBytes, lutUsage.uniqueBytes)
+        self.assertEqual(report.byClass["CmpMap"].nObjects, 1)
+
+        # the mappings of a FrameSet are reported by their components
+        frameset = astshim.FrameSet(astshim.Frame(1))
+        frameset.addFrame(1, lutmap, astshim.Frame(1))
+        report = frameset.memoryReport()
+        self.assertEqual(report.byClass["Frame"].nUnique, 2)
+        self.assertEqual(report.byClass["LutMap"].nObjects, 1)
+        self.assertGreater(report.byClass["LutMap"].largestBytes, 10000 * 8)
+        self.assertEqual(report.byClass["FrameSet"].nObjects, 1)
+        self.assertTrue(report.isEstimate)
+        self.assertTrue(report.byClass["FrameSet"].isEstimate)
+        self.assertFalse(report.byClass["LutMap"].isEstimate)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -70,6 +70,32 @@ class TestPermMap(MappingTestCase):
         outdata2 = permmap.tranInverse(indata)
         self.assertTrue(np.allclose(outdata2, [-126.5, 1.1, 3.3]))
 
+    def test_PermMapLargeBatch(self):
+        """Test transforming enough points to copy columns without calling AST
+
+        Small batches are transformed by AST, so they provide the expected values.
+        """
+        rng = np.random.RandomState(5)
+        nPts = 1000
+        for permmap in (
+            astshim.PermMap([2, 3, 1], [3, 1, 2]),
+            astshim.PermMap([2, 1, 3], [3, 1]),
+            astshim.PermMap([-2, 1, 3], [2, 1, -1], [75.3, -126.5]),
+            astshim.SeriesMap(astshim.PermMap([2, 3, 1], [3, 1, 2]), astshim.ZoomMap(3, 1.0)),
+        ):
+            for forward in (True, False):
+                nIn = permmap.getNin() if forward else permmap.getNout()
+                tran = permmap.tran if forward else permmap.tranInverse
+                indata = rng.uniform(-10, 10, size=(nPts, nIn))
+                indata[3, 0] = np.nan
+                expected = np.concatenate([tran(indata[i:i + 10]) for i in range(0, nPts, 10)])
+                for order in ("C", "F"):
+                    outdata = tran(np.array(indata, order=order))
+                    np.testing.assert_equal(outdata, expected)
+                    outdata = np.zeros(expected.shape, order=order)
+                    tran(indata, outdata)
+                    np.testing.assert_equal(outdata, expected)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,71 @@
+from __future__ import absolute_import, division, print_function
+import os.path
+import shutil
+import tempfile
+import unittest
+
+import numpy as np
+
+import astshim
+
+
+class TestPointStream(unittest.TestCase):
+
+    def setUp(self):
+        self.tempDir = tempfile.mkdtemp()
+        self.inPath = os.path.join(self.tempDir, "in.dat")
+        self.outPath = os.path.join(self.tempDir, "out.dat")
+        self.frompos = np.random.uniform(-100, 100, size=(1001, 2))
+        self.frompos.tofile(self.inPath)
+
+    def tearDown(self):
+        shutil.rmtree(self.tempDir)
+
+    def test_MmapPointReader(self):
+        reader = astshim.MmapPointReader(self.inPath, 2)
+        self.assertEqual(reader.getNaxes(), 2)
+        self.assertEqual(reader.getNpoints(), len(self.frompos))
+        self.assertEqual(reader.getPath(), self.inPath)
+
+        buf = np.zeros((600, 2))
+        self.assertEqual(reader.read(buf), 600)
+        self.assertTrue(np.all(buf == self.frompos[0:600]))
+        self.assertEqual(reader.read(buf), 401)
+        self.assertTrue(np.all(buf[0:401] == self.frompos[600:]))
+        self.assertEqual(reader.read(buf), 0)
+
+        # the file size must be a whole number of points
+        with self.assertRaises(Exception):
+            astshim.MmapPointReader(self.inPath, 3)
+        with self.assertRaises(Exception):
+            astshim.MmapPointReader(os.path.join(self.tempDir, "missing.dat"), 2)
+
+    def test_TranStream(self):
+        zoommap = astshim.ZoomMap(2, 1.3)
+        # use a chunk size that does not evenly divide the number of points
+        for chunkSize in (1, 100, 1001, 5000):
+            reader = astshim.MmapPointReader(self.inPath, 2)
+            writer = astshim.FilePointWriter(self.outPath, 2)
+            self.assertEqual(zoommap.tranStream(reader, writer, chunkSize), len(self.frompos))
+            del writer
+            topos = np.fromfile(self.outPath).reshape(-1, 2)
+            self.assertTrue(np.allclose(topos, self.frompos * 1.3))
+
+            reader = astshim.MmapPointReader(self.outPath, 2)
+            writer = astshim.FilePointWriter(self.inPath + ".rt", 2)
+            zoommap.tranInverseStream(reader, writer, chunkSize)
+            del writer
+            rtpos = np.fromfile(self.inPath + ".rt").reshape(-1, 2)
+            self.assertTrue(np.allclose(rtpos, self.frompos))
+
+    def test_TranStreamErrors(self):
+        zoommap = astshim.ZoomMap(2, 1.3)
+        reader = astshim.MmapPointReader(self.inPath, 2)
+        with self.assertRaises(Exception):
+            zoommap.tranStream(reader, astshim.FilePointWriter(self.outPath, 3))
+        with self.assertRaises(Exception):
+            zoommap.tranStream(reader, astshim.FilePointWriter(self.outPath, 2), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
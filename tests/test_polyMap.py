@@ -1,4 +1,7 @@
 from __future__ import absolute_import, division, print_function
+import os
+import shutil
+import tempfile
 import unittest
 
 import numpy as np
@@ -105,6 +108,139 @@ class TestMatrixMap(MappingTestCase):
             self.assertAlmostEqual(xn, xi)
             self.assertAlmostEqual(yn, yi)
 
+    def test_PolyMapPolyTranCache(self):
+        coeff_f = np.array([
+            [1., 1, 1, 0],
+            [1., 1, 0, 1],
+            [1., 2, 1, 0],
+            [-1., 2, 0, 1]
+        ])
+        pm = astshim.PolyMap(coeff_f, 2, "IterInverse=0")
+        pin = np.array([
+            [0.5, 0.0],
+            [-0.25, 0.75],
+        ])
+        lbnd = [-1.0, -1.0]
+        ubnd = [1.0, 1.0]
+        uncached = pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+        expected = uncached.tranInverse(uncached.tran(pin))
+
+        self.assertEqual(astshim.getPolyTranCacheSize(), 0)
+        self.assertEqual(astshim.getPolyTranCacheDir(), "")
+        tempDir = tempfile.mkdtemp()
+        try:
+            astshim.setPolyTranCacheSize(2)
+            self.assertEqual(astshim.getPolyTranCacheSize(), 2)
+            first = pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+            second = pm.copy().polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+            self.assertEqual(first.show(), uncached.show())
+            self.assertEqual(second.show(), uncached.show())
+            # each call returns a separate object
+            second.setIdent("modified")
+            self.assertEqual(pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd).getIdent(), "")
+            # different arguments give a different result
+            other = pm.polyTran(False, 1.0E-8, 0.01, 2, lbnd, ubnd)
+            self.assertNotEqual(other.show(), uncached.show())
+
+            # results are saved to and read from the cache directory
+            astshim.clearPolyTranCache()
+            astshim.setPolyTranCacheDir(tempDir)
+            self.assertEqual(astshim.getPolyTranCacheDir(), tempDir)
+            pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+            cacheFiles = os.listdir(tempDir)
+            self.assertEqual(len(cacheFiles), 1)
+            self.assertTrue(cacheFiles[0].startswith("polyTran-"))
+            astshim.setPolyTranCacheSize(0)
+            fromDisk = pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+            np.testing.assert_allclose(fromDisk.tranInverse(fromDisk.tran(pin)), expected)
+
+            # a corrupt file is ignored
+            with open(os.path.join(tempDir, cacheFiles[0]), "w") as f:
+                f.write("garbage")
+            recomputed = pm.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd)
+            np.testing.assert_allclose(recomputed.tranInverse(recomputed.tran(pin)), expected)
+
+            with self.assertRaises(Exception):
+                pm.polyTran(False, 1.0E-8, 0.01, 4, [-1.0], ubnd)
+        finally:
+            astshim.setPolyTranCacheSize(0)
+            astshim.setPolyTranCacheDir("")
+            shutil.rmtree(tempDir)
+
+    def test_PolyMapPolyTrans(self):
+        polyMaps = []
+        for scale in (1.0, 2.0, 1.0, 3.0):
+            coeff_f = np.array([
+                [scale, 1, 1, 0],
+                [0.1, 1, 0, 2],
+                [scale, 2, 0, 1],
+            ])
+            polyMaps.append(astshim.PolyMap(coeff_f, 2, "IterInverse=0"))
+        lbnd = [-1.0, -1.0]
+        ubnd = [1.0, 1.0]
+        fits = astshim.PolyMap.polyTrans(polyMaps, False, 1.0E-8, 0.01, 4, lbnd, ubnd, 2)
+        self.assertEqual(len(fits), len(polyMaps))
+        for polyMap, fit in zip(polyMaps, fits):
+            self.assertTrue(fit.getTranInverse())
+            self.assertEqual(fit.show(), polyMap.polyTran(False, 1.0E-8, 0.01, 4, lbnd, ubnd).show())
+        # identical PolyMaps share a fit, but not an object
+        fits[2].setIdent("modified")
+        self.assertEqual(fits[0].getIdent(), "")
+
+        self.assertEqual(astshim.PolyMap.polyTrans([], False, 1.0E-8, 0.01, 4, lbnd, ubnd), [])
+        with self.assertRaises(Exception):
+            astshim.PolyMap.polyTrans(polyMaps, False, 1.0E-8, 0.01, 4, [-1.0], ubnd)
+
+    def test_PolyMapTranInverseIterative(self):
+        """Test solving for inputs with tranInverseIterative, using only the forward transform"""
+        # a focal-plane-like distortion over roughly [0, 2000] x [0, 2000]
+        coeff_f = np.array([
+            [1.0, 1, 1, 0],
+            [2.0e-5, 1, 2, 0],
+            [-1.0e-5, 1, 1, 1],
+            [5.0, 1, 0, 0],
+            [1.0, 2, 0, 1],
+            [1.5e-5, 2, 0, 2],
+            [3.0e-9, 2, 3, 0],
+        ])
+        pm = astshim.PolyMap(coeff_f, 2)
+        rng = np.random.RandomState(17)
+        nPts = 500
+        pin = rng.uniform(0, 2000, size=(nPts, 2))
+        pout = pm.tran(pin)
+        pout[7] = np.nan
+
+        tol = 1e-9
+        seed = np.array([[1000.0, 1000.0]])
+        for layout in ("C", "F"):
+            solved = np.zeros(pin.shape, order=layout)
+            converged = pm.tranInverseIterative(pout, seed, solved, tol)
+            self.assertEqual(converged.dtype, bool)
+            self.assertEqual(converged.shape, (nPts,))
+            good = np.ones(nPts, dtype=bool)
+            good[7] = False
+            np.testing.assert_array_equal(converged, good)
+            self.assertTrue(np.all(np.isnan(solved[7])))
+            np.testing.assert_allclose(pm.tran(solved)[good], pout[good], atol=tol)
+            np.testing.assert_allclose(solved[good], pin[good], atol=1e-6)
+
+        # a seed for each point
+        solved = np.zeros(pin.shape)
+        converged = pm.tranInverseIterative(pout, pin + 1.0, solved, tol)
+        self.assertEqual(converged.sum(), nPts - 1)
+        np.testing.assert_allclose(solved[good], pin[good], atol=1e-6)
+
+        # too few iterations to converge from a distant seed
+        converged = pm.tranInverseIterative(pout, np.array([[1.0e5, -1.0e5]]), solved, tol, 0)
+        self.assertFalse(np.any(converged))
+
+        with self.assertRaises(Exception):
+            pm.tranInverseIterative(pout, seed, solved, 0.0)
+        with self.assertRaises(Exception):
+            pm.tranInverseIterative(pout, np.zeros((2, 2)), solved, tol)
+        with self.assertRaises(Exception):
+            astshim.PolyMap(np.array([[1.0, 1, 1]]), 2).tranInverseIterative(pout, seed, solved, tol)
+
 
 if __name__ == "__main__":
     unittest.main()
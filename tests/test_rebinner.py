@@ -0,0 +1,123 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+from numpy.testing import assert_allclose, assert_equal
+
+import astshim
+
+
+class TestRebinner(unittest.TestCase):
+
+    def setUp(self):
+        self.shape = (30, 40)  # (height, width)
+        self.image = np.random.uniform(1, 10, size=self.shape)
+        self.variance = np.random.uniform(0.1, 1, size=self.shape)
+        # output grid is the input grid shifted by +3 in x and -2 in y
+        self.shiftmap = astshim.ShiftMap([3.0, -2.0])
+        self.lbnd = [1, 1]
+        self.ubnd = [self.shape[1], self.shape[0]]
+
+    def shift(self, image):
+        """Return the expected result of rebinning image with self.shiftmap
+        """
+        expected = np.full(image.shape, np.nan)
+        expected[0:-2, 3:] = image[2:, 0:-3]
+        return expected
+
+    def test_RebinnerShift(self):
+        ctrl = astshim.RebinControl(astshim.ResampleKernel_NEAREST)
+        rebinner = astshim.Rebinner(self.lbnd, self.ubnd, ctrl)
+        self.assertEqual(rebinner.getLbnd(), self.lbnd)
+        self.assertEqual(rebinner.getUbnd(), self.ubnd)
+        self.assertFalse(rebinner.hasVariance())
+
+        # adding the same image twice gives the same mean, with half the variance
+        for i in range(2):
+            rebinner.add(self.shiftmap, self.image, self.variance, self.lbnd)
+        self.assertEqual(rebinner.getNumImages(), 2)
+        self.assertTrue(rebinner.hasVariance())
+        self.assertEqual(rebinner.getNused(), 2 * (self.shape[0] - 2) * (self.shape[1] - 3))
+
+        outImage = np.zeros(self.shape)
+        outVariance = np.zeros(self.shape)
+        nBad = rebinner.finish(outImage, outVariance)
+        expected = self.shift(self.image)
+        assert_allclose(outImage, expected)
+        assert_allclose(outVariance, self.shift(self.variance) / 2)
+        self.assertEqual(nBad, np.sum(np.isnan(expected)))
+
+        # finish does not change the accumulators
+        outImage2 = np.zeros(self.shape)
+        rebinner.finish(outImage2, np.zeros((0, 0)))
+        assert_equal(outImage2, outImage)
+
+        rebinner.reset()
+        self.assertEqual(rebinner.getNumImages(), 0)
+        self.assertEqual(rebinner.getNused(), 0)
+        rebinner.finish(outImage, np.zeros((0, 0)))
+        self.assertTrue(np.all(np.isnan(outImage)))
+
+    def test_RebinnerMask(self):
+        image = self.image.copy()
+        image[5, 10] = np.nan
+        mask = np.zeros(self.shape, dtype=np.intc)
+        mask[20, 30] = 0x4
+        ctrl = astshim.RebinControl(astshim.ResampleKernel_NEAREST)
+        ctrl.badMask = 0x4
+        rebinner = astshim.Rebinner(self.lbnd, self.ubnd, ctrl)
+        rebinner.add(self.shiftmap, image, np.zeros((0, 0)), mask, self.lbnd)
+
+        outImage = np.zeros(self.shape)
+        rebinner.finish(outImage, np.zeros((0, 0)))
+        maskedImage = image.copy()
+        maskedImage[20, 30] = np.nan
+        assert_allclose(outImage, self.shift(maskedImage))
+        # the input is not modified
+        self.assertEqual(image[20, 30], self.image[20, 30])
+
+    def test_RebinnerThreads(self):
+        """Threads and tile size change the result by no more than rounding
+        """
+        zoommap = astshim.ZoomMap(2, 0.7)
+        outImages = []
+        for nThreads, tileSize in ((1, 256), (1, 7), (3, 7), (0, 5)):
+            ctrl = astshim.RebinControl(astshim.ResampleKernel_LINEAR)
+            ctrl.nThreads = nThreads
+            ctrl.tileSize = tileSize
+            rebinner = astshim.Rebinner([-5, -5], [30, 20], ctrl)
+            for offset in (0.0, 0.3, -1.2):
+                shiftmap = astshim.ShiftMap([offset, -offset])
+                rebinner.add(shiftmap.of(zoommap), self.image, self.variance, self.lbnd)
+            outImage = np.zeros((26, 36))
+            outVariance = np.zeros((26, 36))
+            rebinner.finish(outImage, outVariance)
+            outImages.append(outImage)
+        for outImage in outImages[1:]:
+            assert_allclose(outImage, outImages[0], rtol=1e-12)
+
+    def test_RebinnerErrors(self):
+        with self.assertRaises(Exception):
+            astshim.Rebinner([1, 1, 1], [5, 5, 5])
+        with self.assertRaises(Exception):
+            astshim.Rebinner([1, 1], [0, 5])
+        ctrl = astshim.RebinControl()
+        ctrl.tileSize = 0
+        with self.assertRaises(Exception):
+            astshim.Rebinner(self.lbnd, self.ubnd, ctrl)
+
+        rebinner = astshim.Rebinner(self.lbnd, self.ubnd)
+        with self.assertRaises(Exception):
+            rebinner.add(astshim.ZoomMap(3, 2.0), self.image, self.variance, self.lbnd)
+        with self.assertRaises(Exception):
+            rebinner.add(self.shiftmap, self.image, np.zeros((3, 3)), self.lbnd)
+        rebinner.add(self.shiftmap, self.image, self.variance, self.lbnd)
+        # variance must be provided for all images or none
+        with self.assertRaises(Exception):
+            rebinner.add(self.shiftmap, self.image, np.zeros((0, 0)), self.lbnd)
+        with self.assertRaises(Exception):
+            rebinner.finish(np.zeros((3, 3)), np.zeros((0, 0)))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,124 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+from numpy.testing import assert_allclose, assert_equal
+
+import astshim
+
+
+class TestResample(unittest.TestCase):
+
+    def setUp(self):
+        self.shape = (30, 40)  # (height, width)
+        self.srcImage = np.random.uniform(1, 10, size=self.shape)
+        # shift src pixels by +3 in x and -2 in y
+        self.shiftmap = astshim.ShiftMap([3.0, -2.0])
+
+    def makeExpected(self, srcImage):
+        """Return the expected result of shifting srcImage by self.shiftmap
+        """
+        expected = np.full(srcImage.shape, np.nan, dtype=srcImage.dtype)
+        expected[0:-2, 3:] = srcImage[2:, 0:-3]
+        return expected
+
+    def test_ResampleShift(self):
+        for kernel in (astshim.ResampleKernel_NEAREST, astshim.ResampleKernel_LINEAR):
+            ctrl = astshim.ResampleControl(kernel)
+            dstImage = np.zeros(self.shape)
+            nBad = self.shiftmap.resample(self.srcImage, [1, 1], dstImage, [1, 1], ctrl)
+            expected = self.makeExpected(self.srcImage)
+            assert_allclose(dstImage, expected)
+            self.assertEqual(nBad, np.sum(np.isnan(expected)))
+
+    def test_ResampleFloat(self):
+        srcImage = self.srcImage.astype(np.float32)
+        dstImage = np.zeros(self.shape, dtype=np.float32)
+        ctrl = astshim.ResampleControl(astshim.ResampleKernel_NEAREST)
+        self.shiftmap.resample(srcImage, [1, 1], dstImage, [1, 1], ctrl)
+        assert_allclose(dstImage, self.makeExpected(srcImage))
+
+    def test_ResampleThreads(self):
+        """Results must not depend on the tile size or number of threads
+        """
+        zoommap = astshim.ZoomMap(2, 0.7)
+        ctrl = astshim.ResampleControl(astshim.ResampleKernel_SINCSINC, 0.01)
+        ctrl.params = [2, 2]
+        dstImage1 = np.zeros(self.shape)
+        zoommap.resample(self.srcImage, [1, 1], dstImage1, [-5, 3], ctrl)
+
+        for nThreads in (1, 3, 0):
+            ctrl.nThreads = nThreads
+            ctrl.tileSize = 7
+            dstImage = np.zeros(self.shape)
+            zoommap.resample(self.srcImage, [1, 1], dstImage, [-5, 3], ctrl)
+            assert_equal(dstImage, dstImage1)
+
+    def test_ResampleVarianceMask(self):
+        srcVariance = np.random.uniform(0.1, 1, size=self.shape)
+        srcMask = np.zeros(self.shape, dtype=np.intc)
+        srcImage = self.srcImage.copy()
+        srcImage[5, 10] = np.nan
+        srcMask[20, 30] = 0x4
+        srcMask[21, 31] = 0x1  # not in badMask, so not treated as bad
+
+        ctrl = astshim.ResampleControl(astshim.ResampleKernel_NEAREST)
+        ctrl.badMask = 0x4
+        ctrl.noDataMask = 0x2
+        dstImage = np.zeros(self.shape)
+        dstVariance = np.zeros(self.shape)
+        dstMask = np.full(self.shape, 0x3, dtype=np.intc)
+        self.shiftmap.resample(srcImage, srcVariance, srcMask, [1, 1],
+                               dstImage, dstVariance, dstMask, [1, 1], ctrl)
+
+        maskedImage = srcImage.copy()
+        maskedImage[20, 30] = np.nan
+        expected = self.makeExpected(maskedImage)
+        assert_allclose(dstImage, expected)
+        expectedVariance = self.makeExpected(srcVariance)
+        expectedVariance[np.isnan(expected)] = np.nan
+        assert_allclose(dstVariance, expectedVariance)
+        expectedMask = np.where(np.isnan(expected), 0x3, 0x1)
+        assert_equal(dstMask, expectedMask)
+        # the inputs are not modified
+        self.assertTrue(np.isnan(srcImage[5, 10]))
+        self.assertEqual(srcImage[20, 30], self.srcImage[20, 30])
+
+    def test_ResampleExtremeValues(self):
+        """The most negative finite value is a genuine pixel value, not a bad one
+        """
+        ctrl = astshim.ResampleControl(astshim.ResampleKernel_NEAREST)
+        for dtype in (np.float64, np.float32):
+            lowest = -np.finfo(dtype).max
+            srcImage = self.srcImage.astype(dtype)
+            srcImage[10, 10] = lowest
+            srcImage[11, 11] = np.nextafter(lowest, dtype(0))
+            for hasNan in (False, True):
+                if hasNan:
+                    srcImage[5, 10] = np.nan
+                dstImage = np.zeros(self.shape, dtype=dtype)
+                nBad = self.shiftmap.resample(srcImage, [1, 1], dstImage, [1, 1], ctrl)
+                expected = self.makeExpected(srcImage)
+                self.assertEqual(dstImage[8, 13], lowest)
+                self.assertEqual(dstImage[9, 14], np.nextafter(lowest, dtype(0)))
+                assert_equal(dstImage, expected)
+                self.assertEqual(nBad, np.sum(np.isnan(expected)))
+
+    def test_ResampleErrors(self):
+        dstImage = np.zeros(self.shape)
+        with self.assertRaises(Exception):
+            self.shiftmap.resample(self.srcImage, [1, 1, 1], dstImage, [1, 1])
+        with self.assertRaises(Exception):
+            astshim.ZoomMap(3, 2.0).resample(self.srcImage, [1, 1], dstImage, [1, 1])
+        ctrl = astshim.ResampleControl()
+        ctrl.tileSize = 0
+        with self.assertRaises(Exception):
+            self.shiftmap.resample(self.srcImage, [1, 1], dstImage, [1, 1], ctrl)
+        ctrl = astshim.ResampleControl()
+        ctrl.nThreads = -1
+        with self.assertRaises(Exception):
+            self.shiftmap.resample(self.srcImage, [1, 1], dstImage, [1, 1], ctrl)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,41 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+
+import astshim
+
+
+class TestScratchArena(unittest.TestCase):
+
+    def test_ScratchArena(self):
+        arena = astshim.ScratchArena.get()
+        arena.trim()
+        self.assertEqual(arena.getInUse(), 0)
+        self.assertEqual(arena.getCapacity(), 0)
+        self.assertEqual(arena.getHighWaterMark(), 0)
+
+        # transforming a C-ordered array borrows scratch buffers to transpose it
+        zoommap = astshim.ZoomMap(2, 1.3)
+        frompos = np.random.uniform(-100, 100, size=(1000, 2))
+        topos = zoommap.tran(frompos)
+        self.assertTrue(np.allclose(topos, frompos * 1.3))
+        self.assertEqual(arena.getInUse(), 0)
+        highWaterMark = arena.getHighWaterMark()
+        self.assertGreaterEqual(highWaterMark, 2 * frompos.size * 8)
+        capacity = arena.getCapacity()
+        self.assertGreaterEqual(capacity, highWaterMark)
+
+        # the memory is reused
+        for i in range(3):
+            zoommap.tran(frompos)
+        self.assertEqual(arena.getCapacity(), capacity)
+        self.assertEqual(arena.getHighWaterMark(), highWaterMark)
+
+        self.assertEqual(arena.trim(), capacity)
+        self.assertEqual(arena.getCapacity(), 0)
+        self.assertEqual(arena.getHighWaterMark(), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
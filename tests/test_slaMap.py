@@ -7,8 +7,28 @@ import astshim
 from astshim.test import MappingTestCase
 
 
+def skySeparation(sky1, sky2):
+    """Return the angular separation of each pair of (lon, lat) positions, in radians"""
+    def unitVectors(sky):
+        return np.column_stack([
+            np.cos(sky[:, 1]) * np.cos(sky[:, 0]),
+            np.cos(sky[:, 1]) * np.sin(sky[:, 0]),
+            np.sin(sky[:, 1]),
+        ])
+    chord = np.linalg.norm(unitVectors(sky1) - unitVectors(sky2), axis=1)
+    return 2 * np.arcsin(np.minimum(1.0, 0.5 * chord))
+
+
 class TestSlaMap(MappingTestCase):
 
+    def setUp(self):
+        rng = np.random.RandomState(11)
+        nPts = 3000
+        self.sky = np.column_stack([
+            rng.uniform(0, 2 * np.pi, size=nPts),
+            np.arcsin(rng.uniform(-1, 1, size=nPts)),
+        ])
+
     def test_SlaMap(self):
         last = 0.1  # an arbitrary value small enough to avoid wrap
         slamap = astshim.SlaMap()
@@ -34,6 +54,73 @@ class TestSlaMap(MappingTestCase):
 
         self.checkRoundTrip(slamap, pin)
 
+    def test_optimizeSkyConversionRotation(self):
+        slamap = astshim.SlaMap()
+        slamap.add("PREC", [1975.0, 2000.0])
+        slamap.add("EQGAL")
+        optimized = astshim.optimizeSkyConversion(slamap)
+        self.assertEqual(optimized.getNin(), 2)
+        self.assertEqual(optimized.getNout(), 2)
+
+        compiled = optimized.freeze()
+        self.assertNotIn("SlaMap", compiled.getPlan())
+        self.assertTrue(compiled.isNative())
+        self.assertTrue(compiled.isNative(False))
+
+        expected = slamap.tran(self.sky)
+        self.assertLess(skySeparation(optimized.tran(self.sky), expected).max(), 1e-12)
+        self.assertLess(skySeparation(compiled.tran(self.sky), expected).max(), 1e-12)
+        self.assertLess(skySeparation(optimized.tranInverse(expected), self.sky).max(), 1e-12)
+
+        # an inverted SlaMap is optimized as the inverse conversion
+        inverse = astshim.optimizeSkyConversion(slamap.getInverse())
+        self.assertLess(skySeparation(inverse.tran(expected), self.sky).max(), 1e-12)
+
+    def test_optimizeSkyConversionMixed(self):
+        """Test a conversion with E-terms of aberration, which are not a rotation"""
+        slamap = astshim.SlaMap()
+        slamap.add("PREC", [1975.0, 2000.0])
+        slamap.add("ADDET", [1950.0])
+        slamap.add("EQGAL")
+        expected = slamap.tran(self.sky)
+
+        # only the E-terms are still transformed by AST
+        optimized = astshim.optimizeSkyConversion(slamap)
+        plan = optimized.freeze().getPlan()
+        self.assertEqual(plan.count("SlaMap"), 1)
+        self.assertGreater(len(plan), 1)
+        self.assertLess(skySeparation(optimized.tran(self.sky), expected).max(), 1e-12)
+
+        # the E-terms (about 0.34 arcseconds) are within a coarse bound of a rotation
+        maxError = 1e-5
+        coarse = astshim.optimizeSkyConversion(slamap, maxError)
+        self.assertNotIn("SlaMap", coarse.freeze().getPlan())
+        separation = skySeparation(coarse.tran(self.sky), expected)
+        self.assertLess(separation.max(), maxError)
+        self.assertGreater(separation.max(), 1e-12)
+
+        # nothing to replace
+        etermmap = astshim.SlaMap()
+        etermmap.add("ADDET", [1950.0])
+        unchanged = astshim.optimizeSkyConversion(etermmap)
+        self.assertEqual(unchanged.getClass(), "SlaMap")
+        np.testing.assert_equal(unchanged.tran(self.sky), etermmap.tran(self.sky))
+
+    def test_optimizeSkyConversionSkyFrames(self):
+        frameSet = astshim.SkyFrame("System=FK5, Equinox=J1975").convert(
+            astshim.SkyFrame("System=Galactic"))
+        optimized = astshim.optimizeSkyConversion(frameSet)
+        self.assertNotIn("SlaMap", optimized.freeze().getPlan())
+        self.assertLess(skySeparation(optimized.tran(self.sky), frameSet.tran(self.sky)).max(), 1e-12)
+
+    def test_optimizeSkyConversionErrors(self):
+        with self.assertRaises(Exception):
+            astshim.optimizeSkyConversion(astshim.ZoomMap(3, 2.0))
+        slamap = astshim.SlaMap()
+        slamap.add("EQGAL")
+        with self.assertRaises(Exception):
+            astshim.optimizeSkyConversion(slamap, 0.0)
+
 
 if __name__ == "__main__":
     unittest.main()
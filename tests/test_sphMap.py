@@ -50,6 +50,39 @@ class TestSphMap(MappingTestCase):
         self.assertEqual(sphmap.getPolarLong(), 0.5)
         self.assertTrue(sphmap.getUnitRadius())
 
+    def test_SphMapLargeBatch(self):
+        """Test transforming many points, by AST and natively
+
+        Mapping.tran gives the same results however many points it is given;
+        a frozen mapping evaluates them natively.
+        """
+        sphmap = astshim.SphMap("PolarLong=0.5")
+        rng = np.random.RandomState(11)
+        nPts = 2000
+        indata = rng.uniform(-2, 2, size=(nPts, 3))
+        indata[5] = [0, 0, 1.5]  # a pole
+        indata[6] = [0, 0, 0]  # no direction
+        indata[7, 2] = np.nan
+        outdata = sphmap.tran(indata)
+        expected = np.concatenate([sphmap.tran(indata[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(outdata, expected)
+        np.testing.assert_equal(outdata[5], [0.5, math.pi/2])
+        self.assertTrue(np.all(np.isnan(outdata[6:8])))
+
+        backdata = sphmap.tranInverse(outdata)
+        expected = np.concatenate([sphmap.tranInverse(outdata[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(backdata, expected)
+        norm = np.linalg.norm(indata, axis=1)
+        np.testing.assert_allclose(backdata[8:], indata[8:] / norm[8:, np.newaxis], rtol=0, atol=1e-15)
+
+        compiled = sphmap.freeze()
+        self.assertEqual(compiled.getPlan(), ["Sph"])
+        self.assertEqual(compiled.getPlan(False), ["Sph"])
+        np.testing.assert_allclose(compiled.tran(indata), outdata, rtol=0, atol=1e-15)
+        inverted = sphmap.getInverse().freeze()
+        self.assertEqual(inverted.getPlan(), ["Sph"])
+        np.testing.assert_allclose(inverted.tran(outdata), backdata, rtol=0, atol=1e-15)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -2,6 +2,8 @@ from __future__ import absolute_import, division, print_function
 import math
 import unittest
 
+import numpy as np
+
 import astshim
 from astshim.test import MappingTestCase
 
@@ -60,6 +62,28 @@ class TestTimeFrame(MappingTestCase):
         self.assertAlmostEqual(frame.getLTOffset(), 55.5, places=3)
         self.assertAlmostEqual(frame.getTimeOrigin(), 66.6, places=3)
         self.assertEqual(frame.getTimeScale(), "UT1")
+    def test_TimeFrameConvertTimes(self):
+        utc = astshim.TimeFrame("TimeScale=UTC")
+        tdb = astshim.TimeFrame("TimeScale=TDB")
+        times = np.concatenate([np.linspace(57000, 58000, 10001), [np.nan]])
+        converted = utc.convertTimes(tdb, times)
+        self.assertEqual(converted.shape, times.shape)
+        self.assertTrue(np.isnan(converted[-1]))
+
+        # AST converts a few times at a time
+        frameSet = utc.convert(tdb)
+        batchSize = 100
+        expected = np.concatenate([frameSet.tran(times[i:i + batchSize].reshape(-1, 1))[:, 0]
+                                   for i in range(0, len(times), batchSize)])
+        # the table matches AST to within a few units in the last place
+        self.assertTrue(np.allclose(converted[:-1], expected[:-1],
+                                    atol=4*np.spacing(np.max(np.abs(expected[:-1]))), rtol=0))
+
+        # strided input (avoiding the ends of days, where leap seconds are) and the reverse conversion;
+        # the round trip is the sum of two conversion errors
+        back = tdb.convertTimes(utc, converted[1:-1:2])
+        self.assertTrue(np.allclose(back, times[1:-1:2], atol=8*np.spacing(np.max(times[1:-1:2])), rtol=0))
+
 
 if __name__ == "__main__":
     unittest.main()
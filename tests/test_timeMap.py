@@ -8,9 +8,24 @@ from astshim.test import MappingTestCase
 
 SecPerDay = 3600*24
 
+# MJD of the leap seconds at the ends of 2015 June and 2016 December
+LeapSecondMjds = (57204.0, 57754.0)
+
 
 class TestTimeMap(MappingTestCase):
 
+    def checkBatched(self, timemap, indata):
+        """Check that a large batch of times is transformed exactly as AST transforms a few at a time
+        """
+        batchSize = 100
+        for forward in (True, False):
+            tran = timemap.tran if forward else timemap.tranInverse
+            outdata = tran(indata)
+            self.assertEqual(outdata.shape, indata.shape)
+            expected = np.concatenate([tran(indata[i:i + batchSize])
+                                       for i in range(0, len(indata), batchSize)])
+            np.testing.assert_array_equal(outdata, expected)
+
     def test_TimeMapDefault(self):
         """Test a TimeMap with no conversions added
         """
@@ -47,6 +62,35 @@ class TestTimeMap(MappingTestCase):
 
         self.checkRoundTrip(timemap, indata)
 
+    def test_TimeMapBatchedUTCTOTAI(self):
+        """Test a large batch of times spanning leap seconds, including times either side of each
+        """
+        timemap = astshim.TimeMap()
+        timemap.add("UTCTOTAI", [0])
+        times = np.linspace(57000, 58000, 20001)
+        edges = [np.nextafter(mjd, 0) for mjd in LeapSecondMjds] + list(LeapSecondMjds)
+        indata = np.concatenate([times, edges, [np.nan]]).reshape(-1, 1)
+        self.checkBatched(timemap, indata)
+
+        # each leap second is a jump of one second
+        outdata = timemap.tran(indata)
+        nEdges = len(LeapSecondMjds)
+        for i in range(nEdges):
+            before = outdata[len(times) + i, 0]
+            after = outdata[len(times) + nEdges + i, 0]
+            self.assertAlmostEqual((after - before)*SecPerDay, 1.0, places=4)
+
+    def test_TimeMapBatchedTTTOTDB(self):
+        """Test a large batch of times through the TDB series, which varies by about 1.7 ms over a year
+        """
+        timemap = astshim.TimeMap()
+        timemap.add("TTTOTDB", [0, 0.5, 0.3, 2000])
+        indata = np.linspace(55000, 60000, 50001).reshape(-1, 1)
+        self.checkBatched(timemap, indata)
+
+        outdata = timemap.tran(indata)
+        self.assertLess(np.max(np.abs(outdata - indata))*SecPerDay, 2e-3)
+
     def test_TimeMapAddInvalid(self):
         timemap = astshim.TimeMap()
 
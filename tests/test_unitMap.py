@@ -28,6 +28,22 @@ class TestUnitMap(MappingTestCase):
         self.assertTrue(np.allclose(outdata, indata))
         self.checkRoundTrip(unitmap, indata)
 
+    def test_UnitMapLargeBatch(self):
+        """Test transforming enough points to copy them without calling AST"""
+        rng = np.random.RandomState(3)
+        indata = rng.uniform(-10, 10, size=(2000, 3))
+        indata[7, 1] = np.nan
+        for unitmap in (
+            astshim.UnitMap(3),
+            astshim.SeriesMap(astshim.PermMap([2, 3, 1], [3, 1, 2]), astshim.PermMap([3, 1, 2], [2, 3, 1])),
+        ):
+            for order in ("C", "F"):
+                outdata = np.zeros(indata.shape, order=order)
+                unitmap.tran(np.array(indata, order=order), outdata)
+                np.testing.assert_equal(outdata, indata)
+                np.testing.assert_equal(unitmap.tranInverse(np.array(indata, order=order)), indata)
+            np.testing.assert_equal(unitmap.tran(indata[::2]), indata[::2])
+
 
 if __name__ == "__main__":
     unittest.main()
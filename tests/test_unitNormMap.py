@@ -49,6 +49,35 @@ class TestUnitNormMap(MappingTestCase):
         with self.assertRaises(Exception):
             astshim.UnitNormMap([])
 
+    def test_UnitNormMapLargeBatch(self):
+        """Test transforming many points, by AST and natively
+
+        Mapping.tran gives the same results however many points it is given;
+        a frozen mapping evaluates them natively.
+        """
+        center = np.array([-1, 1, 2], dtype=float)
+        unitnormmap = astshim.UnitNormMap(center)
+        rng = np.random.RandomState(17)
+        nPts = 2000
+        frompos = rng.uniform(-5, 5, size=(nPts, 3))
+        frompos[3] = center
+        frompos[4, 1] = np.nan
+        topos = unitnormmap.tran(frompos)
+        predpos = np.concatenate([unitnormmap.tran(frompos[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(topos, predpos)
+        self.assertTrue(np.all(np.isnan(topos[4])))
+
+        rtpos = unitnormmap.tranInverse(topos)
+        predpos = np.concatenate([unitnormmap.tranInverse(topos[i:i + 100]) for i in range(0, nPts, 100)])
+        np.testing.assert_array_equal(rtpos, predpos)
+        np.testing.assert_allclose(rtpos[5:], frompos[5:], rtol=1e-14, atol=1e-14)
+
+        compiled = unitnormmap.freeze()
+        self.assertEqual(compiled.getPlan(), ["UnitNorm"])
+        self.assertEqual(compiled.getPlan(False), ["UnitNorm"])
+        np.testing.assert_allclose(compiled.tran(frompos), topos, rtol=1e-15, atol=1e-15)
+        np.testing.assert_allclose(compiled.tranInverse(topos), rtpos, rtol=1e-15, atol=1e-15)
+
     def test_UnitNormMapSimplify(self):
         """Test advanced simplification of UnitNormMap
 
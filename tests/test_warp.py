@@ -0,0 +1,126 @@
+from __future__ import absolute_import, division, print_function
+import unittest
+
+import numpy as np
+from numpy.testing import assert_allclose, assert_equal
+
+import astshim
+
+
+class TestWarp(unittest.TestCase):
+
+    def setUp(self):
+        self.shape = (30, 40)  # (height, width)
+        self.srcImage = np.random.uniform(1, 10, size=self.shape)
+        self.kernels = (astshim.WarpKernel_BILINEAR, astshim.WarpKernel_LANCZOS3)
+
+    def test_WarpIntegerShift(self):
+        """A shift by whole pixels reproduces the image right up to its edges
+        """
+        shiftmap = astshim.ShiftMap([3.0, -2.0])
+        expected = np.full(self.shape, np.nan)
+        expected[0:-2, 3:] = self.srcImage[2:, 0:-3]
+        for kernel in self.kernels:
+            dstImage = np.zeros(self.shape)
+            nNoData = shiftmap.warp(self.srcImage, [1, 1], dstImage, [1, 1], astshim.WarpControl(kernel))
+            assert_allclose(dstImage, expected)
+            self.assertEqual(nNoData, np.sum(np.isnan(expected)))
+
+    def test_WarpHalfPixel(self):
+        shiftmap = astshim.ShiftMap([-0.5, 0.0])
+        ctrl = astshim.WarpControl(astshim.WarpKernel_BILINEAR)
+        dstImage = np.zeros(self.shape)
+        shiftmap.warp(self.srcImage, [1, 1], dstImage, [1, 1], ctrl)
+        assert_allclose(dstImage[:, :-1], 0.5 * (self.srcImage[:, :-1] + self.srcImage[:, 1:]))
+        self.assertTrue(np.all(np.isnan(dstImage[:, -1])))
+
+        # Lanczos interpolation of a linear ramp is nearly exact away from the edges
+        ramp = np.tile(np.arange(self.shape[1], dtype=float), (self.shape[0], 1))
+        ctrl = astshim.WarpControl(astshim.WarpKernel_LANCZOS3)
+        dstImage = np.zeros(self.shape)
+        shiftmap.warp(ramp, [1, 1], dstImage, [1, 1], ctrl)
+        assert_allclose(dstImage[:, 2:-3], ramp[:, 2:-3] + 0.5, atol=0.02)
+        self.assertTrue(np.all(np.isnan(dstImage[:, :2])))
+        self.assertTrue(np.all(np.isnan(dstImage[:, -3:])))
+
+    def test_WarpEdges(self):
+        """Pixels whose kernel extends beyond the source image receive no data
+        """
+        # source position = destination position + (0.25, 0.75)
+        shiftmap = astshim.ShiftMap([-0.25, -0.75])
+        height, width = self.shape
+        # the number of pixels with no data at the low and high ends of each axis
+        for kernel, nLow, nHigh in ((astshim.WarpKernel_BILINEAR, 0, 1),
+                                    (astshim.WarpKernel_LANCZOS3, 2, 3)):
+            dstImage = np.zeros(self.shape)
+            nNoData = shiftmap.warp(self.srcImage, [1, 1], dstImage, [1, 1], astshim.WarpControl(kernel))
+            expectedNoData = np.ones(self.shape, dtype=bool)
+            expectedNoData[nLow:height - nHigh, nLow:width - nHigh] = False
+            assert_equal(np.isnan(dstImage), expectedNoData)
+            self.assertEqual(nNoData, np.sum(expectedNoData))
+
+    def test_WarpFloat(self):
+        zoommap = astshim.ZoomMap(2, 0.8)
+        srcImage = self.srcImage.astype(np.float32)
+        for kernel in self.kernels:
+            ctrl = astshim.WarpControl(kernel)
+            dstImage = np.zeros(self.shape)
+            zoommap.warp(srcImage.astype(float), [1, 1], dstImage, [1, 1], ctrl)
+            dstImageF = np.zeros(self.shape, dtype=np.float32)
+            zoommap.warp(srcImage, [1, 1], dstImageF, [1, 1], ctrl)
+            assert_allclose(dstImageF, dstImage, rtol=1e-6)
+
+    def test_WarpThreads(self):
+        """Results must not depend on the block size or number of threads
+        """
+        zoommap = astshim.ZoomMap(2, 0.7)
+        ctrl = astshim.WarpControl(astshim.WarpKernel_LANCZOS3)
+        dstImage1 = np.zeros(self.shape)
+        zoommap.warp(self.srcImage, [1, 1], dstImage1, [-5, 3], ctrl)
+        for nThreads in (1, 3, 0):
+            ctrl.nThreads = nThreads
+            ctrl.blockSize = 7
+            dstImage = np.zeros(self.shape)
+            zoommap.warp(self.srcImage, [1, 1], dstImage, [-5, 3], ctrl)
+            assert_equal(dstImage, dstImage1)
+
+    def test_WarpMask(self):
+        shiftmap = astshim.ShiftMap([-0.5, 0.0])
+        srcImage = self.srcImage.copy()
+        srcImage[5, 10] = np.nan
+        srcMask = np.zeros(self.shape, dtype=np.intc)
+        srcMask[20, 30] = 0x4
+        srcMask[21, 31] = 0x1
+        ctrl = astshim.WarpControl(astshim.WarpKernel_BILINEAR)
+        ctrl.badMask = 0x4
+        ctrl.noDataMask = 0x2
+        dstImage = np.zeros(self.shape)
+        dstMask = np.full(self.shape, 0x8, dtype=np.intc)
+        shiftmap.warp(srcImage, srcMask, [1, 1], dstImage, dstMask, [1, 1], ctrl)
+
+        # each destination pixel is interpolated from source pixels x and x + 1
+        for x in (9, 10):
+            self.assertTrue(np.isnan(dstImage[5, x]))
+        for x in (29, 30):
+            self.assertTrue(np.isnan(dstImage[20, x]))
+            self.assertEqual(dstMask[20, x], 0x4)
+        for x in (30, 31):
+            self.assertFalse(np.isnan(dstImage[21, x]))
+            self.assertEqual(dstMask[21, x], 0x1)
+        assert_equal(dstMask[:, -1], 0x2)
+        self.assertEqual(dstMask[0, 0], 0)
+
+    def test_WarpErrors(self):
+        dstImage = np.zeros(self.shape)
+        with self.assertRaises(Exception):
+            astshim.ZoomMap(3, 2.0).warp(self.srcImage, [1, 1], dstImage, [1, 1])
+        with self.assertRaises(Exception):
+            astshim.UnitMap(2).warp(self.srcImage, [1, 1, 1], dstImage, [1, 1])
+        ctrl = astshim.WarpControl()
+        ctrl.blockSize = 0
+        with self.assertRaises(Exception):
+            astshim.UnitMap(2).warp(self.srcImage, [1, 1], dstImage, [1, 1], ctrl)
+
+
+if __name__ == "__main__":
+    unittest.main()